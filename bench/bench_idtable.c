@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <uuid/uuid.h>
+#include "../src/storage/epoch.h"
+#include "../src/storage/hashtable.h"
+#include "../src/storage/idtable.h"
+
+// Largest table size; the runs go from 1M up to it
+#define DEFAULT_MAX_NODES 4000000
+
+// Monotonic clock in seconds
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Keys to store and keys that are never stored, in random order
+typedef struct {
+    uuid_t* ids;
+    uuid_t* missing;
+    hash_node_t* nodes;
+    int count;
+} keys_t;
+
+static bool keys_init(keys_t* keys, int count) {
+    keys->ids = malloc(count * sizeof(uuid_t));
+    keys->missing = malloc(count * sizeof(uuid_t));
+    keys->nodes = calloc(count, sizeof(hash_node_t));
+    keys->count = count;
+    if (!keys->ids || !keys->missing || !keys->nodes) return false;
+    for (int i = 0; i < count; i++) {
+        uuid_generate(keys->ids[i]);
+        uuid_generate(keys->missing[i]);
+        keys->nodes[i].key = keys->ids[i];
+        keys->nodes[i].key_len = sizeof(uuid_t);
+    }
+    return true;
+}
+
+static void keys_free(keys_t* keys) {
+    free(keys->ids);
+    free(keys->missing);
+    free(keys->nodes);
+}
+
+typedef struct {
+    double insert, hit, miss, remove;  // ns per operation
+    bool failed;
+} result_t;
+
+// The chained table, hashed with djb2 as the storage tables were
+static result_t run_chained(keys_t* keys) {
+    result_t result = { 0 };
+    hash_table_t table;
+    if (!hash_table_init(&table)) {
+        result.failed = true;
+        return result;
+    }
+    int n = keys->count;
+    volatile size_t found = 0;
+
+    double start = now_s();
+    for (int i = 0; i < n; i++) {
+        keys->nodes[i].hash = hash_bytes(keys->ids[i], sizeof(uuid_t));
+        hash_table_insert(&table, &keys->nodes[i]);
+    }
+    result.insert = (now_s() - start) * 1e9 / n;
+
+    start = now_s();
+    for (int i = 0; i < n; i++) {
+        found += hash_table_find(&table, keys->ids[i], sizeof(uuid_t),
+                                 hash_bytes(keys->ids[i], sizeof(uuid_t))) != NULL;
+    }
+    result.hit = (now_s() - start) * 1e9 / n;
+
+    start = now_s();
+    for (int i = 0; i < n; i++) {
+        found += hash_table_find(&table, keys->missing[i], sizeof(uuid_t),
+                                 hash_bytes(keys->missing[i], sizeof(uuid_t))) != NULL;
+    }
+    result.miss = (now_s() - start) * 1e9 / n;
+
+    start = now_s();
+    for (int i = 0; i < n; i++) {
+        hash_table_remove(&table, &keys->nodes[i]);
+    }
+    result.remove = (now_s() - start) * 1e9 / n;
+
+    result.failed = found != (size_t)n || hash_table_count(&table) != 0;
+    hash_table_destroy(&table);
+    epoch_drain();
+    return result;
+}
+
+// The open-addressing id table
+static result_t run_open(keys_t* keys) {
+    result_t result = { 0 };
+    id_table_t table;
+    if (!id_table_init(&table)) {
+        result.failed = true;
+        return result;
+    }
+    int n = keys->count;
+    volatile size_t found = 0;
+
+    double start = now_s();
+    for (int i = 0; i < n; i++) {
+        keys->nodes[i].hash = id_hash(keys->ids[i]);
+        if (!id_table_insert(&table, &keys->nodes[i])) {
+            result.failed = true;
+            break;
+        }
+    }
+    result.insert = (now_s() - start) * 1e9 / n;
+
+    start = now_s();
+    for (int i = 0; i < n; i++) {
+        found += id_table_find(&table, keys->ids[i], id_hash(keys->ids[i])) != NULL;
+    }
+    result.hit = (now_s() - start) * 1e9 / n;
+
+    start = now_s();
+    for (int i = 0; i < n; i++) {
+        found += id_table_find(&table, keys->missing[i], id_hash(keys->missing[i])) != NULL;
+    }
+    result.miss = (now_s() - start) * 1e9 / n;
+
+    start = now_s();
+    for (int i = 0; i < n; i++) {
+        id_table_remove(&table, &keys->nodes[i]);
+    }
+    result.remove = (now_s() - start) * 1e9 / n;
+
+    result.failed |= found != (size_t)n || id_table_count(&table) != 0;
+    id_table_destroy(&table);
+    epoch_drain();
+    return result;
+}
+
+static void report(const char* name, int n, result_t result) {
+    printf("%-8s n=%-8d insert=%6.1f ns hit=%6.1f ns miss=%6.1f ns delete=%6.1f ns\n", name, n,
+           result.insert, result.hit, result.miss, result.remove);
+}
+
+int main(int argc, char** argv) {
+    // Optional cap on the largest table size
+    int max_nodes = argc > 1 ? atoi(argv[1]) : DEFAULT_MAX_NODES;
+
+    printf("Running id table benchmarks...\n\n");
+    for (int n = 1000000; n <= max_nodes; n *= 2) {
+        keys_t keys;
+        if (!keys_init(&keys, n)) {
+            printf("Failed to allocate keys\n");
+            keys_free(&keys);
+            return 1;
+        }
+        result_t chained = run_chained(&keys);
+        result_t open = run_open(&keys);
+        keys_free(&keys);
+        if (chained.failed || open.failed) {
+            printf("Id table benchmark failed\n");
+            return 1;
+        }
+        report("chained", n, chained);
+        report("id_table", n, open);
+    }
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <json-c/json.h>
+#include "../src/api/cache.h"
+#include "../src/api/stream.h"
+#include "../src/api/writer.h"
+#include "../src/network/vxlan.h"
+#include "../src/storage/memory.h"
+#include "../src/utils/logging.h"
+
+#define DEFAULT_ENDPOINTS 10000
+// Responses built per measurement
+#define ROUNDS 20
+// Bytes a streamed response hands out per read, as the HTTP server asks
+#define STREAM_BLOCK_SIZE (32 * 1024)
+
+#ifdef __GLIBC__
+// Count heap allocations by interposing the allocator entry points
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static atomic_ulong alloc_calls;
+
+void* malloc(size_t size) {
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+static unsigned long allocations(void) {
+    return atomic_load(&alloc_calls);
+}
+#else
+static unsigned long allocations(void) {
+    return 0;
+}
+#endif
+
+// Monotonic clock in seconds
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The json-c tree the handlers used to build for an endpoint
+static void add_string(struct json_object* obj, const char* key, const char* value) {
+    json_object_object_add(obj, key, json_object_new_string(value));
+}
+
+static struct json_object* endpoint_tree(const vxlan_endpoint_t* endpoint) {
+    struct json_object* obj = json_object_new_object();
+    char buf[VXLAN_IP_STR_SIZE];
+    vxlan_uuid_format(&endpoint->id, buf);
+    add_string(obj, "id", buf);
+    vxlan_uuid_format(&endpoint->network_id, buf);
+    add_string(obj, "network_id", buf);
+    vxlan_mac_format(&endpoint->mac_address, buf);
+    add_string(obj, "mac_address", buf);
+    vxlan_ip_format(&endpoint->ip_address, buf);
+    add_string(obj, "ip_address", buf);
+    add_string(obj, "host_id", endpoint->host_id);
+    vxlan_ip_format(endpoint->vtep_ip, buf);
+    add_string(obj, "vtep_ip", buf);
+    vxlan_time_format(endpoint->created_at, buf);
+    add_string(obj, "created_at", buf);
+    vxlan_time_format(endpoint->updated_at, buf);
+    add_string(obj, "updated_at", buf);
+    return obj;
+}
+
+// A listing response the old way: tree, serialization, and the copy the
+// response made of the text. Returns the response size.
+static size_t list_tree(vxlan_endpoint_t** endpoints, int count) {
+    struct json_object* array = json_object_new_array();
+    for (int i = 0; i < count; i++) {
+        json_object_array_add(array, endpoint_tree(endpoints[i]));
+    }
+    const char* json = json_object_to_json_string(array);
+    size_t len = strlen(json);
+    char* copy = malloc(len);
+    if (copy) {
+        memcpy(copy, json, len);
+    }
+    free(copy);
+    json_object_put(array);
+    return len;
+}
+
+// A listing response written directly, the buffer handed over and
+// released as the response would
+static size_t list_writer(vxlan_endpoint_t** endpoints, int count) {
+    writer_t writer;
+    writer_init(&writer);
+    writer_begin_array(&writer);
+    for (int i = 0; i < count; i++) {
+        writer_endpoint(&writer, endpoints[i]);
+    }
+    writer_end_array(&writer);
+    size_t len = 0;
+    writer_buffer_free(writer_take(&writer, &len));
+    return len;
+}
+
+// The same response from the records' cached JSON
+static size_t list_cached(vxlan_endpoint_t** endpoints, int count) {
+    writer_t writer;
+    writer_init(&writer);
+    writer_begin_array(&writer);
+    for (int i = 0; i < count; i++) {
+        cache_write_endpoint(&writer, endpoints[i]);
+    }
+    writer_end_array(&writer);
+    size_t len = 0;
+    writer_buffer_free(writer_take(&writer, &len));
+    return len;
+}
+
+// Build ROUNDS responses of the first count endpoints and report
+// allocations per response and latency
+static void measure(const char* name, size_t (*list)(vxlan_endpoint_t**, int),
+                    vxlan_endpoint_t** endpoints, int count) {
+    list(endpoints, count);  // warm up: pools, spare buffers
+    unsigned long before = allocations();
+    double start = now_s();
+    size_t len = 0;
+    for (int i = 0; i < ROUNDS; i++) {
+        len = list(endpoints, count);
+    }
+    double elapsed = now_s() - start;
+    printf("%-7s endpoints=%-6d %9.1f allocs/response %9.2f us/response %8zu bytes\n", name, count,
+           (double)(allocations() - before) / ROUNDS, elapsed * 1e6 / ROUNDS, len);
+}
+
+// Stream the whole listing ROUNDS times and report allocations, time to
+// the first block, total time and the largest buffer the stream held
+static bool measure_stream(const vxlan_uuid_t* network_id) {
+    static char block[STREAM_BLOCK_SIZE];
+    unsigned long before = allocations();
+    double first = 0, total = 0;
+    size_t len = 0, buffer = 0;
+    for (int i = 0; i < ROUNDS; i++) {
+        double start = now_s();
+        list_stream_t* stream = list_stream_endpoints(network_id);
+        if (!stream) return false;
+        len = 0;
+        ssize_t n;
+        while ((n = list_stream_read(stream, block, sizeof(block))) > 0) {
+            if (len == 0) {
+                first += now_s() - start;
+            }
+            len += (size_t)n;
+            buffer = stream->writer.capacity > buffer ? stream->writer.capacity : buffer;
+        }
+        list_stream_free(stream);
+        total += now_s() - start;
+        if (n < 0) return false;
+    }
+    printf("stream  endpoints=all    %9.1f allocs/response %9.1f us/response %8zu bytes, first block %.1f us, "
+           "buffer %zu bytes\n", (double)(allocations() - before) / ROUNDS, total * 1e6 / ROUNDS, len,
+           first * 1e6 / ROUNDS, buffer);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int total = argc > 1 ? atoi(argv[1]) : DEFAULT_ENDPOINTS;
+    logging_set_level(LOG_LEVEL_ERROR);
+    if (total < 1 || !storage_init()) {
+        printf("Failed to initialize storage\n");
+        return 1;
+    }
+
+    vxlan_network_t* network = vxlan_create_network("bench-tenant", "bench", 0, NULL);
+    if (!network || !storage_save_network(network)) {
+        printf("Failed to create network\n");
+        return 1;
+    }
+    vxlan_ip_t vtep;
+    vxlan_ip_parse("192.0.2.1", &vtep);
+    for (int i = 0; i < total; i++) {
+        vxlan_mac_t mac = {{0x02, 0x00, 0x00, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i}};
+        vxlan_ip_t ip = { AF_INET, {10, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i} };
+        vxlan_endpoint_t* endpoint = vxlan_create_endpoint(&network->id, &mac, &ip, "host1", &vtep);
+        if (!endpoint || !storage_save_endpoint(endpoint)) {
+            printf("Failed to create endpoints\n");
+            return 1;
+        }
+    }
+
+    printf("Running JSON response benchmark...\n\n");
+    int count;
+    storage_read_begin();
+    vxlan_endpoint_t** endpoints = storage_list_endpoints(&network->id, &count);
+    if (!endpoints) {
+        storage_read_end();
+        printf("Failed to list endpoints\n");
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        cache_endpoint(endpoints[i]);
+    }
+    // One record, as for a GET, then the whole listing
+    const int sizes[] = {1, count};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        measure("json-c", list_tree, endpoints, sizes[i]);
+        measure("writer", list_writer, endpoints, sizes[i]);
+        measure("cached", list_cached, endpoints, sizes[i]);
+    }
+    storage_read_end();
+
+    // A conditional GET of the unchanged listing: the list's tag compared
+    // with the client's, and no response body at all
+    char etag[CACHE_ETAG_SIZE];
+    cache_etag(storage_endpoints_version(&network->id), etag);
+    int matched = 0;
+    double start = now_s();
+    for (int i = 0; i < ROUNDS; i++) {
+        char current[CACHE_ETAG_SIZE];
+        cache_etag(storage_endpoints_version(&network->id), current);
+        matched += cache_etag_matches(etag, current);
+    }
+    printf("304     endpoints=%-6d %9.1f matched/response %9.3f us/response\n", count, (double)matched / ROUNDS,
+           (now_s() - start) * 1e6 / ROUNDS);
+    free(endpoints);
+    // The whole listing streamed from storage a page at a time
+    bool ok = measure_stream(&network->id);
+    storage_cleanup();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include "../src/network/vxlan.h"
+#include "../src/storage/memory.h"
+#include "../src/utils/logging.h"
+
+#define DEFAULT_ENDPOINTS 1000000
+// Page size for the paged listing measurements
+#define PAGE_LIMIT 100
+
+#ifdef __GLIBC__
+// Count heap allocations by interposing the allocator entry points
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static atomic_ulong alloc_calls;
+static atomic_ulong alloc_bytes;
+
+void* malloc(size_t size) {
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&alloc_bytes, size, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&alloc_bytes, nmemb * size, memory_order_relaxed);
+    return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&alloc_bytes, size, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+static unsigned long allocations(void) {
+    return atomic_load(&alloc_calls);
+}
+
+// Bytes requested from the heap so far
+static unsigned long allocated_bytes(void) {
+    return atomic_load(&alloc_bytes);
+}
+#else
+static unsigned long allocations(void) {
+    return 0;
+}
+
+static unsigned long allocated_bytes(void) {
+    return 0;
+}
+#endif
+
+// Resident set size in KiB, from /proc where available
+static long rss_kib(void) {
+    FILE* f = fopen("/proc/self/status", "r");
+    if (!f) return -1;
+    char line[256];
+    long rss = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "VmRSS:", 6) == 0) {
+            rss = atol(line + 6);
+            break;
+        }
+    }
+    fclose(f);
+    return rss;
+}
+
+// Monotonic clock in nanoseconds
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+    int total = argc > 1 ? atoi(argv[1]) : DEFAULT_ENDPOINTS;
+
+    logging_set_level(LOG_LEVEL_ERROR);
+    if (!storage_init()) return 1;
+
+    printf("Running memory benchmarks...\n\n");
+
+    vxlan_network_t* network = vxlan_create_network("bench-tenant", "bench", 0, NULL);
+    if (!network || !storage_save_network(network)) {
+        printf("Failed to create network\n");
+        return 1;
+    }
+    vxlan_uuid_t network_id = network->id;
+
+    long rss_before = rss_kib();
+    unsigned long allocs_before = allocations();
+    double start = now_ns();
+
+    vxlan_ip_t vtep;
+    vxlan_ip_parse("192.0.2.1", &vtep);
+    char host[16];
+    for (int i = 0; i < total; i++) {
+        vxlan_mac_t mac = {{0x02, 0x00, (i >> 24) & 0xff, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff}};
+        vxlan_ip_t ip = { AF_INET, {10, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff} };
+        snprintf(host, sizeof(host), "host-%d", i % 1000);
+        vxlan_endpoint_t* endpoint = vxlan_create_endpoint(&network_id, &mac, &ip, host, &vtep);
+        if (!endpoint || !storage_save_endpoint(endpoint)) {
+            printf("Failed to create endpoint %d\n", i);
+            return 1;
+        }
+    }
+
+    double elapsed = now_ns() - start;
+    unsigned long allocs = allocations() - allocs_before;
+    long rss = rss_kib() - rss_before;
+
+    printf("endpoint record=%zu bytes\n", sizeof(vxlan_endpoint_t));
+    printf("endpoints=%d create+save=%.0f ns/op allocs=%.2f/endpoint rss=%ld KiB (%.0f bytes/endpoint)\n",
+           total, elapsed / total, (double)allocs / total, rss, rss * 1024.0 / total);
+
+    // Heap and time per listing request on the one large network
+    unsigned long bytes_before = allocated_bytes();
+    start = now_ns();
+    int count;
+    vxlan_endpoint_t** endpoints = storage_list_endpoints(&network_id, &count);
+    printf("list all:  endpoints=%d heap=%lu bytes time=%.2f ms\n",
+           count, allocated_bytes() - bytes_before, (now_ns() - start) / 1e6);
+    storage_free_endpoint_array(endpoints, count);
+
+    // The middle page costs the same as the first one
+    vxlan_uuid_t after;
+    bool has_after = false;
+    int pages = 0, listed = 0;
+    double page_ns = 0;
+    unsigned long page_bytes = 0;
+    do {
+        bytes_before = allocated_bytes();
+        start = now_ns();
+        endpoints = storage_list_endpoints_page(&network_id, has_after ? &after : NULL, PAGE_LIMIT, &count);
+        page_ns += now_ns() - start;
+        page_bytes += allocated_bytes() - bytes_before;
+        if (!endpoints) break;
+        if (count > 0) {
+            after = endpoints[count - 1]->id;
+            has_after = true;
+        }
+        listed += count;
+        pages++;
+        storage_free_endpoint_array(endpoints, count);
+    } while (count == PAGE_LIMIT);
+    printf("list paged: limit=%d pages=%d endpoints=%d heap=%lu bytes/page time=%.2f us/page\n",
+           PAGE_LIMIT, pages, listed, page_bytes / pages, page_ns / pages / 1000.0);
+
+    storage_cleanup();
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <curl/curl.h>
+
+// The service under test, started separately
+#define BASE_URL "http://localhost:18080/api/v1/networks"
+// Response text kept per request; enough for a network
+#define RESPONSE_SIZE 4096
+#define ID_SIZE 36
+
+// Body sizes and the number of POSTs of each
+typedef struct {
+    const char* name;
+    size_t size;
+    int requests;
+} body_case_t;
+
+static const body_case_t cases[] = {
+    {"1KB", 1024, 2000},
+    {"64KB", 64 * 1024, 500},
+    {"4MB", 4 * 1024 * 1024, 20},
+};
+
+typedef struct {
+    char text[RESPONSE_SIZE];
+    size_t len;
+} response_t;
+
+static size_t write_callback(void* contents, size_t size, size_t nmemb, void* userp) {
+    response_t* response = (response_t*)userp;
+    size_t len = size * nmemb;
+    size_t room = sizeof(response->text) - 1 - response->len;
+    size_t keep = len < room ? len : room;
+    memcpy(response->text + response->len, contents, keep);
+    response->len += keep;
+    response->text[response->len] = '\0';
+    return len;
+}
+
+// Monotonic clock in seconds
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// A network create body of about size bytes: the required fields, padded
+// with labels (which the service ignores) so that most of the body is
+// small objects and strings to parse
+static char* make_body(size_t size) {
+    char* body = malloc(size + 128);
+    if (!body) return NULL;
+    size_t len = (size_t)sprintf(body, "{\"tenant_id\":\"bench-requests\",\"name\":\"bench\",\"labels\":[");
+    for (int i = 0; len + 64 < size; i++) {
+        len += (size_t)sprintf(body + len, "%s{\"key\":\"label-%d\",\"value\":\"value-%d\"}", i ? "," : "", i, i);
+    }
+    strcpy(body + len, "]}");
+    return body;
+}
+
+// Delete a network created by the benchmark
+static void delete_network(CURL* curl, const char* id) {
+    char url[sizeof(BASE_URL) + ID_SIZE + 2];
+    response_t response = {{0}, 0};
+    snprintf(url, sizeof(url), "%s/%s", BASE_URL, id);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    // Drop the POST body before turning the request into a DELETE
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    curl_easy_perform(curl);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, NULL);
+}
+
+// POST the case's body requests times over one keep-alive connection and
+// report throughput; the networks are deleted afterwards, untimed
+static bool run(CURL* curl, const body_case_t* body_case) {
+    char* body = make_body(body_case->size);
+    char (*ids)[ID_SIZE + 1] = calloc(body_case->requests, sizeof(*ids));
+    if (!body || !ids) {
+        free(body);
+        free(ids);
+        return false;
+    }
+    size_t body_len = strlen(body);
+
+    bool ok = true;
+    int created = 0;
+    double start = now_s();
+    for (int i = 0; i < body_case->requests && ok; i++) {
+        response_t response = {{0}, 0};
+        curl_easy_setopt(curl, CURLOPT_URL, BASE_URL);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)body_len);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+
+        long http_code = 0;
+        CURLcode res = curl_easy_perform(curl);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        const char* id = strstr(response.text, "\"id\":\"");
+        ok = res == CURLE_OK && http_code == 201 && id && strlen(id) > 6 + ID_SIZE;
+        if (!ok) {
+            printf("POST %s body failed: %s, HTTP %ld %s\n", body_case->name, curl_easy_strerror(res),
+                   http_code, response.text);
+            break;
+        }
+        memcpy(ids[created++], id + 6, ID_SIZE);
+    }
+    double elapsed = now_s() - start;
+
+    if (ok) {
+        printf("body=%-5s requests=%-5d %8.0f requests/s %8.1f MB/s %8.1f us/request\n", body_case->name,
+               body_case->requests, body_case->requests / elapsed,
+               body_case->requests * (double)body_len / elapsed / 1e6, elapsed * 1e6 / body_case->requests);
+    }
+
+    for (int i = 0; i < created; i++) {
+        delete_network(curl, ids[i]);
+    }
+    free(ids);
+    free(body);
+    return ok;
+}
+
+int main(void) {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        printf("Failed to initialize CURL\n");
+        return 1;
+    }
+    // No "Expect: 100-continue" round trip before large bodies
+    struct curl_slist* headers = curl_slist_append(NULL, "Content-Type: application/json");
+    headers = curl_slist_append(headers, "Expect:");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+
+    printf("Running request body benchmark against %s...\n\n", BASE_URL);
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]) && ok; i++) {
+        ok = run(curl, &cases[i]);
+    }
+    if (!ok) {
+        printf("Request benchmark failed (is the service running?)\n");
+    }
+
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+    curl_global_cleanup();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/api/router.h"
+#include "../src/api/routes.h"
+#include "../src/utils/logging.h"
+
+#define DEFAULT_ROUNDS 2000000
+#define NETWORK_URL API_BASE_PATH "/networks/6f1c2a3b-4d5e-4f60-8a7b-9c0d1e2f3a4b"
+#define ENDPOINT_URL NETWORK_URL "/endpoints/0a1b2c3d-4e5f-4a6b-8c7d-8e9f0a1b2c3d"
+
+// Monotonic clock in seconds
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// A request mix weighted toward host traffic: FDB polls and lookups, then
+// reads, then changes
+static const struct {
+    const char* method;
+    const char* url;
+} requests[] = {
+    {"GET", API_BASE_PATH "/hosts/host-17/fdb"},
+    {"GET", API_BASE_PATH "/hosts/host-17/fdb"},
+    {"GET", API_BASE_PATH "/hosts/host-2041/fdb"},
+    {"GET", API_BASE_PATH "/lookup"},
+    {"GET", API_BASE_PATH "/lookup"},
+    {"GET", API_BASE_PATH "/watch"},
+    {"GET", NETWORK_URL},
+    {"GET", NETWORK_URL "/endpoints"},
+    {"GET", ENDPOINT_URL},
+    {"GET", API_BASE_PATH "/networks"},
+    {"POST", NETWORK_URL "/endpoints"},
+    {"DELETE", ENDPOINT_URL},
+    {"POST", API_BASE_PATH "/networks"},
+    {"DELETE", NETWORK_URL},
+    {"GET", API_BASE_PATH "/nothing/here"},
+    {"PUT", NETWORK_URL},
+};
+#define REQUESTS (sizeof(requests) / sizeof(requests[0]))
+
+// Where an id follows marker, as the handlers used to find path ids
+static const char* find_id(const char* url, const char* marker) {
+    const char* start = strstr(url, marker);
+    return start ? start + strlen(marker) : NULL;
+}
+
+// The dispatch the server did before the route table: a chain of string
+// compares and searches, then a search per path id in the handler. Kept
+// as it was, misroutes included.
+static int dispatch_chain(const char* method, const char* url, const char** params) {
+    if (strcmp(method, "POST") == 0) {
+        if (strncmp(url, "/api/v1/networks", 15) == 0) {
+            return ROUTE_CREATE_NETWORK;
+        } else if (strstr(url, "/endpoints") != NULL) {
+            params[0] = find_id(url, "/networks/");
+            return ROUTE_ADD_ENDPOINT;
+        }
+    } else if (strcmp(method, "GET") == 0) {
+        if (strncmp(url, "/api/v1/networks", 15) == 0) {
+            if (strlen(url) > 16) {
+                params[0] = find_id(url + 16, "/");
+                return ROUTE_GET_NETWORK;
+            } else {
+                return ROUTE_LIST_NETWORKS;
+            }
+        } else if (strstr(url, "/endpoints") != NULL) {
+            params[0] = find_id(url, "/networks/");
+            return ROUTE_LIST_ENDPOINTS;
+        } else if (strcmp(url, "/api/v1/lookup") == 0) {
+            return ROUTE_LOOKUP_ADDRESS;
+        } else if (strcmp(url, "/api/v1/watch") == 0) {
+            return ROUTE_WATCH_CHANGES;
+        } else if (strncmp(url, "/api/v1/hosts/", 14) == 0) {
+            params[0] = url + strlen("/api/v1/hosts/");
+            const char* end = strchr(params[0], '/');
+            return end && end != params[0] && strcmp(end, "/fdb") == 0 ? ROUTE_TAKE_HOST_FDB : -1;
+        }
+    } else if (strcmp(method, "DELETE") == 0) {
+        if (strncmp(url, "/api/v1/networks", 15) == 0) {
+            if (strstr(url, "/endpoints") != NULL) {
+                params[1] = find_id(url, "/endpoints/");
+                params[0] = find_id(url, "/networks/");
+                return ROUTE_REMOVE_ENDPOINT;
+            } else {
+                params[0] = find_id(url + 16, "/");
+                return ROUTE_DELETE_NETWORK;
+            }
+        }
+    }
+    return -1;
+}
+
+// Dispatch the requests picked by mask rounds times each way and report
+// the time per dispatch
+static void measure(const char* name, const router_t* router, const bool* mask, long rounds) {
+    size_t count = 0;
+    for (size_t i = 0; i < REQUESTS; i++) {
+        count += mask[i];
+    }
+
+    // Sum the results so the calls are not optimized away
+    long sum = 0;
+    double start = now_s();
+    for (long r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < REQUESTS; i++) {
+            if (!mask[i]) continue;
+            const char* params[ROUTER_MAX_PARAMS] = {NULL};
+            sum += dispatch_chain(requests[i].method, requests[i].url, params) + (params[0] != NULL);
+        }
+    }
+    double chain = now_s() - start;
+
+    start = now_s();
+    for (long r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < REQUESTS; i++) {
+            if (!mask[i]) continue;
+            route_match_t match;
+            sum += (int)router_match(router, requests[i].method, requests[i].url, &match) + match.route + match.count;
+        }
+    }
+    double table = now_s() - start;
+
+    double dispatches = (double)rounds * count;
+    printf("%-9s requests=%-3zu chain %7.1f ns/dispatch   table %7.1f ns/dispatch   (checksum %ld)\n", name, count,
+           chain * 1e9 / dispatches, table * 1e9 / dispatches, sum);
+}
+
+int main(int argc, char** argv) {
+    long rounds = argc > 1 ? atol(argv[1]) : DEFAULT_ROUNDS;
+    logging_set_level(LOG_LEVEL_ERROR);
+    router_t* router = router_compile(api_routes, API_ROUTE_COUNT);
+    if (rounds < 1 || !router) {
+        printf("Failed to compile routes\n");
+        return 1;
+    }
+
+    printf("Running dispatch benchmark (%ld rounds)...\n\n", rounds);
+
+    // The requests the two disagree on are the old chain's misroutes,
+    // which it reaches early by skipping the rest of the path
+    bool all[REQUESTS], agree[REQUESTS];
+    for (size_t i = 0; i < REQUESTS; i++) {
+        const char* params[ROUTER_MAX_PARAMS];
+        route_match_t match;
+        int old = dispatch_chain(requests[i].method, requests[i].url, params);
+        int route = router_match(router, requests[i].method, requests[i].url, &match) == ROUTER_FOUND ? match.route
+                                                                                                      : -1;
+        all[i] = true;
+        agree[i] = old == route;
+        if (!agree[i]) {
+            printf("misrouted %-6s %-40.40s... to %s, not %s\n", requests[i].method, requests[i].url,
+                   old >= 0 ? api_routes[old].name : "nothing", route >= 0 ? api_routes[route].name : "nothing");
+        }
+    }
+    printf("\n");
+    measure("all", router, all, rounds);
+    measure("agreeing", router, agree, rounds);
+    router_free(router);
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include "../src/network/vxlan.h"
+#include "../src/storage/memory.h"
+#include "../src/utils/logging.h"
+
+// Wall time of each timed run
+#define RUN_SECONDS 1.0
+// Endpoints saved into each network before it is deleted
+#define ENDPOINTS_PER_NETWORK 4
+// Networks listed per tenant page
+#define PAGE_LIMIT 16
+
+typedef struct {
+    int id;
+    unsigned long long networks;  // completed network lifecycles
+    bool failed;
+} worker_t;
+
+static atomic_bool running;
+
+// Monotonic clock in seconds
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// One network lifecycle of a tenant: create the network, save and look up
+// its endpoints, page the tenant's networks and delete the network with
+// its endpoints. Storage operations per lifecycle:
+#define OPS_PER_NETWORK (2 * ENDPOINTS_PER_NETWORK + 3)
+
+static bool lifecycle(const char* tenant, const vxlan_ip_t* vtep) {
+    vxlan_network_t* network = vxlan_create_network(tenant, "bench", 0, NULL);
+    if (!network || !storage_save_network(network)) {
+        vxlan_free_network(network);
+        return false;
+    }
+    vxlan_uuid_t network_id = network->id;
+
+    vxlan_uuid_t ids[ENDPOINTS_PER_NETWORK];
+    for (int i = 0; i < ENDPOINTS_PER_NETWORK; i++) {
+        vxlan_mac_t mac = {{0x02, 0x00, 0x00, 0x00, 0x00, (uint8_t)i}};
+        vxlan_ip_t ip = { AF_INET, {10, 0, 0, (uint8_t)(i + 1)} };
+        vxlan_endpoint_t* endpoint = vxlan_create_endpoint(&network_id, &mac, &ip, "host1", vtep);
+        if (!endpoint || !storage_save_endpoint(endpoint)) {
+            vxlan_free_endpoint(endpoint);
+            return false;
+        }
+        ids[i] = endpoint->id;
+    }
+    storage_read_begin();
+    bool ok = true;
+    for (int i = 0; i < ENDPOINTS_PER_NETWORK && ok; i++) {
+        ok = storage_get_endpoint(NULL, &ids[i]) != NULL;
+    }
+    int count;
+    vxlan_network_t** page = storage_list_networks_page(tenant, NULL, PAGE_LIMIT, &count);
+    ok = ok && page && count >= 1;
+    storage_free_network_array(page, count);
+    storage_read_end();
+
+    return ok && storage_delete_network(&network_id);
+}
+
+// Each worker is its own tenant
+static void* worker_run(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    char tenant[32];
+    vxlan_ip_t vtep;
+    snprintf(tenant, sizeof(tenant), "bench-tenant-%d", worker->id);
+    vxlan_ip_parse("192.0.2.1", &vtep);
+
+    while (atomic_load(&running)) {
+        if (!lifecycle(tenant, &vtep)) {
+            worker->failed = true;
+            return NULL;
+        }
+        worker->networks++;
+    }
+    return NULL;
+}
+
+// Run threads workers for RUN_SECONDS against storage with shards shards
+// and report aggregate throughput
+static bool run(unsigned shards, int threads) {
+    if (!storage_init_shards(shards)) return false;
+
+    worker_t* workers = calloc(threads, sizeof(worker_t));
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    if (!workers || !tids) {
+        free(workers);
+        free(tids);
+        storage_cleanup();
+        return false;
+    }
+
+    atomic_store(&running, true);
+    double start = now_s();
+    for (int i = 0; i < threads; i++) {
+        workers[i].id = i;
+        pthread_create(&tids[i], NULL, worker_run, &workers[i]);
+    }
+    while (now_s() - start < RUN_SECONDS) {
+        struct timespec pause = {0, 10 * 1000 * 1000};
+        nanosleep(&pause, NULL);
+    }
+    atomic_store(&running, false);
+
+    unsigned long long networks = 0;
+    bool failed = false;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        networks += workers[i].networks;
+        failed |= workers[i].failed;
+    }
+    double elapsed = now_s() - start;
+
+    printf("shards=%-3u threads=%-3d %9.0f networks/s %6.2f Mops/s\n", shards, threads,
+           networks / elapsed, networks * OPS_PER_NETWORK / elapsed / 1e6);
+
+    free(workers);
+    free(tids);
+    storage_cleanup();
+    return !failed;
+}
+
+int main(int argc, char** argv) {
+    // Tenants (one thread each); defaults to one per CPU
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = argc > 1 ? atoi(argv[1]) : cpus < 1 ? 1 : (int)cpus;
+    const unsigned shard_counts[] = {1, 2, 4, 8, 16, 32, 64};
+
+    logging_set_level(LOG_LEVEL_ERROR);
+    printf("Running shard scaling benchmark (%d tenants, %ld CPUs)...\n\n", threads, cpus);
+    for (size_t i = 0; i < sizeof(shard_counts) / sizeof(shard_counts[0]); i++) {
+        if (!run(shard_counts[i], threads)) {
+            printf("Shard benchmark failed\n");
+            return 1;
+        }
+    }
+    return 0;
+}
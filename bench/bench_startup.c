@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include "../src/network/vxlan.h"
+#include "../src/storage/memory.h"
+#include "../src/utils/logging.h"
+
+// Endpoints per network
+#define ENDPOINTS_PER_NETWORK 1000
+// Changes logged after the snapshot, replayed on top of it
+#define TAIL_ENDPOINTS 10000
+
+// Monotonic clock in seconds
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long file_size(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : 0;
+}
+
+// Save count endpoints spread over networks of ENDPOINTS_PER_NETWORK
+static bool populate(int count, int seed) {
+    vxlan_network_t* network = NULL;
+    vxlan_ip_t ip, vtep;
+    vxlan_ip_parse("192.0.2.1", &vtep);
+    char host[32];
+
+    for (int i = 0; i < count; i++) {
+        if (i % ENDPOINTS_PER_NETWORK == 0) {
+            char name[32];
+            snprintf(name, sizeof(name), "net-%d-%d", seed, i / ENDPOINTS_PER_NETWORK);
+            network = vxlan_create_network("tenant-bench", name, 0, NULL);
+            if (!network || !storage_save_network(network)) {
+                vxlan_free_network(network);
+                return false;
+            }
+        }
+        vxlan_mac_t mac = {{0x02, 0x00, (uint8_t)(i >> 24), (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i}};
+        ip.family = AF_INET;
+        memset(ip.bytes, 0, sizeof(ip.bytes));
+        memcpy(ip.bytes, &i, sizeof(i));
+        snprintf(host, sizeof(host), "host-%d", i % 1024);
+
+        vxlan_endpoint_t* endpoint = vxlan_create_endpoint(&network->id, &mac, &ip, host, &vtep);
+        if (!endpoint || !storage_save_endpoint(endpoint)) {
+            vxlan_free_endpoint(endpoint);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Time from an empty process to a store ready to serve requests
+static bool time_startup(const char* path, const char* label, int expected) {
+    double start = now_s();
+    if (!storage_init() || !storage_open_log(path, WAL_SYNC_NONE)) return false;
+    double elapsed = now_s() - start;
+
+    int networks;
+    vxlan_network_t** list = storage_list_networks(NULL, &networks);
+    storage_free_network_array(list, networks);
+    printf("%-22s %8.3f s  (%d networks)\n", label, elapsed, networks);
+    return list && networks == expected;
+}
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 1000000;
+    const char* path = argc > 2 ? argv[2] : "bench_startup.wal";
+    char snap[256];
+    snprintf(snap, sizeof(snap), "%s.snap", path);
+    int networks = (count + ENDPOINTS_PER_NETWORK - 1) / ENDPOINTS_PER_NETWORK;
+    int tail_networks = (TAIL_ENDPOINTS + ENDPOINTS_PER_NETWORK - 1) / ENDPOINTS_PER_NETWORK;
+
+    logging_set_level(LOG_LEVEL_ERROR);
+    printf("Running startup benchmark (%d endpoints, %s)...\n\n", count, path);
+    unlink(path);
+    unlink(snap);
+
+    double start = now_s();
+    bool ok = storage_init() && storage_open_log(path, WAL_SYNC_NONE) && populate(count, 0);
+    printf("%-22s %8.3f s  (log %ld MB)\n", "populate", now_s() - start, file_size(path) >> 20);
+    storage_cleanup();
+
+    // Cold start: the whole log is replayed
+    ok = ok && time_startup(path, "log replay", networks);
+
+    start = now_s();
+    ok = ok && storage_snapshot();
+    printf("%-22s %8.3f s  (snapshot %ld MB)\n", "snapshot", now_s() - start, file_size(snap) >> 20);
+    ok = ok && populate(TAIL_ENDPOINTS, 1);
+    storage_cleanup();
+
+    // Warm start: snapshot plus a short log tail
+    ok = ok && time_startup(path, "snapshot + log tail", networks + tail_networks);
+    storage_cleanup();
+
+    unlink(path);
+    unlink(snap);
+    if (!ok) {
+        printf("Startup benchmark failed\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,393 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/network/vxlan.h"
+#include "../src/storage/memory.h"
+#include "../src/utils/logging.h"
+
+// Endpoints in the network whose listing is timed
+#define TARGET_NETWORK_SIZE 100
+// Endpoints per filler network used to grow the table
+#define FILLER_NETWORK_SIZE 100
+// Networks owned by the tenant whose listing is timed
+#define TARGET_TENANT_SIZE 10
+#define LIST_ITERATIONS 1000
+// Random gets timed after the table is fully populated
+#define GET_ITERATIONS 1000000
+
+// Monotonic clock in nanoseconds
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// xorshift64 pseudo-random generator, deterministic across runs
+static unsigned long long next_random(unsigned long long* state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static int compare_float(const void* a, const void* b) {
+    float fa = *(const float*)a, fb = *(const float*)b;
+    return (fa > fb) - (fa < fb);
+}
+
+// Deterministic network id for bench networks
+static vxlan_uuid_t bench_network_id(int n) {
+    vxlan_uuid_t uuid = {{0}};
+    memcpy(uuid.bytes, &n, sizeof(n));
+    return uuid;
+}
+
+// Store a network with id bench_network_id(n), for endpoints to be saved in
+static bool save_bench_network(int n) {
+    vxlan_network_t fields = { .tenant_id = "tenant-bench", .name = "net" };
+    fields.id = bench_network_id(n);
+    vxlan_network_t* network = vxlan_restore_network(&fields);
+    if (!network || !storage_save_network(network)) {
+        vxlan_free_network(network);
+        return false;
+    }
+    return true;
+}
+
+// Create endpoint number n, with a unique MAC and IP
+static vxlan_endpoint_t* bench_endpoint(const vxlan_uuid_t* network_id, int n) {
+    vxlan_mac_t mac = {{0x02, 0x00, (n >> 24) & 0xff, (n >> 16) & 0xff, (n >> 8) & 0xff, n & 0xff}};
+    vxlan_ip_t ip, vtep;
+    char ip_str[16];
+    snprintf(ip_str, sizeof(ip_str), "10.%d.%d.%d", (n >> 16) & 0xff, (n >> 8) & 0xff, n & 0xff);
+    vxlan_ip_parse(ip_str, &ip);
+    vxlan_ip_parse("192.0.2.1", &vtep);
+    return vxlan_create_endpoint(network_id, &mac, &ip, "host1", &vtep);
+}
+
+// Create and store count endpoints in network_id
+static bool populate_network(const vxlan_uuid_t* network_id, int count, int base) {
+    for (int i = 0; i < count; i++) {
+        vxlan_endpoint_t* endpoint = bench_endpoint(network_id, base + i);
+        if (!endpoint || !storage_save_endpoint(endpoint)) {
+            vxlan_free_endpoint(endpoint);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Time listing one fixed-size network while the total endpoint count grows
+static bool bench_list_endpoints(int total) {
+    if (!storage_init()) return false;
+
+    vxlan_uuid_t target = bench_network_id(0);
+    int created = 0;
+    if (!save_bench_network(0) || !populate_network(&target, TARGET_NETWORK_SIZE, created)) {
+        storage_cleanup();
+        return false;
+    }
+    created += TARGET_NETWORK_SIZE;
+
+    for (int n = 0; created < total; n++) {
+        vxlan_uuid_t filler = bench_network_id(n + 1);
+        int batch = total - created < FILLER_NETWORK_SIZE ? total - created : FILLER_NETWORK_SIZE;
+        if (!save_bench_network(n + 1) || !populate_network(&filler, batch, created)) {
+            storage_cleanup();
+            return false;
+        }
+        created += batch;
+    }
+
+    double start = now_ns();
+    for (int i = 0; i < LIST_ITERATIONS; i++) {
+        int count;
+        vxlan_endpoint_t** endpoints = storage_list_endpoints(&target, &count);
+        if (!endpoints || count != TARGET_NETWORK_SIZE) {
+            printf("list_endpoints returned %d endpoints, expected %d\n", count, TARGET_NETWORK_SIZE);
+            storage_free_endpoint_array(endpoints, count);
+            storage_cleanup();
+            return false;
+        }
+        storage_free_endpoint_array(endpoints, count);
+    }
+    double elapsed = now_ns() - start;
+
+    printf("list_endpoints total=%-8d network_size=%d avg=%.2f us\n",
+           total, TARGET_NETWORK_SIZE, elapsed / LIST_ITERATIONS / 1000.0);
+
+    storage_cleanup();
+    return true;
+}
+
+// Time listing one tenant's networks while the total network count grows
+static bool bench_list_tenant_networks(int total) {
+    if (!storage_init()) return false;
+
+    char tenant_id[32];
+    for (int i = 0; i < total; i++) {
+        if (i < TARGET_TENANT_SIZE) {
+            snprintf(tenant_id, sizeof(tenant_id), "target-tenant");
+        } else {
+            snprintf(tenant_id, sizeof(tenant_id), "tenant-%d", i / TARGET_TENANT_SIZE);
+        }
+        vxlan_network_t* network = vxlan_create_network(tenant_id, "net", (i % MAX_VNI) + 1, NULL);
+        if (!network || !storage_save_network(network)) {
+            vxlan_free_network(network);
+            storage_cleanup();
+            return false;
+        }
+    }
+
+    double start = now_ns();
+    for (int i = 0; i < LIST_ITERATIONS; i++) {
+        int count;
+        vxlan_network_t** networks = storage_list_networks("target-tenant", &count);
+        if (!networks || count != TARGET_TENANT_SIZE) {
+            printf("list_networks returned %d networks, expected %d\n", count, TARGET_TENANT_SIZE);
+            storage_free_network_array(networks, count);
+            storage_cleanup();
+            return false;
+        }
+        storage_free_network_array(networks, count);
+    }
+    double elapsed = now_ns() - start;
+
+    printf("list_networks  total=%-8d tenant_size=%d avg=%.2f us\n",
+           total, TARGET_TENANT_SIZE, elapsed / LIST_ITERATIONS / 1000.0);
+
+    storage_cleanup();
+    return true;
+}
+
+// Time saves and gets as the endpoint table grows to total entries.
+// One get of an already stored endpoint is issued after every save so the
+// p99 get latency covers the table's growth phases.
+static bool bench_get_save(int total) {
+    if (!storage_init()) return false;
+
+    vxlan_endpoint_t** endpoints = malloc(total * sizeof(vxlan_endpoint_t*));
+    float* get_latency = malloc(total * sizeof(float));
+    if (!endpoints || !get_latency || !save_bench_network(0)) {
+        free(endpoints);
+        free(get_latency);
+        storage_cleanup();
+        return false;
+    }
+
+    vxlan_uuid_t network_id = bench_network_id(0);
+    for (int i = 0; i < total; i++) {
+        endpoints[i] = bench_endpoint(&network_id, i);
+        if (!endpoints[i]) {
+            total = i;
+            break;
+        }
+    }
+
+    unsigned long long seed = 88172645463325252ULL;
+    double save_ns = 0;
+    for (int i = 0; i < total; i++) {
+        double start = now_ns();
+        bool saved = storage_save_endpoint(endpoints[i]);
+        double mid = now_ns();
+        const vxlan_uuid_t* id = &endpoints[next_random(&seed) % (i + 1)]->id;
+        vxlan_endpoint_t* found = storage_get_endpoint(NULL, id);
+        double end = now_ns();
+        if (!saved || !found) {
+            printf("save/get failed at entry %d\n", i);
+            free(endpoints);
+            free(get_latency);
+            storage_cleanup();
+            return false;
+        }
+        save_ns += mid - start;
+        get_latency[i] = (float)(end - mid);
+    }
+
+    qsort(get_latency, total, sizeof(float), compare_float);
+    float p99_growth = get_latency[(size_t)(total * 0.99)];
+
+    double start = now_ns();
+    for (int i = 0; i < GET_ITERATIONS; i++) {
+        const vxlan_uuid_t* id = &endpoints[next_random(&seed) % total]->id;
+        if (!storage_get_endpoint(NULL, id)) {
+            printf("get failed\n");
+            break;
+        }
+    }
+    double get_ns = (now_ns() - start) / GET_ITERATIONS;
+
+    printf("get/save       total=%-8d save=%.0f ns get=%.0f ns p99_get_during_growth=%.0f ns\n",
+           total, save_ns / total, get_ns, p99_growth);
+
+    free(endpoints);
+    free(get_latency);
+    storage_cleanup();
+    return true;
+}
+
+// Time MAC and IP lookups by VNI across networks of FILLER_NETWORK_SIZE
+// endpoints as the endpoint table grows to total entries
+static bool bench_lookup(int total) {
+    if (!storage_init()) return false;
+
+    int networks = (total + FILLER_NETWORK_SIZE - 1) / FILLER_NETWORK_SIZE;
+    vxlan_endpoint_t** endpoints = malloc(total * sizeof(vxlan_endpoint_t*));
+    if (!endpoints) {
+        storage_cleanup();
+        return false;
+    }
+    for (int n = 0, created = 0; n < networks; n++) {
+        vxlan_network_t* network = vxlan_create_network("tenant-bench", "net", (uint32_t)n + 1, NULL);
+        if (!network || !storage_save_network(network)) {
+            vxlan_free_network(network);
+            free(endpoints);
+            storage_cleanup();
+            return false;
+        }
+        for (; created < total && created < (n + 1) * FILLER_NETWORK_SIZE; created++) {
+            endpoints[created] = bench_endpoint(&network->id, created);
+            if (!endpoints[created] || !storage_save_endpoint(endpoints[created])) {
+                vxlan_free_endpoint(endpoints[created]);
+                free(endpoints);
+                storage_cleanup();
+                return false;
+            }
+        }
+    }
+
+    unsigned long long seed = 88172645463325252ULL;
+    double mac_ns = 0, ip_ns = 0;
+    for (int i = 0; i < GET_ITERATIONS; i++) {
+        int n = (int)(next_random(&seed) % total);
+        uint32_t vni = (uint32_t)(n / FILLER_NETWORK_SIZE) + 1;
+        double start = now_ns();
+        vxlan_endpoint_t* by_mac = storage_lookup_mac(vni, &endpoints[n]->mac_address);
+        double mid = now_ns();
+        vxlan_endpoint_t* by_ip = storage_lookup_ip(vni, &endpoints[n]->ip_address);
+        double end = now_ns();
+        if (by_mac != endpoints[n] || by_ip != endpoints[n]) {
+            printf("lookup failed for endpoint %d\n", n);
+            free(endpoints);
+            storage_cleanup();
+            return false;
+        }
+        mac_ns += mid - start;
+        ip_ns += end - mid;
+    }
+
+    printf("lookup         total=%-8d mac=%.0f ns ip=%.0f ns\n",
+           total, mac_ns / GET_ITERATIONS, ip_ns / GET_ITERATIONS);
+
+    free(endpoints);
+    storage_cleanup();
+    return true;
+}
+
+// Save a network of size endpoints; its id is returned in *network_id
+static bool populate_teardown_network(int size, vxlan_uuid_t* network_id) {
+    vxlan_network_t* network = vxlan_create_network("tenant-bench", "teardown", 0, NULL);
+    if (!network || !storage_save_network(network)) {
+        vxlan_free_network(network);
+        return false;
+    }
+    *network_id = network->id;
+    return populate_network(network_id, size, 0);
+}
+
+// Time deleting a network of size endpoints in one cascade, with its
+// teardown commands, against deleting the endpoints one by one first
+static bool bench_delete_network(int size) {
+    if (!storage_init()) return false;
+
+    vxlan_uuid_t network_id;
+    int count;
+    vxlan_endpoint_t** endpoints = NULL;
+    bool ok = populate_teardown_network(size, &network_id) &&
+              (endpoints = storage_list_endpoints(&network_id, &count)) && count == size;
+    vxlan_uuid_t* ids = ok ? malloc(size * sizeof(vxlan_uuid_t)) : NULL;
+    for (int i = 0; ids && i < size; i++) {
+        ids[i] = endpoints[i]->id;
+    }
+    storage_free_endpoint_array(endpoints, count);
+    ok = ok && ids;
+
+    double start = now_ns();
+    for (int i = 0; ok && i < size; i++) {
+        ok = storage_delete_endpoint(&network_id, &ids[i]);
+    }
+    ok = ok && storage_delete_network(&network_id);
+    double one_by_one = now_ns() - start;
+    free(ids);
+
+    vxlan_network_t* network;
+    char* teardown = NULL;
+    ok = ok && populate_teardown_network(size, &network_id);
+    start = now_ns();
+    storage_read_begin();
+    ok = ok && storage_delete_network_endpoints(&network_id, &network, &endpoints, &count) && count == size;
+    if (ok) {
+        teardown = vxlan_generate_teardown_cmds(network, endpoints, count);
+        storage_free_endpoint_array(endpoints, count);
+    }
+    storage_read_end();
+    double cascade = now_ns() - start;
+    ok = ok && teardown;
+    free(teardown);
+
+    if (ok) {
+        printf("delete_network endpoints=%-8d cascade+teardown=%.2f ms one_by_one=%.2f ms\n", size,
+               cascade / 1e6, one_by_one / 1e6);
+    }
+    storage_cleanup();
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    // Optional cap on the largest table size, 1M by default; pass 10000000
+    // for the 10M runs
+    int max_total = argc > 1 ? atoi(argv[1]) : 1000000;
+    const int totals[] = {10000, 100000, 1000000, 10000000};
+
+    logging_set_level(LOG_LEVEL_ERROR);
+
+    printf("Running storage benchmarks...\n\n");
+    for (size_t i = 0; i < sizeof(totals) / sizeof(totals[0]); i++) {
+        if (totals[i] > max_total) break;
+        if (!bench_list_endpoints(totals[i])) {
+            printf("list_endpoints benchmark failed\n");
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < sizeof(totals) / sizeof(totals[0]); i++) {
+        if (totals[i] > max_total) break;
+        if (!bench_list_tenant_networks(totals[i])) {
+            printf("list_networks benchmark failed\n");
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < sizeof(totals) / sizeof(totals[0]); i++) {
+        if (totals[i] > max_total) break;
+        if (!bench_get_save(totals[i])) {
+            printf("get/save benchmark failed\n");
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < sizeof(totals) / sizeof(totals[0]); i++) {
+        if (totals[i] > max_total) break;
+        if (!bench_lookup(totals[i])) {
+            printf("lookup benchmark failed\n");
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < sizeof(totals) / sizeof(totals[0]); i++) {
+        if (totals[i] > max_total) break;
+        if (!bench_delete_network(totals[i])) {
+            printf("delete_network benchmark failed\n");
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include "../src/network/vxlan.h"
+#include "../src/storage/memory.h"
+#include "../src/utils/logging.h"
+
+// Endpoints preloaded before the timed runs
+#define PRELOAD_ENDPOINTS 100000
+// Wall time of each timed run
+#define RUN_SECONDS 1.0
+// One write (save + delete) per this many operations
+#define WRITE_INTERVAL 20
+// Writers and write latencies kept per writer in the listing run
+#define LATENCY_WRITERS 2
+#define LATENCY_SAMPLES 200000
+
+typedef struct {
+    int id;
+    bool read_only;
+    unsigned long long ops;
+    bool failed;
+    double* latencies;  // listing run only, seconds per write
+} worker_t;
+
+static vxlan_uuid_t* preloaded_ids;
+static atomic_bool running;
+
+// Monotonic clock in seconds
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift64 pseudo-random generator
+static unsigned long long next_random(unsigned long long* state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+// Store network n, for bench_endpoint() to create endpoints in
+static bool save_bench_network(int n) {
+    vxlan_network_t fields = { .tenant_id = "tenant-bench", .name = "threads" };
+    memcpy(fields.id.bytes, &n, sizeof(n));
+    vxlan_network_t* network = vxlan_restore_network(&fields);
+    if (!network || !storage_save_network(network)) {
+        vxlan_free_network(network);
+        return false;
+    }
+    return true;
+}
+
+// Create endpoint number seq in network n; addresses are unique per seq
+static vxlan_endpoint_t* bench_endpoint(int n, int seq) {
+    vxlan_uuid_t network_id = {{0}};
+    vxlan_mac_t mac = {{0x02, 0x00, (seq >> 24) & 0xff, (seq >> 16) & 0xff, (seq >> 8) & 0xff, seq & 0xff}};
+    vxlan_ip_t ip = { AF_INET, {10, (seq >> 16) & 0xff, (seq >> 8) & 0xff, seq & 0xff} };
+    vxlan_ip_t vtep;
+    memcpy(network_id.bytes, &n, sizeof(n));
+    vxlan_ip_parse("192.0.2.1", &vtep);
+    return vxlan_create_endpoint(&network_id, &mac, &ip, "host1", &vtep);
+}
+
+// Random gets on preloaded endpoints; in mixed mode every WRITE_INTERVAL-th
+// operation saves and deletes a thread-private endpoint instead
+static void* worker_run(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    unsigned long long seed = 0x9E3779B97F4A7C15ULL * (worker->id + 1);
+
+    while (atomic_load(&running)) {
+        for (int i = 0; i < WRITE_INTERVAL; i++) {
+            if (!worker->read_only && i == 0) {
+                vxlan_endpoint_t* endpoint = bench_endpoint(worker->id + 1, 0);
+                if (!endpoint) {
+                    worker->failed = true;
+                    return NULL;
+                }
+                vxlan_uuid_t network_id = endpoint->network_id, id = endpoint->id;
+                if (!storage_save_endpoint(endpoint) || !storage_delete_endpoint(&network_id, &id)) {
+                    worker->failed = true;
+                    return NULL;
+                }
+            } else {
+                const vxlan_uuid_t* id = &preloaded_ids[next_random(&seed) % PRELOAD_ENDPOINTS];
+                if (!storage_get_endpoint(NULL, id)) {
+                    worker->failed = true;
+                    return NULL;
+                }
+            }
+            worker->ops++;
+        }
+    }
+    return NULL;
+}
+
+// Run threads workers for RUN_SECONDS and report aggregate throughput
+static bool run(int threads, bool read_only) {
+    worker_t* workers = calloc(threads, sizeof(worker_t));
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    if (!workers || !tids) {
+        free(workers);
+        free(tids);
+        return false;
+    }
+
+    atomic_store(&running, true);
+    double start = now_s();
+    for (int i = 0; i < threads; i++) {
+        workers[i].id = i;
+        workers[i].read_only = read_only;
+        pthread_create(&tids[i], NULL, worker_run, &workers[i]);
+    }
+    while (now_s() - start < RUN_SECONDS) {
+        struct timespec pause = {0, 10 * 1000 * 1000};
+        nanosleep(&pause, NULL);
+    }
+    atomic_store(&running, false);
+
+    unsigned long long ops = 0;
+    bool failed = false;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        ops += workers[i].ops;
+        failed |= workers[i].failed;
+    }
+    double elapsed = now_s() - start;
+
+    printf("%-10s threads=%-3d %.2f Mops/s\n", read_only ? "get-only" : "95/5 mix",
+           threads, ops / elapsed / 1e6);
+
+    free(workers);
+    free(tids);
+    return !failed;
+}
+
+// Save and delete endpoints in the preloaded network, timing each pair
+static void* writer_run(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    vxlan_uuid_t network_id = {{0}};
+    while (atomic_load(&running) && worker->ops < LATENCY_SAMPLES) {
+        vxlan_endpoint_t* endpoint = bench_endpoint(0, PRELOAD_ENDPOINTS + worker->id);
+        if (!endpoint) {
+            worker->failed = true;
+            return NULL;
+        }
+        vxlan_uuid_t id = endpoint->id;
+        double start = now_s();
+        if (!storage_save_endpoint(endpoint) || !storage_delete_endpoint(&network_id, &id)) {
+            worker->failed = true;
+            return NULL;
+        }
+        worker->latencies[worker->ops++] = now_s() - start;
+    }
+    return NULL;
+}
+
+// List every endpoint of the preloaded network, over and over
+static void* lister_run(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    vxlan_uuid_t network_id = {{0}};
+    while (atomic_load(&running)) {
+        int count;
+        storage_read_begin();
+        vxlan_endpoint_t** endpoints = storage_list_endpoints(&network_id, &count);
+        if (!endpoints || count < PRELOAD_ENDPOINTS) {
+            worker->failed = true;
+        }
+        storage_free_endpoint_array(endpoints, count);
+        storage_read_end();
+        if (worker->failed) return NULL;
+        worker->ops++;
+    }
+    return NULL;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Write latency of LATENCY_WRITERS writers while listers list the network
+// the writers write to
+static bool run_listing(int listers) {
+    worker_t workers[LATENCY_WRITERS + 64] = {0};
+    pthread_t tids[LATENCY_WRITERS + 64];
+    double* latencies = malloc(LATENCY_WRITERS * LATENCY_SAMPLES * sizeof(double));
+    if (!latencies || listers > 64) {
+        free(latencies);
+        return false;
+    }
+
+    atomic_store(&running, true);
+    double start = now_s();
+    for (int i = 0; i < LATENCY_WRITERS + listers; i++) {
+        workers[i].id = i;
+        workers[i].latencies = latencies + (size_t)i * LATENCY_SAMPLES;
+        pthread_create(&tids[i], NULL, i < LATENCY_WRITERS ? writer_run : lister_run, &workers[i]);
+    }
+    while (now_s() - start < RUN_SECONDS) {
+        struct timespec pause = {0, 10 * 1000 * 1000};
+        nanosleep(&pause, NULL);
+    }
+    atomic_store(&running, false);
+
+    // Pack the samples of all writers together
+    size_t samples = 0;
+    unsigned long long lists = 0;
+    bool failed = false;
+    for (int i = 0; i < LATENCY_WRITERS + listers; i++) {
+        pthread_join(tids[i], NULL);
+        failed |= workers[i].failed;
+        if (i < LATENCY_WRITERS) {
+            memmove(latencies + samples, workers[i].latencies, workers[i].ops * sizeof(double));
+            samples += workers[i].ops;
+        } else {
+            lists += workers[i].ops;
+        }
+    }
+    double elapsed = now_s() - start;
+
+    if (samples > 0) {
+        qsort(latencies, samples, sizeof(double), compare_double);
+        printf("writes     listers=%-3d %.0f writes/s, p50 %.1f us, p99 %.1f us, %.1f lists/s\n", listers,
+               samples / elapsed, latencies[samples / 2] * 1e6, latencies[samples * 99 / 100] * 1e6,
+               lists / elapsed);
+    }
+
+    free(latencies);
+    return !failed && samples > 0;
+}
+
+int main(int argc, char** argv) {
+    // Optional cap on the thread count
+    int max_threads = argc > 1 ? atoi(argv[1]) : 64;
+    const int thread_counts[] = {1, 2, 4, 8, 16, 32, 64};
+
+    logging_set_level(LOG_LEVEL_ERROR);
+    if (!storage_init()) return 1;
+
+    preloaded_ids = malloc(PRELOAD_ENDPOINTS * sizeof(*preloaded_ids));
+    if (!preloaded_ids) return 1;
+    // Network 0 is preloaded; each worker writes to its own after it
+    int most_threads = thread_counts[sizeof(thread_counts) / sizeof(thread_counts[0]) - 1];
+    for (int n = 0; n <= most_threads && n <= max_threads; n++) {
+        if (!save_bench_network(n)) {
+            printf("Failed to create networks\n");
+            return 1;
+        }
+    }
+    for (int i = 0; i < PRELOAD_ENDPOINTS; i++) {
+        vxlan_endpoint_t* endpoint = bench_endpoint(0, i);
+        if (!endpoint || !storage_save_endpoint(endpoint)) {
+            printf("Failed to preload endpoints\n");
+            return 1;
+        }
+        preloaded_ids[i] = endpoint->id;
+    }
+
+    printf("Running concurrency benchmarks...\n\n");
+    for (int mode = 0; mode < 2; mode++) {
+        for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+            if (thread_counts[i] > max_threads) break;
+            if (!run(thread_counts[i], mode == 0)) {
+                printf("Concurrency benchmark failed\n");
+                return 1;
+            }
+        }
+    }
+
+    // Listings of the whole preloaded network against writes to it
+    const int lister_counts[] = {0, 1, 4};
+    for (size_t i = 0; i < sizeof(lister_counts) / sizeof(lister_counts[0]); i++) {
+        if (!run_listing(lister_counts[i])) {
+            printf("Listing benchmark failed\n");
+            return 1;
+        }
+    }
+
+    free(preloaded_ids);
+    storage_cleanup();
+    return 0;
+}
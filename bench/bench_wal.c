@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include "../src/network/vxlan.h"
+#include "../src/storage/memory.h"
+#include "../src/storage/wal.h"
+#include "../src/utils/logging.h"
+
+// Wall time of each timed run
+#define RUN_SECONDS 1.0
+
+typedef struct {
+    int id;
+    unsigned long long ops;
+    bool failed;
+} worker_t;
+
+static atomic_bool running;
+
+// Monotonic clock in seconds
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Store the network of the worker with id, whose endpoints go in it
+static bool save_worker_network(int id) {
+    vxlan_network_t fields = { .tenant_id = "tenant-bench", .name = "wal" };
+    memcpy(fields.id.bytes, &id, sizeof(id));
+    vxlan_network_t* network = vxlan_restore_network(&fields);
+    if (!network || !storage_save_network(network)) {
+        vxlan_free_network(network);
+        return false;
+    }
+    return true;
+}
+
+// Create and save endpoints until the run ends
+static void* worker_run(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    vxlan_uuid_t network_id = {{0}};
+    vxlan_ip_t vtep;
+    memcpy(network_id.bytes, &worker->id, sizeof(worker->id));
+    vxlan_ip_parse("192.0.2.1", &vtep);
+
+    while (atomic_load(&running)) {
+        // Addresses must be unique within the network
+        unsigned long long n = worker->ops;
+        vxlan_mac_t mac = {{0x02, 0x00, (n >> 24) & 0xff, (n >> 16) & 0xff, (n >> 8) & 0xff, n & 0xff}};
+        vxlan_ip_t ip = { AF_INET, {10, (n >> 16) & 0xff, (n >> 8) & 0xff, n & 0xff} };
+        vxlan_endpoint_t* endpoint = vxlan_create_endpoint(&network_id, &mac, &ip, "host1", &vtep);
+        if (!endpoint || !storage_save_endpoint(endpoint)) {
+            vxlan_free_endpoint(endpoint);
+            worker->failed = true;
+            return NULL;
+        }
+        worker->ops++;
+    }
+    return NULL;
+}
+
+// Run threads writers against a fresh store; log_mode < 0 disables the log
+static bool run(const char* path, const char* label, int log_mode, int threads) {
+    unlink(path);
+    if (!storage_init()) return false;
+    if (log_mode >= 0 && !storage_open_log(path, (wal_sync_mode_t)log_mode)) {
+        storage_cleanup();
+        return false;
+    }
+
+    worker_t* workers = calloc(threads, sizeof(worker_t));
+    pthread_t* tids = malloc(threads * sizeof(pthread_t));
+    bool ready = workers && tids;
+    for (int i = 0; ready && i < threads; i++) {
+        ready = save_worker_network(i);
+    }
+    if (!ready) {
+        free(workers);
+        free(tids);
+        storage_cleanup();
+        return false;
+    }
+
+    atomic_store(&running, true);
+    double start = now_s();
+    for (int i = 0; i < threads; i++) {
+        workers[i].id = i;
+        pthread_create(&tids[i], NULL, worker_run, &workers[i]);
+    }
+    while (now_s() - start < RUN_SECONDS) {
+        usleep(10000);
+    }
+    atomic_store(&running, false);
+
+    unsigned long long ops = 0;
+    bool failed = false;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        ops += workers[i].ops;
+        failed |= workers[i].failed;
+    }
+    double elapsed = now_s() - start;
+    unsigned long long syncs = log_mode >= 0 ? wal_sync_count() : 0;
+
+    printf("%-15s threads=%-3d %8.0f creates/s  syncs/op=%.3f\n",
+           label, threads, ops / elapsed, ops ? (double)syncs / ops : 0.0);
+
+    free(workers);
+    free(tids);
+    storage_cleanup();
+    unlink(path);
+    return !failed;
+}
+
+int main(int argc, char** argv) {
+    // The log goes to the current directory by default; fdatasync() on a
+    // tmpfs such as /tmp costs nothing and hides the difference
+    const char* path = argc > 1 ? argv[1] : "bench_wal.log";
+    const int thread_counts[] = {1, 4, 16, 64};
+    const struct {
+        const char* label;
+        int mode;
+    } modes[] = {
+        {"durability=off", -1},
+        {"per-op fsync", WAL_SYNC_EACH},
+        {"group commit", WAL_SYNC_GROUP},
+    };
+
+    logging_set_level(LOG_LEVEL_ERROR);
+    printf("Running write-ahead log benchmarks (%s)...\n\n", path);
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+            if (!run(path, modes[m].label, modes[m].mode, thread_counts[t])) {
+                printf("Write-ahead log benchmark failed\n");
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
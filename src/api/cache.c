@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+
+// Format the entity tag of a version
+void cache_etag(uint64_t version, char etag[CACHE_ETAG_SIZE]) {
+    static const char hex[] = "0123456789abcdef";
+    etag[0] = '"';
+    for (int i = 16; i > 0; i--) {
+        etag[i] = hex[version & 0xf];
+        version >>= 4;
+    }
+    etag[17] = '"';
+    etag[18] = '\0';
+}
+
+// Walk a comma-separated list of entity tags, ignoring weakness prefixes
+bool cache_etag_matches(const char* if_none_match, const char* etag) {
+    size_t etag_len = strlen(etag);
+    const char* p = if_none_match;
+    for (;;) {
+        p += strspn(p, " \t,");
+        if (!*p) return false;
+        if (*p == '*') return true;
+        if (p[0] == 'W' && p[1] == '/') {
+            p += 2;
+        }
+        const char* end = *p == '"' ? strchr(p + 1, '"') : NULL;
+        if (!end) return false;  // malformed: match nothing
+        end++;
+        if ((size_t)(end - p) == etag_len && memcmp(p, etag, etag_len) == 0) return true;
+        p = end;
+    }
+}
+
+// Copy a writer's text into a new cache entry and install it, unless
+// another thread got there first. Returns the installed entry.
+static struct vxlan_json* install(_Atomic(struct vxlan_json*)* slot, writer_t* writer) {
+    struct vxlan_json* json = writer->failed ? NULL : malloc(sizeof(struct vxlan_json) + writer->len);
+    if (json) {
+        json->len = writer->len;
+        memcpy(json->data, writer->data, writer->len);
+    }
+    writer_free(writer);
+    if (!json) return NULL;
+
+    struct vxlan_json* expected = NULL;
+    if (!atomic_compare_exchange_strong(slot, &expected, json)) {
+        free(json);
+        return expected;
+    }
+    return json;
+}
+
+const struct vxlan_json* cache_network(vxlan_network_t* network) {
+    struct vxlan_json* json = atomic_load_explicit(&network->json, memory_order_acquire);
+    if (json) return json;
+
+    writer_t writer;
+    writer_init(&writer);
+    writer_network(&writer, network);
+    return install(&network->json, &writer);
+}
+
+const struct vxlan_json* cache_endpoint(vxlan_endpoint_t* endpoint) {
+    struct vxlan_json* json = atomic_load_explicit(&endpoint->json, memory_order_acquire);
+    if (json) return json;
+
+    writer_t writer;
+    writer_init(&writer);
+    writer_endpoint(&writer, endpoint);
+    return install(&endpoint->json, &writer);
+}
+
+void cache_write_network(writer_t* writer, const vxlan_network_t* network) {
+    struct vxlan_json* json = atomic_load_explicit(&network->json, memory_order_acquire);
+    if (json) {
+        writer_raw(writer, json->data, json->len);
+    } else {
+        writer_network(writer, network);
+    }
+}
+
+void cache_write_endpoint(writer_t* writer, const vxlan_endpoint_t* endpoint) {
+    struct vxlan_json* json = atomic_load_explicit(&endpoint->json, memory_order_acquire);
+    if (json) {
+        writer_raw(writer, json->data, json->len);
+    } else {
+        writer_endpoint(writer, endpoint);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "writer.h"
+#include "../network/vxlan.h"
+
+// Serialized records and entity tags.
+//
+// Stored records never change, so the JSON of one is written once, the
+// first time it is asked for, and kept with the record (vxlan_*_t.json)
+// until the record is freed after its delete. Threads that miss at the
+// same time each write it and the first to install its copy wins.
+//
+// A record's strong ETag is its version; a network's endpoint list has
+// the version from storage_endpoints_version(). Comparing the tag of a
+// conditional GET needs neither the cache nor a serialization.
+
+// A quoted entity tag: '"', 16 hex digits, '"' and the terminator
+#define CACHE_ETAG_SIZE 19
+
+struct vxlan_json {
+    size_t len;
+    char data[];
+};
+
+// Format the entity tag of a version
+void cache_etag(uint64_t version, char etag[CACHE_ETAG_SIZE]);
+
+// True if an If-None-Match header value lists etag or is "*". Tags are
+// compared weakly, as RFC 9110 requires for If-None-Match.
+bool cache_etag_matches(const char* if_none_match, const char* etag);
+
+// The JSON of a stored record, written and cached on the first call; NULL
+// if memory runs out. Valid while the record is.
+const struct vxlan_json* cache_network(vxlan_network_t* network);
+const struct vxlan_json* cache_endpoint(vxlan_endpoint_t* endpoint);
+
+// Write a record, copying its cached JSON when there is one. Listings use
+// these so they neither pay for records already cached nor fill the cache.
+void cache_write_network(writer_t* writer, const vxlan_network_t* network);
+void cache_write_endpoint(writer_t* writer, const vxlan_endpoint_t* endpoint);
+
+#endif // CACHE_H
@@ -1,33 +1,71 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
 #include <json-c/json.h>
 #include <microhttpd.h>
 #include "handlers.h"
+#include "cache.h"
+#include "request.h"
+#include "router.h"
+#include "routes.h"
+#include "stream.h"
+#include "writer.h"
 #include "../network/vxlan.h"
+#include "../storage/changes.h"
+#include "../storage/fdb.h"
 #include "../storage/memory.h"
 #include "../utils/logging.h"
 
+// Requests are dispatched through the API's route table, compiled once
+static router_t* router = NULL;
+
+// Set when shutdown begins: polls then answer at once instead of parking
+static atomic_bool shutting_down = false;
+
 // Initialize API handlers
-bool api_init(void) {
+bool api_init(const char* wal_path, unsigned snapshot_interval) {
+    router = router_compile(api_routes, API_ROUTE_COUNT);
+    if (!router) {
+        LOG_ERROR_FMT("Failed to compile API routes");
+        return false;
+    }
     if (!storage_init()) {
         LOG_ERROR_FMT("Failed to initialize storage");
+        router_free(router);
+        router = NULL;
         return false;
     }
+    if (wal_path && !storage_open_log(wal_path, WAL_SYNC_GROUP)) {
+        LOG_ERROR_FMT("Failed to recover storage from %s", wal_path);
+        storage_cleanup();
+        router_free(router);
+        router = NULL;
+        return false;
+    }
+    if (wal_path && snapshot_interval > 0 && !storage_start_snapshots(snapshot_interval)) {
+        LOG_WARN_FMT("Failed to start background snapshots");
+    }
     return true;
 }
 
 // Clean up API resources
 void api_cleanup(void) {
     storage_cleanup();
+    router_free(router);
+    router = NULL;
 }
 
-// Helper function to send JSON response
+// Largest block of a streamed listing handed to the HTTP server at once
+#define STREAM_BLOCK_SIZE (32 * 1024)
+
+// Send a fixed JSON text
 static int send_json_response(struct MHD_Connection* connection, int status_code, const char* json) {
     struct MHD_Response* response = MHD_create_response_from_buffer(
         strlen(json),
         (void*)json,
-        MHD_RESPMEM_MUST_COPY
+        MHD_RESPMEM_PERSISTENT
     );
 
     if (!response) {
@@ -41,345 +79,879 @@ static int send_json_response(struct MHD_Connection* connection, int status_code
     return ret;
 }
 
-// Generate error response
-char* generate_error_response(const char* code, const char* message) {
-    struct json_object* error = json_object_new_object();
-    json_object_object_add(error, "code", json_object_new_string(code));
-    json_object_object_add(error, "message", json_object_new_string(message));
+// Send the text of a writer, with the cursor of the next page and the
+// entity tag when there are. The response takes the writer's buffer over
+// instead of copying it and releases it once sent.
+static int send_writer(struct MHD_Connection* connection, int status_code, writer_t* writer,
+                       const char* next_cursor, const char* etag) {
+    size_t len;
+    char* json = writer_take(writer, &len);
+    if (!json) {
+        LOG_ERROR_FMT("Failed to write response");
+        return MHD_NO;
+    }
+    struct MHD_Response* response = MHD_create_response_from_buffer_with_free_callback(len, json,
+                                                                                       writer_buffer_free);
+    if (!response) {
+        writer_buffer_free(json);
+        LOG_ERROR_FMT("Failed to create response");
+        return MHD_NO;
+    }
 
-    const char* json = json_object_to_json_string(error);
-    char* response = strdup(json);
-    json_object_put(error);
-    return response;
+    MHD_add_response_header(response, "Content-Type", "application/json");
+    if (next_cursor) {
+        MHD_add_response_header(response, "X-Next-Cursor", next_cursor);
+    }
+    if (etag) {
+        MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, etag);
+    }
+    int ret = MHD_queue_response(connection, status_code, response);
+    MHD_destroy_response(response);
+    return ret;
 }
 
-// Generate success response
-char* generate_success_response(const char* data) {
-    return strdup(data);
+// Send a response read from a listing stream as the socket drains, with
+// chunked encoding. The response owns the stream.
+static ssize_t stream_reader(void* cls, uint64_t pos, char* buf, size_t max) {
+    (void)pos;
+    ssize_t len = list_stream_read(cls, buf, max);
+    if (len == 0) return MHD_CONTENT_READER_END_OF_STREAM;
+    return len < 0 ? MHD_CONTENT_READER_END_WITH_ERROR : len;
 }
 
-// Helper to format time_t to ISO 8601 string
-static void format_time_iso8601(const char* iso_str, char* buf, size_t buflen) {
-    if (iso_str && buf && buflen > 0) {
-        strncpy(buf, iso_str, buflen - 1);
-        buf[buflen - 1] = '\0';
-    } else if (buf && buflen > 0) {
-        buf[0] = '\0';
+static int send_stream(struct MHD_Connection* connection, list_stream_t* stream, const char* etag) {
+    struct MHD_Response* response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, STREAM_BLOCK_SIZE,
+                                                                      stream_reader, stream, list_stream_free);
+    if (!response) {
+        list_stream_free(stream);
+        LOG_ERROR_FMT("Failed to create response");
+        return MHD_NO;
     }
+
+    MHD_add_response_header(response, "Content-Type", "application/json");
+    if (etag) {
+        MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, etag);
+    }
+    int ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+// Send an error response
+static int send_error(struct MHD_Connection* connection, int status_code, const char* code, const char* message) {
+    writer_t writer;
+    writer_init(&writer);
+    writer_begin_object(&writer);
+    writer_key(&writer, "code");
+    writer_string(&writer, code);
+    writer_key(&writer, "message");
+    writer_string(&writer, message);
+    writer_end_object(&writer);
+    return send_writer(connection, status_code, &writer, NULL, NULL);
+}
+
+// True if the client's copy, named by If-None-Match, has entity tag etag
+static bool not_modified(struct MHD_Connection* connection, const char* etag) {
+    const char* header = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_IF_NONE_MATCH);
+    return header && cache_etag_matches(header, etag);
+}
+
+// Tell the client its copy is current
+static int send_not_modified(struct MHD_Connection* connection, const char* etag) {
+    struct MHD_Response* response = MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+    if (!response) {
+        LOG_ERROR_FMT("Failed to create response");
+        return MHD_NO;
+    }
+
+    MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, etag);
+    int ret = MHD_queue_response(connection, MHD_HTTP_NOT_MODIFIED, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+// Refuse a request whose body is not one JSON document
+static int send_body_error(struct MHD_Connection* connection, const request_t* request) {
+    if (request->status == BODY_TOO_LARGE) {
+        return send_error(connection, MHD_HTTP_PAYLOAD_TOO_LARGE, "PAYLOAD_TOO_LARGE", "Request body too large");
+    }
+    return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_JSON", "Invalid JSON payload");
+}
+
+// Page size when only a cursor is given, and the largest one allowed
+#define DEFAULT_PAGE_LIMIT 100
+#define MAX_PAGE_LIMIT 1000
+// A cursor is the hex id of the last record on the previous page
+#define CURSOR_SIZE (2 * sizeof(((vxlan_uuid_t*)0)->bytes) + 1)
+
+// Paging parameters of a listing; limit is 0 when the client did not ask
+// for paging, and the whole listing is streamed
+typedef struct {
+    int limit;
+    bool has_after;
+    vxlan_uuid_t after;
+} page_params_t;
+
+static void format_cursor(const vxlan_uuid_t* id, char cursor[CURSOR_SIZE]) {
+    for (size_t i = 0; i < sizeof(id->bytes); i++) {
+        snprintf(cursor + 2 * i, 3, "%02x", id->bytes[i]);
+    }
+}
+
+static bool parse_cursor(const char* cursor, vxlan_uuid_t* id) {
+    if (strlen(cursor) != CURSOR_SIZE - 1 || strspn(cursor, "0123456789abcdefABCDEF") != CURSOR_SIZE - 1) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(id->bytes); i++) {
+        unsigned int byte;
+        sscanf(cursor + 2 * i, "%2x", &byte);
+        id->bytes[i] = (uint8_t)byte;
+    }
+    return true;
+}
+
+// Parse the limit and cursor query parameters
+static bool parse_page_params(struct MHD_Connection* connection, page_params_t* page) {
+    const char* limit = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "limit");
+    const char* cursor = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "cursor");
+    page->limit = 0;
+    page->has_after = cursor != NULL;
+    if (limit) {
+        char* end;
+        errno = 0;
+        long value = strtol(limit, &end, 10);
+        if (!*limit || *end || errno || value < 1 || value > MAX_PAGE_LIMIT) return false;
+        page->limit = (int)value;
+    } else if (cursor) {
+        page->limit = DEFAULT_PAGE_LIMIT;
+    }
+    return !cursor || parse_cursor(cursor, &page->after);
+}
+
+// Parse a path parameter as an id. It ends the path or is followed by
+// '/', which is where vxlan_uuid_parse() expects an id to end.
+static bool parse_path_id(const route_match_t* match, int param, vxlan_uuid_t* id) {
+    const route_param_t* value = &match->params[param];
+    return value->len == VXLAN_UUID_STR_SIZE - 1 && vxlan_uuid_parse(value->value, id);
 }
 
 // Handle network creation
-int handle_create_network(struct MHD_Connection* connection, const char* upload_data) {
-    struct json_object* json = json_tokener_parse(upload_data);
+int handle_create_network(struct MHD_Connection* connection, const route_match_t* match, request_t* request) {
+    (void)match;
+    struct json_object* json = request_body(request);
     if (!json) {
-        char* error = generate_error_response("INVALID_JSON", "Invalid JSON payload");
-        int ret = send_json_response(connection, MHD_HTTP_BAD_REQUEST, error);
-        free(error);
-        return ret;
+        return send_body_error(connection, request);
     }
     struct json_object* tenant_id, *name, *vni, *description;
     if (!json_object_object_get_ex(json, "tenant_id", &tenant_id) ||
-        !json_object_object_get_ex(json, "name", &name) ||
-        !json_object_object_get_ex(json, "vni", &vni)) {
-        char* error = generate_error_response("INVALID_PARAMS", "Missing required parameters");
-        int ret = send_json_response(connection, MHD_HTTP_BAD_REQUEST, error);
-        free(error);
-        json_object_put(json);
-        return ret;
+        !json_object_object_get_ex(json, "name", &name)) {
+        return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_PARAMS", "Missing required parameters");
+    }
+    // Without a vni the next free one is allocated when the network is saved
+    int64_t requested_vni = 0;
+    if (json_object_object_get_ex(json, "vni", &vni)) {
+        requested_vni = json_object_is_type(vni, json_type_int) ? json_object_get_int64(vni) : -1;
+        if (requested_vni < 1 || requested_vni > MAX_VNI) {
+            return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_PARAMS",
+                              "vni must be an integer between 1 and 16777215");
+        }
     }
     vxlan_network_t* network = vxlan_create_network(
         json_object_get_string(tenant_id),
         json_object_get_string(name),
-        json_object_get_int(vni),
+        (uint32_t)requested_vni,
         json_object_object_get_ex(json, "description", &description) ? json_object_get_string(description) : NULL
     );
     if (!network) {
-        char* error = generate_error_response("CREATE_FAILED", "Failed to create network");
-        int ret = send_json_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, error);
-        free(error);
-        json_object_put(json);
-        return ret;
+        return send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "CREATE_FAILED", "Failed to create network");
     }
+    // Once saved the network may be deleted concurrently; keep it alive
+    // until the response has been built
+    storage_read_begin();
     if (!storage_save_network(network)) {
-        char* error = generate_error_response("SAVE_FAILED", "Failed to save network");
-        int ret = send_json_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, error);
-        free(error);
+        int reason = errno;
+        storage_read_end();
         vxlan_free_network(network);
-        json_object_put(json);
-        return ret;
+        if (reason == EEXIST) {
+            return send_error(connection, MHD_HTTP_CONFLICT, "VNI_IN_USE",
+                              "VNI is already used by another network");
+        }
+        if (reason == ENOSPC) {
+            return send_error(connection, MHD_HTTP_SERVICE_UNAVAILABLE, "VNI_EXHAUSTED",
+                              "No free VNI left");
+        }
+        return send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "SAVE_FAILED",
+                          "Failed to save network");
     }
-    struct json_object* response = json_object_new_object();
-    json_object_object_add(response, "id", json_object_new_string(network->id));
-    json_object_object_add(response, "tenant_id", json_object_new_string(network->tenant_id));
-    json_object_object_add(response, "name", json_object_new_string(network->name));
-    json_object_object_add(response, "vni", json_object_new_int64(network->vni));
-    if (network->description) {
-        json_object_object_add(response, "description", json_object_new_string(network->description));
-    }
-    char created_at_str[32], updated_at_str[32];
-    format_time_iso8601(network->created_at, created_at_str, sizeof(created_at_str));
-    format_time_iso8601(network->updated_at, updated_at_str, sizeof(updated_at_str));
-    json_object_object_add(response, "created_at", json_object_new_string(created_at_str));
-    json_object_object_add(response, "updated_at", json_object_new_string(updated_at_str));
-    const char* response_json = json_object_to_json_string(response);
-    int ret = send_json_response(connection, MHD_HTTP_CREATED, response_json);
-    json_object_put(response);
-    json_object_put(json);
-    return ret;
+    writer_t writer;
+    writer_init(&writer);
+    writer_network(&writer, network);
+    storage_read_end();
+    return send_writer(connection, MHD_HTTP_CREATED, &writer, NULL, NULL);
 }
 
 // Handle network retrieval
-int handle_get_network(struct MHD_Connection* connection, const char* network_id) {
-    vxlan_network_t* network = storage_get_network(network_id);
+int handle_get_network(struct MHD_Connection* connection, const route_match_t* match, request_t* request) {
+    (void)request;
+    vxlan_uuid_t id;
+    if (!parse_path_id(match, ROUTE_PARAM_NETWORK_ID, &id)) {
+        return send_error(connection, MHD_HTTP_NOT_FOUND, "NOT_FOUND", "Network not found");
+    }
+    storage_read_begin();
+    vxlan_network_t* network = storage_get_network(&id);
     if (!network) {
-        char* error = generate_error_response("NOT_FOUND", "Network not found");
-        int ret = send_json_response(connection, MHD_HTTP_NOT_FOUND, error);
-        free(error);
-        return ret;
+        storage_read_end();
+        return send_error(connection, MHD_HTTP_NOT_FOUND, "NOT_FOUND", "Network not found");
     }
-    struct json_object* response = json_object_new_object();
-    json_object_object_add(response, "id", json_object_new_string(network->id));
-    json_object_object_add(response, "tenant_id", json_object_new_string(network->tenant_id));
-    json_object_object_add(response, "name", json_object_new_string(network->name));
-    json_object_object_add(response, "vni", json_object_new_int64(network->vni));
-    if (network->description) {
-        json_object_object_add(response, "description", json_object_new_string(network->description));
-    }
-    char created_at_str[32], updated_at_str[32];
-    format_time_iso8601(network->created_at, created_at_str, sizeof(created_at_str));
-    format_time_iso8601(network->updated_at, updated_at_str, sizeof(updated_at_str));
-    json_object_object_add(response, "created_at", json_object_new_string(created_at_str));
-    json_object_object_add(response, "updated_at", json_object_new_string(updated_at_str));
-    const char* response_json = json_object_to_json_string(response);
-    int ret = send_json_response(connection, MHD_HTTP_OK, response_json);
-    json_object_put(response);
-    return ret;
+    char etag[CACHE_ETAG_SIZE];
+    cache_etag(network->version, etag);
+    if (not_modified(connection, etag)) {
+        storage_read_end();
+        return send_not_modified(connection, etag);
+    }
+    cache_network(network);
+    writer_t writer;
+    writer_init(&writer);
+    cache_write_network(&writer, network);
+    storage_read_end();
+    return send_writer(connection, MHD_HTTP_OK, &writer, NULL, etag);
 }
 
 // Handle network deletion
-int handle_delete_network(struct MHD_Connection* connection, const char* network_id) {
-    if (!storage_delete_network(network_id)) {
-        char* error = generate_error_response("NOT_FOUND", "Network not found");
-        int ret = send_json_response(connection, MHD_HTTP_NOT_FOUND, error);
-        free(error);
-        return ret;
+int handle_delete_network(struct MHD_Connection* connection, const route_match_t* match, request_t* request) {
+    (void)request;
+    vxlan_uuid_t id;
+    if (!parse_path_id(match, ROUTE_PARAM_NETWORK_ID, &id) || !storage_delete_network(&id)) {
+        return send_error(connection, MHD_HTTP_NOT_FOUND, "NOT_FOUND", "Network not found");
     }
     return send_json_response(connection, MHD_HTTP_NO_CONTENT, "{}");
 }
 
-// Handle network listing
-int handle_list_networks(struct MHD_Connection* connection) {
+// Handle network listing, optionally filtered by ?tenant_id=
+int handle_list_networks(struct MHD_Connection* connection, const route_match_t* match, request_t* request) {
+    (void)match;
+    (void)request;
+    const char* tenant_id = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "tenant_id");
+    if (tenant_id && tenant_id[0] == '\0') {
+        tenant_id = NULL;
+    }
+    page_params_t page;
+    if (!parse_page_params(connection, &page)) {
+        return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_PARAMS", "Invalid limit or cursor");
+    }
+    // Without paging the listing may be any size: stream it
+    if (!page.limit) {
+        list_stream_t* stream = list_stream_networks(tenant_id);
+        return stream ? send_stream(connection, stream, NULL)
+                      : send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "LIST_FAILED", "Failed to list networks");
+    }
     int count;
-    vxlan_network_t** networks = storage_list_networks(NULL, &count);
+    storage_read_begin();
+    // One extra record tells whether there is a next page
+    vxlan_network_t** networks =
+        storage_list_networks_page(tenant_id, page.has_after ? &page.after : NULL, page.limit + 1, &count);
     if (!networks) {
-        char* error = generate_error_response("LIST_FAILED", "Failed to list networks");
-        int ret = send_json_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, error);
-        free(error);
-        return ret;
+        storage_read_end();
+        return send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "LIST_FAILED", "Failed to list networks");
+    }
+    char cursor[CURSOR_SIZE];
+    bool more = count > page.limit;
+    if (more) {
+        count = page.limit;
+        format_cursor(&networks[count - 1]->id, cursor);
     }
-    struct json_object* response = json_object_new_array();
+    writer_t writer;
+    writer_init(&writer);
+    writer_begin_array(&writer);
     for (int i = 0; i < count; i++) {
-        struct json_object* network = json_object_new_object();
-        json_object_object_add(network, "id", json_object_new_string(networks[i]->id));
-        json_object_object_add(network, "tenant_id", json_object_new_string(networks[i]->tenant_id));
-        json_object_object_add(network, "name", json_object_new_string(networks[i]->name));
-        json_object_object_add(network, "vni", json_object_new_int64(networks[i]->vni));
-        if (networks[i]->description) {
-            json_object_object_add(network, "description", json_object_new_string(networks[i]->description));
-        }
-        char created_at_str[32], updated_at_str[32];
-        format_time_iso8601(networks[i]->created_at, created_at_str, sizeof(created_at_str));
-        format_time_iso8601(networks[i]->updated_at, updated_at_str, sizeof(updated_at_str));
-        json_object_object_add(network, "created_at", json_object_new_string(created_at_str));
-        json_object_object_add(network, "updated_at", json_object_new_string(updated_at_str));
-        json_object_array_add(response, network);
-    }
-    const char* response_json = json_object_to_json_string(response);
-    int ret = send_json_response(connection, MHD_HTTP_OK, response_json);
-    json_object_put(response);
+        cache_write_network(&writer, networks[i]);
+    }
+    writer_end_array(&writer);
+    storage_read_end();
     free(networks);
-    return ret;
+    return send_writer(connection, MHD_HTTP_OK, &writer, more ? cursor : NULL, NULL);
 }
 
 // Handle endpoint creation
-int handle_create_endpoint(struct MHD_Connection* connection, const char* url, const char* upload_data) {
-    // Extract network_id from URL
-    const char* network_id = strrchr(url, '/');
-    if (!network_id) {
-        char* error = generate_error_response("INVALID_URL", "Invalid network ID");
-        int ret = send_json_response(connection, MHD_HTTP_BAD_REQUEST, error);
-        free(error);
-        return ret;
+int handle_create_endpoint(struct MHD_Connection* connection, const route_match_t* match, request_t* request) {
+    vxlan_uuid_t network_id;
+    if (!parse_path_id(match, ROUTE_PARAM_NETWORK_ID, &network_id)) {
+        return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_URL", "Invalid network ID");
+    }
+    if (!storage_get_network(&network_id)) {
+        return send_error(connection, MHD_HTTP_NOT_FOUND, "NOT_FOUND", "Network not found");
     }
-    network_id++; // skip '/'
-    struct json_object* json = json_tokener_parse(upload_data);
+    struct json_object* json = request_body(request);
     if (!json) {
-        char* error = generate_error_response("INVALID_JSON", "Invalid JSON payload");
-        int ret = send_json_response(connection, MHD_HTTP_BAD_REQUEST, error);
-        free(error);
-        return ret;
+        return send_body_error(connection, request);
     }
     struct json_object* mac_address, *ip_address, *host_id, *vtep_ip;
     if (!json_object_object_get_ex(json, "mac_address", &mac_address) ||
         !json_object_object_get_ex(json, "ip_address", &ip_address) ||
         !json_object_object_get_ex(json, "host_id", &host_id) ||
         !json_object_object_get_ex(json, "vtep_ip", &vtep_ip)) {
-        char* error = generate_error_response("INVALID_PARAMS", "Missing required parameters");
-        int ret = send_json_response(connection, MHD_HTTP_BAD_REQUEST, error);
-        free(error);
-        json_object_put(json);
-        return ret;
+        return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_PARAMS", "Missing required parameters");
+    }
+    vxlan_mac_t mac;
+    vxlan_ip_t ip, vtep;
+    if (!vxlan_mac_parse(json_object_get_string(mac_address), &mac) ||
+        !vxlan_ip_parse(json_object_get_string(ip_address), &ip) ||
+        !vxlan_ip_parse(json_object_get_string(vtep_ip), &vtep)) {
+        return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_PARAMS", "Invalid address format");
     }
     vxlan_endpoint_t* endpoint = vxlan_create_endpoint(
-        network_id,
-        json_object_get_string(mac_address),
-        json_object_get_string(ip_address),
+        &network_id,
+        &mac,
+        &ip,
         json_object_get_string(host_id),
-        json_object_get_string(vtep_ip)
+        &vtep
     );
     if (!endpoint) {
-        char* error = generate_error_response("CREATE_FAILED", "Failed to create endpoint");
-        int ret = send_json_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, error);
-        free(error);
-        json_object_put(json);
-        return ret;
+        return send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "CREATE_FAILED", "Failed to create endpoint");
     }
+    // Once saved the endpoint may be deleted concurrently; keep it alive
+    // until the response has been built
+    storage_read_begin();
     if (!storage_save_endpoint(endpoint)) {
-        char* error = generate_error_response("SAVE_FAILED", "Failed to save endpoint");
-        int ret = send_json_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, error);
-        free(error);
+        int reason = errno;
+        storage_read_end();
         vxlan_free_endpoint(endpoint);
-        json_object_put(json);
-        return ret;
+        if (reason == EEXIST) {
+            return send_error(connection, MHD_HTTP_CONFLICT, "ADDRESS_IN_USE",
+                              "MAC or IP address is already used by an endpoint in this network");
+        }
+        // The network was deleted since the check above
+        if (reason == ENOENT) {
+            return send_error(connection, MHD_HTTP_NOT_FOUND, "NOT_FOUND", "Network not found");
+        }
+        return send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "SAVE_FAILED",
+                          "Failed to save endpoint");
     }
-    struct json_object* response = json_object_new_object();
-    json_object_object_add(response, "id", json_object_new_string(endpoint->id));
-    json_object_object_add(response, "network_id", json_object_new_string(endpoint->network_id));
-    json_object_object_add(response, "mac_address", json_object_new_string(endpoint->mac_address));
-    json_object_object_add(response, "ip_address", json_object_new_string(endpoint->ip_address));
-    json_object_object_add(response, "host_id", json_object_new_string(endpoint->host_id));
-    json_object_object_add(response, "vtep_ip", json_object_new_string(endpoint->vtep_ip));
-    char created_at_str[32], updated_at_str[32];
-    format_time_iso8601(endpoint->created_at, created_at_str, sizeof(created_at_str));
-    format_time_iso8601(endpoint->updated_at, updated_at_str, sizeof(updated_at_str));
-    json_object_object_add(response, "created_at", json_object_new_string(created_at_str));
-    json_object_object_add(response, "updated_at", json_object_new_string(updated_at_str));
-    const char* response_json = json_object_to_json_string(response);
-    int ret = send_json_response(connection, MHD_HTTP_CREATED, response_json);
-    json_object_put(response);
-    json_object_put(json);
-    return ret;
+    writer_t writer;
+    writer_init(&writer);
+    writer_endpoint(&writer, endpoint);
+    storage_read_end();
+    return send_writer(connection, MHD_HTTP_CREATED, &writer, NULL, NULL);
 }
 
 // Handle endpoint retrieval
-int handle_get_endpoint(struct MHD_Connection* connection, const char* endpoint_id) {
-    // Extract network_id from the endpoint_id or URL if needed (assuming endpoint_id is actually a URL)
-    const char* network_id = NULL;
-    const char* slash = strrchr(endpoint_id, '/');
-    if (slash) {
-        network_id = endpoint_id;
-        endpoint_id = slash + 1;
-        // Temporarily null-terminate network_id
-        size_t len = slash - network_id;
-        char net_id_buf[256];
-        if (len < sizeof(net_id_buf)) {
-            strncpy(net_id_buf, network_id, len);
-            net_id_buf[len] = '\0';
-            network_id = net_id_buf;
-        } else {
-            network_id = NULL;
-        }
+int handle_get_endpoint(struct MHD_Connection* connection, const route_match_t* match, request_t* request) {
+    (void)request;
+    vxlan_uuid_t id, network_id;
+    if (!parse_path_id(match, ROUTE_PARAM_NETWORK_ID, &network_id) ||
+        !parse_path_id(match, ROUTE_PARAM_ENDPOINT_ID, &id)) {
+        return send_error(connection, MHD_HTTP_NOT_FOUND, "NOT_FOUND", "Endpoint not found");
     }
-    vxlan_endpoint_t* endpoint = storage_get_endpoint(network_id, endpoint_id);
+    storage_read_begin();
+    vxlan_endpoint_t* endpoint = storage_get_endpoint(&network_id, &id);
     if (!endpoint) {
-        char* error = generate_error_response("NOT_FOUND", "Endpoint not found");
-        int ret = send_json_response(connection, MHD_HTTP_NOT_FOUND, error);
-        free(error);
-        return ret;
+        storage_read_end();
+        return send_error(connection, MHD_HTTP_NOT_FOUND, "NOT_FOUND", "Endpoint not found");
     }
-    struct json_object* response = json_object_new_object();
-    json_object_object_add(response, "id", json_object_new_string(endpoint->id));
-    json_object_object_add(response, "network_id", json_object_new_string(endpoint->network_id));
-    json_object_object_add(response, "mac_address", json_object_new_string(endpoint->mac_address));
-    json_object_object_add(response, "ip_address", json_object_new_string(endpoint->ip_address));
-    json_object_object_add(response, "host_id", json_object_new_string(endpoint->host_id));
-    json_object_object_add(response, "vtep_ip", json_object_new_string(endpoint->vtep_ip));
-    char created_at_str[32], updated_at_str[32];
-    format_time_iso8601(endpoint->created_at, created_at_str, sizeof(created_at_str));
-    format_time_iso8601(endpoint->updated_at, updated_at_str, sizeof(updated_at_str));
-    json_object_object_add(response, "created_at", json_object_new_string(created_at_str));
-    json_object_object_add(response, "updated_at", json_object_new_string(updated_at_str));
-    const char* response_json = json_object_to_json_string(response);
-    int ret = send_json_response(connection, MHD_HTTP_OK, response_json);
-    json_object_put(response);
-    return ret;
+    char etag[CACHE_ETAG_SIZE];
+    cache_etag(endpoint->version, etag);
+    if (not_modified(connection, etag)) {
+        storage_read_end();
+        return send_not_modified(connection, etag);
+    }
+    cache_endpoint(endpoint);
+    writer_t writer;
+    writer_init(&writer);
+    cache_write_endpoint(&writer, endpoint);
+    storage_read_end();
+    return send_writer(connection, MHD_HTTP_OK, &writer, NULL, etag);
 }
 
 // Handle endpoint deletion
-int handle_delete_endpoint(struct MHD_Connection* connection, const char* url) {
-    // Extract endpoint_id from URL
-    const char* endpoint_id = strrchr(url, '/');
-    if (!endpoint_id) {
-        char* error = generate_error_response("INVALID_URL", "Invalid endpoint ID");
-        int ret = send_json_response(connection, MHD_HTTP_BAD_REQUEST, error);
-        free(error);
-        return ret;
+int handle_delete_endpoint(struct MHD_Connection* connection, const route_match_t* match, request_t* request) {
+    (void)request;
+    vxlan_uuid_t network_id, endpoint_id;
+    if (!parse_path_id(match, ROUTE_PARAM_ENDPOINT_ID, &endpoint_id)) {
+        return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_URL", "Invalid endpoint ID");
     }
-    endpoint_id++; // skip '/'
-    // Extract network_id from URL (everything before last slash)
-    size_t net_id_len = endpoint_id - url - 1;
-    char network_id[256] = {0};
-    if (net_id_len < sizeof(network_id)) {
-        strncpy(network_id, url, net_id_len);
-        network_id[net_id_len] = '\0';
-    }
-    if (!storage_delete_endpoint(network_id, endpoint_id)) {
-        char* error = generate_error_response("NOT_FOUND", "Endpoint not found");
-        int ret = send_json_response(connection, MHD_HTTP_NOT_FOUND, error);
-        free(error);
-        return ret;
+    if (!parse_path_id(match, ROUTE_PARAM_NETWORK_ID, &network_id) ||
+        !storage_delete_endpoint(&network_id, &endpoint_id)) {
+        return send_error(connection, MHD_HTTP_NOT_FOUND, "NOT_FOUND", "Endpoint not found");
     }
     return send_json_response(connection, MHD_HTTP_NO_CONTENT, "{}");
 }
 
 // Handle endpoint listing
-int handle_list_endpoints(struct MHD_Connection* connection, const char* url) {
-    // Extract network_id from URL
-    const char* network_id = strrchr(url, '/');
-    if (!network_id) {
-        char* error = generate_error_response("INVALID_URL", "Invalid network ID");
-        int ret = send_json_response(connection, MHD_HTTP_BAD_REQUEST, error);
-        free(error);
-        return ret;
+int handle_list_endpoints(struct MHD_Connection* connection, const route_match_t* match, request_t* request) {
+    (void)request;
+    vxlan_uuid_t network_id;
+    if (!parse_path_id(match, ROUTE_PARAM_NETWORK_ID, &network_id)) {
+        return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_URL", "Invalid network ID");
+    }
+    page_params_t page;
+    if (!parse_page_params(connection, &page)) {
+        return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_PARAMS", "Invalid limit or cursor");
+    }
+    // Taken before the listing is read, so the listing is at least as
+    // recent as its tag: a stale tag costs a full response, never a 304
+    // for a list that has changed
+    uint64_t version = storage_endpoints_version(&network_id);
+    char etag[CACHE_ETAG_SIZE];
+    cache_etag(version, etag);
+    if (version && not_modified(connection, etag)) {
+        return send_not_modified(connection, etag);
+    }
+    // Without paging the listing may be any size: stream it
+    if (!page.limit) {
+        list_stream_t* stream = list_stream_endpoints(&network_id);
+        return stream ? send_stream(connection, stream, version ? etag : NULL)
+                      : send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "LIST_FAILED", "Failed to list endpoints");
     }
-    network_id++; // skip '/'
     int count;
-    vxlan_endpoint_t** endpoints = storage_list_endpoints(network_id, &count);
+    storage_read_begin();
+    // One extra record tells whether there is a next page
+    vxlan_endpoint_t** endpoints =
+        storage_list_endpoints_page(&network_id, page.has_after ? &page.after : NULL, page.limit + 1, &count);
     if (!endpoints) {
-        char* error = generate_error_response("LIST_FAILED", "Failed to list endpoints");
-        int ret = send_json_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, error);
-        free(error);
-        return ret;
+        storage_read_end();
+        return send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "LIST_FAILED", "Failed to list endpoints");
+    }
+    char cursor[CURSOR_SIZE];
+    bool more = count > page.limit;
+    if (more) {
+        count = page.limit;
+        format_cursor(&endpoints[count - 1]->id, cursor);
     }
-    struct json_object* response = json_object_new_array();
+    writer_t writer;
+    writer_init(&writer);
+    writer_begin_array(&writer);
     for (int i = 0; i < count; i++) {
-        struct json_object* endpoint = json_object_new_object();
-        json_object_object_add(endpoint, "id", json_object_new_string(endpoints[i]->id));
-        json_object_object_add(endpoint, "network_id", json_object_new_string(endpoints[i]->network_id));
-        json_object_object_add(endpoint, "mac_address", json_object_new_string(endpoints[i]->mac_address));
-        json_object_object_add(endpoint, "ip_address", json_object_new_string(endpoints[i]->ip_address));
-        json_object_object_add(endpoint, "host_id", json_object_new_string(endpoints[i]->host_id));
-        json_object_object_add(endpoint, "vtep_ip", json_object_new_string(endpoints[i]->vtep_ip));
-        char created_at_str[32], updated_at_str[32];
-        format_time_iso8601(endpoints[i]->created_at, created_at_str, sizeof(created_at_str));
-        format_time_iso8601(endpoints[i]->updated_at, updated_at_str, sizeof(updated_at_str));
-        json_object_object_add(endpoint, "created_at", json_object_new_string(created_at_str));
-        json_object_object_add(endpoint, "updated_at", json_object_new_string(updated_at_str));
-        json_object_array_add(response, endpoint);
-    }
-    const char* response_json = json_object_to_json_string(response);
-    int ret = send_json_response(connection, MHD_HTTP_OK, response_json);
-    json_object_put(response);
+        cache_write_endpoint(&writer, endpoints[i]);
+    }
+    writer_end_array(&writer);
+    storage_read_end();
     free(endpoints);
+    return send_writer(connection, MHD_HTTP_OK, &writer, more ? cursor : NULL, version ? etag : NULL);
+} 
+
+// Longest and default wait of a watch, and the most changes it returns
+#define MAX_WATCH_TIMEOUT 60
+#define DEFAULT_WATCH_TIMEOUT 30
+#define MAX_WATCH_CHANGES 1000
+
+static const char* change_type_name(change_type_t type) {
+    switch (type) {
+    case CHANGE_NETWORK_CREATED: return "network.created";
+    case CHANGE_NETWORK_DELETED: return "network.deleted";
+    case CHANGE_ENDPOINT_CREATED: return "endpoint.created";
+    case CHANGE_ENDPOINT_DELETED: return "endpoint.deleted";
+    }
+    return "unknown";
+}
+
+// Write the JSON representation of a change
+static void write_change(writer_t* writer, const change_t* change) {
+    writer_begin_object(writer);
+    writer_key(writer, "sequence");
+    writer_int(writer, (int64_t)change->seq);
+    writer_key(writer, "type");
+    writer_string(writer, change_type_name(change->type));
+    writer_key(writer, "network_id");
+    writer_uuid(writer, &change->network_id);
+    if (change->type == CHANGE_ENDPOINT_CREATED || change->type == CHANGE_ENDPOINT_DELETED) {
+        writer_key(writer, "endpoint");
+        writer_endpoint(writer, &change->endpoint);
+    } else {
+        writer_key(writer, "tenant_id");
+        writer_string(writer, change->tenant_id);
+        writer_key(writer, "vni");
+        writer_int(writer, change->vni);
+    }
+    writer_end_object(writer);
+}
+
+// Parse an unsigned query parameter no larger than max
+static bool parse_unsigned(const char* arg, unsigned long long max, unsigned long long* value) {
+    char* end;
+    errno = 0;
+    *value = strtoull(arg, &end, 10);
+    return *arg && *arg != '-' && !*end && !errno && *value <= max;
+}
+
+// Kind of a parked poll, the first member of its request state
+typedef enum {
+    POLL_WATCH,
+    POLL_FDB,
+} poll_kind_t;
+
+// A watch parked (its connection suspended) on the change feed until a
+// change is appended or it times out
+typedef struct {
+    poll_kind_t kind;
+    struct MHD_Connection* connection;
+    change_waiter_t waiter;
+    uint64_t since;
+    bool filtered;
+    vxlan_uuid_t network_id;
+} watch_poll_t;
+
+// Send changes and the sequence to watch from next
+static int send_changes(struct MHD_Connection* connection, const change_t* changes, int count, uint64_t next) {
+    writer_t writer;
+    writer_init(&writer);
+    writer_begin_object(&writer);
+    writer_key(&writer, "sequence");
+    writer_int(&writer, (int64_t)next);
+    writer_key(&writer, "changes");
+    writer_begin_array(&writer);
+    for (int i = 0; i < count; i++) {
+        write_change(&writer, &changes[i]);
+    }
+    writer_end_array(&writer);
+    writer_end_object(&writer);
+    return send_writer(connection, MHD_HTTP_OK, &writer, NULL, NULL);
+}
+
+// Resume a parked watch; called by the change feed with the feed locked
+static void resume_watch(void* ctx) {
+    MHD_resume_connection(((watch_poll_t*)ctx)->connection);
+}
+
+// Send the changes after the watch's sequence, or park it until there are
+// some or it times out
+static int watch_changes(struct MHD_Connection* connection, watch_poll_t* poll) {
+    // The feed tells a resumed watch how far it holds nothing for it
+    if (poll->waiter.since > poll->since) {
+        poll->since = poll->waiter.since;
+    }
+    // Room for the changes appended so far, at most a response's worth
+    uint64_t last = storage_changes_last();
+    int max = last <= poll->since ? 0
+              : last - poll->since < MAX_WATCH_CHANGES ? (int)(last - poll->since) : MAX_WATCH_CHANGES;
+    change_t* changes = max ? malloc(max * sizeof(change_t)) : NULL;
+    if (max && !changes) {
+        return send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "WATCH_FAILED", "Failed to watch");
+    }
+    int count = 0;
+    uint64_t next = 0;
+    if (!storage_watch(poll->since, poll->filtered ? &poll->network_id : NULL, 0, changes, max, &count,
+                       &next)) {
+        free(changes);
+        return send_error(connection, MHD_HTTP_GONE, "RESYNC_REQUIRED",
+                          "Changes since this sequence are no longer available");
+    }
+    if (count > 0 || poll->waiter.timed_out || atomic_load(&shutting_down)) {
+        int ret = send_changes(connection, changes, count, next);
+        free(changes);
+        return ret;
+    }
+    free(changes);
+
+    // Park past the changes of other networks, which will not wake it
+    // either. Suspend first, so a notification can only resume a suspended
+    // connection; if changes came or the wait timed out meanwhile, the
+    // resumed call finds out which. A watch parked as shutdown began may
+    // have been missed by api_resume_all(), so it takes itself back.
+    poll->since = next;
+    MHD_suspend_connection(connection);
+    if (!changes_park(&poll->waiter, next) ||
+        (atomic_load(&shutting_down) && changes_cancel(&poll->waiter))) {
+        MHD_resume_connection(connection);
+    }
+    return MHD_YES;
+}
+
+// Handle a watch: the changes after ?since=, optionally of one network,
+// waiting up to ?timeout= seconds for the first one with the connection
+// suspended, so waiting watchers hold no thread. Without since it returns
+// the current sequence at once, to list from and then watch. The
+// request's state is NULL on the first call and the parked watch when the
+// connection is resumed.
+int handle_watch(struct MHD_Connection* connection, const route_match_t* match, request_t* request) {
+    (void)match;
+    watch_poll_t* poll = request->state;
+    if (poll) {
+        return watch_changes(connection, poll);
+    }
+
+    const char* since_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "since");
+    const char* network_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "network_id");
+    const char* timeout_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "timeout");
+
+    unsigned long long since = 0, timeout = DEFAULT_WATCH_TIMEOUT;
+    vxlan_uuid_t network_id;
+    if ((since_arg && !parse_unsigned(since_arg, UINT64_MAX, &since)) ||
+        (timeout_arg && !parse_unsigned(timeout_arg, MAX_WATCH_TIMEOUT, &timeout)) ||
+        (network_arg && !vxlan_uuid_parse(network_arg, &network_id))) {
+        return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_PARAMS",
+                          "Invalid since, network_id or timeout");
+    }
+    if (!since_arg) {
+        return send_changes(connection, NULL, 0, storage_changes_last());
+    }
+
+    poll = calloc(1, sizeof(watch_poll_t));
+    if (!poll) {
+        return send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "WATCH_FAILED", "Failed to watch");
+    }
+    poll->kind = POLL_WATCH;
+    poll->connection = connection;
+    poll->since = since;
+    poll->filtered = network_arg != NULL;
+    if (network_arg) {
+        poll->network_id = network_id;
+    }
+    changes_waiter_init(&poll->waiter, poll->filtered ? &poll->network_id : NULL, (int)timeout * 1000,
+                        resume_watch, poll);
+    poll->waiter.timed_out = timeout == 0;
+    request->state = poll;
+    return watch_changes(connection, poll);
+}
+
+// Most updates in one FDB response, and the longest wait for one
+#define MAX_FDB_UPDATES 1000
+#define MAX_FDB_TIMEOUT 300
+#define DEFAULT_FDB_TIMEOUT 30
+
+// An FDB poll parked (its connection suspended) until updates arrive or
+// it times out. Updates taken while parking are kept for the response.
+typedef struct {
+    poll_kind_t kind;
+    struct MHD_Connection* connection;
+    char* host_id;
+    fdb_update_t* updates;
+    int count;
+    bool gone;
+} fdb_poll_t;
+
+static const char* fdb_op_name(fdb_op_t op) {
+    switch (op) {
+    case FDB_ADD: return "add";
+    case FDB_REMOVE: return "remove";
+    case FDB_FLUSH: return "flush";
+    }
+    return "unknown";
+}
+
+// Send FDB updates, or 410 when the host's stream has to be restarted
+static int send_fdb_updates(struct MHD_Connection* connection, const fdb_update_t* updates, int count,
+                            bool gone) {
+    if (gone) {
+        return send_error(connection, MHD_HTTP_GONE, "RESYNC_REQUIRED",
+                          "FDB stream not started or dropped; start it again");
+    }
+    writer_t writer;
+    writer_init(&writer);
+    writer_begin_object(&writer);
+    writer_key(&writer, "updates");
+    writer_begin_array(&writer);
+    for (int i = 0; i < count; i++) {
+        writer_begin_object(&writer);
+        writer_key(&writer, "op");
+        writer_string(&writer, fdb_op_name(updates[i].op));
+        writer_key(&writer, "vni");
+        writer_int(&writer, updates[i].vni);
+        writer_key(&writer, "network_id");
+        writer_uuid(&writer, &updates[i].network_id);
+        if (updates[i].op != FDB_FLUSH) {
+            writer_key(&writer, "endpoint");
+            writer_endpoint(&writer, &updates[i].endpoint);
+        }
+        writer_end_object(&writer);
+    }
+    writer_end_array(&writer);
+    writer_end_object(&writer);
+    return send_writer(connection, MHD_HTTP_OK, &writer, NULL, NULL);
+}
+
+// Resume a parked poll; called by the FDB module with the host locked
+static void resume_poll(void* ctx) {
+    MHD_resume_connection(((fdb_poll_t*)ctx)->connection);
+}
+
+// Handle a host's FDB stream: GET /api/v1/hosts/{host_id}/fdb. ?start=true
+// (re)starts it with the host's full FDB; later calls return the updates
+// queued since, waiting up to ?timeout= seconds with the connection
+// suspended, so waiting hosts hold no thread. The request's state is NULL
+// on the first call and the parked poll when the connection is resumed.
+int handle_host_fdb(struct MHD_Connection* connection, const route_match_t* match, request_t* request) {
+    fdb_poll_t* poll = request->state;
+    if (poll) {
+        if (!poll->gone && !poll->updates) {
+            poll->updates = malloc(MAX_FDB_UPDATES * sizeof(fdb_update_t));
+            if (!poll->updates) {
+                return send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "FDB_FAILED",
+                                  "Failed to read FDB updates");
+            }
+            poll->gone = !fdb_take(poll->host_id, poll->updates, MAX_FDB_UPDATES, &poll->count, NULL, NULL, 0);
+        }
+        return send_fdb_updates(connection, poll->updates, poll->count, poll->gone);
+    }
+
+    const route_param_t* host_id = &match->params[ROUTE_PARAM_HOST_ID];
+    const char* start_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "start");
+    const char* timeout_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "timeout");
+    unsigned long long timeout = DEFAULT_FDB_TIMEOUT;
+    if (timeout_arg && !parse_unsigned(timeout_arg, MAX_FDB_TIMEOUT, &timeout)) {
+        return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_PARAMS", "Invalid timeout");
+    }
+
+    poll = calloc(1, sizeof(fdb_poll_t));
+    if (poll) {
+        poll->kind = POLL_FDB;
+        poll->connection = connection;
+        poll->host_id = strndup(host_id->value, host_id->len);
+        poll->updates = malloc(MAX_FDB_UPDATES * sizeof(fdb_update_t));
+    }
+    if (!poll || !poll->host_id || !poll->updates) {
+        if (poll) {
+            free(poll->host_id);
+            free(poll->updates);
+            free(poll);
+        }
+        return send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "FDB_FAILED", "Failed to read FDB updates");
+    }
+    request->state = poll;
+
+    if (start_arg && strcmp(start_arg, "true") == 0 && !fdb_start(poll->host_id)) {
+        return send_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "FDB_FAILED", "Failed to start FDB stream");
+    }
+    poll->gone = !fdb_take(poll->host_id, poll->updates, MAX_FDB_UPDATES, &poll->count, NULL, NULL, 0);
+    if (poll->gone || poll->count > 0 || timeout == 0 || atomic_load(&shutting_down)) {
+        return send_fdb_updates(connection, poll->updates, poll->count, poll->gone);
+    }
+
+    // Park: suspend first, so a notification can only resume a suspended
+    // connection. Updates that slipped in meanwhile are kept for the
+    // resumed call, which otherwise takes whatever has arrived. A poll
+    // parked as shutdown began takes itself back, as a watch does.
+    MHD_suspend_connection(connection);
+    poll->gone = !fdb_take(poll->host_id, poll->updates, MAX_FDB_UPDATES, &poll->count, resume_poll, poll,
+                           (int)timeout * 1000);
+    if (poll->gone || poll->count > 0 || (atomic_load(&shutting_down) && fdb_cancel(poll->host_id, poll))) {
+        MHD_resume_connection(connection);
+    } else {
+        free(poll->updates);
+        poll->updates = NULL;
+    }
+    return MHD_YES;
+}
+
+// Release the state of a finished request
+void api_request_completed(void* state) {
+    // After the cancel no notification can resume the connection
+    if (*(poll_kind_t*)state == POLL_WATCH) {
+        watch_poll_t* poll = state;
+        changes_cancel(&poll->waiter);
+        free(poll);
+        return;
+    }
+    fdb_poll_t* poll = state;
+    fdb_cancel(poll->host_id, poll);
+    free(poll->updates);
+    free(poll->host_id);
+    free(poll);
+}
+
+// Time out parked polls; call about once a second
+void api_tick(void) {
+    changes_expire(false);
+    fdb_expire(false);
+}
+
+// Stop parking polls and resume every parked one, before the HTTP daemon
+// is stopped
+void api_resume_all(void) {
+    atomic_store(&shutting_down, true);
+    changes_expire(true);
+    fdb_expire(true);
+}
+
+// Handle an address lookup: the endpoint holding a MAC or IP in a VNI
+int handle_lookup(struct MHD_Connection* connection, const route_match_t* match, request_t* request) {
+    (void)match;
+    (void)request;
+    const char* vni_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "vni");
+    const char* mac_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "mac");
+    const char* ip_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "ip");
+
+    char* end = NULL;
+    errno = 0;
+    unsigned long vni = vni_arg ? strtoul(vni_arg, &end, 10) : 0;
+    if (!vni_arg || !*vni_arg || *end || errno || vni < 1 || vni > MAX_VNI || !mac_arg == !ip_arg) {
+        return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_PARAMS",
+                          "vni and exactly one of mac or ip are required");
+    }
+
+    vxlan_mac_t mac;
+    vxlan_ip_t ip;
+    if (mac_arg ? !vxlan_mac_parse(mac_arg, &mac) : !vxlan_ip_parse(ip_arg, &ip)) {
+        return send_error(connection, MHD_HTTP_BAD_REQUEST, "INVALID_PARAMS", "Invalid address format");
+    }
+
+    storage_read_begin();
+    vxlan_endpoint_t* endpoint = mac_arg ? storage_lookup_mac((uint32_t)vni, &mac)
+                                         : storage_lookup_ip((uint32_t)vni, &ip);
+    if (!endpoint) {
+        storage_read_end();
+        return send_error(connection, MHD_HTTP_NOT_FOUND, "NOT_FOUND", "Address not found");
+    }
+    // Versions are never reused, so the endpoint's tag also tells whether
+    // the address has moved to another endpoint since
+    char etag[CACHE_ETAG_SIZE];
+    cache_etag(endpoint->version, etag);
+    if (not_modified(connection, etag)) {
+        storage_read_end();
+        return send_not_modified(connection, etag);
+    }
+    cache_endpoint(endpoint);
+    writer_t writer;
+    writer_init(&writer);
+    cache_write_endpoint(&writer, endpoint);
+    storage_read_end();
+    return send_writer(connection, MHD_HTTP_OK, &writer, NULL, etag);
+}
+
+typedef int (*api_handler_t)(struct MHD_Connection* connection, const route_match_t* match, request_t* request);
+
+// Indexed by api_route_t
+static const api_handler_t route_handlers[API_ROUTE_COUNT] = {
+    [ROUTE_CREATE_NETWORK] = handle_create_network,
+    [ROUTE_LIST_NETWORKS] = handle_list_networks,
+    [ROUTE_GET_NETWORK] = handle_get_network,
+    [ROUTE_DELETE_NETWORK] = handle_delete_network,
+    [ROUTE_ADD_ENDPOINT] = handle_create_endpoint,
+    [ROUTE_LIST_ENDPOINTS] = handle_list_endpoints,
+    [ROUTE_GET_ENDPOINT] = handle_get_endpoint,
+    [ROUTE_REMOVE_ENDPOINT] = handle_delete_endpoint,
+    [ROUTE_WATCH_CHANGES] = handle_watch,
+    [ROUTE_TAKE_HOST_FDB] = handle_host_fdb,
+    [ROUTE_LOOKUP_ADDRESS] = handle_lookup,
+};
+
+// Refuse a method the path has no route for, naming the ones it has
+static int send_method_not_allowed(struct MHD_Connection* connection, unsigned allowed) {
+    static const char json[] = "{\"code\":\"METHOD_NOT_ALLOWED\",\"message\":\"Method not allowed\"}";
+    struct MHD_Response* response = MHD_create_response_from_buffer(sizeof(json) - 1, (void*)json,
+                                                                    MHD_RESPMEM_PERSISTENT);
+    if (!response) {
+        LOG_ERROR_FMT("Failed to create response");
+        return MHD_NO;
+    }
+
+    char allow[64];
+    router_format_allowed(allowed, allow, sizeof(allow));
+    MHD_add_response_header(response, "Content-Type", "application/json");
+    MHD_add_response_header(response, MHD_HTTP_HEADER_ALLOW, allow);
+    int ret = MHD_queue_response(connection, MHD_HTTP_METHOD_NOT_ALLOWED, response);
+    MHD_destroy_response(response);
     return ret;
-} 
\ No newline at end of file
+}
+
+// Route a request to its handler
+int api_dispatch(struct MHD_Connection* connection, const char* method, const char* url, request_t* request) {
+    route_match_t match;
+    switch (router_match(router, method, url, &match)) {
+    case ROUTER_FOUND:
+        return route_handlers[match.route](connection, &match, request);
+    case ROUTER_METHOD_NOT_ALLOWED:
+        return send_method_not_allowed(connection, match.allowed);
+    default:
+        return send_error(connection, MHD_HTTP_NOT_FOUND, "NOT_FOUND", "Not found");
+    }
+}
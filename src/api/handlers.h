@@ -3,23 +3,46 @@
 
 #include <stdbool.h>
 #include <microhttpd.h>
+#include "request.h"
+#include "router.h"
 
-// Initialize API handlers
-bool api_init(void);
+// Initialize API handlers. State is recovered from and logged to the
+// write-ahead log at wal_path, with a snapshot taken every
+// snapshot_interval seconds (0 never); NULL keeps it in memory only.
+bool api_init(const char* wal_path, unsigned snapshot_interval);
 
 // Clean up API resources
 void api_cleanup(void);
 
-// Network handlers
-int handle_create_network(struct MHD_Connection* connection, const char* upload_data);
-int handle_get_network(struct MHD_Connection* connection, const char* network_id);
-int handle_delete_network(struct MHD_Connection* connection, const char* network_id);
-int handle_list_networks(struct MHD_Connection* connection);
-
-// Endpoint handlers
-int handle_create_endpoint(struct MHD_Connection* connection, const char* url, const char* upload_data);
-int handle_get_endpoint(struct MHD_Connection* connection, const char* endpoint_id);
-int handle_delete_endpoint(struct MHD_Connection* connection, const char* url);
-int handle_list_endpoints(struct MHD_Connection* connection, const char* url);
+// Route a request to its handler: 404 for a path the API does not have,
+// 405 with an Allow header for a method the path does not take
+int api_dispatch(struct MHD_Connection* connection, const char* method, const char* url, request_t* request);
+
+// Handlers, one per route in routes.h; path parameters come from match.
+// Create handlers take their JSON body from the request.
+int handle_create_network(struct MHD_Connection* connection, const route_match_t* match, request_t* request);
+int handle_get_network(struct MHD_Connection* connection, const route_match_t* match, request_t* request);
+int handle_delete_network(struct MHD_Connection* connection, const route_match_t* match, request_t* request);
+int handle_list_networks(struct MHD_Connection* connection, const route_match_t* match, request_t* request);
+int handle_create_endpoint(struct MHD_Connection* connection, const route_match_t* match, request_t* request);
+int handle_get_endpoint(struct MHD_Connection* connection, const route_match_t* match, request_t* request);
+int handle_delete_endpoint(struct MHD_Connection* connection, const route_match_t* match, request_t* request);
+int handle_list_endpoints(struct MHD_Connection* connection, const route_match_t* match, request_t* request);
+
+// Address lookup handler
+int handle_lookup(struct MHD_Connection* connection, const route_match_t* match, request_t* request);
+
+// Change feed and host FDB stream handlers (long polls). The request's
+// state carries a poll parked with the connection suspended; release it
+// with api_request_completed().
+int handle_watch(struct MHD_Connection* connection, const route_match_t* match, request_t* request);
+int handle_host_fdb(struct MHD_Connection* connection, const route_match_t* match, request_t* request);
+void api_request_completed(void* state);
+
+// Time out parked polls (about once a second). At shutdown, once the
+// daemon is quiesced, api_resume_all() resumes every parked poll and makes
+// later ones answer at once, so none is suspended when the daemon stops.
+void api_tick(void);
+void api_resume_all(void);
 
 #endif // HANDLERS_H 
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "request.h"
+
+// A finished request kept for the next one on the same thread, freed
+// when the thread exits
+static _Thread_local request_t* spare = NULL;
+static _Thread_local bool spare_registered = false;
+static pthread_key_t spare_key;
+static pthread_once_t spare_key_once = PTHREAD_ONCE_INIT;
+
+static void destroy(request_t* request) {
+    if (request->tokener) {
+        json_tokener_free(request->tokener);
+    }
+    free(request);
+}
+
+static void spare_release(void* arg) {
+    (void)arg;
+    if (spare) {
+        destroy(spare);
+        spare = NULL;
+    }
+}
+
+static void make_spare_key(void) {
+    pthread_key_create(&spare_key, spare_release);
+}
+
+// Start a request, reusing this thread's spare one when there is one
+request_t* request_new(void) {
+    request_t* request = spare;
+    if (request) {
+        spare = NULL;
+        return request;
+    }
+    return calloc(1, sizeof(request_t));
+}
+
+static bool all_space(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] != ' ' && data[i] != '\t' && data[i] != '\r' && data[i] != '\n') return false;
+    }
+    return true;
+}
+
+// Drop a body that will not be used
+static void drop_body(request_t* request, body_status_t status) {
+    if (request->body) {
+        json_object_put(request->body);
+        request->body = NULL;
+    }
+    request->status = status;
+}
+
+// Parse the next chunk of the body. The tokener keeps a token split
+// across chunks, so chunks can end anywhere.
+void request_feed(request_t* request, const char* data, size_t size) {
+    if (request->status == BODY_INVALID || request->status == BODY_TOO_LARGE) return;
+
+    request->body_size += size;
+    if (request->body_size > MAX_BODY_SIZE) {
+        drop_body(request, BODY_TOO_LARGE);
+        return;
+    }
+    if (request->status == BODY_COMPLETE) {
+        if (!all_space(data, size)) drop_body(request, BODY_INVALID);
+        return;
+    }
+
+    if (!request->tokener && !(request->tokener = json_tokener_new())) {
+        request->status = BODY_INVALID;
+        return;
+    }
+    // size is at most MAX_BODY_SIZE, so it fits the tokener's int
+    request->body = json_tokener_parse_ex(request->tokener, data, (int)size);
+    if (request->body) {
+        size_t end = json_tokener_get_parse_end(request->tokener);
+        request->status = BODY_COMPLETE;
+        if (!all_space(data + end, size - end)) drop_body(request, BODY_INVALID);
+    } else {
+        request->status = json_tokener_get_error(request->tokener) == json_tokener_continue
+            ? BODY_PARTIAL : BODY_INVALID;
+    }
+}
+
+// The body once the upload is over
+struct json_object* request_body(request_t* request) {
+    if (request->status == BODY_PARTIAL) {
+        request->status = BODY_INVALID;
+    }
+    return request->body;
+}
+
+// Release a request, keeping it as this thread's spare if there is none
+void request_free(request_t* request) {
+    if (!request) return;
+
+    drop_body(request, BODY_NONE);
+    request->body_size = 0;
+    request->state = NULL;
+    if (!spare) {
+        // Key destructors only run for a non-NULL value
+        if (!spare_registered) {
+            pthread_once(&spare_key_once, make_spare_key);
+            pthread_setspecific(spare_key, &spare);
+            spare_registered = true;
+        }
+        if (request->tokener) {
+            json_tokener_reset(request->tokener);
+        }
+        spare = request;
+        return;
+    }
+    destroy(request);
+}
@@ -0,0 +1,48 @@
+#ifndef REQUEST_H
+#define REQUEST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <json-c/json.h>
+
+// Largest request body accepted; the rest of a larger upload is read and
+// dropped, and the request refused
+#define MAX_BODY_SIZE (16 * 1024 * 1024)
+
+typedef enum {
+    BODY_NONE,       // nothing received
+    BODY_PARTIAL,    // a document is being parsed
+    BODY_COMPLETE,   // one whole document, optionally followed by whitespace
+    BODY_INVALID,    // not JSON, cut short, or followed by more data
+    BODY_TOO_LARGE,  // over MAX_BODY_SIZE
+} body_status_t;
+
+// State of one HTTP request, kept by the daemon across the calls for the
+// request: its upload chunks and, for a parked poll, its resumption.
+//
+// The body is parsed as it arrives: each chunk goes straight to an
+// incremental JSON tokener, so a large body is never buffered whole or
+// scanned twice. Requests are recycled per thread, tokener included, so
+// the common request allocates no state of its own.
+typedef struct {
+    struct json_tokener* tokener;
+    struct json_object* body;
+    body_status_t status;
+    size_t body_size;
+    void* state;  // handler state, e.g. a parked FDB poll
+} request_t;
+
+// Start a request; NULL when out of memory
+request_t* request_new(void);
+
+// Parse the next chunk of the body
+void request_feed(request_t* request, const char* data, size_t size);
+
+// The body once the upload is over, or NULL when there is none or it is
+// not one JSON document (see status). The request keeps ownership.
+struct json_object* request_body(request_t* request);
+
+// Release a request and its body; handler state is the caller's
+void request_free(request_t* request);
+
+#endif // REQUEST_H
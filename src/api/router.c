@@ -0,0 +1,264 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include "router.h"
+#include "../utils/logging.h"
+
+static const char* const method_names[ROUTER_METHODS] = {"GET", "POST", "PUT", "PATCH", "DELETE"};
+
+// A path position: the routes ending here and the segments that follow
+typedef struct node {
+    const char* segment;  // literal text in the template, not terminated; may span segments
+    size_t len;
+    struct node* literals;  // first literal child
+    struct node* next;      // next literal sibling
+    struct node* param;     // parameter child
+    int routes[ROUTER_METHODS];  // route index per method, -1 for none
+    unsigned allowed;
+} node_t;
+
+struct router {
+    node_t* root;
+};
+
+static int method_of(const char* method) {
+    if (!method) return -1;
+    switch (method[0]) {
+    case 'G': return strcmp(method, "GET") == 0 ? ROUTER_GET : -1;
+    case 'D': return strcmp(method, "DELETE") == 0 ? ROUTER_DELETE : -1;
+    case 'P':
+        if (strcmp(method, "POST") == 0) return ROUTER_POST;
+        if (strcmp(method, "PUT") == 0) return ROUTER_PUT;
+        return strcmp(method, "PATCH") == 0 ? ROUTER_PATCH : -1;
+    }
+    return -1;
+}
+
+static node_t* node_new(const char* segment, size_t len) {
+    node_t* node = calloc(1, sizeof(node_t));
+    if (!node) return NULL;
+    node->segment = segment;
+    node->len = len;
+    for (int i = 0; i < ROUTER_METHODS; i++) {
+        node->routes[i] = -1;
+    }
+    return node;
+}
+
+static void node_free(node_t* node) {
+    while (node) {
+        node_t* next = node->next;
+        node_free(node->literals);
+        node_free(node->param);
+        free(node);
+        node = next;
+    }
+}
+
+// The child of node for one template segment, created if needed; NULL
+// with errno set if the segment is malformed or memory runs out
+static node_t* child_for(node_t* node, const char* segment, size_t len, int* params) {
+    if (len == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (segment[0] == '{') {
+        // "{name}", with no braces inside the name
+        if (len < 3 || segment[len - 1] != '}' || memchr(segment + 1, '{', len - 2) ||
+            memchr(segment + 1, '}', len - 2) || ++*params > ROUTER_MAX_PARAMS) {
+            errno = EINVAL;
+            return NULL;
+        }
+        if (!node->param && !(node->param = node_new(segment, len))) {
+            errno = ENOMEM;
+        }
+        return node->param;
+    }
+    if (memchr(segment, '{', len) || memchr(segment, '}', len)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    for (node_t* child = node->literals; child; child = child->next) {
+        if (child->len == len && memcmp(child->segment, segment, len) == 0) return child;
+    }
+    node_t* child = node_new(segment, len);
+    if (!child) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    child->next = node->literals;
+    node->literals = child;
+    return child;
+}
+
+// Add route index to the tree
+static bool add_route(node_t* root, const route_t* route, int index) {
+    int method = method_of(route->method);
+    const char* p = route->path;
+    if (method < 0 || !p || *p != '/') {
+        errno = EINVAL;
+        return false;
+    }
+
+    node_t* node = root;
+    int params = 0;
+    while (*p) {
+        p++;  // the '/'
+        size_t len = strcspn(p, "/");
+        node = child_for(node, p, len, &params);
+        if (!node) return false;
+        p += len;
+    }
+    if (node->routes[method] >= 0) {
+        errno = EINVAL;
+        return false;
+    }
+    node->routes[method] = index;
+    node->allowed |= 1u << method;
+    return true;
+}
+
+// Merge each literal with its only child while neither ends a route or
+// has a parameter, so that a run such as "api/v1" is one comparison. The
+// two are adjacent in the template that created them.
+static void node_compress(node_t* node) {
+    for (node_t* child = node->literals; child; child = child->next) {
+        node_t* only;
+        while (!child->allowed && !child->param && (only = child->literals) && !only->next &&
+               child->segment + child->len + 1 == only->segment) {
+            child->len += 1 + only->len;
+            child->literals = only->literals;
+            child->param = only->param;
+            memcpy(child->routes, only->routes, sizeof(child->routes));
+            child->allowed = only->allowed;
+            free(only);
+        }
+        node_compress(child);
+    }
+    if (node->param) {
+        node_compress(node->param);
+    }
+}
+
+// Compile a route table
+router_t* router_compile(const route_t* routes, int count) {
+    router_t* router = malloc(sizeof(router_t));
+    if (!router || !(router->root = node_new("", 0))) {
+        free(router);
+        errno = ENOMEM;
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!add_route(router->root, &routes[i], i)) {
+            int reason = errno;
+            LOG_ERROR_FMT("Invalid route %s %s", routes[i].method ? routes[i].method : "(none)",
+                          routes[i].path ? routes[i].path : "(none)");
+            router_free(router);
+            errno = reason;
+            return NULL;
+        }
+    }
+    node_compress(router->root);
+    return router;
+}
+
+void router_free(router_t* router) {
+    if (!router) return;
+    node_free(router->root);
+    free(router);
+}
+
+// True if a literal, which may span segments, is the whole of the
+// segments that start the rest of a path
+static bool literal_matches(const node_t* literal, const char* segment) {
+    size_t i = 0;
+    while (i < literal->len) {
+        if (segment[i] != literal->segment[i]) return false;  // or the path ended
+        i++;
+    }
+    return segment[i] == '/' || !segment[i];
+}
+
+// The node the rest of a path leads to from node with a route for one of
+// the methods in want, collecting parameters; NULL if there is none. The
+// first node reached with routes for other methods only is kept in
+// fallback. A literal is tried before the parameter, so only a literal
+// beside a parameter needs a recursive call to back up from.
+static const node_t* walk(const node_t* node, const char* path, unsigned want, route_match_t* match,
+                          const node_t** fallback) {
+    int count = match->count;
+    for (;;) {
+        if (!*path) {
+            if (node->allowed & want) return node;
+            if (node->allowed && !*fallback) {
+                *fallback = node;
+            }
+            break;
+        }
+        if (*path != '/') break;
+
+        const char* segment = path + 1;
+        const node_t* literal = node->literals;
+        while (literal && !literal_matches(literal, segment)) {
+            literal = literal->next;  // siblings differ in their first segment
+        }
+        if (literal && !node->param) {
+            node = literal;
+            path = segment + literal->len;
+            continue;
+        }
+        if (literal) {
+            const node_t* found = walk(literal, segment + literal->len, want, match, fallback);
+            if (found) return found;
+        }
+        if (!node->param || match->count >= ROUTER_MAX_PARAMS) break;
+        const char* end = strchr(segment, '/');
+        size_t len = end ? (size_t)(end - segment) : strlen(segment);
+        if (len == 0) break;
+        match->params[match->count].value = segment;
+        match->params[match->count].len = len;
+        match->count++;
+        node = node->param;
+        path = segment + len;
+    }
+    match->count = count;
+    return NULL;
+}
+
+// Match a request: a route for its method if the path has one, else the
+// methods of the path for a 405
+router_result_t router_match(const router_t* router, const char* method, const char* path, route_match_t* match) {
+    match->route = -1;
+    match->count = 0;
+    match->allowed = 0;
+    if (!path) return ROUTER_NOT_FOUND;
+
+    int index = method_of(method);
+    const node_t* fallback = NULL;
+    const node_t* node = walk(router->root, path, index >= 0 ? 1u << index : 0, match, &fallback);
+    if (node) {
+        match->allowed = node->allowed;
+        match->route = node->routes[index];
+        return ROUTER_FOUND;
+    }
+    match->count = 0;
+    if (!fallback) return ROUTER_NOT_FOUND;
+    match->allowed = fallback->allowed;
+    return ROUTER_METHOD_NOT_ALLOWED;
+}
+
+// Format allowed methods for an Allow header
+void router_format_allowed(unsigned allowed, char* buf, size_t size) {
+    size_t len = 0;
+    if (size > 0) {
+        buf[0] = '\0';
+    }
+    for (int i = 0; i < ROUTER_METHODS; i++) {
+        if (!(allowed & (1u << i)) || len >= size) continue;
+        int n = snprintf(buf + len, size - len, "%s%s", len ? ", " : "", method_names[i]);
+        if (n > 0) {
+            len += (size_t)n;
+        }
+    }
+}
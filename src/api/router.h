@@ -0,0 +1,70 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Path-template router.
+//
+// A route table of templates such as "/networks/{network_id}/endpoints"
+// is compiled once into a tree of path segments: literal segments by
+// text, and at most one parameter per position. A run of literals with no
+// branches, such as the API's base path, becomes one node. Matching walks the path
+// segment by segment, preferring a literal to a parameter and backing up
+// only when a literal branch dead-ends or has no route for the method.
+// Parameters come back as pointers into the path with their lengths, so a
+// match copies and allocates nothing. A parameter matches one non-empty
+// segment.
+
+// Most parameters in one template
+#define ROUTER_MAX_PARAMS 4
+
+typedef enum {
+    ROUTER_GET,
+    ROUTER_POST,
+    ROUTER_PUT,
+    ROUTER_PATCH,
+    ROUTER_DELETE,
+    ROUTER_METHODS
+} router_method_t;
+
+// One route. The strings are not copied and must outlive the router.
+typedef struct {
+    const char* method;
+    const char* path;
+    const char* name;  // e.g. the OpenAPI operationId
+} route_t;
+
+typedef struct {
+    const char* value;  // not terminated
+    size_t len;
+} route_param_t;
+
+typedef struct {
+    int route;  // index in the route table
+    int count;  // parameters, set when found
+    route_param_t params[ROUTER_MAX_PARAMS];  // in template order
+    unsigned allowed;  // methods the path has routes for, a bit per router_method_t
+} route_match_t;
+
+typedef enum {
+    ROUTER_FOUND,
+    ROUTER_NOT_FOUND,
+    ROUTER_METHOD_NOT_ALLOWED  // the path exists: see allowed
+} router_result_t;
+
+typedef struct router router_t;
+
+// Compile a route table; NULL with errno EINVAL for an unknown method, a
+// malformed template, too many parameters or two routes for one method
+// and template, or with errno ENOMEM
+router_t* router_compile(const route_t* routes, int count);
+void router_free(router_t* router);
+
+// Match a request
+router_result_t router_match(const router_t* router, const char* method, const char* path, route_match_t* match);
+
+// Format allowed methods for an Allow header, e.g. "GET, DELETE"
+void router_format_allowed(unsigned allowed, char* buf, size_t size);
+
+#endif // ROUTER_H
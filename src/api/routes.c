@@ -0,0 +1,16 @@
+#include "routes.h"
+
+const route_t api_routes[API_ROUTE_COUNT] = {
+    [ROUTE_CREATE_NETWORK] = {"POST", API_BASE_PATH "/networks", "createNetwork"},
+    [ROUTE_LIST_NETWORKS] = {"GET", API_BASE_PATH "/networks", "listNetworks"},
+    [ROUTE_GET_NETWORK] = {"GET", API_BASE_PATH "/networks/{network_id}", "getNetwork"},
+    [ROUTE_DELETE_NETWORK] = {"DELETE", API_BASE_PATH "/networks/{network_id}", "deleteNetwork"},
+    [ROUTE_ADD_ENDPOINT] = {"POST", API_BASE_PATH "/networks/{network_id}/endpoints", "addEndpoint"},
+    [ROUTE_LIST_ENDPOINTS] = {"GET", API_BASE_PATH "/networks/{network_id}/endpoints", "listEndpoints"},
+    [ROUTE_GET_ENDPOINT] = {"GET", API_BASE_PATH "/networks/{network_id}/endpoints/{endpoint_id}", "getEndpoint"},
+    [ROUTE_REMOVE_ENDPOINT] = {"DELETE", API_BASE_PATH "/networks/{network_id}/endpoints/{endpoint_id}",
+                               "removeEndpoint"},
+    [ROUTE_WATCH_CHANGES] = {"GET", API_BASE_PATH "/watch", "watchChanges"},
+    [ROUTE_TAKE_HOST_FDB] = {"GET", API_BASE_PATH "/hosts/{host_id}/fdb", "takeHostFdb"},
+    [ROUTE_LOOKUP_ADDRESS] = {"GET", API_BASE_PATH "/lookup", "lookupAddress"},
+};
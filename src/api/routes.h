@@ -0,0 +1,34 @@
+#ifndef ROUTES_H
+#define ROUTES_H
+
+#include "router.h"
+
+// The API's routes, mirroring the paths and operations of api/openapi.yaml
+// under the server's base path. Each is named by its operationId.
+
+#define API_BASE_PATH "/api/v1"
+
+typedef enum {
+    ROUTE_CREATE_NETWORK,
+    ROUTE_LIST_NETWORKS,
+    ROUTE_GET_NETWORK,
+    ROUTE_DELETE_NETWORK,
+    ROUTE_ADD_ENDPOINT,
+    ROUTE_LIST_ENDPOINTS,
+    ROUTE_GET_ENDPOINT,
+    ROUTE_REMOVE_ENDPOINT,
+    ROUTE_WATCH_CHANGES,
+    ROUTE_TAKE_HOST_FDB,
+    ROUTE_LOOKUP_ADDRESS,
+    API_ROUTE_COUNT
+} api_route_t;
+
+// Path parameters, by position in their templates
+#define ROUTE_PARAM_NETWORK_ID 0
+#define ROUTE_PARAM_ENDPOINT_ID 1
+#define ROUTE_PARAM_HOST_ID 0
+
+// Indexed by api_route_t
+extern const route_t api_routes[API_ROUTE_COUNT];
+
+#endif // ROUTES_H
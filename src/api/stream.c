@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <string.h>
+#include "stream.h"
+#include "cache.h"
+#include "../storage/memory.h"
+#include "../utils/logging.h"
+
+// Write the next page of the listing over the previous one
+static bool fill(list_stream_t* stream) {
+    writer_clear(&stream->writer);
+    stream->sent = 0;
+    if (!stream->started) {
+        writer_begin_array(&stream->writer);
+        stream->started = true;
+    }
+
+    const vxlan_uuid_t* after = stream->has_after ? &stream->after : NULL;
+    int count;
+    storage_read_begin();
+    if (stream->networks) {
+        vxlan_network_t** networks = storage_list_networks_page(stream->tenant_id, after, LIST_STREAM_PAGE, &count);
+        if (!networks) {
+            storage_read_end();
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            cache_write_network(&stream->writer, networks[i]);
+        }
+        if (count > 0) {
+            stream->after = networks[count - 1]->id;
+        }
+        free(networks);
+    } else {
+        vxlan_endpoint_t** endpoints = storage_list_endpoints_page(&stream->network_id, after, LIST_STREAM_PAGE,
+                                                                   &count);
+        if (!endpoints) {
+            storage_read_end();
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            cache_write_endpoint(&stream->writer, endpoints[i]);
+        }
+        if (count > 0) {
+            stream->after = endpoints[count - 1]->id;
+        }
+        free(endpoints);
+    }
+    storage_read_end();
+
+    stream->has_after |= count > 0;
+    if (count < LIST_STREAM_PAGE) {
+        writer_end_array(&stream->writer);
+        stream->last_page = true;
+    }
+    return !stream->writer.failed;
+}
+
+// Read the first page of a new stream
+static list_stream_t* start(list_stream_t* stream) {
+    writer_init(&stream->writer);
+    if (!fill(stream)) {
+        LOG_ERROR_FMT("Failed to start streaming a listing");
+        list_stream_free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+// Start streaming a network's endpoints
+list_stream_t* list_stream_endpoints(const vxlan_uuid_t* network_id) {
+    list_stream_t* stream = calloc(1, sizeof(list_stream_t));
+    if (!stream) return NULL;
+    stream->network_id = *network_id;
+    return start(stream);
+}
+
+// Start streaming a tenant's networks, or all of them
+list_stream_t* list_stream_networks(const char* tenant_id) {
+    list_stream_t* stream = calloc(1, sizeof(list_stream_t));
+    if (!stream) return NULL;
+    stream->networks = true;
+    if (tenant_id && !(stream->tenant_id = strdup(tenant_id))) {
+        free(stream);
+        return NULL;
+    }
+    return start(stream);
+}
+
+// Copy the next bytes, writing another page once the current one is sent
+ssize_t list_stream_read(list_stream_t* stream, char* buf, size_t max) {
+    while (stream->sent == stream->writer.len) {
+        if (stream->last_page) return 0;
+        if (!fill(stream)) {
+            LOG_ERROR_FMT("Failed to stream a listing");
+            return -1;
+        }
+    }
+    size_t len = stream->writer.len - stream->sent;
+    if (len > max) {
+        len = max;
+    }
+    memcpy(buf, stream->writer.data + stream->sent, len);
+    stream->sent += len;
+    return (ssize_t)len;
+}
+
+// Release a stream
+void list_stream_free(void* ptr) {
+    list_stream_t* stream = ptr;
+    if (!stream) return;
+    writer_free(&stream->writer);
+    free(stream->tenant_id);
+    free(stream);
+}
@@ -0,0 +1,48 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "writer.h"
+#include "../network/vxlan.h"
+
+// Records read from storage per page of a streamed listing
+#define LIST_STREAM_PAGE 64
+
+// A full listing (a JSON array) produced in record id order one storage
+// page at a time, as the response is sent. Only one page of records and
+// its text are held at once, so the memory of a listing in flight does
+// not depend on its length, and the first bytes go out as soon as the
+// first page is written.
+//
+// Each page is read in its own read section, so unlike a buffered listing
+// the result is not the state at one instant: records saved or deleted
+// while it streams may or may not appear, but none appears twice and none
+// present throughout is missed (see storage_list_endpoints_page()).
+typedef struct {
+    bool networks;
+    vxlan_uuid_t network_id;  // whose endpoints are listed
+    char* tenant_id;          // whose networks are listed, NULL for all
+    bool started;
+    bool has_after;
+    vxlan_uuid_t after;  // id of the last record written
+    bool last_page;      // the closing bracket is written
+    writer_t writer;     // text of the current page
+    size_t sent;         // bytes of it already read
+} list_stream_t;
+
+// Start streaming a network's endpoints, or a tenant's (NULL: all)
+// networks. The first page is read at once, so a storage failure can
+// still be reported; NULL on failure.
+list_stream_t* list_stream_endpoints(const vxlan_uuid_t* network_id);
+list_stream_t* list_stream_networks(const char* tenant_id);
+
+// Copy up to max more bytes of the listing to buf; 0 at the end, -1 if
+// storage fails
+ssize_t list_stream_read(list_stream_t* stream, char* buf, size_t max);
+
+// Release a stream (void* for use as a response free callback)
+void list_stream_free(void* stream);
+
+#endif // STREAM_H
@@ -0,0 +1,294 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "writer.h"
+
+// A buffer carries its capacity in front of the text, so it can be
+// released from the text pointer alone
+typedef struct {
+    size_t capacity;
+    char data[];
+} buffer_t;
+
+// A released buffer kept for the next writer on the same thread, freed
+// when the thread exits
+static _Thread_local buffer_t* spare = NULL;
+static _Thread_local bool spare_registered = false;
+static pthread_key_t spare_key;
+static pthread_once_t spare_key_once = PTHREAD_ONCE_INIT;
+
+static void spare_release(void* arg) {
+    (void)arg;
+    free(spare);
+    spare = NULL;
+}
+
+static void make_spare_key(void) {
+    pthread_key_create(&spare_key, spare_release);
+}
+
+static buffer_t* buffer_of(char* data) {
+    return (buffer_t*)(data - offsetof(buffer_t, data));
+}
+
+// Start an empty writer
+void writer_init(writer_t* writer) {
+    buffer_t* buffer = spare;
+    spare = NULL;
+    writer->data = buffer ? buffer->data : NULL;
+    writer->capacity = buffer ? buffer->capacity : 0;
+    writer->len = 0;
+    writer->comma = false;
+    writer->failed = false;
+}
+
+// Release a buffer, keeping it as this thread's spare if there is none
+void writer_buffer_free(void* data) {
+    if (!data) return;
+
+    buffer_t* buffer = buffer_of(data);
+    if (!spare && buffer->capacity <= WRITER_SPARE_MAX) {
+        // Key destructors only run for a non-NULL value
+        if (!spare_registered) {
+            pthread_once(&spare_key_once, make_spare_key);
+            pthread_setspecific(spare_key, &spare);
+            spare_registered = true;
+        }
+        spare = buffer;
+        return;
+    }
+    free(buffer);
+}
+
+// Release the buffer of a writer whose text was not taken
+void writer_free(writer_t* writer) {
+    writer_buffer_free(writer->data);
+    writer->data = NULL;
+    writer->capacity = 0;
+    writer->len = 0;
+}
+
+// Take the text
+char* writer_take(writer_t* writer, size_t* len) {
+    if (writer->failed || !writer->data) {
+        writer_free(writer);
+        return NULL;
+    }
+    char* data = writer->data;
+    *len = writer->len;
+    writer->data = NULL;
+    writer->capacity = 0;
+    writer->len = 0;
+    return data;
+}
+
+// Drop the text written so far
+void writer_clear(writer_t* writer) {
+    writer->len = 0;
+}
+
+// Make room for size more bytes, doubling the buffer
+static bool reserve(writer_t* writer, size_t size) {
+    if (writer->failed) return false;
+    if (writer->len + size <= writer->capacity) return true;
+
+    size_t capacity = writer->capacity ? writer->capacity : WRITER_INITIAL_SIZE;
+    while (capacity < writer->len + size) {
+        capacity *= 2;
+    }
+    buffer_t* buffer = realloc(writer->data ? buffer_of(writer->data) : NULL, sizeof(buffer_t) + capacity);
+    if (!buffer) {
+        writer->failed = true;
+        return false;
+    }
+    buffer->capacity = capacity;
+    writer->data = buffer->data;
+    writer->capacity = capacity;
+    return true;
+}
+
+static void append(writer_t* writer, const char* text, size_t len) {
+    if (reserve(writer, len)) {
+        memcpy(writer->data + writer->len, text, len);
+        writer->len += len;
+    }
+}
+
+static void append_char(writer_t* writer, char c) {
+    if (reserve(writer, 1)) {
+        writer->data[writer->len++] = c;
+    }
+}
+
+// Start a value or member, after a comma if it is not the first
+static void separate(writer_t* writer) {
+    if (writer->comma) {
+        append_char(writer, ',');
+    }
+    writer->comma = true;
+}
+
+void writer_begin_object(writer_t* writer) {
+    separate(writer);
+    append_char(writer, '{');
+    writer->comma = false;
+}
+
+void writer_end_object(writer_t* writer) {
+    append_char(writer, '}');
+    writer->comma = true;
+}
+
+void writer_begin_array(writer_t* writer) {
+    separate(writer);
+    append_char(writer, '[');
+    writer->comma = false;
+}
+
+void writer_end_array(writer_t* writer) {
+    append_char(writer, ']');
+    writer->comma = true;
+}
+
+// Write a quoted string, escaping quotes, backslashes and control
+// characters. Runs of plain characters are copied at once.
+static void quote(writer_t* writer, const char* value) {
+    static const char hex[] = "0123456789abcdef";
+    append_char(writer, '"');
+    const char* run = value;
+    for (const char* p = value;; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        append(writer, run, p - run);
+        if (!c) break;
+        run = p + 1;
+        switch (c) {
+        case '"': append(writer, "\\\"", 2); break;
+        case '\\': append(writer, "\\\\", 2); break;
+        case '\n': append(writer, "\\n", 2); break;
+        case '\r': append(writer, "\\r", 2); break;
+        case '\t': append(writer, "\\t", 2); break;
+        default: {
+            char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+            append(writer, escape, sizeof(escape));
+        }
+        }
+    }
+    append_char(writer, '"');
+}
+
+void writer_key(writer_t* writer, const char* key) {
+    separate(writer);
+    quote(writer, key);
+    append_char(writer, ':');
+    writer->comma = false;
+}
+
+void writer_string(writer_t* writer, const char* value) {
+    separate(writer);
+    quote(writer, value);
+}
+
+void writer_int(writer_t* writer, int64_t value) {
+    char digits[20];
+    int n = 0;
+    // Negate as unsigned so INT64_MIN works
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    do {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+
+    separate(writer);
+    if (value < 0) {
+        append_char(writer, '-');
+    }
+    if (reserve(writer, n)) {
+        while (n > 0) {
+            writer->data[writer->len++] = digits[--n];
+        }
+    }
+}
+
+void writer_raw(writer_t* writer, const char* json, size_t len) {
+    separate(writer);
+    append(writer, json, len);
+}
+
+// Formatted fields need no escaping
+static void unescaped(writer_t* writer, const char* text) {
+    separate(writer);
+    append_char(writer, '"');
+    append(writer, text, strlen(text));
+    append_char(writer, '"');
+}
+
+void writer_uuid(writer_t* writer, const vxlan_uuid_t* uuid) {
+    char buf[VXLAN_UUID_STR_SIZE];
+    vxlan_uuid_format(uuid, buf);
+    unescaped(writer, buf);
+}
+
+void writer_mac(writer_t* writer, const vxlan_mac_t* mac) {
+    char buf[VXLAN_MAC_STR_SIZE];
+    vxlan_mac_format(mac, buf);
+    unescaped(writer, buf);
+}
+
+void writer_ip(writer_t* writer, const vxlan_ip_t* ip) {
+    char buf[VXLAN_IP_STR_SIZE];
+    vxlan_ip_format(ip, buf);
+    unescaped(writer, buf);
+}
+
+void writer_time(writer_t* writer, int64_t seconds) {
+    char buf[VXLAN_TIME_STR_SIZE];
+    vxlan_time_format(seconds, buf);
+    unescaped(writer, buf);
+}
+
+// The JSON representation of a network
+void writer_network(writer_t* writer, const vxlan_network_t* network) {
+    writer_begin_object(writer);
+    writer_key(writer, "id");
+    writer_uuid(writer, &network->id);
+    writer_key(writer, "tenant_id");
+    writer_string(writer, network->tenant_id);
+    writer_key(writer, "name");
+    writer_string(writer, network->name);
+    writer_key(writer, "vni");
+    writer_int(writer, network->vni);
+    if (network->description) {
+        writer_key(writer, "description");
+        writer_string(writer, network->description);
+    }
+    writer_key(writer, "created_at");
+    writer_time(writer, network->created_at);
+    writer_key(writer, "updated_at");
+    writer_time(writer, network->updated_at);
+    writer_end_object(writer);
+}
+
+// The JSON representation of an endpoint
+void writer_endpoint(writer_t* writer, const vxlan_endpoint_t* endpoint) {
+    writer_begin_object(writer);
+    writer_key(writer, "id");
+    writer_uuid(writer, &endpoint->id);
+    writer_key(writer, "network_id");
+    writer_uuid(writer, &endpoint->network_id);
+    writer_key(writer, "mac_address");
+    writer_mac(writer, &endpoint->mac_address);
+    writer_key(writer, "ip_address");
+    writer_ip(writer, &endpoint->ip_address);
+    writer_key(writer, "host_id");
+    writer_string(writer, endpoint->host_id);
+    writer_key(writer, "vtep_ip");
+    writer_ip(writer, endpoint->vtep_ip);
+    writer_key(writer, "created_at");
+    writer_time(writer, endpoint->created_at);
+    writer_key(writer, "updated_at");
+    writer_time(writer, endpoint->updated_at);
+    writer_end_object(writer);
+}
@@ -0,0 +1,70 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../network/vxlan.h"
+
+// JSON text written straight from records into one growable buffer, with
+// no allocation per value: the replacement for building a json-c tree and
+// serializing it. Commas between members and elements are inserted as
+// values are written.
+//
+// A response takes the buffer over with writer_take() and releases it
+// with writer_buffer_free(), which keeps one buffer per thread (up to
+// WRITER_SPARE_MAX bytes, freed when the thread exits) for the next
+// writer, so a steady stream of responses allocates nothing. Running out of memory sets failed; the
+// text is then incomplete and writer_take() returns NULL.
+
+#define WRITER_INITIAL_SIZE 4096
+#define WRITER_SPARE_MAX (64 * 1024)
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+    bool comma;  // a value was written: the next one needs a comma
+    bool failed;
+} writer_t;
+
+// Start an empty writer, reusing this thread's spare buffer if any
+void writer_init(writer_t* writer);
+
+// Release the buffer of a writer whose text was not taken
+void writer_free(writer_t* writer);
+
+// Take the text (*len bytes, not NUL-terminated) to release later with
+// writer_buffer_free(); NULL, with the buffer released, if writing failed
+char* writer_take(writer_t* writer, size_t* len);
+
+// Release a buffer returned by writer_take()
+void writer_buffer_free(void* data);
+
+// Drop the text written so far but keep the buffer and the comma state,
+// to write the next part of the same document (see stream.h)
+void writer_clear(writer_t* writer);
+
+// Structure; a key is followed by exactly one value
+void writer_begin_object(writer_t* writer);
+void writer_end_object(writer_t* writer);
+void writer_begin_array(writer_t* writer);
+void writer_end_array(writer_t* writer);
+void writer_key(writer_t* writer, const char* key);
+
+// Values
+void writer_string(writer_t* writer, const char* value);
+void writer_int(writer_t* writer, int64_t value);
+void writer_raw(writer_t* writer, const char* json, size_t len);  // already JSON
+
+// Binary fields as text
+void writer_uuid(writer_t* writer, const vxlan_uuid_t* uuid);
+void writer_mac(writer_t* writer, const vxlan_mac_t* mac);
+void writer_ip(writer_t* writer, const vxlan_ip_t* ip);
+void writer_time(writer_t* writer, int64_t seconds);
+
+// Records, as the API represents them
+void writer_network(writer_t* writer, const vxlan_network_t* network);
+void writer_endpoint(writer_t* writer, const vxlan_endpoint_t* endpoint);
+
+#endif // WRITER_H
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <unistd.h>
 #include <microhttpd.h>
 #include "api/handlers.h"
 #include "utils/logging.h"
@@ -9,18 +10,30 @@
 
 #define PORT 18080
 #define MAX_CONNECTIONS 1024
+// Open connections, including hosts waiting on their FDB stream
+#define CONNECTION_LIMIT 16384
+#define WAL_PATH "network_service.wal"
+#define SNAPSHOT_INTERVAL 300
+
+// epoll where there is one (Linux); elsewhere, e.g. on macOS, the best
+// poller libmicrohttpd has
+#ifdef __linux__
+#define MHD_POLLING MHD_USE_EPOLL_INTERNALLY
+#else
+#define MHD_POLLING (MHD_USE_AUTO | MHD_USE_INTERNAL_POLLING_THREAD)
+#endif
 
 static struct MHD_Daemon* mhd_daemon = NULL;
 
+// Set by SIGINT and SIGTERM; the main loop shuts down when it sees it.
+// Nothing else is safe to do in the handler: the main loop may be holding
+// the locks shutdown takes.
+static volatile sig_atomic_t stop_requested = 0;
+
 // Signal handler for graceful shutdown
 static void signal_handler(int signum) {
-    if (mhd_daemon) {
-        MHD_stop_daemon(mhd_daemon);
-        mhd_daemon = NULL;
-    }
-    api_cleanup();
-    logging_cleanup();
-    exit(0);
+    (void)signum;
+    stop_requested = 1;
 }
 
 // Main request handler
@@ -32,53 +45,37 @@ static enum MHD_Result request_handler(void* cls,
                          const char* upload_data,
                          size_t* upload_data_size,
                          void** ptr) {
-    static int dummy;
-    if (&dummy != *ptr) {
-        *ptr = &dummy;
-        return MHD_YES;
+    if (!*ptr) {
+        *ptr = request_new();
+        return *ptr ? MHD_YES : MHD_NO;
     }
+    request_t* request = *ptr;
 
+    // Parse POST bodies chunk by chunk as they arrive; other bodies are
+    // ignored
     if (0 != *upload_data_size) {
+        if (strcmp(method, "POST") == 0) {
+            request_feed(request, upload_data, *upload_data_size);
+        }
         *upload_data_size = 0;
         return MHD_YES;
     }
 
-    // Parse URL and method to determine handler
-    if (strcmp(method, "POST") == 0) {
-        if (strncmp(url, "/api/v1/networks", 15) == 0) {
-            return handle_create_network(connection, upload_data);
-        } else if (strstr(url, "/endpoints") != NULL) {
-            return handle_create_endpoint(connection, url, upload_data);
-        }
-    } else if (strcmp(method, "GET") == 0) {
-        if (strncmp(url, "/api/v1/networks", 15) == 0) {
-            if (strlen(url) > 16) {
-                return handle_get_network(connection, url + 16);
-            } else {
-                return handle_list_networks(connection);
-            }
-        } else if (strstr(url, "/endpoints") != NULL) {
-            return handle_list_endpoints(connection, url);
-        }
-    } else if (strcmp(method, "DELETE") == 0) {
-        if (strncmp(url, "/api/v1/networks", 15) == 0) {
-            if (strstr(url, "/endpoints") != NULL) {
-                return handle_delete_endpoint(connection, url);
-            } else {
-                return handle_delete_network(connection, url + 16);
-            }
-        }
-    }
+    return api_dispatch(connection, method, url, request);
+}
 
-    // Return 404 for unhandled routes
-    const char* response = "{\"error\":\"Not Found\"}";
-    struct MHD_Response* resp = MHD_create_response_from_buffer(strlen(response),
-                                                              (void*)response,
-                                                              MHD_RESPMEM_PERSISTENT);
-    MHD_add_response_header(resp, "Content-Type", "application/json");
-    MHD_queue_response(connection, MHD_HTTP_NOT_FOUND, resp);
-    MHD_destroy_response(resp);
-    return MHD_YES;
+// Release a finished request and the state a handler left for it
+static void request_completed(void* cls, struct MHD_Connection* connection, void** ptr,
+                              enum MHD_RequestTerminationCode toe) {
+    (void)cls;
+    (void)connection;
+    (void)toe;
+    request_t* request = *ptr;
+    if (request && request->state) {
+        api_request_completed(request->state);
+    }
+    request_free(request);
+    *ptr = NULL;
 }
 
 int main(void) {
@@ -90,18 +87,26 @@ int main(void) {
     logging_set_level(LOG_LEVEL_DEBUG);
 
     // Initialize API
-    if (!api_init()) {
+    if (!api_init(WAL_PATH, SNAPSHOT_INTERVAL)) {
         fprintf(stderr, "Failed to initialize API\n");
         logging_cleanup();
         return 1;
     }
 
-    // Set up signal handlers
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    // Set up signal handlers; without SA_RESTART a signal cuts the main
+    // loop's sleep short
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = signal_handler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
 
     // Start HTTP daemon
-    mhd_daemon = MHD_start_daemon(MHD_USE_SELECT_INTERNALLY,
+    // An event poller and suspend/resume, so thousands of hosts can wait
+    // on their FDB stream without a thread each
+    // (MHD_USE_ITC lets the daemon be quiesced at shutdown)
+    mhd_daemon = MHD_start_daemon(MHD_POLLING | MHD_ALLOW_SUSPEND_RESUME | MHD_USE_ITC,
                              PORT,
                              NULL,
                              NULL,
@@ -109,6 +114,11 @@ int main(void) {
                              NULL,
                              MHD_OPTION_THREAD_POOL_SIZE,
                              MAX_CONNECTIONS,
+                             MHD_OPTION_CONNECTION_LIMIT,
+                             (unsigned int)CONNECTION_LIMIT,
+                             MHD_OPTION_NOTIFY_COMPLETED,
+                             &request_completed,
+                             NULL,
                              MHD_OPTION_END);
 
     if (mhd_daemon == NULL) {
@@ -120,10 +130,25 @@ int main(void) {
 
     printf("Network service started on port %d\n", PORT);
 
-    // Wait for signals
-    while (1) {
+    // Wait for signals, timing out parked polls
+    while (!stop_requested) {
         sleep(1);
+        if (!stop_requested) {
+            api_tick();
+        }
     }
 
+    // The daemon refuses to stop with suspended connections. Stop accepting
+    // connections first, then answer every poll: parked ones are resumed
+    // and new ones on open connections no longer park.
+    MHD_socket listen_socket = MHD_quiesce_daemon(mhd_daemon);
+    api_resume_all();
+    MHD_stop_daemon(mhd_daemon);
+    mhd_daemon = NULL;
+    if (listen_socket != MHD_INVALID_SOCKET) {
+        close(listen_socket);
+    }
+    api_cleanup();
+    logging_cleanup();
     return 0;
 } 
\ No newline at end of file
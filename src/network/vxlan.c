@@ -2,79 +2,107 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
 #include <uuid/uuid.h>
 #include "vxlan.h"
 #include "../utils/logging.h"
-
-// Generate a UUID string
-static char* generate_uuid(void) {
-    uuid_t uuid;
-    char* uuid_str = malloc(37); // 36 chars + null terminator
-    if (!uuid_str) {
-        LOG_ERROR_FMT("Failed to allocate memory for UUID");
-        return NULL;
+#include "../utils/slab.h"
+#include "../storage/intern.h"
+
+// Allocator for network and endpoint records. Each record is one block:
+// the struct followed by any strings that are not interned.
+static slab_allocator_t* record_slab = NULL;
+static pthread_once_t record_slab_once = PTHREAD_ONCE_INIT;
+
+static void record_slab_create(void) {
+    record_slab = slab_create();
+    if (!record_slab) {
+        LOG_WARN_FMT("Failed to create record slab, falling back to malloc");
     }
-    uuid_generate(uuid);
-    uuid_unparse_lower(uuid, uuid_str);
-    return uuid_str;
 }
 
-// Get current timestamp in ISO 8601 format
-static char* get_timestamp(void) {
-    time_t now = time(NULL);
-    struct tm* tm_info = gmtime(&now);
-    char* timestamp = malloc(21); // YYYY-MM-DDTHH:MM:SSZ + null terminator
-    if (!timestamp) {
-        LOG_ERROR_FMT("Failed to allocate memory for timestamp");
-        return NULL;
-    }
-    strftime(timestamp, 21, "%Y-%m-%dT%H:%M:%SZ", tm_info);
-    return timestamp;
+static slab_allocator_t* records(void) {
+    pthread_once(&record_slab_once, record_slab_create);
+    return record_slab;
 }
 
-// Create a new VXLAN network
-vxlan_network_t* vxlan_create_network(const char* tenant_id, const char* name, uint32_t vni, const char* description) {
-    if (!tenant_id || !name || vni == 0 || vni > MAX_VNI) {
-        LOG_ERROR_FMT("Invalid network parameters");
-        return NULL;
-    }
+// Copy a string into the record's string area and advance the cursor
+static char* pack_string(char** cursor, const char* src, size_t size) {
+    char* dst = *cursor;
+    memcpy(dst, src, size);
+    *cursor += size;
+    return dst;
+}
+
+// Size of a network record block
+static size_t network_size(size_t name_len, const char* description) {
+    return sizeof(vxlan_network_t) + name_len + 1 + (description ? strlen(description) + 1 : 0);
+}
 
-    vxlan_network_t* network = malloc(sizeof(vxlan_network_t));
+// Rebuild a network record from stored field values, keeping its id and
+// timestamps. The strings are copied; tenant_id is interned.
+vxlan_network_t* vxlan_restore_network(const vxlan_network_t* fields) {
+    const char* tenant = intern_string(fields->tenant_id);
+    size_t name_len = strlen(fields->name);
+    vxlan_network_t* network = tenant ? slab_alloc(records(), network_size(name_len, fields->description)) : NULL;
     if (!network) {
         LOG_ERROR_FMT("Failed to allocate memory for network");
         return NULL;
     }
 
-    // Generate UUID
-    network->id = generate_uuid();
-    if (!network->id) {
-        free(network);
-        return NULL;
+    char* cursor = (char*)(network + 1);
+    network->id = fields->id;
+    network->vni = fields->vni;
+    network->created_at = fields->created_at;
+    network->updated_at = fields->updated_at;
+    network->tenant_id = tenant;
+    network->name = pack_string(&cursor, fields->name, name_len + 1);
+    network->description = fields->description ?
+        pack_string(&cursor, fields->description, strlen(fields->description) + 1) : NULL;
+    network->version = 0;
+    atomic_init(&network->json, NULL);
+    return network;
+}
+
+// Shard tag of a tenant: FNV-1a of the id folded to a byte
+uint8_t vxlan_tenant_tag(const char* tenant_id) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char* c = (const unsigned char*)tenant_id; *c; c++) {
+        h = (h ^ *c) * 16777619u;
     }
+    h ^= h >> 16;
+    return (uint8_t)(h ^ (h >> 8));
+}
 
-    // Copy tenant ID and name
-    network->tenant_id = strdup(tenant_id);
-    network->name = strdup(name);
-    if (!network->tenant_id || !network->name) {
-        LOG_ERROR_FMT("Failed to copy network parameters");
-        vxlan_free_network(network);
+// Create a new VXLAN network
+vxlan_network_t* vxlan_create_network(const char* tenant_id, const char* name, uint32_t vni, const char* description) {
+    if (!tenant_id || !name || vni > MAX_VNI) {
+        LOG_ERROR_FMT("Invalid network parameters");
         return NULL;
     }
 
-    // Set VNI and description
-    network->vni = vni;
-    network->description = description ? strdup(description) : NULL;
+    vxlan_network_t fields = {
+        .vni = vni,
+        .created_at = time(NULL),
+        .tenant_id = tenant_id,
+        .name = name,
+        .description = description,
+    };
+    fields.updated_at = fields.created_at;
+    uuid_generate(fields.id.bytes);
+    fields.id.bytes[VXLAN_UUID_TAG_BYTE] = vxlan_tenant_tag(tenant_id);
+
+    vxlan_network_t* network = vxlan_restore_network(&fields);
+    if (!network) return NULL;
 
-    // Set timestamps
-    network->created_at = get_timestamp();
-    network->updated_at = strdup(network->created_at);
-    if (!network->created_at || !network->updated_at) {
-        LOG_ERROR_FMT("Failed to set timestamps");
-        vxlan_free_network(network);
-        return NULL;
+    char id[VXLAN_UUID_STR_SIZE];
+    vxlan_uuid_format(&network->id, id);
+    if (vni) {
+        LOG_INFO_FMT("Created network %s (VNI: %u) for tenant %s", id, vni, tenant_id);
+    } else {
+        LOG_INFO_FMT("Created network %s (VNI: to be allocated) for tenant %s", id, tenant_id);
     }
-
-    LOG_INFO_FMT("Created network %s (VNI: %u) for tenant %s", network->id, vni, tenant_id);
     return network;
 }
 
@@ -82,60 +110,72 @@ vxlan_network_t* vxlan_create_network(const char* tenant_id, const char* name, u
 void vxlan_free_network(vxlan_network_t* network) {
     if (!network) return;
 
-    free(network->id);
-    free(network->tenant_id);
-    free(network->name);
-    free(network->description);
-    free(network->created_at);
-    free(network->updated_at);
-    free(network);
+    free(atomic_load_explicit(&network->json, memory_order_relaxed));
+    slab_free(records(), network, network_size(strlen(network->name), network->description));
 }
 
-// Create a new VXLAN endpoint
-vxlan_endpoint_t* vxlan_create_endpoint(const char* network_id, const char* mac_address,
-                                       const char* ip_address, const char* host_id, const char* vtep_ip) {
-    if (!network_id || !mac_address || !ip_address || !host_id || !vtep_ip) {
-        LOG_ERROR_FMT("Invalid endpoint parameters");
-        return NULL;
-    }
-
-    vxlan_endpoint_t* endpoint = malloc(sizeof(vxlan_endpoint_t));
+// Rebuild an endpoint record from stored field values, keeping its id and
+// timestamps. host_id and vtep_ip are interned.
+vxlan_endpoint_t* vxlan_restore_endpoint(const vxlan_endpoint_t* fields) {
+    const char* host = intern_string(fields->host_id);
+    const vxlan_ip_t* vtep = intern_bytes(fields->vtep_ip, sizeof(*fields->vtep_ip));
+    vxlan_endpoint_t* endpoint = host && vtep ? slab_alloc(records(), sizeof(vxlan_endpoint_t)) : NULL;
     if (!endpoint) {
         LOG_ERROR_FMT("Failed to allocate memory for endpoint");
         return NULL;
     }
 
-    // Generate UUID
-    endpoint->id = generate_uuid();
-    if (!endpoint->id) {
-        free(endpoint);
-        return NULL;
-    }
+    *endpoint = *fields;
+    endpoint->host_id = host;
+    endpoint->vtep_ip = vtep;
+    endpoint->version = 0;
+    atomic_init(&endpoint->json, NULL);
+    return endpoint;
+}
 
-    // Copy parameters
-    endpoint->network_id = strdup(network_id);
-    endpoint->mac_address = strdup(mac_address);
-    endpoint->ip_address = strdup(ip_address);
-    endpoint->host_id = strdup(host_id);
-    endpoint->vtep_ip = strdup(vtep_ip);
+// Copy an endpoint's fields but not its cached JSON, which another
+// thread may be setting
+void vxlan_copy_endpoint(vxlan_endpoint_t* copy, const vxlan_endpoint_t* endpoint) {
+    copy->id = endpoint->id;
+    copy->network_id = endpoint->network_id;
+    copy->mac_address = endpoint->mac_address;
+    copy->ip_address = endpoint->ip_address;
+    copy->created_at = endpoint->created_at;
+    copy->updated_at = endpoint->updated_at;
+    copy->host_id = endpoint->host_id;
+    copy->vtep_ip = endpoint->vtep_ip;
+    copy->version = endpoint->version;
+    atomic_init(&copy->json, NULL);
+}
 
-    if (!endpoint->network_id || !endpoint->mac_address || !endpoint->ip_address ||
-        !endpoint->host_id || !endpoint->vtep_ip) {
-        LOG_ERROR_FMT("Failed to copy endpoint parameters");
-        vxlan_free_endpoint(endpoint);
+// Create a new VXLAN endpoint
+vxlan_endpoint_t* vxlan_create_endpoint(const vxlan_uuid_t* network_id, const vxlan_mac_t* mac_address,
+                                       const vxlan_ip_t* ip_address, const char* host_id,
+                                       const vxlan_ip_t* vtep_ip) {
+    if (!network_id || !mac_address || !ip_address || !host_id || !vtep_ip) {
+        LOG_ERROR_FMT("Invalid endpoint parameters");
         return NULL;
     }
 
-    // Set timestamps
-    endpoint->created_at = get_timestamp();
-    endpoint->updated_at = strdup(endpoint->created_at);
-    if (!endpoint->created_at || !endpoint->updated_at) {
-        LOG_ERROR_FMT("Failed to set timestamps");
-        vxlan_free_endpoint(endpoint);
-        return NULL;
-    }
+    vxlan_endpoint_t fields = {
+        .network_id = *network_id,
+        .mac_address = *mac_address,
+        .ip_address = *ip_address,
+        .created_at = time(NULL),
+        .host_id = host_id,
+        .vtep_ip = vtep_ip,
+    };
+    fields.updated_at = fields.created_at;
+    uuid_generate(fields.id.bytes);
+    fields.id.bytes[VXLAN_UUID_TAG_BYTE] = network_id->bytes[VXLAN_UUID_TAG_BYTE];
+
+    vxlan_endpoint_t* endpoint = vxlan_restore_endpoint(&fields);
+    if (!endpoint) return NULL;
 
-    LOG_INFO_FMT("Created endpoint %s for network %s", endpoint->id, network_id);
+    char id[VXLAN_UUID_STR_SIZE], net[VXLAN_UUID_STR_SIZE];
+    vxlan_uuid_format(&endpoint->id, id);
+    vxlan_uuid_format(network_id, net);
+    LOG_INFO_FMT("Created endpoint %s for network %s", id, net);
     return endpoint;
 }
 
@@ -143,15 +183,8 @@ vxlan_endpoint_t* vxlan_create_endpoint(const char* network_id, const char* mac_
 void vxlan_free_endpoint(vxlan_endpoint_t* endpoint) {
     if (!endpoint) return;
 
-    free(endpoint->id);
-    free(endpoint->network_id);
-    free(endpoint->mac_address);
-    free(endpoint->ip_address);
-    free(endpoint->host_id);
-    free(endpoint->vtep_ip);
-    free(endpoint->created_at);
-    free(endpoint->updated_at);
-    free(endpoint);
+    free(atomic_load_explicit(&endpoint->json, memory_order_relaxed));
+    slab_free(records(), endpoint, sizeof(vxlan_endpoint_t));
 }
 
 // Generate iproute2 command for creating a VXLAN network
@@ -186,15 +219,17 @@ char* vxlan_generate_endpoint_cmd(const vxlan_endpoint_t* endpoint) {
     // Extract VNI from network_id (in a real implementation, we would look this up)
     uint32_t vni = 1; // Placeholder - should be looked up from network_id
 
+    char vtep_ip[VXLAN_IP_STR_SIZE];
+    vxlan_ip_format(endpoint->vtep_ip, vtep_ip);
     snprintf(cmd, 256, "bridge fdb append to 00:00:00:00:00:00 dst %s dev vxlan%d", 
-             endpoint->vtep_ip, vni);
+             vtep_ip, vni);
 
     LOG_DEBUG_FMT("Generated endpoint command: %s", cmd);
     return cmd;
 }
 
 // Generate iproute2 command for deleting a VXLAN network
-char* vxlan_generate_delete_network_cmd(const char* network_id) {
+char* vxlan_generate_delete_network_cmd(const vxlan_uuid_t* network_id) {
     if (!network_id) return NULL;
 
     // Format: ip link delete vxlan<vni>
@@ -214,7 +249,7 @@ char* vxlan_generate_delete_network_cmd(const char* network_id) {
 }
 
 // Generate iproute2 command for removing an endpoint from a VXLAN network
-char* vxlan_generate_delete_endpoint_cmd(const char* network_id, const char* endpoint_id) {
+char* vxlan_generate_delete_endpoint_cmd(const vxlan_uuid_t* network_id, const vxlan_uuid_t* endpoint_id) {
     if (!network_id || !endpoint_id) return NULL;
 
     // Format: bridge fdb del <mac> dst <vtep_ip> dev vxlan<vni>
@@ -231,4 +266,210 @@ char* vxlan_generate_delete_endpoint_cmd(const char* network_id, const char* end
 
     LOG_DEBUG_FMT("Generated delete endpoint command: %s", cmd);
     return cmd;
-} 
\ No newline at end of file
+} 
+
+// Longest teardown command: an FDB delete with an IPv6 VTEP and the
+// largest VNI, plus the newline
+#define TEARDOWN_CMD_SIZE 128
+
+static char* put_text(char* cursor, const char* text, size_t len) {
+    memcpy(cursor, text, len);
+    return cursor + len;
+}
+
+// Generate the iproute2 commands tearing down a network and its endpoints.
+// Every line but the MAC is the same or, for the VTEP, shared by all the
+// endpoints of a host, so those parts are formatted once and copied.
+char* vxlan_generate_teardown_cmds(const vxlan_network_t* network, vxlan_endpoint_t* const* endpoints, int count) {
+    if (!network || (count > 0 && !endpoints)) return NULL;
+
+    char* cmds = malloc(((size_t)count + 1) * TEARDOWN_CMD_SIZE);
+    if (!cmds) {
+        LOG_ERROR_FMT("Failed to allocate memory for teardown commands");
+        return NULL;
+    }
+
+    // Format: bridge fdb del <mac> dst <vtep_ip> dev vxlan<vni>, then
+    // ip link delete vxlan<vni>
+    static const char hex[] = "0123456789abcdef";
+    char device[32], vtep_ip[VXLAN_IP_STR_SIZE];
+    size_t device_len = (size_t)snprintf(device, sizeof(device), " dev vxlan%u\n", network->vni);
+    size_t vtep_len = 0;
+    const vxlan_ip_t* vtep = NULL;
+    char* cursor = cmds;
+    for (int i = 0; i < count; i++) {
+        // vtep_ip is interned, so endpoints of one host share the pointer
+        if (endpoints[i]->vtep_ip != vtep) {
+            vtep = endpoints[i]->vtep_ip;
+            vxlan_ip_format(vtep, vtep_ip);
+            vtep_len = strlen(vtep_ip);
+        }
+        cursor = put_text(cursor, "bridge fdb del ", 15);
+        for (int b = 0; b < 6; b++) {
+            uint8_t byte = endpoints[i]->mac_address.bytes[b];
+            *cursor++ = hex[byte >> 4];
+            *cursor++ = hex[byte & 0xf];
+            *cursor++ = b < 5 ? ':' : ' ';
+        }
+        cursor = put_text(cursor, "dst ", 4);
+        cursor = put_text(cursor, vtep_ip, vtep_len);
+        cursor = put_text(cursor, device, device_len);
+    }
+    sprintf(cursor, "ip link delete vxlan%u\n", network->vni);
+
+    LOG_DEBUG_FMT("Generated teardown commands for VNI %u (%d endpoints):\n%s", network->vni, count, cmds);
+    return cmds;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Parse two hex digits into a byte
+static bool parse_hex_byte(const char* str, uint8_t* out) {
+    int hi = hex_value(str[0]);
+    int lo = hi < 0 ? -1 : hex_value(str[1]);
+    if (lo < 0) return false;
+    *out = (uint8_t)(hi << 4 | lo);
+    return true;
+}
+
+// Parse a canonical UUID string. The UUID may be followed by a '/' so
+// path segments can be parsed in place.
+bool vxlan_uuid_parse(const char* str, vxlan_uuid_t* uuid) {
+    if (!str || !uuid) return false;
+
+    int byte = 0;
+    for (int i = 0; i < VXLAN_UUID_STR_SIZE - 1; ) {
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            if (str[i] != '-') return false;
+            i++;
+            continue;
+        }
+        if (!parse_hex_byte(str + i, &uuid->bytes[byte++])) return false;
+        i += 2;
+    }
+    char end = str[VXLAN_UUID_STR_SIZE - 1];
+    return end == '\0' || end == '/';
+}
+
+// Format a UUID as a lowercase canonical string
+void vxlan_uuid_format(const vxlan_uuid_t* uuid, char buf[VXLAN_UUID_STR_SIZE]) {
+    uuid_unparse_lower(uuid->bytes, buf);
+}
+
+// Parse a MAC address separated by ':' or '-'
+bool vxlan_mac_parse(const char* str, vxlan_mac_t* mac) {
+    if (!str || !mac) return false;
+
+    for (int i = 0; i < 6; i++) {
+        const char* octet = str + i * 3;
+        if (!parse_hex_byte(octet, &mac->bytes[i])) return false;
+        char sep = octet[2];
+        if (i < 5 ? (sep != ':' && sep != '-') : sep != '\0') return false;
+    }
+    return true;
+}
+
+// Format a MAC address as lowercase colon-separated hex
+void vxlan_mac_format(const vxlan_mac_t* mac, char buf[VXLAN_MAC_STR_SIZE]) {
+    static const char hex[] = "0123456789abcdef";
+    for (int i = 0; i < 6; i++) {
+        buf[3 * i] = hex[mac->bytes[i] >> 4];
+        buf[3 * i + 1] = hex[mac->bytes[i] & 0xf];
+        buf[3 * i + 2] = i < 5 ? ':' : '\0';
+    }
+}
+
+// Parse a dotted IPv4 or textual IPv6 address
+bool vxlan_ip_parse(const char* str, vxlan_ip_t* ip) {
+    if (!str || !ip) return false;
+
+    memset(ip, 0, sizeof(*ip));
+    if (inet_pton(AF_INET, str, ip->bytes) == 1) {
+        ip->family = AF_INET;
+        return true;
+    }
+    if (inet_pton(AF_INET6, str, ip->bytes) == 1) {
+        ip->family = AF_INET6;
+        return true;
+    }
+    return false;
+}
+
+// Format an IP address
+void vxlan_ip_format(const vxlan_ip_t* ip, char buf[VXLAN_IP_STR_SIZE]) {
+    // IPv4 directly; inet_ntop() costs several times more
+    if (ip->family == AF_INET) {
+        for (int i = 0; i < 4; i++) {
+            unsigned int octet = ip->bytes[i];
+            if (octet >= 100) *buf++ = (char)('0' + octet / 100);
+            if (octet >= 10) *buf++ = (char)('0' + octet / 10 % 10);
+            *buf++ = (char)('0' + octet % 10);
+            *buf++ = i < 3 ? '.' : '\0';
+        }
+        return;
+    }
+    if (!inet_ntop(ip->family, ip->bytes, buf, VXLAN_IP_STR_SIZE)) {
+        buf[0] = '\0';
+    }
+}
+
+// Write value as width decimal digits
+static char* put_digits(char* buf, unsigned int value, int width) {
+    for (int i = width - 1; i >= 0; i--) {
+        buf[i] = (char)('0' + value % 10);
+        value /= 10;
+    }
+    return buf + width;
+}
+
+// Format seconds since the epoch as an ISO 8601 UTC timestamp. The date
+// is computed directly (days to civil date, proleptic Gregorian), which
+// is much cheaper than gmtime_r() and strftime(); years outside
+// 1000-9999 go through them, as strftime() does not pad them.
+void vxlan_time_format(int64_t seconds, char buf[VXLAN_TIME_STR_SIZE]) {
+    int64_t days = seconds / 86400;
+    int64_t second_of_day = seconds % 86400;
+    if (second_of_day < 0) {
+        second_of_day += 86400;
+        days--;
+    }
+    // Shift the epoch to 0000-03-01 so leap days end a 400-year era
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned int day_of_era = (unsigned int)(days - era * 146097);
+    unsigned int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    unsigned int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    unsigned int month_index = (5 * day_of_year + 2) / 153;  // March is 0
+    unsigned int day = day_of_year - (153 * month_index + 2) / 5 + 1;
+    unsigned int month = month_index < 10 ? month_index + 3 : month_index - 9;
+    int64_t year = era * 400 + year_of_era + (month <= 2);
+
+    if (year >= 1000 && year <= 9999) {
+        char* p = put_digits(buf, (unsigned int)year, 4);
+        *p++ = '-';
+        p = put_digits(p, month, 2);
+        *p++ = '-';
+        p = put_digits(p, day, 2);
+        *p++ = 'T';
+        p = put_digits(p, (unsigned int)(second_of_day / 3600), 2);
+        *p++ = ':';
+        p = put_digits(p, (unsigned int)(second_of_day / 60 % 60), 2);
+        *p++ = ':';
+        p = put_digits(p, (unsigned int)(second_of_day % 60), 2);
+        *p++ = 'Z';
+        *p = '\0';
+        return;
+    }
+
+    time_t t = (time_t)seconds;
+    struct tm tm_info;
+    if (!gmtime_r(&t, &tm_info) ||
+        strftime(buf, VXLAN_TIME_STR_SIZE, "%Y-%m-%dT%H:%M:%SZ", &tm_info) == 0) {
+        buf[0] = '\0';
+    }
+}
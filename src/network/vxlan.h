@@ -2,47 +2,118 @@
 #define VXLAN_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <time.h>
 #include <stdint.h>
+#include <stdatomic.h>
 
 // Constants
 #define MAX_VNI 16777215  // 2^24 - 1
 
-// VXLAN network structure
+// Text buffer sizes, including the terminator
+#define VXLAN_UUID_STR_SIZE 37   // xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx
+#define VXLAN_MAC_STR_SIZE 18    // xx:xx:xx:xx:xx:xx
+#define VXLAN_IP_STR_SIZE 46     // INET6_ADDRSTRLEN
+#define VXLAN_TIME_STR_SIZE 21   // YYYY-MM-DDTHH:MM:SSZ
+
+// Binary UUID
+typedef struct {
+    uint8_t bytes[16];
+} vxlan_uuid_t;
+
+// Byte of a generated id holding its shard tag: a network's is its
+// tenant's tag, an endpoint's its network's, so storage can route a
+// record by id alone
+#define VXLAN_UUID_TAG_BYTE 15
+
+// Binary MAC address
+typedef struct {
+    uint8_t bytes[6];
+} vxlan_mac_t;
+
+// IPv4 or IPv6 address in network byte order
 typedef struct {
-    char* id;
-    char* tenant_id;
-    char* name;
+    uint8_t family;     // AF_INET or AF_INET6
+    uint8_t bytes[16];  // AF_INET uses the first 4 bytes
+} vxlan_ip_t;
+
+// Serialized form of a record, kept with it by the API (see api/cache.h)
+struct vxlan_json;
+
+// VXLAN network structure. A record is a single allocation: name and
+// description live in the same block, right after the struct, and are
+// freed with it. tenant_id is interned (see intern.h), so networks of the
+// same tenant share one pointer. Timestamps are seconds since the epoch.
+//
+// Records never change once stored. version is set when storage saves
+// the record and is never reused, even across restarts; json caches the
+// record's API representation once it has been asked for and is freed
+// with it.
+typedef struct {
+    vxlan_uuid_t id;
     uint32_t vni;
-    char* description;
-    char* created_at;
-    char* updated_at;
+    int64_t created_at;
+    int64_t updated_at;
+    const char* tenant_id;  // interned
+    const char* name;
+    const char* description;  // NULL when not set
+    uint64_t version;
+    _Atomic(struct vxlan_json*) json;  // NULL until cached
 } vxlan_network_t;
 
-// VXLAN endpoint structure
+// VXLAN endpoint structure. Fixed-size binary fields plus interned
+// host_id and vtep_ip, which are shared by every endpoint on a host and
+// can be compared by pointer. version and json as for networks.
 typedef struct {
-    char* id;
-    char* network_id;
-    char* mac_address;
-    char* ip_address;
-    char* host_id;
-    char* vtep_ip;
-    char* created_at;
-    char* updated_at;
+    vxlan_uuid_t id;
+    vxlan_uuid_t network_id;
+    vxlan_mac_t mac_address;
+    vxlan_ip_t ip_address;
+    int64_t created_at;
+    int64_t updated_at;
+    const char* host_id;        // interned
+    const vxlan_ip_t* vtep_ip;  // interned
+    uint64_t version;
+    _Atomic(struct vxlan_json*) json;  // NULL until cached
 } vxlan_endpoint_t;
 
-// Network management functions
+// Shard tag of a tenant
+uint8_t vxlan_tenant_tag(const char* tenant_id);
+
+// Network management functions. vni 0 leaves the VNI to be allocated by
+// storage_save_network().
 vxlan_network_t* vxlan_create_network(const char* tenant_id, const char* name, uint32_t vni, const char* description);
 void vxlan_free_network(vxlan_network_t* network);
+// Rebuild a record from stored fields (e.g. during log replay), keeping
+// its id and timestamps
+vxlan_network_t* vxlan_restore_network(const vxlan_network_t* fields);
 char* vxlan_generate_network_cmd(const vxlan_network_t* network);
-char* vxlan_generate_delete_network_cmd(const char* network_id);
+char* vxlan_generate_delete_network_cmd(const vxlan_uuid_t* network_id);
 
 // Endpoint management functions
-vxlan_endpoint_t* vxlan_create_endpoint(const char* network_id, const char* mac_address,
-                                      const char* ip_address, const char* host_id,
-                                      const char* vtep_ip);
+vxlan_endpoint_t* vxlan_create_endpoint(const vxlan_uuid_t* network_id, const vxlan_mac_t* mac_address,
+                                      const vxlan_ip_t* ip_address, const char* host_id,
+                                      const vxlan_ip_t* vtep_ip);
 void vxlan_free_endpoint(vxlan_endpoint_t* endpoint);
+vxlan_endpoint_t* vxlan_restore_endpoint(const vxlan_endpoint_t* fields);
+// Copy an endpoint's fields into a plain value (e.g. an event); the cached
+// JSON stays with the record, so the copy outlives it safely
+void vxlan_copy_endpoint(vxlan_endpoint_t* copy, const vxlan_endpoint_t* endpoint);
 char* vxlan_generate_endpoint_cmd(const vxlan_endpoint_t* endpoint);
-char* vxlan_generate_delete_endpoint_cmd(const char* network_id, const char* endpoint_id);
+char* vxlan_generate_delete_endpoint_cmd(const vxlan_uuid_t* network_id, const vxlan_uuid_t* endpoint_id);
+// Commands tearing down a deleted network and its endpoints as one batch,
+// one per line: an FDB entry delete per endpoint, then the link delete.
+// Built in a single allocation in O(count).
+char* vxlan_generate_teardown_cmds(const vxlan_network_t* network, vxlan_endpoint_t* const* endpoints, int count);
+
+// Text conversion, used at the API boundary. Parsers return false on
+// malformed input; formatters always terminate buf.
+bool vxlan_uuid_parse(const char* str, vxlan_uuid_t* uuid);
+void vxlan_uuid_format(const vxlan_uuid_t* uuid, char buf[VXLAN_UUID_STR_SIZE]);
+bool vxlan_mac_parse(const char* str, vxlan_mac_t* mac);
+void vxlan_mac_format(const vxlan_mac_t* mac, char buf[VXLAN_MAC_STR_SIZE]);
+bool vxlan_ip_parse(const char* str, vxlan_ip_t* ip);
+void vxlan_ip_format(const vxlan_ip_t* ip, char buf[VXLAN_IP_STR_SIZE]);
+void vxlan_time_format(int64_t seconds, char buf[VXLAN_TIME_STR_SIZE]);
 
-#endif // VXLAN_H 
\ No newline at end of file
+#endif // VXLAN_H
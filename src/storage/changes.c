@@ -0,0 +1,284 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "changes.h"
+#include "hashtable.h"
+
+// Parked waiters are listed by a hash of their network, those of every
+// network in the last list
+#define WAITER_BUCKETS 4096
+#define ALL_NETWORKS WAITER_BUCKETS
+
+// The ring holds the changes numbered (first, last], at index seq & mask
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t appended;  // waits on CLOCK_MONOTONIC
+    change_t* ring;
+    size_t mask;
+    uint64_t first;  // changes up to this one are gone
+    uint64_t last;
+    uint64_t limit;  // persisted; last never passes it
+    changes_persist_fn persist;
+    change_waiter_t* waiters[WAITER_BUCKETS + 1];  // parked, most recent first
+} feed = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+static pthread_once_t feed_once = PTHREAD_ONCE_INIT;
+
+// Time waits on the monotonic clock, so a step of the wall clock does not
+// cut them short or stretch them
+static void feed_init_cond(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&feed.appended, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// Wall-clock time in microseconds
+static uint64_t clock_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+// Allocate a ring holding the last capacity changes (a power of two)
+bool changes_init(size_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        errno = EINVAL;
+        return false;
+    }
+    change_t* ring = malloc(capacity * sizeof(change_t));
+    if (!ring) return false;
+    pthread_once(&feed_once, feed_init_cond);
+
+    pthread_mutex_lock(&feed.lock);
+    free(feed.ring);
+    feed.ring = ring;
+    feed.mask = capacity - 1;
+    feed.first = feed.last = feed.limit = clock_us();
+    feed.persist = NULL;
+    pthread_mutex_unlock(&feed.lock);
+    return true;
+}
+
+// Continue numbering after the persisted limit or the clock
+void changes_resume(uint64_t persisted, changes_persist_fn persist) {
+    uint64_t now = clock_us();
+    pthread_mutex_lock(&feed.lock);
+    feed.first = feed.last = feed.limit = persisted > now ? persisted : now;
+    feed.persist = persist;
+    pthread_mutex_unlock(&feed.lock);
+}
+
+// Highest limit persisted
+uint64_t changes_limit(void) {
+    pthread_mutex_lock(&feed.lock);
+    uint64_t limit = feed.limit;
+    pthread_mutex_unlock(&feed.lock);
+    return limit;
+}
+
+// Free the ring
+void changes_destroy(void) {
+    pthread_mutex_lock(&feed.lock);
+    free(feed.ring);
+    feed.ring = NULL;
+    feed.persist = NULL;
+    memset(feed.waiters, 0, sizeof(feed.waiters));
+    pthread_mutex_unlock(&feed.lock);
+}
+
+static unsigned waiter_bucket(const vxlan_uuid_t* network_id) {
+    return hash_bytes(network_id->bytes, sizeof(network_id->bytes)) & (WAITER_BUCKETS - 1);
+}
+
+// Unlink a parked waiter (feed locked)
+static void unlink_waiter(change_waiter_t* waiter) {
+    if (waiter->prev) {
+        waiter->prev->next = waiter->next;
+    } else {
+        feed.waiters[waiter->bucket] = waiter->next;
+    }
+    if (waiter->next) {
+        waiter->next->prev = waiter->prev;
+    }
+    waiter->prev = waiter->next = NULL;
+    waiter->parked = false;
+}
+
+// Unlink a parked waiter and call its notification (feed locked). No
+// change of its network was appended after since and before up_to.
+static void notify_waiter(change_waiter_t* waiter, uint64_t up_to) {
+    unlink_waiter(waiter);
+    waiter->since = up_to;
+    waiter->notify(waiter->ctx);
+}
+
+// Notify the parked waiters of a bucket that watch a change's network
+// (feed locked)
+static void notify_bucket(unsigned bucket, const change_t* change) {
+    change_waiter_t* waiter = feed.waiters[bucket];
+    while (waiter) {
+        change_waiter_t* next = waiter->next;
+        if (!waiter->filtered ||
+            memcmp(&waiter->network_id, &change->network_id, sizeof(change->network_id)) == 0) {
+            notify_waiter(waiter, change->seq - 1);
+        }
+        waiter = next;
+    }
+}
+
+// Append a change, setting its sequence number, and wake the watchers
+void changes_append(change_t* change) {
+    pthread_mutex_lock(&feed.lock);
+    if (feed.ring) {
+        change->seq = ++feed.last;
+        if (change->seq > feed.limit) {
+            feed.limit = change->seq + CHANGES_PERSIST_STEP - 1;
+            if (feed.persist) {
+                feed.persist(feed.limit);
+            }
+        }
+        if (feed.last - feed.first > feed.mask + 1) {
+            feed.first++;
+        }
+        feed.ring[change->seq & feed.mask] = *change;
+        pthread_cond_broadcast(&feed.appended);
+        notify_bucket(waiter_bucket(&change->network_id), change);
+        notify_bucket(ALL_NETWORKS, change);
+    }
+    pthread_mutex_unlock(&feed.lock);
+}
+
+// Sequence number of the last change (the starting one before any)
+uint64_t changes_last(void) {
+    pthread_mutex_lock(&feed.lock);
+    uint64_t last = feed.last;
+    pthread_mutex_unlock(&feed.lock);
+    return last;
+}
+
+// Copy up to max changes after since into out, keeping those that match
+bool changes_read(uint64_t since, const vxlan_uuid_t* network_id, change_t* out, int max, int* count,
+                  uint64_t* next) {
+    *count = 0;
+    pthread_mutex_lock(&feed.lock);
+    if (since < feed.first || since > feed.last) {
+        pthread_mutex_unlock(&feed.lock);
+        errno = ERANGE;
+        return false;
+    }
+    uint64_t seq = since;
+    while (seq < feed.last && *count < max) {
+        const change_t* change = &feed.ring[++seq & feed.mask];
+        if (!network_id || memcmp(&change->network_id, network_id, sizeof(*network_id)) == 0) {
+            out[(*count)++] = *change;
+        }
+    }
+    *next = seq;
+    pthread_mutex_unlock(&feed.lock);
+    return true;
+}
+
+// Wait until there are changes after since or timeout_ms elapses
+bool changes_wait(uint64_t since, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&feed.lock);
+    while (feed.last <= since) {
+        if (pthread_cond_timedwait(&feed.appended, &feed.lock, &deadline) == ETIMEDOUT) break;
+    }
+    bool changed = feed.last > since;
+    pthread_mutex_unlock(&feed.lock);
+    return changed;
+}
+
+static bool deadline_passed(const struct timespec* deadline, const struct timespec* now) {
+    return deadline->tv_sec < now->tv_sec || (deadline->tv_sec == now->tv_sec && deadline->tv_nsec <= now->tv_nsec);
+}
+
+// Set up a waiter whose waits end timeout_ms from now
+void changes_waiter_init(change_waiter_t* waiter, const vxlan_uuid_t* network_id, int timeout_ms,
+                         changes_notify_fn notify, void* ctx) {
+    memset(waiter, 0, sizeof(*waiter));
+    waiter->notify = notify;
+    waiter->ctx = ctx;
+    waiter->filtered = network_id != NULL;
+    if (network_id) {
+        waiter->network_id = *network_id;
+    }
+    waiter->bucket = network_id ? waiter_bucket(network_id) : ALL_NETWORKS;
+    clock_gettime(CLOCK_MONOTONIC, &waiter->deadline);
+    waiter->deadline.tv_sec += timeout_ms / 1000;
+    waiter->deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (waiter->deadline.tv_nsec >= 1000000000) {
+        waiter->deadline.tv_sec++;
+        waiter->deadline.tv_nsec -= 1000000000;
+    }
+}
+
+// Park a waiter until a change of its network is appended after since
+bool changes_park(change_waiter_t* waiter, uint64_t since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&feed.lock);
+    if (deadline_passed(&waiter->deadline, &now)) {
+        waiter->timed_out = true;
+    }
+    bool parked = !waiter->parked && !waiter->timed_out && feed.ring && feed.last <= since;
+    if (parked) {
+        waiter->since = since;
+        waiter->prev = NULL;
+        waiter->next = feed.waiters[waiter->bucket];
+        if (waiter->next) {
+            waiter->next->prev = waiter;
+        }
+        feed.waiters[waiter->bucket] = waiter;
+        waiter->parked = true;
+    }
+    pthread_mutex_unlock(&feed.lock);
+    return parked;
+}
+
+// Withdraw a parked waiter
+bool changes_cancel(change_waiter_t* waiter) {
+    pthread_mutex_lock(&feed.lock);
+    bool parked = waiter->parked;
+    if (parked) {
+        unlink_waiter(waiter);
+    }
+    pthread_mutex_unlock(&feed.lock);
+    return parked;
+}
+
+// Notify the parked waiters whose deadline has passed. None of them has
+// seen a change of its network since it parked.
+void changes_expire(bool all) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&feed.lock);
+    for (unsigned bucket = 0; bucket <= WAITER_BUCKETS; bucket++) {
+        change_waiter_t* waiter = feed.waiters[bucket];
+        while (waiter) {
+            change_waiter_t* next = waiter->next;
+            if (all || deadline_passed(&waiter->deadline, &now)) {
+                waiter->timed_out = true;
+                notify_waiter(waiter, feed.last);
+            }
+            waiter = next;
+        }
+    }
+    pthread_mutex_unlock(&feed.lock);
+}
@@ -0,0 +1,127 @@
+#ifndef CHANGES_H
+#define CHANGES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "../network/vxlan.h"
+
+// Change feed: a ring of the most recent saves and deletes.
+//
+// Every change gets the next sequence number. Numbering starts from the
+// wall-clock time in microseconds at changes_init(). With a log,
+// changes_resume() carries on after the highest limit persisted by the
+// previous run if the clock is behind it, so sequences keep growing across
+// restarts even when the clock steps back, and a sequence from a previous
+// run reads as too old.
+// Appending copies the event into the ring under one mutex and wakes the
+// watchers; readers copy out the events after a sequence, and fail with
+// errno ERANGE when the ring no longer holds all of them, in which case
+// the caller has to list the current state and watch from there.
+//
+// A watcher with nothing to read can block in changes_wait(), or park a
+// waiter with a one-shot notification instead of blocking a thread, so any
+// number of them can wait at once. Waiters are kept by the network they
+// watch, so an append only notifies the waiters of its network and those
+// of every network. Notifications are called with the feed locked and
+// must not call back into this module.
+
+typedef enum {
+    CHANGE_NETWORK_CREATED,
+    CHANGE_NETWORK_DELETED,
+    CHANGE_ENDPOINT_CREATED,
+    CHANGE_ENDPOINT_DELETED
+} change_type_t;
+
+// One change. network_id is the network's, or the endpoint's network.
+// Network events also carry the tenant and VNI; endpoint events a copy of
+// the endpoint (its strings are interned, so the copy stays valid after
+// the record is freed).
+typedef struct {
+    uint64_t seq;
+    change_type_t type;
+    vxlan_uuid_t network_id;
+    uint32_t vni;              // network events
+    const char* tenant_id;     // network events, interned
+    vxlan_endpoint_t endpoint; // endpoint events
+} change_t;
+
+// Records a limit the sequence will not pass until it is called again;
+// called with the feed locked, so it must not call back into this module
+typedef void (*changes_persist_fn)(uint64_t limit);
+
+// Sequences handed out per persisted limit
+#define CHANGES_PERSIST_STEP (1 << 20)
+
+// Allocate a ring holding the last capacity changes (a power of two)
+bool changes_init(size_t capacity);
+
+// Once the state is recovered: continue numbering after persisted (the
+// highest limit recovered) or the clock, whichever is later, and from then
+// on call persist with a new limit before a sequence passes the last one
+void changes_resume(uint64_t persisted, changes_persist_fn persist);
+
+// Current limit: no sequence handed out so far is past it
+uint64_t changes_limit(void);
+
+// Free the ring
+void changes_destroy(void);
+
+// Append a change, setting its sequence number, and wake the watchers
+void changes_append(change_t* change);
+
+// Sequence number of the last change (the starting one before any)
+uint64_t changes_last(void);
+
+// Copy up to max changes after since into out, keeping those that
+// network_id is NULL or matches. *next is the sequence to read from next
+// time: the last change examined, which may be past the last one copied.
+// Fails with errno ERANGE when changes after since were dropped or since
+// is ahead of the feed.
+bool changes_read(uint64_t since, const vxlan_uuid_t* network_id, change_t* out, int max, int* count,
+                  uint64_t* next);
+
+// Wait until there are changes after since or timeout_ms elapses; true if
+// there are
+bool changes_wait(uint64_t since, int timeout_ms);
+
+// Called once when a change of a parked waiter's network is appended, or
+// its wait times out
+typedef void (*changes_notify_fn)(void* ctx);
+
+// A parked wait, owned by the caller; set up with changes_waiter_init()
+typedef struct change_waiter {
+    changes_notify_fn notify;
+    void* ctx;
+    bool filtered;             // waits for changes of network_id only
+    vxlan_uuid_t network_id;
+    struct timespec deadline;  // CLOCK_MONOTONIC
+    uint64_t since;            // no change of the network up to here
+    bool timed_out;            // set once the deadline has passed
+    bool parked;
+    unsigned bucket;
+    struct change_waiter* prev;
+    struct change_waiter* next;
+} change_waiter_t;
+
+// Set up a waiter for the changes of network_id (of every network if it
+// is NULL) whose waits end timeout_ms from now, however often it is parked
+void changes_waiter_init(change_waiter_t* waiter, const vxlan_uuid_t* network_id, int timeout_ms,
+                         changes_notify_fn notify, void* ctx);
+
+// Park waiter until a change of its network is appended after since or its
+// deadline passes, then notify(ctx) is called once. Returns false without
+// parking when there already are changes after since, or when the deadline
+// has passed (timed_out is then set). Once notified, waiter->since is the
+// last sequence known to hold no change of the network, to read on from.
+bool changes_park(change_waiter_t* waiter, uint64_t since);
+
+// Withdraw a parked waiter; false if it was not parked (already notified)
+bool changes_cancel(change_waiter_t* waiter);
+
+// Notify the parked waiters whose deadline has passed (all of them with
+// all, e.g. before shutdown), setting timed_out; call about once a second
+void changes_expire(bool all);
+
+#endif // CHANGES_H
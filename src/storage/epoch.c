@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "epoch.h"
+#include "../utils/logging.h"
+
+// Try to advance the global epoch after this many retirements
+#define EPOCH_ADVANCE_INTERVAL 64
+
+// Per-thread record; records are never freed, only recycled when a thread exits
+typedef struct epoch_thread {
+    _Atomic uint64_t state;  // (epoch << 1) | 1 while pinned, 0 otherwise
+    atomic_bool in_use;
+    int depth;
+    struct epoch_thread* next;
+} epoch_thread_t;
+
+// Object waiting for reclamation
+typedef struct retired {
+    void* ptr;
+    void (*free_fn)(void* ptr);
+    struct retired* next;
+} retired_t;
+
+static _Atomic uint64_t global_epoch = 1;
+
+// Registry of thread records (append-only list)
+static _Atomic(epoch_thread_t*) threads = NULL;
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local epoch_thread_t* self = NULL;
+
+// Retired objects, bucketed by the epoch they were retired in (mod 3)
+static pthread_mutex_t limbo_mutex = PTHREAD_MUTEX_INITIALIZER;
+static retired_t* limbo[3];
+static unsigned int retired_since_advance = 0;
+
+// Release a thread record when its thread exits
+static void thread_record_release(void* arg) {
+    epoch_thread_t* record = (epoch_thread_t*)arg;
+    record->depth = 0;
+    atomic_store(&record->state, 0);
+    atomic_store(&record->in_use, false);
+}
+
+static void make_thread_key(void) {
+    pthread_key_create(&thread_key, thread_record_release);
+}
+
+// Get (registering on first use) the calling thread's record
+static epoch_thread_t* thread_record(void) {
+    if (self) return self;
+
+    pthread_once(&thread_key_once, make_thread_key);
+
+    pthread_mutex_lock(&registry_mutex);
+    epoch_thread_t* record = atomic_load(&threads);
+    while (record) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&record->in_use, &expected, true)) {
+            break;
+        }
+        record = record->next;
+    }
+    if (!record) {
+        record = calloc(1, sizeof(epoch_thread_t));
+        if (!record) {
+            pthread_mutex_unlock(&registry_mutex);
+            LOG_FATAL_FMT("Failed to allocate epoch thread record");
+            abort();
+        }
+        atomic_store(&record->in_use, true);
+        record->next = atomic_load(&threads);
+        atomic_store(&threads, record);
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    record->depth = 0;
+    pthread_setspecific(thread_key, record);
+    self = record;
+    return record;
+}
+
+// Pin the calling thread to the current epoch
+void epoch_enter(void) {
+    epoch_thread_t* record = thread_record();
+    if (record->depth++ == 0) {
+        atomic_store(&record->state, (atomic_load(&global_epoch) << 1) | 1);
+    }
+}
+
+// Unpin the calling thread
+void epoch_exit(void) {
+    epoch_thread_t* record = self;
+    if (!record || record->depth == 0) return;
+    if (--record->depth == 0) {
+        atomic_store_explicit(&record->state, 0, memory_order_release);
+    }
+}
+
+// True while the calling thread is inside a critical section
+bool epoch_is_pinned(void) {
+    return self && self->depth > 0;
+}
+
+// Advance the global epoch if every pinned thread has observed it. Returns
+// the list that became safe to free. Caller holds limbo_mutex.
+static retired_t* try_advance(void) {
+    uint64_t epoch = atomic_load(&global_epoch);
+    for (epoch_thread_t* record = atomic_load(&threads); record; record = record->next) {
+        uint64_t state = atomic_load(&record->state);
+        if ((state & 1) && (state >> 1) != epoch) {
+            return NULL;
+        }
+    }
+    atomic_store(&global_epoch, epoch + 1);
+
+    // Readers can lag the global epoch by one, so objects retired two
+    // epochs ago are now unreachable
+    retired_t** bucket = &limbo[(epoch + 2) % 3];
+    retired_t* ready = *bucket;
+    *bucket = NULL;
+    return ready;
+}
+
+static void free_retired(retired_t* list) {
+    while (list) {
+        retired_t* next = list->next;
+        list->free_fn(list->ptr);
+        free(list);
+        list = next;
+    }
+}
+
+// Defer free_fn(ptr) until no reader can still reference ptr
+void epoch_retire(void* ptr, void (*free_fn)(void* ptr)) {
+    if (!ptr) return;
+
+    retired_t* item = malloc(sizeof(retired_t));
+    if (!item) {
+        LOG_FATAL_FMT("Failed to allocate retired object record");
+        abort();
+    }
+    item->ptr = ptr;
+    item->free_fn = free_fn;
+
+    retired_t* ready = NULL;
+    pthread_mutex_lock(&limbo_mutex);
+    uint64_t epoch = atomic_load(&global_epoch);
+    item->next = limbo[epoch % 3];
+    limbo[epoch % 3] = item;
+    if (++retired_since_advance >= EPOCH_ADVANCE_INTERVAL) {
+        retired_since_advance = 0;
+        ready = try_advance();
+    }
+    pthread_mutex_unlock(&limbo_mutex);
+
+    free_retired(ready);
+}
+
+// Free everything retired so far (no thread may be pinned)
+void epoch_drain(void) {
+    retired_t* lists[3];
+
+    pthread_mutex_lock(&limbo_mutex);
+    for (int i = 0; i < 3; i++) {
+        lists[i] = limbo[i];
+        limbo[i] = NULL;
+    }
+    retired_since_advance = 0;
+    pthread_mutex_unlock(&limbo_mutex);
+
+    for (int i = 0; i < 3; i++) {
+        free_retired(lists[i]);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdbool.h>
+
+// Epoch-based reclamation.
+//
+// Readers bracket lock-free traversals with epoch_enter()/epoch_exit().
+// Writers unlink objects under their own locks and hand them to
+// epoch_retire(); the object is freed only after every thread that could
+// still hold a reference has left its critical section. Critical sections
+// nest and must stay short: a pinned thread delays all reclamation.
+
+// Pin the calling thread to the current epoch
+void epoch_enter(void);
+
+// Unpin the calling thread (matches epoch_enter)
+void epoch_exit(void);
+
+// True while the calling thread is inside a critical section
+bool epoch_is_pinned(void);
+
+// Defer free_fn(ptr) until no reader can still reference ptr
+void epoch_retire(void* ptr, void (*free_fn)(void* ptr));
+
+// Free everything retired so far. Only safe when no thread is pinned,
+// e.g. at shutdown.
+void epoch_drain(void);
+
+#endif // EPOCH_H
@@ -0,0 +1,523 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "fdb.h"
+#include "epoch.h"
+#include "hashtable.h"
+#include "intern.h"
+#include "../utils/logging.h"
+
+#define FDB_STRIPES 64
+#define FDB_STRIPE_MASK (FDB_STRIPES - 1)
+
+// An update shared by every host it is queued for
+typedef struct {
+    atomic_int refs;
+    fdb_update_t update;
+} fdb_event_t;
+
+// A host, from its first endpoint or stream start until fdb_destroy()
+typedef struct fdb_host {
+    hash_node_t node;  // keyed by host_id
+    const char* host_id;  // interned
+    pthread_mutex_t lock;
+    struct fdb_host* next;  // all hosts, for fdb_expire()
+    // Networks the host has local endpoints in
+    vxlan_uuid_t* networks;
+    int network_count;
+    int network_capacity;
+    // Queue of updates, a ring of capacity slots (a power of two)
+    bool started;
+    fdb_event_t** queue;
+    int head;
+    int count;
+    int capacity;
+    // Pending notification
+    fdb_notify_fn notify;
+    void* ctx;
+    struct timespec deadline;
+} fdb_host_t;
+
+// A host's local endpoint count in a network
+typedef struct {
+    fdb_host_t* host;
+    int endpoints;
+} fdb_member_t;
+
+// A network with at least one endpoint
+typedef struct {
+    hash_node_t node;  // keyed by id
+    vxlan_uuid_t id;
+    uint32_t vni;
+    fdb_member_t* members;
+    int count;
+    int capacity;
+} fdb_network_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    hash_table_t table;
+} fdb_stripe_t;
+
+static fdb_members_fn list_members;
+static fdb_stripe_t networks[FDB_STRIPES];
+
+// Hosts are found without a lock inside an epoch and never freed before
+// fdb_destroy(); hosts_lock serializes adding them
+static hash_table_t hosts;
+static fdb_host_t* all_hosts = NULL;
+static pthread_mutex_t hosts_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Set up empty tables
+bool fdb_init(fdb_members_fn members) {
+    list_members = members;
+    all_hosts = NULL;
+    if (!hash_table_init(&hosts)) return false;
+    for (int i = 0; i < FDB_STRIPES; i++) {
+        if (!hash_table_init(&networks[i].table)) {
+            while (--i >= 0) {
+                hash_table_destroy(&networks[i].table);
+            }
+            hash_table_destroy(&hosts);
+            return false;
+        }
+        pthread_mutex_init(&networks[i].lock, NULL);
+    }
+    return true;
+}
+
+static void event_release(fdb_event_t* event) {
+    if (atomic_fetch_sub(&event->refs, 1) == 1) {
+        free(event);
+    }
+}
+
+// Drop everything queued for a host (host locked)
+static void queue_clear(fdb_host_t* host) {
+    for (int i = 0; i < host->count; i++) {
+        event_release(host->queue[(host->head + i) & (host->capacity - 1)]);
+    }
+    host->head = 0;
+    host->count = 0;
+}
+
+static void free_network(hash_node_t* node, void* ctx) {
+    (void)ctx;
+    fdb_network_t* network = (fdb_network_t*)node;
+    free(network->members);
+    free(network);
+}
+
+// Free all hosts, networks and queued updates
+void fdb_destroy(void) {
+    for (int i = 0; i < FDB_STRIPES; i++) {
+        hash_table_foreach(&networks[i].table, free_network, NULL);
+        hash_table_destroy(&networks[i].table);
+        pthread_mutex_destroy(&networks[i].lock);
+    }
+    fdb_host_t* host = all_hosts;
+    while (host) {
+        fdb_host_t* next = host->next;
+        queue_clear(host);
+        free(host->queue);
+        free(host->networks);
+        pthread_mutex_destroy(&host->lock);
+        free(host);
+        host = next;
+    }
+    all_hosts = NULL;
+    hash_table_destroy(&hosts);
+}
+
+// Find a host, adding it when add is set
+static fdb_host_t* find_host(const char* host_id, bool add) {
+    size_t len = strlen(host_id);
+    unsigned int h = hash_bytes(host_id, len);
+
+    epoch_enter();
+    fdb_host_t* host = (fdb_host_t*)hash_table_find(&hosts, host_id, len, h);
+    epoch_exit();
+    if (host || !add) return host;
+
+    pthread_mutex_lock(&hosts_lock);
+    host = (fdb_host_t*)hash_table_find(&hosts, host_id, len, h);
+    if (!host) {
+        host = calloc(1, sizeof(fdb_host_t));
+        const char* interned = host ? intern_string(host_id) : NULL;
+        if (!interned) {
+            free(host);
+            pthread_mutex_unlock(&hosts_lock);
+            LOG_ERROR_FMT("Failed to allocate FDB host");
+            return NULL;
+        }
+        host->host_id = interned;
+        host->node.key = interned;
+        host->node.key_len = (unsigned int)len;
+        host->node.hash = h;
+        pthread_mutex_init(&host->lock, NULL);
+        host->next = all_hosts;
+        all_hosts = host;
+        hash_table_insert(&hosts, &host->node);
+    }
+    pthread_mutex_unlock(&hosts_lock);
+    return host;
+}
+
+// Call and clear the host's notification (host locked)
+static void notify_host(fdb_host_t* host) {
+    if (!host->notify) return;
+    fdb_notify_fn notify = host->notify;
+    host->notify = NULL;
+    notify(host->ctx);
+}
+
+// Queue an event for a started host, dropping the stream when the queue
+// is full. Takes a reference to the event.
+static void push(fdb_host_t* host, fdb_event_t* event) {
+    pthread_mutex_lock(&host->lock);
+    if (!host->started) {
+        pthread_mutex_unlock(&host->lock);
+        return;
+    }
+    if (host->count == host->capacity) {
+        int capacity = host->capacity ? host->capacity * 2 : 16;
+        fdb_event_t** queue = capacity <= FDB_QUEUE_LIMIT ? malloc(capacity * sizeof(fdb_event_t*)) : NULL;
+        if (!queue) {
+            // The consumer fell too far behind; it has to start over
+            queue_clear(host);
+            host->started = false;
+            notify_host(host);
+            pthread_mutex_unlock(&host->lock);
+            return;
+        }
+        for (int i = 0; i < host->count; i++) {
+            queue[i] = host->queue[(host->head + i) & (host->capacity - 1)];
+        }
+        free(host->queue);
+        host->queue = queue;
+        host->head = 0;
+        host->capacity = capacity;
+    }
+    atomic_fetch_add(&event->refs, 1);
+    host->queue[(host->head + host->count++) & (host->capacity - 1)] = event;
+    notify_host(host);
+    pthread_mutex_unlock(&host->lock);
+}
+
+static fdb_event_t* event_new(fdb_op_t op, uint32_t vni, const vxlan_uuid_t* network_id,
+                              const vxlan_endpoint_t* endpoint) {
+    fdb_event_t* event = calloc(1, sizeof(fdb_event_t));
+    if (!event) {
+        LOG_ERROR_FMT("Failed to allocate FDB update");
+        return NULL;
+    }
+    atomic_init(&event->refs, 1);
+    event->update.op = op;
+    event->update.vni = vni;
+    event->update.network_id = *network_id;
+    if (endpoint) {
+        vxlan_copy_endpoint(&event->update.endpoint, endpoint);
+    }
+    return event;
+}
+
+// Queue an update for a single host
+static void push_new(fdb_host_t* host, fdb_op_t op, uint32_t vni, const vxlan_uuid_t* network_id,
+                     const vxlan_endpoint_t* endpoint) {
+    fdb_event_t* event = event_new(op, vni, network_id, endpoint);
+    if (event) {
+        push(host, event);
+        event_release(event);
+    }
+}
+
+// Queue an update for every member of a network except the endpoint's host
+static void fan_out(fdb_network_t* network, fdb_op_t op, const vxlan_endpoint_t* endpoint) {
+    fdb_event_t* event = NULL;
+    for (int i = 0; i < network->count; i++) {
+        fdb_host_t* host = network->members[i].host;
+        if (host->host_id == endpoint->host_id) continue;
+        if (!event && !(event = event_new(op, network->vni, &network->id, endpoint))) return;
+        push(host, event);
+    }
+    if (event) {
+        event_release(event);
+    }
+}
+
+// Sends a joining host the remote endpoints of a network
+typedef struct {
+    fdb_host_t* host;
+    uint32_t vni;
+} join_ctx_t;
+
+static void send_remote(const vxlan_endpoint_t* endpoint, void* arg) {
+    join_ctx_t* join = (join_ctx_t*)arg;
+    if (endpoint->host_id != join->host->host_id) {
+        push_new(join->host, FDB_ADD, join->vni, &endpoint->network_id, endpoint);
+    }
+}
+
+static fdb_stripe_t* stripe_for(const vxlan_uuid_t* network_id, unsigned int* hash) {
+    *hash = hash_bytes(network_id->bytes, sizeof(network_id->bytes));
+    return &networks[*hash & FDB_STRIPE_MASK];
+}
+
+static fdb_network_t* find_network(fdb_stripe_t* stripe, const vxlan_uuid_t* network_id, unsigned int h) {
+    return (fdb_network_t*)hash_table_find(&stripe->table, network_id->bytes, sizeof(network_id->bytes), h);
+}
+
+static fdb_member_t* find_member(fdb_network_t* network, const fdb_host_t* host) {
+    for (int i = 0; i < network->count; i++) {
+        if (network->members[i].host == host) return &network->members[i];
+    }
+    return NULL;
+}
+
+// Record that a host takes part in a network (stripe locked). *started
+// tells whether the host's stream had started by then; if not,
+// fdb_start() will send the network.
+static bool host_join(fdb_host_t* host, const vxlan_uuid_t* network_id, bool* started) {
+    pthread_mutex_lock(&host->lock);
+    *started = host->started;
+    if (host->network_count == host->network_capacity) {
+        int capacity = host->network_capacity ? host->network_capacity * 2 : 4;
+        vxlan_uuid_t* grown = realloc(host->networks, capacity * sizeof(vxlan_uuid_t));
+        if (!grown) {
+            pthread_mutex_unlock(&host->lock);
+            return false;
+        }
+        host->networks = grown;
+        host->network_capacity = capacity;
+    }
+    host->networks[host->network_count++] = *network_id;
+    pthread_mutex_unlock(&host->lock);
+    return true;
+}
+
+static void host_leave(fdb_host_t* host, const vxlan_uuid_t* network_id) {
+    pthread_mutex_lock(&host->lock);
+    for (int i = 0; i < host->network_count; i++) {
+        if (memcmp(&host->networks[i], network_id, sizeof(*network_id)) == 0) {
+            host->networks[i] = host->networks[--host->network_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&host->lock);
+}
+
+// Track a saved endpoint and fan it out
+void fdb_endpoint_added(const vxlan_endpoint_t* endpoint, uint32_t vni) {
+    fdb_host_t* host = find_host(endpoint->host_id, true);
+    if (!host) return;
+
+    unsigned int h;
+    fdb_stripe_t* stripe = stripe_for(&endpoint->network_id, &h);
+    pthread_mutex_lock(&stripe->lock);
+    fdb_network_t* network = find_network(stripe, &endpoint->network_id, h);
+    if (!network) {
+        network = calloc(1, sizeof(fdb_network_t));
+        if (!network) {
+            pthread_mutex_unlock(&stripe->lock);
+            LOG_ERROR_FMT("Failed to allocate FDB network");
+            return;
+        }
+        network->id = endpoint->network_id;
+        network->vni = vni;
+        network->node.key = network->id.bytes;
+        network->node.key_len = sizeof(network->id.bytes);
+        network->node.hash = h;
+        hash_table_insert(&stripe->table, &network->node);
+    } else if (vni) {
+        network->vni = vni;
+    }
+
+    fdb_member_t* member = find_member(network, host);
+    if (!member) {
+        if (network->count == network->capacity) {
+            int capacity = network->capacity ? network->capacity * 2 : 4;
+            fdb_member_t* grown = realloc(network->members, capacity * sizeof(fdb_member_t));
+            if (grown) {
+                network->members = grown;
+                network->capacity = capacity;
+            }
+        }
+        bool started;
+        if (network->count == network->capacity || !host_join(host, &network->id, &started)) {
+            if (network->count == 0) {
+                hash_table_remove(&stripe->table, &network->node);
+                free_network(&network->node, NULL);
+            }
+            pthread_mutex_unlock(&stripe->lock);
+            LOG_ERROR_FMT("Failed to allocate FDB membership");
+            return;
+        }
+        member = &network->members[network->count++];
+        member->host = host;
+        member->endpoints = 0;
+
+        // Under the stripe lock, so no change of the network is fanned
+        // out between this listing and the host joining
+        if (started) {
+            join_ctx_t join = { host, network->vni };
+            list_members(&network->id, send_remote, &join);
+        }
+    }
+    member->endpoints++;
+    fan_out(network, FDB_ADD, endpoint);
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+// Track a deleted endpoint and fan it out
+void fdb_endpoint_removed(const vxlan_endpoint_t* endpoint) {
+    fdb_host_t* host = find_host(endpoint->host_id, false);
+    if (!host) return;
+
+    unsigned int h;
+    fdb_stripe_t* stripe = stripe_for(&endpoint->network_id, &h);
+    pthread_mutex_lock(&stripe->lock);
+    fdb_network_t* network = find_network(stripe, &endpoint->network_id, h);
+    fdb_member_t* member = network ? find_member(network, host) : NULL;
+    if (!member) {
+        pthread_mutex_unlock(&stripe->lock);
+        return;
+    }
+    fan_out(network, FDB_REMOVE, endpoint);
+    if (--member->endpoints == 0) {
+        *member = network->members[--network->count];
+        host_leave(host, &network->id);
+        push_new(host, FDB_FLUSH, network->vni, &network->id, NULL);
+    }
+    if (network->count == 0) {
+        hash_table_remove(&stripe->table, &network->node);
+        free_network(&network->node, NULL);
+    }
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+// Drop a deleted network, flushing it on every member host
+void fdb_network_deleted(const vxlan_uuid_t* network_id) {
+    unsigned int h;
+    fdb_stripe_t* stripe = stripe_for(network_id, &h);
+    pthread_mutex_lock(&stripe->lock);
+    fdb_network_t* network = find_network(stripe, network_id, h);
+    if (network) {
+        for (int i = 0; i < network->count; i++) {
+            host_leave(network->members[i].host, &network->id);
+            push_new(network->members[i].host, FDB_FLUSH, network->vni, &network->id, NULL);
+        }
+        hash_table_remove(&stripe->table, &network->node);
+        free_network(&network->node, NULL);
+    }
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+// Start (or restart) the stream of host_id
+bool fdb_start(const char* host_id) {
+    fdb_host_t* host = find_host(host_id, true);
+    if (!host) return false;
+
+    pthread_mutex_lock(&host->lock);
+    queue_clear(host);
+    host->started = true;
+    int count = host->network_count;
+    vxlan_uuid_t* ids = count ? malloc(count * sizeof(vxlan_uuid_t)) : NULL;
+    if (ids) {
+        memcpy(ids, host->networks, count * sizeof(vxlan_uuid_t));
+    }
+    if (count && !ids) {
+        host->started = false;
+    }
+    pthread_mutex_unlock(&host->lock);
+    if (count && !ids) return false;
+
+    // Networks joined from here on are sent by the join itself, and
+    // changes fanned out meanwhile are repeated by the listing at worst
+    for (int i = 0; i < count; i++) {
+        unsigned int h;
+        fdb_stripe_t* stripe = stripe_for(&ids[i], &h);
+        pthread_mutex_lock(&stripe->lock);
+        fdb_network_t* network = find_network(stripe, &ids[i], h);
+        if (network && find_member(network, host)) {
+            join_ctx_t join = { host, network->vni };
+            list_members(&network->id, send_remote, &join);
+        }
+        pthread_mutex_unlock(&stripe->lock);
+    }
+    free(ids);
+    return true;
+}
+
+// Take up to max queued updates of host_id
+bool fdb_take(const char* host_id, fdb_update_t* out, int max, int* count, fdb_notify_fn notify, void* ctx,
+              int timeout_ms) {
+    *count = 0;
+    fdb_host_t* host = find_host(host_id, false);
+    if (!host) {
+        errno = ENOENT;
+        return false;
+    }
+
+    pthread_mutex_lock(&host->lock);
+    if (!host->started) {
+        pthread_mutex_unlock(&host->lock);
+        errno = ENOENT;
+        return false;
+    }
+    while (host->count > 0 && *count < max) {
+        fdb_event_t* event = host->queue[host->head];
+        host->head = (host->head + 1) & (host->capacity - 1);
+        host->count--;
+        out[(*count)++] = event->update;
+        event_release(event);
+    }
+    if (*count == 0 && notify) {
+        // A consumer already waiting gives way to the new one
+        notify_host(host);
+        host->notify = notify;
+        host->ctx = ctx;
+        clock_gettime(CLOCK_MONOTONIC, &host->deadline);
+        host->deadline.tv_sec += timeout_ms / 1000;
+        host->deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (host->deadline.tv_nsec >= 1000000000) {
+            host->deadline.tv_sec++;
+            host->deadline.tv_nsec -= 1000000000;
+        }
+    }
+    pthread_mutex_unlock(&host->lock);
+    return true;
+}
+
+// Withdraw the notification left with ctx
+bool fdb_cancel(const char* host_id, void* ctx) {
+    fdb_host_t* host = find_host(host_id, false);
+    if (!host) return false;
+
+    pthread_mutex_lock(&host->lock);
+    bool pending = host->notify && host->ctx == ctx;
+    if (pending) {
+        host->notify = NULL;
+    }
+    pthread_mutex_unlock(&host->lock);
+    return pending;
+}
+
+// Call the notifications whose wait has timed out
+void fdb_expire(bool all) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&hosts_lock);
+    for (fdb_host_t* host = all_hosts; host; host = host->next) {
+        pthread_mutex_lock(&host->lock);
+        if (host->notify && (all || host->deadline.tv_sec < now.tv_sec ||
+                             (host->deadline.tv_sec == now.tv_sec && host->deadline.tv_nsec <= now.tv_nsec))) {
+            notify_host(host);
+        }
+        pthread_mutex_unlock(&host->lock);
+    }
+    pthread_mutex_unlock(&hosts_lock);
+}
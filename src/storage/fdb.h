@@ -0,0 +1,85 @@
+#ifndef FDB_H
+#define FDB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../network/vxlan.h"
+
+// Per-host forwarding database (FDB) streams.
+//
+// A host takes part in a network while it has local endpoints in it (by
+// vxlan_endpoint_t.host_id). Each network keeps its member hosts with
+// their local endpoint counts, so a save or delete is fanned out to the
+// other hosts of its network only, in O(member hosts), as it happens. A
+// host that joins a network is sent the network's remote endpoints, and
+// one that leaves is told to flush it.
+//
+// Updates are queued per host once the host has started its stream with
+// fdb_start(), which queues its whole FDB first. A queue that outgrows
+// FDB_QUEUE_LIMIT is dropped and the host must start again. A consumer
+// with nothing to take can leave a one-shot notification instead of
+// blocking a thread, so any number of hosts can wait at once.
+//
+// Lock order: network stripe, then host. Notifications are called with the
+// host locked and must not call back into this module.
+
+// Most updates queued for one host; a start queues a whole network
+#define FDB_QUEUE_LIMIT 65536
+
+typedef enum {
+    FDB_ADD,    // a remote endpoint to reach through its VTEP
+    FDB_REMOVE, // a remote endpoint that is gone
+    FDB_FLUSH   // the host has left the network: drop all of its entries
+} fdb_op_t;
+
+// One update. endpoint is unset for FDB_FLUSH.
+typedef struct {
+    fdb_op_t op;
+    uint32_t vni;
+    vxlan_uuid_t network_id;
+    vxlan_endpoint_t endpoint;
+} fdb_update_t;
+
+// Calls visit for every endpoint of a network at one point in time
+typedef void (*fdb_visit_fn)(const vxlan_endpoint_t* endpoint, void* arg);
+typedef void (*fdb_members_fn)(const vxlan_uuid_t* network_id, fdb_visit_fn visit, void* arg);
+
+// Called once when updates are queued for a waiting host, or its wait
+// times out
+typedef void (*fdb_notify_fn)(void* ctx);
+
+// Set up empty tables. members lists a network's endpoints for joins.
+bool fdb_init(fdb_members_fn members);
+
+// Free all hosts, networks and queued updates
+void fdb_destroy(void);
+
+// Track a saved or deleted endpoint and fan it out. Calls for one endpoint
+// must be serialized and in order. vni is the network's VNI, 0 if unknown.
+void fdb_endpoint_added(const vxlan_endpoint_t* endpoint, uint32_t vni);
+void fdb_endpoint_removed(const vxlan_endpoint_t* endpoint);
+
+// Drop a deleted network with all of its endpoints: each member host is
+// told to flush it, in O(member hosts). Calls must be serialized with the
+// network's endpoint calls.
+void fdb_network_deleted(const vxlan_uuid_t* network_id);
+
+// Start (or restart) the stream of host_id: drop what is queued and queue
+// an FDB_ADD for every remote endpoint of every network it is in
+bool fdb_start(const char* host_id);
+
+// Take up to max queued updates of host_id. Fails with errno ENOENT when
+// the stream was never started or was dropped. When nothing is queued and
+// notify is given, notify(ctx) is called once updates arrive or after
+// timeout_ms; fdb_cancel() withdraws it.
+bool fdb_take(const char* host_id, fdb_update_t* out, int max, int* count, fdb_notify_fn notify, void* ctx,
+              int timeout_ms);
+
+// Withdraw the notification left with ctx; false if it was already called
+bool fdb_cancel(const char* host_id, void* ctx);
+
+// Call the notifications whose wait has timed out (all of them with all,
+// e.g. before shutdown); call about once a second
+void fdb_expire(bool all);
+
+#endif // FDB_H
@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <string.h>
+#include "hashtable.h"
+#include "epoch.h"
+
+// Initial number of buckets (power of two)
+#define HASH_INITIAL_SIZE 16
+// Non-empty buckets migrated per insert/remove while rehashing
+#define HASH_REHASH_STEP 2
+// Empty buckets skipped per step before giving up until the next operation
+#define HASH_REHASH_MAX_EMPTY (HASH_REHASH_STEP * 10)
+
+// Hash function (djb2), with a final mix so low bits are usable as an index
+unsigned int hash_bytes(const void* key, size_t len) {
+    const unsigned char* p = (const unsigned char*)key;
+    unsigned int hash = 5381;
+    for (size_t i = 0; i < len; i++) {
+        hash = ((hash << 5) + hash) + p[i];
+    }
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3b;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+unsigned int hash_string(const char* str) {
+    return hash_bytes(str, strlen(str));
+}
+
+static hash_buckets_t* buckets_new(size_t size) {
+    hash_buckets_t* ht = malloc(sizeof(hash_buckets_t));
+    if (!ht) return NULL;
+    ht->buckets = calloc(size, sizeof(ht->buckets[0]));
+    if (!ht->buckets) {
+        free(ht);
+        return NULL;
+    }
+    ht->size = size;
+    ht->used = 0;
+    return ht;
+}
+
+static void buckets_free(void* ptr) {
+    hash_buckets_t* ht = (hash_buckets_t*)ptr;
+    if (!ht) return;
+    free(ht->buckets);
+    free(ht);
+}
+
+// Writer-side accessors; writers are serialized so relaxed loads suffice
+static inline hash_buckets_t* gen(const hash_table_t* table, int t) {
+    return atomic_load_explicit(&((hash_table_t*)table)->ht[t], memory_order_relaxed);
+}
+
+static inline hash_node_t* next_of(hash_node_t* node) {
+    return atomic_load_explicit(&node->next, memory_order_relaxed);
+}
+
+static inline bool is_rehashing(const hash_table_t* table) {
+    return table->rehash_idx >= 0;
+}
+
+// Migrate up to HASH_REHASH_STEP buckets from ht[0] to ht[1]. Readers that
+// overlap the migration window see an odd or changed counter and retry.
+static void rehash_step(hash_table_t* table) {
+    if (!is_rehashing(table)) return;
+
+    hash_buckets_t* from = gen(table, 0);
+    hash_buckets_t* to = gen(table, 1);
+    int moves = HASH_REHASH_STEP;
+    int empty_visits = HASH_REHASH_MAX_EMPTY;
+
+    atomic_fetch_add(&table->migrations, 1);
+    while (moves-- > 0 && from->used > 0) {
+        while (atomic_load_explicit(&from->buckets[table->rehash_idx], memory_order_relaxed) == NULL) {
+            table->rehash_idx++;
+            if (--empty_visits == 0) goto done;
+        }
+        hash_node_t* node = atomic_load_explicit(&from->buckets[table->rehash_idx], memory_order_relaxed);
+        atomic_store_explicit(&from->buckets[table->rehash_idx], NULL, memory_order_release);
+        while (node) {
+            hash_node_t* next = next_of(node);
+            size_t idx = node->hash & (to->size - 1);
+            atomic_store_explicit(&node->next,
+                                  atomic_load_explicit(&to->buckets[idx], memory_order_relaxed),
+                                  memory_order_release);
+            atomic_store_explicit(&to->buckets[idx], node, memory_order_release);
+            from->used--;
+            to->used++;
+            node = next;
+        }
+        table->rehash_idx++;
+    }
+
+    if (from->used == 0) {
+        atomic_store(&table->ht[0], to);
+        atomic_store(&table->ht[1], NULL);
+        table->rehash_idx = -1;
+        epoch_retire(from, buckets_free);
+    }
+done:
+    atomic_fetch_add(&table->migrations, 1);
+}
+
+// Start growing once the load factor reaches 1
+static void maybe_expand(hash_table_t* table) {
+    hash_buckets_t* ht = gen(table, 0);
+    if (is_rehashing(table) || ht->used < ht->size) return;
+
+    // On allocation failure keep using the current buckets; chains just get longer
+    hash_buckets_t* grown = buckets_new(ht->size * 2);
+    if (grown) {
+        atomic_store(&table->ht[1], grown);
+        table->rehash_idx = 0;
+    }
+}
+
+// Initialize an empty table
+bool hash_table_init(hash_table_t* table) {
+    hash_buckets_t* ht = buckets_new(HASH_INITIAL_SIZE);
+    if (!ht) return false;
+    atomic_init(&table->ht[0], ht);
+    atomic_init(&table->ht[1], NULL);
+    atomic_init(&table->migrations, 0);
+    table->rehash_idx = -1;
+    return true;
+}
+
+// Release bucket arrays immediately (nodes are owned by the caller)
+void hash_table_destroy(hash_table_t* table) {
+    buckets_free(gen(table, 0));
+    buckets_free(gen(table, 1));
+    atomic_store(&table->ht[0], NULL);
+    atomic_store(&table->ht[1], NULL);
+    table->rehash_idx = -1;
+}
+
+// Number of nodes stored
+size_t hash_table_count(const hash_table_t* table) {
+    size_t count = 0;
+    for (int t = 0; t <= 1; t++) {
+        hash_buckets_t* ht = gen(table, t);
+        if (ht) count += ht->used;
+    }
+    return count;
+}
+
+// Search one generation
+static hash_node_t* find_in(hash_buckets_t* ht, const void* key, size_t key_len, unsigned int hash) {
+    if (!ht) return NULL;
+    hash_node_t* node = atomic_load_explicit(&ht->buckets[hash & (ht->size - 1)], memory_order_acquire);
+    while (node) {
+        if (node->hash == hash && node->key_len == key_len && memcmp(node->key, key, key_len) == 0) {
+            return node;
+        }
+        node = atomic_load_explicit(&node->next, memory_order_acquire);
+    }
+    return NULL;
+}
+
+// Find the first node with the given key, checking both generations. A hit
+// is always genuine; a miss is only trusted if no migration overlapped it.
+hash_node_t* hash_table_find(hash_table_t* table, const void* key, size_t key_len, unsigned int hash) {
+    for (;;) {
+        unsigned int before = atomic_load(&table->migrations);
+        hash_node_t* node = find_in(atomic_load(&table->ht[0]), key, key_len, hash);
+        if (!node) {
+            node = find_in(atomic_load(&table->ht[1]), key, key_len, hash);
+        }
+        if (node) return node;
+        if (!(before & 1) && atomic_load(&table->migrations) == before) return NULL;
+    }
+}
+
+// Insert a node; new nodes go to the newer generation while rehashing
+bool hash_table_insert(hash_table_t* table, hash_node_t* node) {
+    if (!node || !node->key) return false;
+
+    rehash_step(table);
+    maybe_expand(table);
+
+    hash_buckets_t* ht = is_rehashing(table) ? gen(table, 1) : gen(table, 0);
+    size_t idx = node->hash & (ht->size - 1);
+    atomic_store_explicit(&node->next,
+                          atomic_load_explicit(&ht->buckets[idx], memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_store_explicit(&ht->buckets[idx], node, memory_order_release);
+    ht->used++;
+    return true;
+}
+
+// Unlink a node previously inserted into the table. The node's own next
+// pointer is left intact so a reader standing on it can keep walking.
+bool hash_table_remove(hash_table_t* table, hash_node_t* node) {
+    if (!node) return false;
+
+    rehash_step(table);
+
+    for (int t = 0; t <= 1; t++) {
+        hash_buckets_t* ht = gen(table, t);
+        if (!ht) break;
+        _Atomic(hash_node_t*)* link = &ht->buckets[node->hash & (ht->size - 1)];
+        hash_node_t* current;
+        while ((current = atomic_load_explicit(link, memory_order_relaxed))) {
+            if (current == node) {
+                atomic_store_explicit(link, next_of(node), memory_order_release);
+                ht->used--;
+                return true;
+            }
+            link = &current->next;
+        }
+    }
+    return false;
+}
+
+// Visit every node in both generations
+void hash_table_foreach(hash_table_t* table, void (*fn)(hash_node_t* node, void* ctx), void* ctx) {
+    for (int t = 0; t <= 1; t++) {
+        hash_buckets_t* ht = gen(table, t);
+        if (!ht) continue;
+        for (size_t i = 0; i < ht->size; i++) {
+            hash_node_t* node = atomic_load_explicit(&ht->buckets[i], memory_order_relaxed);
+            while (node) {
+                hash_node_t* next = next_of(node);
+                fn(node, ctx);
+                node = next;
+            }
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef HASHTABLE_H
+#define HASHTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Chained hash table node, embedded as the first member of stored entries.
+// key, key_len and hash must not change while the node is in a table.
+// Keys are compared as byte strings, so binary ids work as well as text.
+typedef struct hash_node {
+    const void* key;
+    unsigned int key_len;
+    unsigned int hash;
+    _Atomic(struct hash_node*) next;
+} hash_node_t;
+
+// One generation of buckets
+typedef struct {
+    _Atomic(hash_node_t*)* buckets;
+    size_t size;
+    size_t used;
+} hash_buckets_t;
+
+// Growable hash table. When the load factor passes 1 a second, twice as
+// large generation is allocated and buckets are migrated a few at a time
+// on each insert/remove, so no single operation pays for the full rehash.
+//
+// Writers must be serialized by the caller. hash_table_find() may run
+// concurrently with a writer as long as the reader is inside an epoch
+// critical section (see epoch.h): unlinked nodes and old bucket arrays
+// are only reclaimed through the epoch, and a reader that races with a
+// bucket migration retries instead of reporting a false miss.
+typedef struct {
+    _Atomic(hash_buckets_t*) ht[2];
+    long rehash_idx;          // next bucket of ht[0] to migrate, -1 when not rehashing
+    atomic_uint migrations;   // odd while nodes are being moved between buckets
+} hash_table_t;
+
+// Hash functions (djb2)
+unsigned int hash_bytes(const void* key, size_t len);
+unsigned int hash_string(const char* str);
+
+// Initialize an empty table
+bool hash_table_init(hash_table_t* table);
+
+// Release bucket arrays immediately (nodes are owned by the caller)
+void hash_table_destroy(hash_table_t* table);
+
+// Number of nodes stored (writer side)
+size_t hash_table_count(const hash_table_t* table);
+
+// Find the first node with the given key
+hash_node_t* hash_table_find(hash_table_t* table, const void* key, size_t key_len, unsigned int hash);
+
+// Insert a node; node->key, node->key_len and node->hash must be set. Duplicates are not checked.
+bool hash_table_insert(hash_table_t* table, hash_node_t* node);
+
+// Unlink a node previously inserted into the table. The node stays valid
+// for concurrent readers; free it through epoch_retire().
+bool hash_table_remove(hash_table_t* table, hash_node_t* node);
+
+// Visit every node (writer side); the callback may free the node it is
+// given but must not insert into or remove from the table
+void hash_table_foreach(hash_table_t* table, void (*fn)(hash_node_t* node, void* ctx), void* ctx);
+
+#endif // HASHTABLE_H
@@ -0,0 +1,284 @@
+#include <stdlib.h>
+#include <string.h>
+#include "idtable.h"
+#include "epoch.h"
+
+// Control bytes are compared 16 at a time with SSE2 (baseline on x86-64).
+// The vector load is not an atomic access, so sanitizer builds that track
+// races use the byte-wise fallback instead.
+#if defined(__SSE2__) && !defined(__SANITIZE_THREAD__)
+#define ID_TABLE_SSE2 1
+#endif
+#if defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#undef ID_TABLE_SSE2
+#endif
+#endif
+
+#ifdef ID_TABLE_SSE2
+#include <emmintrin.h>
+#endif
+
+// Control bytes: a full slot holds the low 7 bits of its node's hash, so
+// only free slots have the top bit set
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xfe
+
+// Slots in a new table
+#define ID_INITIAL_SIZE ID_GROUP_SIZE
+// Slots filled (nodes plus tombstones) before a rebuild: 7/8
+#define MAX_LOAD(capacity) ((capacity) - (capacity) / 8)
+
+static inline uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Hash of a 16-byte id: both halves through the murmur3 finalizer
+unsigned int id_hash(const void* key) {
+    uint64_t lo, hi;
+    memcpy(&lo, key, sizeof(lo));
+    memcpy(&hi, (const char*)key + sizeof(lo), sizeof(hi));
+    uint64_t h = mix64(lo + mix64(hi ^ 0x9e3779b97f4a7c15ULL));
+    return (unsigned int)(h ^ (h >> 32));
+}
+
+static inline uint8_t hash_tag(unsigned int hash) {
+    return hash & 0x7f;
+}
+
+// One group of control bytes, loaded once so every match reads the same
+// state. Acquire: a full byte seen here has its slot published.
+typedef struct {
+#ifdef ID_TABLE_SSE2
+    __m128i bytes;
+#else
+    uint8_t bytes[ID_GROUP_SIZE];
+#endif
+} group_t;
+
+// Bit i set for each byte i of a group that matches
+typedef unsigned int group_mask_t;
+
+static inline group_t group_load(const uint8_t* ctrl) {
+    group_t group;
+#ifdef ID_TABLE_SSE2
+    group.bytes = _mm_load_si128((const __m128i*)ctrl);
+    atomic_thread_fence(memory_order_acquire);
+#else
+    for (int i = 0; i < ID_GROUP_SIZE; i++) {
+        group.bytes[i] = __atomic_load_n(&ctrl[i], __ATOMIC_ACQUIRE);
+    }
+#endif
+    return group;
+}
+
+static inline group_mask_t group_match(group_t group, uint8_t byte) {
+#ifdef ID_TABLE_SSE2
+    return (group_mask_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group.bytes, _mm_set1_epi8((char)byte)));
+#else
+    group_mask_t mask = 0;
+    for (int i = 0; i < ID_GROUP_SIZE; i++) {
+        mask |= (group_mask_t)(group.bytes[i] == byte) << i;
+    }
+    return mask;
+#endif
+}
+
+// Empty and deleted slots
+static inline group_mask_t group_free(group_t group) {
+#ifdef ID_TABLE_SSE2
+    return (group_mask_t)_mm_movemask_epi8(group.bytes);
+#else
+    group_mask_t mask = 0;
+    for (int i = 0; i < ID_GROUP_SIZE; i++) {
+        mask |= (group_mask_t)(group.bytes[i] >> 7) << i;
+    }
+    return mask;
+#endif
+}
+
+// Probe groups in triangular steps (g, g+1, g+3, g+6, ...), which visits
+// every group of a power-of-two count
+typedef struct {
+    size_t group;
+    size_t mask;
+    size_t step;
+} probe_t;
+
+static inline probe_t probe_start(const id_slots_t* slots, unsigned int hash) {
+    size_t mask = slots->capacity / ID_GROUP_SIZE - 1;
+    return (probe_t){ (hash >> 7) & mask, mask, 0 };
+}
+
+// Advance; false once every group has been visited
+static inline bool probe_next(probe_t* probe) {
+    probe->step++;
+    probe->group = (probe->group + probe->step) & probe->mask;
+    return probe->step <= probe->mask;
+}
+
+static inline void set_ctrl(id_slots_t* slots, size_t i, uint8_t byte) {
+    __atomic_store_n(&slots->ctrl[i], byte, __ATOMIC_RELEASE);
+}
+
+// Header, node pointers and control bytes in one 16-byte aligned block
+static id_slots_t* slots_new(size_t capacity) {
+    size_t header = (sizeof(id_slots_t) + ID_GROUP_SIZE - 1) & ~(size_t)(ID_GROUP_SIZE - 1);
+    size_t pointers = capacity * sizeof(_Atomic(hash_node_t*));
+    id_slots_t* slots = aligned_alloc(ID_GROUP_SIZE, header + pointers + capacity);
+    if (!slots) return NULL;
+
+    slots->capacity = capacity;
+    slots->growth_left = MAX_LOAD(capacity);
+    slots->slots = (_Atomic(hash_node_t*)*)((char*)slots + header);
+    slots->ctrl = (uint8_t*)slots->slots + pointers;
+    memset(slots->slots, 0, pointers);
+    memset(slots->ctrl, CTRL_EMPTY, capacity);
+    return slots;
+}
+
+static void slots_free(void* ptr) {
+    free(ptr);
+}
+
+// Writer-side access; writers are serialized so a relaxed load suffices
+static inline id_slots_t* current(const id_table_t* table) {
+    return atomic_load_explicit(&((id_table_t*)table)->slots, memory_order_relaxed);
+}
+
+// Put a node in the first free slot of its probe sequence. The slot is
+// published before its control byte, so a reader matching the byte finds
+// the node.
+static void place(id_slots_t* slots, hash_node_t* node) {
+    probe_t probe = probe_start(slots, node->hash);
+    group_mask_t free_slots;
+    while (!(free_slots = group_free(group_load(slots->ctrl + probe.group * ID_GROUP_SIZE)))) {
+        probe_next(&probe);
+    }
+    size_t i = probe.group * ID_GROUP_SIZE + (size_t)__builtin_ctz(free_slots);
+    if (slots->ctrl[i] == CTRL_EMPTY) {
+        slots->growth_left--;
+    }
+    atomic_store_explicit(&slots->slots[i], node, memory_order_release);
+    set_ctrl(slots, i, hash_tag(node->hash));
+}
+
+// Copy the nodes into a new slot array, twice as large unless tombstones
+// made up most of the load, and swap it in; readers still on the old one
+// finish there
+static bool rebuild(id_table_t* table) {
+    id_slots_t* old = current(table);
+    size_t capacity = old->capacity;
+    if (table->count + 1 > MAX_LOAD(capacity) / 2) {
+        capacity *= 2;
+    }
+    id_slots_t* slots = slots_new(capacity);
+    if (!slots) return false;
+
+    for (size_t i = 0; i < old->capacity; i++) {
+        if (!(old->ctrl[i] & CTRL_EMPTY)) {
+            place(slots, atomic_load_explicit(&old->slots[i], memory_order_relaxed));
+        }
+    }
+    atomic_store_explicit(&table->slots, slots, memory_order_release);
+    epoch_retire(old, slots_free);
+    return true;
+}
+
+// Initialize an empty table
+bool id_table_init(id_table_t* table) {
+    id_slots_t* slots = slots_new(ID_INITIAL_SIZE);
+    if (!slots) return false;
+    atomic_init(&table->slots, slots);
+    table->count = 0;
+    return true;
+}
+
+// Release the slot array immediately (nodes are owned by the caller)
+void id_table_destroy(id_table_t* table) {
+    slots_free(current(table));
+    atomic_store(&table->slots, NULL);
+    table->count = 0;
+}
+
+// Number of nodes stored
+size_t id_table_count(const id_table_t* table) {
+    return table->count;
+}
+
+// Find the node with the given key. Groups are compared by control byte
+// first, so a miss rarely reads a node.
+hash_node_t* id_table_find(id_table_t* table, const void* key, unsigned int hash) {
+    id_slots_t* slots = atomic_load_explicit(&table->slots, memory_order_acquire);
+    probe_t probe = probe_start(slots, hash);
+    do {
+        size_t base = probe.group * ID_GROUP_SIZE;
+        group_t group = group_load(slots->ctrl + base);
+        for (group_mask_t match = group_match(group, hash_tag(hash)); match; match &= match - 1) {
+            hash_node_t* node = atomic_load_explicit(&slots->slots[base + (size_t)__builtin_ctz(match)],
+                                                     memory_order_acquire);
+            if (node->hash == hash && memcmp(node->key, key, ID_KEY_SIZE) == 0) {
+                return node;
+            }
+        }
+        // Inserts fill a group before moving on, so the key is not further
+        if (group_match(group, CTRL_EMPTY)) return NULL;
+    } while (probe_next(&probe));
+    return NULL;
+}
+
+// Insert a node, rebuilding first when the slots are used up
+bool id_table_insert(id_table_t* table, hash_node_t* node) {
+    if (!node || !node->key) return false;
+
+    if (current(table)->growth_left == 0 && !rebuild(table)) {
+        return false;
+    }
+    place(current(table), node);
+    table->count++;
+    return true;
+}
+
+// Remove a node. Its slot becomes empty again if its group still has an
+// empty slot: no probe has then ever passed the group. Otherwise it
+// becomes a tombstone, which inserts reuse and rebuilds drop.
+bool id_table_remove(id_table_t* table, hash_node_t* node) {
+    if (!node) return false;
+
+    id_slots_t* slots = current(table);
+    probe_t probe = probe_start(slots, node->hash);
+    do {
+        size_t base = probe.group * ID_GROUP_SIZE;
+        group_t group = group_load(slots->ctrl + base);
+        for (group_mask_t match = group_match(group, hash_tag(node->hash)); match; match &= match - 1) {
+            size_t i = base + (size_t)__builtin_ctz(match);
+            if (atomic_load_explicit(&slots->slots[i], memory_order_relaxed) != node) continue;
+
+            if (group_match(group, CTRL_EMPTY)) {
+                set_ctrl(slots, i, CTRL_EMPTY);
+                slots->growth_left++;
+            } else {
+                set_ctrl(slots, i, CTRL_DELETED);
+            }
+            table->count--;
+            return true;
+        }
+        if (group_match(group, CTRL_EMPTY)) return false;
+    } while (probe_next(&probe));
+    return false;
+}
+
+// Visit every node
+void id_table_foreach(id_table_t* table, void (*fn)(hash_node_t* node, void* ctx), void* ctx) {
+    id_slots_t* slots = current(table);
+    for (size_t i = 0; i < slots->capacity; i++) {
+        if (!(slots->ctrl[i] & CTRL_EMPTY)) {
+            fn(atomic_load_explicit(&slots->slots[i], memory_order_relaxed), ctx);
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef IDTABLE_H
+#define IDTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "hashtable.h"
+
+// Open-addressing table of hash_node_t keyed by 16-byte binary ids, in
+// the Swiss table layout: slots come in groups of ID_GROUP_SIZE with one
+// control byte each (empty, deleted, or 7 bits of the slot's hash), and a
+// lookup compares a whole group's control bytes at once (SSE2 where
+// available) before touching any node. A lookup walks one group in the
+// common case and stops at the first group with an empty slot.
+//
+// Nodes are the same as in hashtable.h, so a table can switch between the
+// two: key must point to ID_KEY_SIZE bytes and hash must be
+// id_hash(key). Only the slot array is allocated, never a node.
+//
+// Writers must be serialized by the caller. id_table_find() may run
+// concurrently with a writer inside an epoch critical section (see
+// epoch.h): a slot is published before its control byte, a removed node
+// is left in place for readers already on it, and a table that fills up
+// is rebuilt into a new slot array that replaces the old one at once, the
+// old one being reclaimed through the epoch.
+
+#define ID_KEY_SIZE 16
+#define ID_GROUP_SIZE 16
+
+// One slot array: groups of control bytes and node pointers
+typedef struct {
+    size_t capacity;     // slots, a power-of-two multiple of ID_GROUP_SIZE
+    size_t growth_left;  // inserts into empty slots before a rebuild
+    uint8_t* ctrl;
+    _Atomic(hash_node_t*)* slots;
+} id_slots_t;
+
+typedef struct {
+    _Atomic(id_slots_t*) slots;
+    size_t count;
+} id_table_t;
+
+// Hash of a 16-byte id; every bit depends on every key bit
+unsigned int id_hash(const void* key);
+
+// Initialize an empty table
+bool id_table_init(id_table_t* table);
+
+// Release the slot array immediately (nodes are owned by the caller)
+void id_table_destroy(id_table_t* table);
+
+// Number of nodes stored (writer side)
+size_t id_table_count(const id_table_t* table);
+
+// Find the node with the given key; hash is id_hash(key)
+hash_node_t* id_table_find(id_table_t* table, const void* key, unsigned int hash);
+
+// Insert a node; node->key and node->hash must be set. Duplicates are not
+// checked. Fails only when a needed rebuild cannot allocate.
+bool id_table_insert(id_table_t* table, hash_node_t* node);
+
+// Remove a node previously inserted into the table. The node stays valid
+// for concurrent readers; free it through epoch_retire().
+bool id_table_remove(id_table_t* table, hash_node_t* node);
+
+// Visit every node (writer side); the callback may free the node it is
+// given but must not insert into or remove from the table
+void id_table_foreach(id_table_t* table, void (*fn)(hash_node_t* node, void* ctx), void* ctx);
+
+#endif // IDTABLE_H
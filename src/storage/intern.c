@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <pthread.h>
+#include "intern.h"
+#include "hashtable.h"
+#include "epoch.h"
+#include "../utils/logging.h"
+
+// Number of lock stripes (power of two)
+#define INTERN_STRIPE_BITS 6
+#define INTERN_STRIPES (1 << INTERN_STRIPE_BITS)
+
+// Interned value; the node key points at data
+typedef struct {
+    hash_node_t node;
+    alignas(max_align_t) unsigned char data[];
+} intern_entry_t;
+
+// Lookups are lock-free; the mutex serializes inserts
+typedef struct {
+    hash_table_t table;
+    pthread_mutex_t lock;
+} intern_stripe_t;
+
+static intern_stripe_t stripes[INTERN_STRIPES];
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static bool pool_ready = false;
+
+static void pool_init(void) {
+    for (int i = 0; i < INTERN_STRIPES; i++) {
+        if (!hash_table_init(&stripes[i].table)) {
+            LOG_ERROR_FMT("Failed to initialize intern pool");
+            return;
+        }
+        pthread_mutex_init(&stripes[i].lock, NULL);
+    }
+    pool_ready = true;
+}
+
+// Pick the stripe for a hash; uses the top bits, buckets use the low bits
+static intern_stripe_t* stripe_for(unsigned int hash) {
+    return &stripes[hash >> (32 - INTERN_STRIPE_BITS)];
+}
+
+static const void* lookup(intern_stripe_t* stripe, const void* data, size_t len, unsigned int hash) {
+    epoch_enter();
+    hash_node_t* node = hash_table_find(&stripe->table, data, len, hash);
+    epoch_exit();
+    return node ? node->key : NULL;
+}
+
+// Return the canonical copy of len bytes, adding them if needed
+const void* intern_bytes(const void* data, size_t len) {
+    pthread_once(&pool_once, pool_init);
+    if (!data || !pool_ready) return NULL;
+
+    unsigned int hash = hash_bytes(data, len);
+    intern_stripe_t* stripe = stripe_for(hash);
+    const void* found = lookup(stripe, data, len, hash);
+    if (found) return found;
+
+    pthread_mutex_lock(&stripe->lock);
+    hash_node_t* node = hash_table_find(&stripe->table, data, len, hash);
+    if (!node) {
+        intern_entry_t* entry = malloc(sizeof(intern_entry_t) + len);
+        if (entry) {
+            memcpy(entry->data, data, len);
+            entry->node.key = entry->data;
+            entry->node.key_len = (unsigned int)len;
+            entry->node.hash = hash;
+            hash_table_insert(&stripe->table, &entry->node);
+            node = &entry->node;
+        }
+    }
+    pthread_mutex_unlock(&stripe->lock);
+
+    if (!node) {
+        LOG_ERROR_FMT("Failed to allocate interned value");
+        return NULL;
+    }
+    return node->key;
+}
+
+// Return the canonical copy of a string, adding it if needed
+const char* intern_string(const char* str) {
+    if (!str) return NULL;
+    return (const char*)intern_bytes(str, strlen(str) + 1);
+}
+
+// Return the canonical copy of str if it was ever interned
+const char* intern_find_string(const char* str) {
+    pthread_once(&pool_once, pool_init);
+    if (!str || !pool_ready) return NULL;
+
+    size_t len = strlen(str) + 1;
+    unsigned int hash = hash_bytes(str, len);
+    return (const char*)lookup(stripe_for(hash), str, len, hash);
+}
@@ -0,0 +1,32 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+// Intern pool for values repeated across many records (tenant ids, host
+// ids, VTEP addresses).
+//
+// Each distinct value is stored once and lives for the rest of the
+// process, so two interned values are equal exactly when their pointers
+// are. Lookups of values already in the pool take no lock; adding a new
+// value locks one of 64 stripes. Safe to call from any thread.
+//
+// Values are never freed, not even when no record uses them any more:
+// change feed entries and FDB updates keep copies of records whose strings
+// point into the pool after the records are gone. The pool therefore grows
+// with every distinct tenant id, host id and VTEP address the process ever
+// sees, by the value plus a few dozen bytes each. That is fine for a
+// fleet's hosts and tenants, but not for values that keep changing (e.g. a
+// new host id per VM boot); only a restart reclaims them.
+
+// Return the canonical copy of a NUL-terminated string, adding it if needed
+const char* intern_string(const char* str);
+
+// Return the canonical copy of len bytes, adding them if needed. The copy
+// is aligned for any fixed-size struct.
+const void* intern_bytes(const void* data, size_t len);
+
+// Return the canonical copy of str if it was ever interned, NULL otherwise
+const char* intern_find_string(const char* str);
+
+#endif // INTERN_H
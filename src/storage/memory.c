@@ -1,321 +1,2157 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
 #include "memory.h"
+#include "changes.h"
+#include "hashtable.h"
+#include "idtable.h"
+#include "epoch.h"
+#include "fdb.h"
+#include "intern.h"
+#include "mvcc.h"
+#include "snapshot.h"
+#include "tree.h"
+#include "vni.h"
+#include "wal.h"
 #include "../utils/logging.h"
+#include "../utils/slab.h"
 
-// Hash table size (prime number for better distribution)
-#define HASH_SIZE 10007
+// Link in a version list: listings follow next without locks, writers
+// also keep prev to unlink in O(1)
+typedef struct version_link {
+    _Atomic(struct version_link*) next;
+    struct version_link* prev;
+} version_link_t;
 
-// Hash table entry
+// Storage table entry
 typedef struct hash_entry {
-    char* key;
+    hash_node_t node;  // keyed by record id (points into the record)
     void* value;
-    struct hash_entry* next;
+    // Secondary index membership (see index_set_t), ordered by record id
+    struct index_set* set;
+    tree_node_t set_node;
+    // Commits that created and deleted the record, and its place in the
+    // set's version list
+    mvcc_stamp_t stamp;
+    version_link_t version;
 } hash_entry_t;
 
-// Hash table
+// Network table entry: also a member of the VNI index, of the id order of
+// all networks and of the version list of all networks. endpoints_version
+// is the record version of the network's last endpoint save or delete
+// (see storage_endpoints_version).
 typedef struct {
-    hash_entry_t* entries[HASH_SIZE];
-    pthread_mutex_t mutex;
-} hash_table_t;
+    hash_entry_t entry;
+    hash_node_t vni_node;  // keyed by the record's VNI
+    tree_node_t all_node;  // keyed by the record's id
+    version_link_t all_version;
+    _Atomic uint64_t endpoints_version;
+} network_entry_t;
 
-// Global hash tables
-static hash_table_t networks_table;
-static hash_table_t endpoints_table;
+// Endpoint table entry: also a member of its network's MAC and IP indexes
+typedef struct {
+    hash_entry_t entry;
+    hash_node_t mac_node;  // keyed by the record's MAC
+    hash_node_t ip_node;   // keyed by the record's IP (family and address bytes)
+} endpoint_entry_t;
+
+// Per-network address indexes. Writers hold the index stripe lock of the
+// network's set; lookups only need an epoch.
+typedef struct {
+    hash_table_t macs;
+    hash_table_t ips;
+} address_index_t;
+
+// Secondary index set: all primary entries sharing one secondary key
+typedef struct index_set {
+    hash_node_t node;  // keyed by secondary key, stored after the struct
+    tree_t members;    // hash_entry_t.set_node, in record id order
+    int count;
+    // hash_entry_t.version of every member, newest first, followed by
+    // deleted members an open snapshot may still list (retained of them)
+    _Atomic(version_link_t*) versions;
+    int retained;
+    address_index_t* addresses;  // endpoints by network only, else NULL
+} index_set_t;
+
+// Number of lock stripes per table (power of two)
+#define STORAGE_STRIPE_BITS 6
+#define STORAGE_STRIPES (1 << STORAGE_STRIPE_BITS)
+
+// Primary stripe: lookups are lock-free, the mutex only serializes writers
+typedef struct {
+    id_table_t table;
+    pthread_mutex_t lock;
+} storage_stripe_t;
+
+// Index stripe: listings share the read lock, writers take it exclusively
+typedef struct {
+    hash_table_t table;
+    pthread_rwlock_t lock;
+} index_stripe_t;
+
+// Storage table: primary entries striped by id hash, secondary index sets
+// striped by secondary key hash. Writers lock the entry stripe and then the
+// index stripe. Removed entries are freed through the epoch (see epoch.h),
+// so a record returned to a reader stays valid until it leaves its read
+// section.
+typedef struct {
+    storage_stripe_t entries[STORAGE_STRIPES];
+    index_stripe_t index[STORAGE_STRIPES];
+    bool networks;   // network entries, else endpoint entries
+    bool addressed;  // index sets also index endpoints by MAC and IP
+} storage_table_t;
+
+// Deleted entries still reachable from a version list because a snapshot
+// older than their delete was open. Released once no snapshot needs them.
+typedef struct retained {
+    hash_entry_t* entry;
+    uint64_t deleted;
+    bool network;
+    struct retained* next;
+} retained_t;
+
+// A shard: the networks of the tenants whose tag maps to it, with their
+// endpoints. Networks are indexed by tenant_id, endpoints by network_id.
+// Shards share nothing but the VNI index, the log and the change feed, so
+// writers in different shards never meet on a lock or a free list.
+//
+// The shard's networks in id order and its version list of networks back
+// the global listings; paging through networks_by_id takes
+// network_index_lock shared, and writers take it exclusively.
+typedef struct {
+    storage_table_t networks;
+    storage_table_t endpoints;
+    slab_allocator_t* slab;  // table entries
+    tree_t networks_by_id;
+    _Atomic(version_link_t*) all_networks;
+    pthread_rwlock_t network_index_lock;
+    retained_t* retained;
+    atomic_int retained_count;
+    pthread_mutex_t retained_lock;
+} storage_shard_t;
+
+// A network lives in the shard its id's tag maps to, and an endpoint in its
+// network's. Generated ids carry their tenant's tag (see vxlan.h), so a
+// tenant's networks share a shard; ids from before tagging set
+// stray_networks, and endpoint ids not tagged with their network's shard
+// set stray_endpoints, and lookups that rely on tags then fall back to
+// visiting every shard.
+static storage_shard_t* shards = NULL;
+static unsigned shard_mask = 0;
+static atomic_bool stray_networks = false;
+static atomic_bool stray_endpoints = false;
+
+// Networks by VNI, across shards. Lookups are lock-free inside an epoch;
+// writers take vni_index_lock.
+static hash_table_t networks_by_vni;
+static pthread_mutex_t vni_index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Changes kept for watchers (see changes.h)
+#define CHANGE_FEED_SIZE 16384
+
+// Last record version handed out. It starts from the wall-clock time in
+// microseconds, so versions are not reused after a restart.
+static _Atomic uint64_t last_version = 0;
+
+// Set once storage_open_log() has replayed the log and changes are logged
+static atomic_bool logging = false;
+
+// Highest change sequence limit found while recovering (see changes.h)
+static uint64_t recovered_sequence = 0;
+
+// Set while storage_open_log() rebuilds the tables. A snapshot may briefly
+// hold two networks with one VNI (one deleted, one created while it was
+// written), so VNIs are only claimed once the log tail has been applied.
+static atomic_bool recovering = false;
+
+// Snapshot file next to the log, and the log position of the last one
+// written or loaded. snapshot_lock serializes snapshots.
+static char* snapshot_path = NULL;
+static uint64_t snapshot_lsn = 0;
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Upper bound on threads loading a snapshot
+#define STORAGE_LOAD_THREADS 16
+
+// Background snapshot thread (see storage_start_snapshots)
+static struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    unsigned interval;
+    bool running;
+    bool stop;
+} snapshotter = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+static void stop_snapshots(void);
+static void list_network_endpoints(const vxlan_uuid_t* network_id, fdb_visit_fn visit, void* arg);
+static uint32_t network_vni(const vxlan_uuid_t* network_id);
+
+// Log record types
+enum {
+    LOG_NETWORK_SAVE = 1,
+    LOG_NETWORK_DELETE = 2,
+    LOG_ENDPOINT_SAVE = 3,
+    LOG_ENDPOINT_DELETE = 4,
+    LOG_SEQUENCE_LIMIT = 5,  // a new limit of the change feed's sequence
+};
+
+// Encoded log record. Small records use the inline buffer.
+typedef struct {
+    uint8_t type;
+    uint8_t* payload;
+    size_t len;
+    uint64_t lsn;
+    uint8_t inline_payload[256];
+} log_record_t;
+
+// Pick the stripe for a hash; uses the top bits, buckets use the low bits
+#define STRIPE_FOR(stripes, hash) (&(stripes)[(hash) >> (32 - STORAGE_STRIPE_BITS)])
+
+// Secondary key: an interned tenant_id pointer or a binary network id
+typedef struct {
+    const void* bytes;
+    size_t len;
+    unsigned int hash;
+} index_key_t;
+
+// Key on the value of an interned pointer, so matching is pointer equality
+static index_key_t interned_key(const char* const* interned) {
+    return (index_key_t){ interned, sizeof(*interned), hash_bytes(interned, sizeof(*interned)) };
+}
+
+static index_key_t uuid_key(const vxlan_uuid_t* uuid) {
+    return (index_key_t){ uuid->bytes, sizeof(uuid->bytes), hash_bytes(uuid->bytes, sizeof(uuid->bytes)) };
+}
+
+// Shard of a network by its id, or of an endpoint by its network's id
+static storage_shard_t* shard_for(const vxlan_uuid_t* id) {
+    return &shards[id->bytes[VXLAN_UUID_TAG_BYTE] & shard_mask];
+}
+
+// Shard a tenant's networks are created in
+static storage_shard_t* tenant_shard(const char* tenant_id) {
+    return &shards[vxlan_tenant_tag(tenant_id) & shard_mask];
+}
+
+// Find the index set for a key
+static index_set_t* index_find(hash_table_t* index, const index_key_t* key) {
+    return (index_set_t*)hash_table_find(index, key->bytes, key->len, key->hash);
+}
+
+// IPv4 addresses only use the first 4 address bytes
+static size_t ip_key_len(const vxlan_ip_t* ip) {
+    return 1 + (ip->family == AF_INET ? 4 : sizeof(ip->bytes));
+}
+
+static address_index_t* address_index_new(void) {
+    address_index_t* addresses = malloc(sizeof(address_index_t));
+    if (!addresses) return NULL;
+    if (!hash_table_init(&addresses->macs)) {
+        free(addresses);
+        return NULL;
+    }
+    if (!hash_table_init(&addresses->ips)) {
+        hash_table_destroy(&addresses->macs);
+        free(addresses);
+        return NULL;
+    }
+    return addresses;
+}
+
+static void address_index_free(address_index_t* addresses) {
+    if (!addresses) return;
+    hash_table_destroy(&addresses->macs);
+    hash_table_destroy(&addresses->ips);
+    free(addresses);
+}
+
+static hash_node_t* address_find(hash_table_t* table, const void* key, size_t len) {
+    return hash_table_find(table, key, len, hash_bytes(key, len));
+}
+
+// Find the endpoint entry holding a MAC or IP in one network's indexes
+static endpoint_entry_t* find_by_mac(address_index_t* addresses, const vxlan_mac_t* mac) {
+    hash_node_t* node = address_find(&addresses->macs, mac->bytes, sizeof(mac->bytes));
+    return node ? (endpoint_entry_t*)((char*)node - offsetof(endpoint_entry_t, mac_node)) : NULL;
+}
+
+static endpoint_entry_t* find_by_ip(address_index_t* addresses, const vxlan_ip_t* ip) {
+    hash_node_t* node = address_find(&addresses->ips, ip, ip_key_len(ip));
+    return node ? (endpoint_entry_t*)((char*)node - offsetof(endpoint_entry_t, ip_node)) : NULL;
+}
+
+static void address_node_init(hash_node_t* node, const void* key, size_t len) {
+    node->key = key;
+    node->key_len = (unsigned int)len;
+    node->hash = hash_bytes(key, len);
+    node->next = NULL;
+}
+
+static void address_add(address_index_t* addresses, endpoint_entry_t* entry) {
+    const vxlan_endpoint_t* endpoint = (const vxlan_endpoint_t*)entry->entry.value;
+    address_node_init(&entry->mac_node, endpoint->mac_address.bytes, sizeof(endpoint->mac_address.bytes));
+    address_node_init(&entry->ip_node, &endpoint->ip_address, ip_key_len(&endpoint->ip_address));
+    hash_table_insert(&addresses->macs, &entry->mac_node);
+    hash_table_insert(&addresses->ips, &entry->ip_node);
+}
+
+static void address_remove(address_index_t* addresses, endpoint_entry_t* entry) {
+    hash_table_remove(&addresses->macs, &entry->mac_node);
+    hash_table_remove(&addresses->ips, &entry->ip_node);
+}
+
+// True if another endpoint in the network already has this MAC or IP
+static bool address_conflict(address_index_t* addresses, const vxlan_endpoint_t* endpoint) {
+    return find_by_mac(addresses, &endpoint->mac_address) || find_by_ip(addresses, &endpoint->ip_address);
+}
+
+// Add an entry at the head of a version list (caller serializes writers)
+static void version_push(_Atomic(version_link_t*)* head, version_link_t* link) {
+    version_link_t* first = atomic_load(head);
+    atomic_init(&link->next, first);
+    link->prev = NULL;
+    if (first) {
+        first->prev = link;
+    }
+    atomic_store_explicit(head, link, memory_order_release);
+}
+
+// Unlink an entry from a version list. Its next pointer is kept, so a
+// listing standing on it carries on; free it through the epoch.
+static void version_unlink(_Atomic(version_link_t*)* head, version_link_t* link) {
+    version_link_t* next = atomic_load(&link->next);
+    if (link->prev) {
+        atomic_store_explicit(&link->prev->next, next, memory_order_release);
+    } else {
+        atomic_store_explicit(head, next, memory_order_release);
+    }
+    if (next) {
+        next->prev = link->prev;
+    }
+}
+
+// Tree keys: the record id of the entry holding the node
+#define ENTRY_OF(node, type, member) ((type*)((char*)(node) - offsetof(type, member)))
+
+static const void* set_member_key(const tree_node_t* node, size_t* len) {
+    const hash_entry_t* entry = ENTRY_OF(node, const hash_entry_t, set_node);
+    *len = entry->node.key_len;
+    return entry->node.key;
+}
+
+static const void* network_order_key(const tree_node_t* node, size_t* len) {
+    const network_entry_t* entry = ENTRY_OF(node, const network_entry_t, all_node);
+    *len = entry->entry.node.key_len;
+    return entry->entry.node.key;
+}
+
+// Add a primary entry to the index set for key, creating the set if needed.
+// With addressed, the set also indexes endpoints by MAC and IP, and an
+// address already in the set fails the add with errno EEXIST. Recovery
+// skips the check: a snapshot may briefly hold an address twice, until
+// the log tail deletes the older endpoint.
+static bool index_add(hash_table_t* index, const index_key_t* key, hash_entry_t* entry, bool addressed) {
+    index_set_t* set = index_find(index, key);
+    if (set && set->addresses && !atomic_load(&recovering) &&
+        address_conflict(set->addresses, (const vxlan_endpoint_t*)entry->value)) {
+        errno = EEXIST;
+        return false;
+    }
+    if (!set) {
+        set = malloc(sizeof(index_set_t) + key->len);
+        if (!set) {
+            return false;
+        }
+        set->addresses = addressed ? address_index_new() : NULL;
+        if (addressed && !set->addresses) {
+            free(set);
+            return false;
+        }
+        set->node.key = memcpy(set + 1, key->bytes, key->len);
+        set->node.key_len = (unsigned int)key->len;
+        set->node.hash = key->hash;
+        tree_init(&set->members, set_member_key);
+        set->count = 0;
+        atomic_init(&set->versions, NULL);
+        set->retained = 0;
+        hash_table_insert(index, &set->node);
+    }
+    if (set->addresses) {
+        address_add(set->addresses, (endpoint_entry_t*)entry);
+    }
+
+    entry->set = set;
+    tree_insert(&set->members, &entry->set_node);
+    version_push(&set->versions, &entry->version);
+    set->count++;
+    return true;
+}
+
+// Free an index set and its address indexes once no reader can see them
+static void free_index_set_deferred(void* ptr) {
+    index_set_t* set = (index_set_t*)ptr;
+    address_index_free(set->addresses);
+    free(set);
+}
+
+// Drop an index set once it has neither members nor retained versions
+static void index_set_release(hash_table_t* index, index_set_t* set) {
+    if (set->count > 0 || set->retained > 0) return;
+
+    // Address lookups and listings find sets without the stripe lock
+    hash_table_remove(index, &set->node);
+    epoch_retire(set, free_index_set_deferred);
+}
+
+// Remove a primary entry from its index set, dropping the set once empty.
+// With retain, the entry stays on the set's version list for snapshots
+// that still need it (see release_version).
+static void index_remove(hash_table_t* index, hash_entry_t* entry, bool retain) {
+    index_set_t* set = entry->set;
+    if (!set) return;
+
+    if (set->addresses) {
+        address_remove(set->addresses, (endpoint_entry_t*)entry);
+    }
+    tree_remove(&set->members, &entry->set_node);
+    set->count--;
+    if (retain) {
+        set->retained++;
+        return;
+    }
+    version_unlink(&set->versions, &entry->version);
+    entry->set = NULL;
+    index_set_release(index, set);
+}
+
+// Free an index set (members are owned by the primary table)
+static void free_index_set(hash_node_t* node, void* ctx) {
+    (void)ctx;
+    address_index_free(((index_set_t*)node)->addresses);
+    free(node);
+}
+
+// Free a network entry and its record
+static void free_network_entry(hash_node_t* node, void* ctx) {
+    (void)ctx;
+    hash_entry_t* entry = (hash_entry_t*)node;
+    vxlan_network_t* network = (vxlan_network_t*)entry->value;
+    storage_shard_t* shard = shard_for(&network->id);
+    vxlan_free_network(network);
+    slab_free(shard->slab, entry, sizeof(network_entry_t));
+}
+
+// Free an endpoint entry and its record
+static void free_endpoint_entry(hash_node_t* node, void* ctx) {
+    (void)ctx;
+    hash_entry_t* entry = (hash_entry_t*)node;
+    vxlan_endpoint_t* endpoint = (vxlan_endpoint_t*)entry->value;
+    storage_shard_t* shard = shard_for(&endpoint->network_id);
+    vxlan_free_endpoint(endpoint);
+    slab_free(shard->slab, entry, sizeof(endpoint_entry_t));
+}
 
-// Hash function (djb2)
-static unsigned int hash(const char* str) {
-    unsigned int hash = 5381;
-    int c;
-    while ((c = *str++)) {
-        hash = ((hash << 5) + hash) + c;
+// Epoch callbacks for removed entries
+static void free_network_entry_deferred(void* ptr) {
+    free_network_entry((hash_node_t*)ptr, NULL);
+}
+
+static void free_endpoint_entry_deferred(void* ptr) {
+    free_endpoint_entry((hash_node_t*)ptr, NULL);
+}
+
+// Create a table entry of size bytes keyed by the record's own id
+static hash_entry_t* entry_new(storage_shard_t* shard, const vxlan_uuid_t* id, void* value, size_t size) {
+    hash_entry_t* entry = slab_alloc(shard->slab, size);
+    if (!entry) return NULL;
+
+    entry->node.key = id->bytes;
+    entry->node.key_len = sizeof(id->bytes);
+    entry->node.hash = id_hash(id->bytes);
+    entry->node.next = NULL;
+    entry->value = value;
+    entry->set = NULL;
+    mvcc_stamp_init(&entry->stamp);
+    return entry;
+}
+
+static bool stripe_init(storage_stripe_t* stripe) {
+    if (!id_table_init(&stripe->table)) {
+        return false;
     }
-    return hash % HASH_SIZE;
+    if (pthread_mutex_init(&stripe->lock, NULL) != 0) {
+        id_table_destroy(&stripe->table);
+        return false;
+    }
+    return true;
+}
+
+static void stripe_destroy(storage_stripe_t* stripe, void (*free_node)(hash_node_t*, void*)) {
+    pthread_mutex_lock(&stripe->lock);
+    id_table_foreach(&stripe->table, free_node, NULL);
+    id_table_destroy(&stripe->table);
+    pthread_mutex_unlock(&stripe->lock);
+    pthread_mutex_destroy(&stripe->lock);
+}
+
+static bool index_stripe_init(index_stripe_t* stripe) {
+    if (!hash_table_init(&stripe->table)) {
+        return false;
+    }
+    if (pthread_rwlock_init(&stripe->lock, NULL) != 0) {
+        hash_table_destroy(&stripe->table);
+        return false;
+    }
+    return true;
+}
+
+static void index_stripe_destroy(index_stripe_t* stripe) {
+    pthread_rwlock_wrlock(&stripe->lock);
+    hash_table_foreach(&stripe->table, free_index_set, NULL);
+    hash_table_destroy(&stripe->table);
+    pthread_rwlock_unlock(&stripe->lock);
+    pthread_rwlock_destroy(&stripe->lock);
+}
+
+static void storage_table_destroy(storage_table_t* table, void (*free_entry)(hash_node_t*, void*),
+                                  int initialized) {
+    for (int i = 0; i < initialized; i++) {
+        stripe_destroy(&table->entries[i], free_entry);
+        index_stripe_destroy(&table->index[i]);
+    }
+}
+
+static bool storage_table_init(storage_table_t* table, void (*free_entry)(hash_node_t*, void*)) {
+    for (int i = 0; i < STORAGE_STRIPES; i++) {
+        if (!stripe_init(&table->entries[i])) {
+            storage_table_destroy(table, free_entry, i);
+            return false;
+        }
+        if (!index_stripe_init(&table->index[i])) {
+            stripe_destroy(&table->entries[i], free_entry);
+            storage_table_destroy(table, free_entry, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Free a shard's retained entries at shutdown; they are in no primary table
+static void free_retained(storage_shard_t* shard) {
+    pthread_mutex_lock(&shard->retained_lock);
+    retained_t* item = shard->retained;
+    shard->retained = NULL;
+    atomic_store(&shard->retained_count, 0);
+    pthread_mutex_unlock(&shard->retained_lock);
+
+    while (item) {
+        retained_t* next = item->next;
+        if (item->network) {
+            free_network_entry(&item->entry->node, NULL);
+        } else {
+            free_endpoint_entry(&item->entry->node, NULL);
+        }
+        free(item);
+        item = next;
+    }
+}
+
+static bool shard_init(storage_shard_t* shard) {
+    // Without a slab, entries fall back to malloc
+    shard->slab = slab_create();
+    if (!shard->slab) {
+        LOG_WARN_FMT("Failed to create entry slab, falling back to malloc");
+    }
+
+    shard->networks.networks = true;
+    if (!storage_table_init(&shard->networks, free_network_entry)) {
+        LOG_ERROR_FMT("Failed to initialize networks table");
+        slab_destroy(shard->slab);
+        return false;
+    }
+    shard->endpoints.addressed = true;
+    if (!storage_table_init(&shard->endpoints, free_endpoint_entry)) {
+        LOG_ERROR_FMT("Failed to initialize endpoints table");
+        storage_table_destroy(&shard->networks, free_network_entry, STORAGE_STRIPES);
+        slab_destroy(shard->slab);
+        return false;
+    }
+    tree_init(&shard->networks_by_id, network_order_key);
+    atomic_init(&shard->all_networks, NULL);
+    pthread_rwlock_init(&shard->network_index_lock, NULL);
+    shard->retained = NULL;
+    atomic_init(&shard->retained_count, 0);
+    pthread_mutex_init(&shard->retained_lock, NULL);
+    return true;
+}
+
+// Destroy the first count shards. Entries retired through the epoch are
+// freed into their shard's slab, so slabs go only once it is drained.
+static void free_shards(unsigned count) {
+    for (unsigned i = 0; i < count; i++) {
+        storage_table_destroy(&shards[i].networks, free_network_entry, STORAGE_STRIPES);
+        storage_table_destroy(&shards[i].endpoints, free_endpoint_entry, STORAGE_STRIPES);
+        free_retained(&shards[i]);
+    }
+    epoch_drain();
+    for (unsigned i = 0; i < count; i++) {
+        pthread_rwlock_destroy(&shards[i].network_index_lock);
+        pthread_mutex_destroy(&shards[i].retained_lock);
+        slab_destroy(shards[i].slab);
+    }
+    free(shards);
+    shards = NULL;
 }
 
 // Initialize storage system
 bool storage_init(void) {
-    // Initialize hash tables
-    memset(&networks_table, 0, sizeof(hash_table_t));
-    memset(&endpoints_table, 0, sizeof(hash_table_t));
-
-    // Initialize mutexes
-    if (pthread_mutex_init(&networks_table.mutex, NULL) != 0 ||
-        pthread_mutex_init(&endpoints_table.mutex, NULL) != 0) {
-        LOG_ERROR_FMT("Failed to initialize mutexes");
+    return storage_init_shards(STORAGE_DEFAULT_SHARDS);
+}
+
+// Initialize storage system with count shards
+bool storage_init_shards(unsigned count) {
+    if (count == 0 || count > STORAGE_MAX_SHARDS || (count & (count - 1)) != 0) {
+        LOG_ERROR_FMT("Shard count must be a power of two up to %d", STORAGE_MAX_SHARDS);
+        errno = EINVAL;
+        return false;
+    }
+    vni_reset();
+
+    shards = calloc(count, sizeof(storage_shard_t));
+    if (!shards) {
+        LOG_ERROR_FMT("Failed to allocate storage shards");
+        return false;
+    }
+    shard_mask = count - 1;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    atomic_store(&last_version, (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000);
+    atomic_store(&stray_networks, false);
+    atomic_store(&stray_endpoints, false);
+    for (unsigned i = 0; i < count; i++) {
+        if (!shard_init(&shards[i])) {
+            free_shards(i);
+            return false;
+        }
+    }
+    if (!hash_table_init(&networks_by_vni)) {
+        LOG_ERROR_FMT("Failed to initialize VNI index");
+        free_shards(count);
+        return false;
+    }
+    if (!changes_init(CHANGE_FEED_SIZE) || !fdb_init(list_network_endpoints)) {
+        LOG_ERROR_FMT("Failed to initialize change feed");
+        changes_destroy();
+        hash_table_destroy(&networks_by_vni);
+        free_shards(count);
         return false;
     }
 
-    LOG_INFO_FMT("Storage system initialized");
+    LOG_INFO_FMT("Storage system initialized with %u shards", count);
     return true;
 }
 
 // Clean up storage resources
 void storage_cleanup(void) {
-    // Free network entries
-    pthread_mutex_lock(&networks_table.mutex);
-    for (int i = 0; i < HASH_SIZE; i++) {
-        hash_entry_t* entry = networks_table.entries[i];
-        while (entry) {
-            hash_entry_t* next = entry->next;
-            vxlan_network_t* network = (vxlan_network_t*)entry->value;
+    stop_snapshots();
+    if (atomic_exchange(&logging, false)) {
+        wal_close();
+    }
+    free(snapshot_path);
+    snapshot_path = NULL;
+    snapshot_lsn = 0;
+    hash_table_destroy(&networks_by_vni);
+    changes_destroy();
+    fdb_destroy();
+    free_shards(shard_mask + 1);
+
+    LOG_INFO_FMT("Storage system cleaned up");
+}
+
+// Enter a read section: records returned by storage_get_*/storage_list_*
+// stay valid until the matching storage_read_end()
+void storage_read_begin(void) {
+    epoch_enter();
+}
+
+// Leave a read section
+void storage_read_end(void) {
+    epoch_exit();
+}
+
+// Start a record of len payload bytes; returns the write cursor
+static uint8_t* log_record_init(log_record_t* rec, uint8_t type, size_t len) {
+    rec->type = type;
+    rec->len = len;
+    rec->lsn = 0;
+    rec->payload = len <= sizeof(rec->inline_payload) ? rec->inline_payload : malloc(len);
+    return rec->payload;
+}
+
+static void log_record_free(log_record_t* rec) {
+    if (rec->payload != rec->inline_payload) {
+        free(rec->payload);
+    }
+}
+
+static uint8_t* put(uint8_t* cursor, const void* data, size_t len) {
+    memcpy(cursor, data, len);
+    return cursor + len;
+}
+
+// Strings are logged as a u32 length (including the terminator, 0 for
+// NULL) followed by the bytes
+static size_t string_size(const char* str) {
+    return sizeof(uint32_t) + (str ? strlen(str) + 1 : 0);
+}
+
+static uint8_t* put_string(uint8_t* cursor, const char* str) {
+    uint32_t len = str ? (uint32_t)strlen(str) + 1 : 0;
+    cursor = put(cursor, &len, sizeof(len));
+    return str ? put(cursor, str, len) : cursor;
+}
+
+// Bounds-checked reader over a log payload
+typedef struct {
+    const uint8_t* cursor;
+    const uint8_t* end;
+    bool failed;
+} log_reader_t;
+
+static void get(log_reader_t* reader, void* out, size_t len) {
+    if (reader->failed || (size_t)(reader->end - reader->cursor) < len) {
+        reader->failed = true;
+        memset(out, 0, len);
+        return;
+    }
+    memcpy(out, reader->cursor, len);
+    reader->cursor += len;
+}
+
+// Returns a pointer into the payload; NULL for a NULL string or on error
+static const char* get_string(log_reader_t* reader) {
+    uint32_t len;
+    get(reader, &len, sizeof(len));
+    if (reader->failed || len == 0) return NULL;
+    if ((size_t)(reader->end - reader->cursor) < len || reader->cursor[len - 1] != '\0') {
+        reader->failed = true;
+        return NULL;
+    }
+    const char* str = (const char*)reader->cursor;
+    reader->cursor += len;
+    return str;
+}
+
+static bool encode_network(log_record_t* rec, const vxlan_network_t* network) {
+    size_t len = sizeof(network->id) + sizeof(network->vni) + 2 * sizeof(int64_t) +
+                 string_size(network->tenant_id) + string_size(network->name) +
+                 string_size(network->description);
+    uint8_t* cursor = log_record_init(rec, LOG_NETWORK_SAVE, len);
+    if (!cursor) return false;
+    cursor = put(cursor, &network->id, sizeof(network->id));
+    cursor = put(cursor, &network->vni, sizeof(network->vni));
+    cursor = put(cursor, &network->created_at, sizeof(network->created_at));
+    cursor = put(cursor, &network->updated_at, sizeof(network->updated_at));
+    cursor = put_string(cursor, network->tenant_id);
+    cursor = put_string(cursor, network->name);
+    put_string(cursor, network->description);
+    return true;
+}
+
+static bool encode_endpoint(log_record_t* rec, const vxlan_endpoint_t* endpoint) {
+    size_t len = 2 * sizeof(vxlan_uuid_t) + sizeof(vxlan_mac_t) + 2 * sizeof(vxlan_ip_t) +
+                 2 * sizeof(int64_t) + string_size(endpoint->host_id);
+    uint8_t* cursor = log_record_init(rec, LOG_ENDPOINT_SAVE, len);
+    if (!cursor) return false;
+    cursor = put(cursor, &endpoint->id, sizeof(endpoint->id));
+    cursor = put(cursor, &endpoint->network_id, sizeof(endpoint->network_id));
+    cursor = put(cursor, &endpoint->mac_address, sizeof(endpoint->mac_address));
+    cursor = put(cursor, &endpoint->ip_address, sizeof(endpoint->ip_address));
+    cursor = put(cursor, endpoint->vtep_ip, sizeof(*endpoint->vtep_ip));
+    cursor = put(cursor, &endpoint->created_at, sizeof(endpoint->created_at));
+    cursor = put(cursor, &endpoint->updated_at, sizeof(endpoint->updated_at));
+    put_string(cursor, endpoint->host_id);
+    return true;
+}
+
+static void encode_delete(log_record_t* rec, uint8_t type, const vxlan_uuid_t* id) {
+    put(log_record_init(rec, type, sizeof(*id)), id, sizeof(*id));
+}
+
+// Buffer a record in the log; the caller holds the locks that order the change
+static void log_append(log_record_t* rec) {
+    if (rec) {
+        rec->lsn = wal_append(rec->type, rec->payload, rec->len);
+    }
+}
+
+// Apply one snapshot or log record. A snapshot is taken while writers
+// run, so the log records replayed after it may repeat saves it already
+// holds; with replay set those are skipped (ids are never reused).
+static bool apply_record(uint8_t type, const void* payload, size_t len, bool replay) {
+    log_reader_t reader = { payload, (const uint8_t*)payload + len, false };
+
+    switch (type) {
+    case LOG_NETWORK_SAVE: {
+        vxlan_network_t fields;
+        get(&reader, &fields.id, sizeof(fields.id));
+        get(&reader, &fields.vni, sizeof(fields.vni));
+        get(&reader, &fields.created_at, sizeof(fields.created_at));
+        get(&reader, &fields.updated_at, sizeof(fields.updated_at));
+        fields.tenant_id = get_string(&reader);
+        fields.name = get_string(&reader);
+        fields.description = get_string(&reader);
+        if (reader.failed || !fields.tenant_id || !fields.name) break;
+        if (replay && storage_get_network(&fields.id)) return true;
+        vxlan_network_t* network = vxlan_restore_network(&fields);
+        if (!network || !storage_save_network(network)) {
             vxlan_free_network(network);
-            free(entry->key);
-            free(entry);
-            entry = next;
+            return false;
         }
+        return true;
     }
-    pthread_mutex_unlock(&networks_table.mutex);
-
-    // Free endpoint entries
-    pthread_mutex_lock(&endpoints_table.mutex);
-    for (int i = 0; i < HASH_SIZE; i++) {
-        hash_entry_t* entry = endpoints_table.entries[i];
-        while (entry) {
-            hash_entry_t* next = entry->next;
-            vxlan_endpoint_t* endpoint = (vxlan_endpoint_t*)entry->value;
+    case LOG_ENDPOINT_SAVE: {
+        vxlan_endpoint_t fields;
+        vxlan_ip_t vtep;
+        get(&reader, &fields.id, sizeof(fields.id));
+        get(&reader, &fields.network_id, sizeof(fields.network_id));
+        get(&reader, &fields.mac_address, sizeof(fields.mac_address));
+        get(&reader, &fields.ip_address, sizeof(fields.ip_address));
+        get(&reader, &vtep, sizeof(vtep));
+        get(&reader, &fields.created_at, sizeof(fields.created_at));
+        get(&reader, &fields.updated_at, sizeof(fields.updated_at));
+        fields.host_id = get_string(&reader);
+        fields.vtep_ip = &vtep;
+        if (reader.failed || !fields.host_id) break;
+        if (replay && storage_get_endpoint(&fields.network_id, &fields.id)) return true;
+        vxlan_endpoint_t* endpoint = vxlan_restore_endpoint(&fields);
+        if (!endpoint || !storage_save_endpoint(endpoint)) {
             vxlan_free_endpoint(endpoint);
-            free(entry->key);
-            free(entry);
-            entry = next;
+            return false;
         }
+        return true;
+    }
+    case LOG_SEQUENCE_LIMIT: {
+        uint64_t limit;
+        get(&reader, &limit, sizeof(limit));
+        if (reader.failed) break;
+        if (limit > recovered_sequence) {
+            recovered_sequence = limit;
+        }
+        return true;
+    }
+    case LOG_NETWORK_DELETE:
+    case LOG_ENDPOINT_DELETE: {
+        vxlan_uuid_t id;
+        get(&reader, &id, sizeof(id));
+        if (reader.failed) break;
+        // The record may already be gone if the log holds a duplicate delete
+        if (type == LOG_NETWORK_DELETE) {
+            storage_delete_network(&id);
+        } else {
+            storage_delete_endpoint(NULL, &id);
+        }
+        return true;
+    }
     }
-    pthread_mutex_unlock(&endpoints_table.mutex);
 
-    // Destroy mutexes
-    pthread_mutex_destroy(&networks_table.mutex);
-    pthread_mutex_destroy(&endpoints_table.mutex);
+    LOG_ERROR_FMT("Malformed log record (type %u, %zu bytes)", type, len);
+    return false;
+}
 
-    LOG_INFO_FMT("Storage system cleaned up");
+static bool apply_log_record(uint8_t type, const void* payload, size_t len, void* ctx) {
+    (void)ctx;
+    return apply_record(type, payload, len, true);
+}
+
+static bool apply_snapshot_record(uint8_t type, const void* payload, size_t len, void* ctx) {
+    (void)ctx;
+    return apply_record(type, payload, len, false);
+}
+
+// Collects table values into a growable array
+typedef struct {
+    void** values;
+    int count;
+    int capacity;
+    bool failed;
+} collect_ctx_t;
+
+static void collect_value(hash_node_t* node, void* ctx) {
+    collect_ctx_t* collect = (collect_ctx_t*)ctx;
+    if (collect->failed) return;
+    if (collect->count >= collect->capacity) {
+        int capacity = collect->capacity == 0 ? 16 : collect->capacity * 2;
+        void** grown = realloc(collect->values, capacity * sizeof(void*));
+        if (!grown) {
+            collect->failed = true;
+            return;
+        }
+        collect->values = grown;
+        collect->capacity = capacity;
+    }
+    collect->values[collect->count++] = ((hash_entry_t*)node)->value;
+}
+
+// Collect the entries whose deletion is not yet claimed
+static void collect_live(hash_node_t* node, void* ctx) {
+    if (!mvcc_deleted(&((hash_entry_t*)node)->stamp)) {
+        collect_value(node, ctx);
+    }
+}
+
+// Claim the VNI of every network after recovery; false on a duplicate
+static bool rebuild_vnis(void) {
+    vni_reset();
+    bool ok = true;
+    for (unsigned i = 0; i < (shard_mask + 1) * STORAGE_STRIPES; i++) {
+        collect_ctx_t collect = { NULL, 0, 0, false };
+        storage_stripe_t* stripe = &shards[i / STORAGE_STRIPES].networks.entries[i % STORAGE_STRIPES];
+        pthread_mutex_lock(&stripe->lock);
+        id_table_foreach(&stripe->table, collect_value, &collect);
+        pthread_mutex_unlock(&stripe->lock);
+        ok = !collect.failed;
+        for (int j = 0; ok && j < collect.count; j++) {
+            vxlan_network_t* network = (vxlan_network_t*)collect.values[j];
+            if (!vni_reserve(network->vni)) {
+                LOG_ERROR_FMT("Recovered state has VNI %u on more than one network", network->vni);
+                ok = false;
+            }
+        }
+        free(collect.values);
+        if (!ok) break;
+    }
+    return ok;
+}
+
+// Track every recovered endpoint in the FDB. Snapshot sections load in
+// parallel, so an endpoint may be applied before its network, and the log
+// tail may still delete either: the FDB is only built once the tables are
+// final, with each network's VNI known.
+static void rebuild_fdb(void) {
+    for (unsigned i = 0; i < (shard_mask + 1) * STORAGE_STRIPES; i++) {
+        collect_ctx_t collect = { NULL, 0, 0, false };
+        storage_stripe_t* stripe = &shards[i / STORAGE_STRIPES].endpoints.entries[i % STORAGE_STRIPES];
+        pthread_mutex_lock(&stripe->lock);
+        id_table_foreach(&stripe->table, collect_live, &collect);
+        pthread_mutex_unlock(&stripe->lock);
+        if (collect.failed) {
+            LOG_ERROR_FMT("Failed to rebuild the FDB");
+        }
+        for (int j = 0; j < collect.count; j++) {
+            const vxlan_endpoint_t* endpoint = (const vxlan_endpoint_t*)collect.values[j];
+            fdb_endpoint_added(endpoint, network_vni(&endpoint->network_id));
+        }
+        free(collect.values);
+    }
+}
+
+// Log a new limit of the change feed's sequence before the feed hands out
+// a sequence past the last one. Called with the feed locked; the sync is
+// paid once every CHANGES_PERSIST_STEP changes.
+static void persist_sequence(uint64_t limit) {
+    uint64_t lsn = wal_append(LOG_SEQUENCE_LIMIT, &limit, sizeof(limit));
+    if (!lsn) {
+        LOG_ERROR_FMT("Failed to log change sequence limit");
+    }
+    wal_sync(lsn);
+}
+
+// Load the snapshot (in parallel), replay the log tail after it and open
+// the log for appending
+static bool recover(const char* path, wal_sync_mode_t mode) {
+    size_t snap_size = strlen(path) + sizeof(".snap");
+    char* snap = malloc(snap_size);
+    if (!snap) return false;
+    snprintf(snap, snap_size, "%s.snap", path);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus < 1 ? 1 : cpus > STORAGE_LOAD_THREADS ? STORAGE_LOAD_THREADS : (int)cpus;
+    uint64_t lsn;
+    if (!snapshot_load(snap, threads, apply_snapshot_record, NULL, &lsn, &recovered_sequence)) {
+        free(snap);
+        return false;
+    }
+    if (!wal_replay(path, lsn, apply_log_record, NULL)) {
+        LOG_ERROR_FMT("Failed to replay log %s", path);
+        free(snap);
+        return false;
+    }
+    if (!rebuild_vnis()) {
+        free(snap);
+        return false;
+    }
+    rebuild_fdb();
+    if (!wal_open(path, mode, lsn)) {
+        free(snap);
+        return false;
+    }
+    snapshot_path = snap;
+    snapshot_lsn = lsn;
+    atomic_store(&logging, true);
+    // Sequences from before the restart are never handed out again, even
+    // if the clock has stepped back since
+    changes_resume(recovered_sequence, persist_sequence);
+    return true;
+}
+
+// Recover from the log at path, then log every change
+bool storage_open_log(const char* path, wal_sync_mode_t mode) {
+    if (!path || atomic_load(&logging)) return false;
+    atomic_store(&recovering, true);
+    bool ok = recover(path, mode);
+    atomic_store(&recovering, false);
+    return ok;
+}
+
+// Add a saved network to the VNI index and to its shard's id order and
+// version list of networks. Recovery may briefly index a VNI twice, until
+// the log tail deletes the older network.
+static void network_index_add(storage_shard_t* shard, network_entry_t* entry) {
+    vxlan_network_t* network = (vxlan_network_t*)entry->entry.value;
+    entry->vni_node.key = &network->vni;
+    entry->vni_node.key_len = sizeof(network->vni);
+    entry->vni_node.hash = hash_bytes(&network->vni, sizeof(network->vni));
+    entry->vni_node.next = NULL;
+    pthread_mutex_lock(&vni_index_lock);
+    hash_table_insert(&networks_by_vni, &entry->vni_node);
+    pthread_mutex_unlock(&vni_index_lock);
+    pthread_rwlock_wrlock(&shard->network_index_lock);
+    tree_insert(&shard->networks_by_id, &entry->all_node);
+    version_push(&shard->all_networks, &entry->all_version);
+    pthread_rwlock_unlock(&shard->network_index_lock);
+}
+
+// Remove a deleted network from the network indexes; with retain it stays
+// on its shard's version list of networks
+static void network_index_remove(storage_shard_t* shard, network_entry_t* entry, bool retain) {
+    pthread_mutex_lock(&vni_index_lock);
+    hash_table_remove(&networks_by_vni, &entry->vni_node);
+    pthread_mutex_unlock(&vni_index_lock);
+    pthread_rwlock_wrlock(&shard->network_index_lock);
+    tree_remove(&shard->networks_by_id, &entry->all_node);
+    if (!retain) {
+        version_unlink(&shard->all_networks, &entry->all_version);
+    }
+    pthread_rwlock_unlock(&shard->network_index_lock);
+}
+
+// VNI of a network, 0 if it is not stored
+static uint32_t network_vni(const vxlan_uuid_t* network_id) {
+    unsigned int h = id_hash(network_id->bytes);
+    storage_stripe_t* stripe = STRIPE_FOR(shard_for(network_id)->networks.entries, h);
+    uint32_t vni = 0;
+
+    epoch_enter();
+    hash_entry_t* entry = (hash_entry_t*)id_table_find(&stripe->table, network_id->bytes, h);
+    if (entry) {
+        vni = ((vxlan_network_t*)entry->value)->vni;
+    }
+    epoch_exit();
+    return vni;
+}
+
+static uint64_t next_version(void) {
+    return atomic_fetch_add(&last_version, 1) + 1;
+}
+
+// Give a network's endpoint list a new version. Called once a save or
+// delete is visible to every listing and before it is published, so a
+// client that sees the change never gets the old version back.
+static void touch_endpoints(const vxlan_uuid_t* network_id) {
+    unsigned int h = id_hash(network_id->bytes);
+    storage_stripe_t* stripe = STRIPE_FOR(shard_for(network_id)->networks.entries, h);
+
+    epoch_enter();
+    hash_entry_t* entry = (hash_entry_t*)id_table_find(&stripe->table, network_id->bytes, h);
+    if (entry) {
+        atomic_store(&((network_entry_t*)entry)->endpoints_version, next_version());
+    }
+    epoch_exit();
+}
+
+// Visit the endpoints of a network at a snapshot, for FDB joins. Takes no
+// lock, so it may run under a primary stripe lock.
+static void list_network_endpoints(const vxlan_uuid_t* network_id, fdb_visit_fn visit, void* arg) {
+    index_key_t index_key = uuid_key(network_id);
+    index_stripe_t* index = STRIPE_FOR(shard_for(network_id)->endpoints.index, index_key.hash);
+
+    epoch_enter();
+    uint64_t snapshot = mvcc_begin();
+    index_set_t* set = index_find(&index->table, &index_key);
+    for (version_link_t* link = set ? atomic_load_explicit(&set->versions, memory_order_acquire) : NULL; link;
+         link = atomic_load_explicit(&link->next, memory_order_acquire)) {
+        hash_entry_t* entry = (hash_entry_t*)((char*)link - offsetof(hash_entry_t, version));
+        if (mvcc_visible(&entry->stamp, snapshot)) {
+            visit((const vxlan_endpoint_t*)entry->value, arg);
+        }
+    }
+    mvcc_end();
+    epoch_exit();
+}
+
+// Publish a save or delete to the change feed. Called under the entry's
+// primary stripe lock, so the changes of one record are in order. Replayed
+// changes are not published: watchers resume from a listing after a restart.
+static void publish_change(storage_table_t* table, hash_entry_t* entry, bool created) {
+    if (atomic_load(&recovering)) return;
+
+    change_t change;
+    memset(&change, 0, sizeof(change));
+    if (table->networks) {
+        const vxlan_network_t* network = (const vxlan_network_t*)entry->value;
+        change.type = created ? CHANGE_NETWORK_CREATED : CHANGE_NETWORK_DELETED;
+        change.network_id = network->id;
+        change.tenant_id = network->tenant_id;
+        change.vni = network->vni;
+    } else {
+        const vxlan_endpoint_t* endpoint = (const vxlan_endpoint_t*)entry->value;
+        change.type = created ? CHANGE_ENDPOINT_CREATED : CHANGE_ENDPOINT_DELETED;
+        change.network_id = endpoint->network_id;
+        vxlan_copy_endpoint(&change.endpoint, endpoint);
+    }
+    changes_append(&change);
+}
+
+// Insert an entry into a table's primary stripe and the index set for
+// index_key, holding both stripe write locks. rec, if given, is appended to
+// the log under the same locks so the log order matches the table's. The
+// creation is committed last, still under the primary lock.
+//
+// An endpoint's network must still be stored, else the insert fails with
+// errno ENOENT before anything is logged or published. delete_network()
+// unlinks the network under the same index lock, so an endpoint is either
+// indexed in time to be deleted with its network or finds it gone.
+// Recovery skips the check: a snapshot may load an endpoint before its
+// network.
+static bool table_insert(storage_shard_t* shard, storage_table_t* table, hash_entry_t* entry,
+                         index_key_t index_key, log_record_t* rec) {
+    storage_stripe_t* primary = STRIPE_FOR(table->entries, entry->node.hash);
+    index_stripe_t* index = STRIPE_FOR(table->index, index_key.hash);
+    const vxlan_endpoint_t* endpoint = table->networks ? NULL : (const vxlan_endpoint_t*)entry->value;
+
+    pthread_mutex_lock(&primary->lock);
+    pthread_rwlock_wrlock(&index->lock);
+    uint32_t vni = endpoint ? network_vni(&endpoint->network_id) : 0;
+    bool indexed;
+    if (endpoint && !vni && !atomic_load(&recovering)) {
+        errno = ENOENT;
+        indexed = false;
+    } else {
+        indexed = index_add(&index->table, &index_key, entry, table->addressed);
+    }
+    // The primary table only fails when it cannot grow
+    if (indexed && !id_table_insert(&primary->table, &entry->node)) {
+        index_remove(&index->table, entry, false);
+        indexed = false;
+    }
+    if (indexed) {
+        log_append(rec);
+    }
+    pthread_rwlock_unlock(&index->lock);
+    if (indexed) {
+        if (table->networks) {
+            network_index_add(shard, (network_entry_t*)entry);
+        }
+        // Listings see the record from here on; a delete cannot commit
+        // before this, it needs the primary stripe lock
+        mvcc_commit_create(&entry->stamp);
+        if (endpoint) {
+            touch_endpoints(&endpoint->network_id);
+        }
+        publish_change(table, entry, true);
+        // Recovery builds the FDB once every network is back (rebuild_fdb)
+        if (endpoint && !atomic_load(&recovering)) {
+            fdb_endpoint_added(endpoint, vni);
+        }
+    }
+    pthread_mutex_unlock(&primary->lock);
+    return indexed;
+}
+
+// Unlink an entry whose deletion is committed from its primary stripe,
+// index set and, for networks, the network indexes. The caller holds the
+// primary stripe's lock and, for an endpoint, not its index stripe's. With
+// retain the entry stays on its version lists (see table_unlink).
+static void table_remove(storage_shard_t* shard, storage_table_t* table, storage_stripe_t* primary,
+                         hash_entry_t* entry, bool retain) {
+    id_table_remove(&primary->table, &entry->node);
+    if (entry->set) {
+        index_stripe_t* index = STRIPE_FOR(table->index, entry->set->node.hash);
+        pthread_rwlock_wrlock(&index->lock);
+        index_remove(&index->table, entry, retain);
+        pthread_rwlock_unlock(&index->lock);
+    }
+    if (table->networks) {
+        network_index_remove(shard, (network_entry_t*)entry, retain);
+    }
+}
+
+// Commit the deletion of an entry, unlink it and publish the delete. The
+// caller holds the primary stripe's lock. Fails when a network delete has
+// already claimed the entry. *retain tells whether an open snapshot may
+// still list the entry: it then stays on its version lists, and the caller
+// hands it to retain_entry() instead of retiring it.
+static bool table_unlink(storage_shard_t* shard, storage_table_t* table, storage_stripe_t* primary,
+                         hash_entry_t* entry, bool* retain) {
+    uint64_t deleted = mvcc_commit_delete(&entry->stamp);
+    if (!deleted) return false;
+    *retain = mvcc_needed(deleted);
+    table_remove(shard, table, primary, entry, *retain);
+    if (!table->networks) {
+        touch_endpoints(&((const vxlan_endpoint_t*)entry->value)->network_id);
+    }
+    publish_change(table, entry, false);
+    if (!table->networks && !atomic_load(&recovering)) {
+        fdb_endpoint_removed((const vxlan_endpoint_t*)entry->value);
+    }
+    return true;
+}
+
+// Keep a deleted entry of a shard until no snapshot needs it
+static void retain_entry(storage_shard_t* shard, hash_entry_t* entry, bool network) {
+    retained_t* item = malloc(sizeof(retained_t));
+    if (!item) {
+        LOG_FATAL_FMT("Failed to allocate retained version record");
+        abort();
+    }
+    item->entry = entry;
+    item->deleted = atomic_load(&entry->stamp.deleted);
+    item->network = network;
+
+    pthread_mutex_lock(&shard->retained_lock);
+    item->next = shard->retained;
+    shard->retained = item;
+    atomic_fetch_add(&shard->retained_count, 1);
+    pthread_mutex_unlock(&shard->retained_lock);
+}
+
+// Unlink a retained entry from its version lists and retire it
+static void release_version(storage_shard_t* shard, hash_entry_t* entry, bool network) {
+    storage_table_t* table = network ? &shard->networks : &shard->endpoints;
+    index_set_t* set = entry->set;
+    index_stripe_t* index = STRIPE_FOR(table->index, set->node.hash);
+
+    pthread_rwlock_wrlock(&index->lock);
+    version_unlink(&set->versions, &entry->version);
+    entry->set = NULL;
+    set->retained--;
+    index_set_release(&index->table, set);
+    pthread_rwlock_unlock(&index->lock);
+
+    if (network) {
+        pthread_rwlock_wrlock(&shard->network_index_lock);
+        version_unlink(&shard->all_networks, &((network_entry_t*)entry)->all_version);
+        pthread_rwlock_unlock(&shard->network_index_lock);
+        epoch_retire(entry, free_network_entry_deferred);
+    } else {
+        epoch_retire(entry, free_endpoint_entry_deferred);
+    }
+}
+
+// Release a shard's retained entries that no open snapshot needs any more.
+// Called without locks held, after deletes and when a listing ends.
+static void release_retained(storage_shard_t* shard) {
+    if (atomic_load(&shard->retained_count) == 0) return;
+
+    retained_t* ready = NULL;
+    pthread_mutex_lock(&shard->retained_lock);
+    for (retained_t** link = &shard->retained; *link;) {
+        retained_t* item = *link;
+        if (mvcc_needed(item->deleted)) {
+            link = &item->next;
+            continue;
+        }
+        *link = item->next;
+        item->next = ready;
+        ready = item;
+        atomic_fetch_sub(&shard->retained_count, 1);
+    }
+    pthread_mutex_unlock(&shard->retained_lock);
+
+    while (ready) {
+        retained_t* next = ready->next;
+        release_version(shard, ready->entry, ready->network);
+        free(ready);
+        ready = next;
+    }
+}
+
+// Append the values of the entries on a version list that existed at
+// snapshot. link_offset locates the link within the entry. The caller is
+// inside an epoch.
+static void collect_versions(_Atomic(version_link_t*)* head, size_t link_offset, uint64_t snapshot,
+                             collect_ctx_t* collect) {
+    for (version_link_t* link = head ? atomic_load_explicit(head, memory_order_acquire) : NULL; link;
+         link = atomic_load_explicit(&link->next, memory_order_acquire)) {
+        hash_entry_t* entry = (hash_entry_t*)((char*)link - link_offset);
+        if (mvcc_visible(&entry->stamp, snapshot)) {
+            collect_value(&entry->node, collect);
+        }
+    }
+}
+
+// Hand back collected values, always as an array unless allocation failed
+static void** collect_finish(collect_ctx_t* collect, int* count) {
+    if (collect->failed) {
+        free(collect->values);
+        return NULL;
+    }
+    if (!collect->values) {
+        collect->values = malloc(sizeof(void*));
+    }
+    *count = collect->count;
+    return collect->values;
+}
+
+// Append the values of one index set at snapshot; the caller is inside an
+// epoch
+static void collect_set(storage_table_t* table, const index_key_t* index_key, uint64_t snapshot,
+                        collect_ctx_t* collect) {
+    index_stripe_t* index = STRIPE_FOR(table->index, index_key->hash);
+    index_set_t* set = index_find(&index->table, index_key);
+    collect_versions(set ? &set->versions : NULL, offsetof(hash_entry_t, version), snapshot, collect);
+}
+
+// Copy the values of one index set at a snapshot into a new array (always
+// non-NULL on success). Takes no lock, so writers are never blocked.
+static void** index_collect(storage_shard_t* shard, storage_table_t* table, index_key_t index_key, int* count) {
+    collect_ctx_t collect = { NULL, 0, 0, false };
+
+    epoch_enter();
+    uint64_t snapshot = mvcc_begin();
+    collect_set(table, &index_key, snapshot, &collect);
+    mvcc_end();
+    epoch_exit();
+
+    release_retained(shard);
+    return collect_finish(&collect, count);
+}
+
+// Collect up to limit values in id order from trees of entries (one per
+// shard at most; NULL trees are skipped), merging them, starting after
+// the id after (from the start when NULL). node_offset locates the tree
+// node within the entry.
+static void** tree_page(const tree_t* const* trees, int n, size_t node_offset, const vxlan_uuid_t* after,
+                        int limit, int* count) {
+    void** values = malloc(limit * sizeof(void*));
+    if (!values) return NULL;
+
+    tree_node_t* heads[STORAGE_MAX_SHARDS];
+    for (int i = 0; i < n; i++) {
+        heads[i] = !trees[i] ? NULL
+                 : after ? tree_after(trees[i], after->bytes, sizeof(after->bytes)) : tree_first(trees[i]);
+    }
+    while (*count < limit) {
+        const hash_entry_t* next = NULL;
+        int from = -1;
+        for (int i = 0; i < n; i++) {
+            const hash_entry_t* entry = heads[i] ? (const hash_entry_t*)((char*)heads[i] - node_offset) : NULL;
+            if (entry && (!next || memcmp(entry->node.key, next->node.key, sizeof(vxlan_uuid_t)) < 0)) {
+                next = entry;
+                from = i;
+            }
+        }
+        if (!next) break;
+        values[(*count)++] = next->value;
+        heads[from] = tree_next(heads[from]);
+    }
+    return values;
+}
+
+// One page of the index sets for a key in n tables, found and read under
+// their index stripes' read locks
+static void** index_page(storage_table_t* const* tables, int n, index_key_t index_key, const vxlan_uuid_t* after,
+                         int limit, int* count) {
+    const tree_t* trees[STORAGE_MAX_SHARDS] = { NULL };
+    for (int i = 0; i < n; i++) {
+        index_stripe_t* index = STRIPE_FOR(tables[i]->index, index_key.hash);
+        pthread_rwlock_rdlock(&index->lock);
+        index_set_t* set = index_find(&index->table, &index_key);
+        trees[i] = set ? &set->members : NULL;
+    }
+    void** values = tree_page(trees, n, offsetof(hash_entry_t, set_node), after, limit, count);
+    for (int i = 0; i < n; i++) {
+        pthread_rwlock_unlock(&STRIPE_FOR(tables[i]->index, index_key.hash)->lock);
+    }
+    return values;
+}
+
+// Reserve the network's VNI, or allocate one if it has none. Sets errno
+// to EEXIST when the VNI is taken and ENOSPC when none is free.
+static bool claim_vni(vxlan_network_t* network) {
+    if (network->vni == 0) {
+        network->vni = vni_allocate();
+        if (network->vni == 0) {
+            LOG_ERROR_FMT("No free VNI left");
+            errno = ENOSPC;
+            return false;
+        }
+        return true;
+    }
+    if (!vni_reserve(network->vni)) {
+        LOG_DEBUG_FMT("VNI %u is already in use", network->vni);
+        errno = EEXIST;
+        return false;
+    }
+    return true;
+}
+
+// Give back a VNI claimed by a save that then failed
+static void unclaim_vni(vxlan_network_t* network, uint32_t requested) {
+    vni_release(network->vni);
+    network->vni = requested;
 }
 
 // Save network to storage
 bool storage_save_network(vxlan_network_t* network) {
-    if (!network || !network->id) return false;
+    if (!network) return false;
 
-    unsigned int h = hash(network->id);
-    hash_entry_t* entry = malloc(sizeof(hash_entry_t));
+    // The VNI is claimed before the network becomes visible, so concurrent
+    // creates can never end up sharing one
+    uint32_t requested = network->vni;
+    bool claimed = !atomic_load(&recovering);
+    if (claimed && !claim_vni(network)) {
+        return false;
+    }
+
+    storage_shard_t* shard = shard_for(&network->id);
+    hash_entry_t* entry = entry_new(shard, &network->id, network, sizeof(network_entry_t));
     if (!entry) {
         LOG_ERROR_FMT("Failed to allocate memory for network entry");
+        if (claimed) unclaim_vni(network, requested);
+        return false;
+    }
+    // A new network has no endpoints: its list shares its version
+    network->version = next_version();
+    atomic_init(&((network_entry_t*)entry)->endpoints_version, network->version);
+
+    log_record_t rec;
+    bool logged = atomic_load(&logging);
+    if (logged && !encode_network(&rec, network)) {
+        LOG_ERROR_FMT("Failed to allocate memory for network log record");
+        slab_free(shard->slab, entry, sizeof(network_entry_t));
+        if (claimed) unclaim_vni(network, requested);
         return false;
     }
 
-    entry->key = strdup(network->id);
-    entry->value = network;
-    entry->next = NULL;
+    // Set before the network is visible, so no tenant listing misses it
+    if (shard != tenant_shard(network->tenant_id)) {
+        atomic_store(&stray_networks, true);
+    }
+    bool saved = table_insert(shard, &shard->networks, entry, interned_key(&network->tenant_id),
+                              logged ? &rec : NULL);
+    if (logged) {
+        wal_sync(rec.lsn);
+        log_record_free(&rec);
+    }
+    if (!saved) {
+        LOG_ERROR_FMT("Failed to index network");
+        slab_free(shard->slab, entry, sizeof(network_entry_t));
+        if (claimed) unclaim_vni(network, requested);
+        return false;
+    }
 
-    pthread_mutex_lock(&networks_table.mutex);
-    entry->next = networks_table.entries[h];
-    networks_table.entries[h] = entry;
-    pthread_mutex_unlock(&networks_table.mutex);
+    char id[VXLAN_UUID_STR_SIZE];
+    vxlan_uuid_format(&network->id, id);
+    LOG_DEBUG_FMT("Saved network %s", id);
 
-    LOG_DEBUG_FMT("Saved network %s", network->id);
     return true;
 }
 
 // Get network from storage
-vxlan_network_t* storage_get_network(const char* network_id) {
+vxlan_network_t* storage_get_network(const vxlan_uuid_t* network_id) {
     if (!network_id) return NULL;
 
-    unsigned int h = hash(network_id);
+    unsigned int h = id_hash(network_id->bytes);
+    storage_stripe_t* stripe = STRIPE_FOR(shard_for(network_id)->networks.entries, h);
     vxlan_network_t* network = NULL;
 
-    pthread_mutex_lock(&networks_table.mutex);
-    hash_entry_t* entry = networks_table.entries[h];
-    while (entry) {
-        if (strcmp(entry->key, network_id) == 0) {
-            network = (vxlan_network_t*)entry->value;
-            break;
-        }
-        entry = entry->next;
+    epoch_enter();
+    hash_entry_t* entry = (hash_entry_t*)id_table_find(&stripe->table, network_id->bytes, h);
+    if (entry) {
+        network = (vxlan_network_t*)entry->value;
     }
-    pthread_mutex_unlock(&networks_table.mutex);
+    epoch_exit();
 
     return network;
 }
 
-// Delete network from storage
-bool storage_delete_network(const char* network_id) {
+// Delete a network and every endpoint in it as one operation, in
+// O(endpoints in the network). Under the network's endpoint index lock the
+// members are claimed, committed with the network under one sequence
+// number, so no listing sees part of the delete, and unlinked from the
+// index and address lookups; each is then dropped from its own primary
+// stripe. One log record covers it all and replays as the same cascade.
+// Entries of the endpoints, then the network, are returned in *removed
+// (free()) for the caller to retire.
+static bool delete_network(storage_shard_t* shard, const vxlan_uuid_t* network_id, hash_entry_t*** removed,
+                           int* count, bool* retain) {
+    unsigned int h = id_hash(network_id->bytes);
+    storage_stripe_t* stripe = STRIPE_FOR(shard->networks.entries, h);
+    index_key_t index_key = uuid_key(network_id);
+    index_stripe_t* index = STRIPE_FOR(shard->endpoints.index, index_key.hash);
+
+    *removed = NULL;
+    *count = 0;
+    log_record_t rec = { .lsn = 0 };
+    pthread_mutex_lock(&stripe->lock);
+    hash_entry_t* entry = (hash_entry_t*)id_table_find(&stripe->table, network_id->bytes, h);
+    // Replay also clears endpoints left behind by a network the snapshot
+    // no longer held
+    if (!entry && !atomic_load(&recovering)) {
+        pthread_mutex_unlock(&stripe->lock);
+        return false;
+    }
+    pthread_rwlock_wrlock(&index->lock);
+    index_set_t* set = index_find(&index->table, &index_key);
+    int endpoints = set ? set->count : 0;
+    hash_entry_t** entries = malloc((endpoints + 1) * sizeof(hash_entry_t*));
+    mvcc_stamp_t** stamps = malloc((endpoints + 1) * sizeof(mvcc_stamp_t*));
+    if (!entries || !stamps) {
+        pthread_rwlock_unlock(&index->lock);
+        pthread_mutex_unlock(&stripe->lock);
+        free(entries);
+        free(stamps);
+        LOG_ERROR_FMT("Failed to allocate memory for network delete");
+        return false;
+    }
+
+    // A member whose own delete has claimed it already is left to that
+    int n = 0;
+    for (tree_node_t* node = set ? tree_first(&set->members) : NULL; node; node = tree_next(node)) {
+        hash_entry_t* member = ENTRY_OF(node, hash_entry_t, set_node);
+        if (mvcc_claim_delete(&member->stamp)) {
+            entries[n] = member;
+            stamps[n++] = &member->stamp;
+        }
+    }
+    int claimed = n;
+    if (entry && mvcc_claim_delete(&entry->stamp)) {
+        entries[n] = entry;
+        stamps[claimed++] = &entry->stamp;
+    }
+    *retain = mvcc_needed(mvcc_commit_claimed(stamps, claimed));
+    free(stamps);
+    if (set && n == endpoints && !*retain) {
+        // The set goes as a whole, with its member tree and address indexes
+        hash_table_remove(&index->table, &set->node);
+        epoch_retire(set, free_index_set_deferred);
+    } else {
+        for (int i = 0; i < n; i++) {
+            index_remove(&index->table, entries[i], *retain);
+        }
+    }
+    // Unlinked before the index unlocks, so a save indexed after this
+    // finds the network gone
+    if (entry) {
+        table_remove(shard, &shard->networks, stripe, entry, *retain);
+    }
+    pthread_rwlock_unlock(&index->lock);
+
+    // Endpoint writers lock their primary stripe before the index, so
+    // each stripe is taken here on its own
+    for (int i = 0; i < n; i++) {
+        storage_stripe_t* primary = STRIPE_FOR(shard->endpoints.entries, entries[i]->node.hash);
+        pthread_mutex_lock(&primary->lock);
+        id_table_remove(&primary->table, &entries[i]->node);
+        pthread_mutex_unlock(&primary->lock);
+    }
+
+    // Every save of a member has left its stripe by now, so none of its
+    // changes or FDB updates can come after these. Watchers and host
+    // agents take the network's delete as that of its endpoints.
+    if (!atomic_load(&recovering)) {
+        fdb_network_deleted(network_id);
+    }
+    if (entry) {
+        publish_change(&shard->networks, entry, false);
+        if (atomic_load(&logging)) {
+            encode_delete(&rec, LOG_NETWORK_DELETE, network_id);
+            log_append(&rec);
+        }
+        // Released after the delete is logged, so a network that reuses
+        // the VNI is always logged after this one is gone
+        vni_release(((vxlan_network_t*)entry->value)->vni);
+    }
+    pthread_mutex_unlock(&stripe->lock);
+
+    wal_sync(rec.lsn);
+    *removed = entries;
+    *count = claimed;
+    return entry != NULL;
+}
+
+// Endpoint entries removed together, retired as one
+typedef struct {
+    int count;
+    hash_entry_t* entries[];
+} entry_batch_t;
+
+static void free_entry_batch_deferred(void* ptr) {
+    entry_batch_t* batch = (entry_batch_t*)ptr;
+    for (int i = 0; i < batch->count; i++) {
+        free_endpoint_entry(&batch->entries[i]->node, NULL);
+    }
+    free(batch);
+}
+
+// Retire (or retain) the entries removed by delete_network(); the network's
+// entry, if network, is the last
+static void retire_removed(storage_shard_t* shard, hash_entry_t** entries, int count, bool network, bool retain) {
+    int endpoints = network ? count - 1 : count;
+    entry_batch_t* batch = !retain && endpoints > 1
+        ? malloc(sizeof(entry_batch_t) + endpoints * sizeof(hash_entry_t*)) : NULL;
+    if (batch) {
+        batch->count = endpoints;
+        memcpy(batch->entries, entries, endpoints * sizeof(hash_entry_t*));
+        epoch_retire(batch, free_entry_batch_deferred);
+    }
+    for (int i = batch ? endpoints : 0; i < count; i++) {
+        bool is_network = network && i == count - 1;
+        if (retain) {
+            retain_entry(shard, entries[i], is_network);
+        } else {
+            epoch_retire(entries[i], is_network ? free_network_entry_deferred : free_endpoint_entry_deferred);
+        }
+    }
+    release_retained(shard);
+}
+
+// Delete network from storage, together with its endpoints
+bool storage_delete_network(const vxlan_uuid_t* network_id) {
+    return storage_delete_network_endpoints(network_id, NULL, NULL, NULL);
+}
+
+// Delete a network with its endpoints, returning the deleted records
+bool storage_delete_network_endpoints(const vxlan_uuid_t* network_id, vxlan_network_t** network,
+                                      vxlan_endpoint_t*** endpoints, int* count) {
     if (!network_id) return false;
 
-    unsigned int h = hash(network_id);
-    bool found = false;
+    storage_shard_t* shard = shard_for(network_id);
+    hash_entry_t** entries;
+    int removed;
+    bool retain;
+    bool deleted = delete_network(shard, network_id, &entries, &removed, &retain);
+    if (!entries) return false;
 
-    pthread_mutex_lock(&networks_table.mutex);
-    hash_entry_t* entry = networks_table.entries[h];
-    hash_entry_t* prev = NULL;
+    retire_removed(shard, entries, removed, deleted, retain);
+    int members = deleted ? removed - 1 : removed;
+    if (!deleted) {
+        free(entries);
+        return false;
+    }
+    if (network) {
+        *network = (vxlan_network_t*)entries[members]->value;
+    }
+    if (endpoints) {
+        // Still valid in the caller's read section
+        for (int i = 0; i < members; i++) {
+            entries[i] = entries[i]->value;
+        }
+        *endpoints = (vxlan_endpoint_t**)entries;
+        *count = members;
+    } else {
+        free(entries);
+    }
 
-    while (entry) {
-        if (strcmp(entry->key, network_id) == 0) {
-            if (prev) {
-                prev->next = entry->next;
-            } else {
-                networks_table.entries[h] = entry->next;
-            }
-            vxlan_network_t* network = (vxlan_network_t*)entry->value;
-            vxlan_free_network(network);
-            free(entry->key);
-            free(entry);
-            found = true;
-            break;
+    char id[VXLAN_UUID_STR_SIZE];
+    vxlan_uuid_format(network_id, id);
+    LOG_DEBUG_FMT("Deleted network %s with %d endpoints", id, members);
+    return deleted;
+}
+
+// List the networks of every shard, or those of one tenant (interned) in
+// any shard, merged at a single snapshot
+static vxlan_network_t** list_all_networks(const char* const* tenant, int* count) {
+    index_key_t index_key = tenant ? interned_key(tenant) : (index_key_t){ NULL, 0, 0 };
+    collect_ctx_t collect = { NULL, 0, 0, false };
+
+    epoch_enter();
+    uint64_t snapshot = mvcc_begin();
+    for (unsigned i = 0; i <= shard_mask; i++) {
+        if (tenant) {
+            collect_set(&shards[i].networks, &index_key, snapshot, &collect);
+        } else {
+            collect_versions(&shards[i].all_networks, offsetof(network_entry_t, all_version), snapshot, &collect);
         }
-        prev = entry;
-        entry = entry->next;
     }
-    pthread_mutex_unlock(&networks_table.mutex);
+    mvcc_end();
+    epoch_exit();
 
-    if (found) {
-        LOG_DEBUG_FMT("Deleted network %s", network_id);
+    for (unsigned i = 0; i <= shard_mask; i++) {
+        release_retained(&shards[i]);
     }
-    return found;
+    return (vxlan_network_t**)collect_finish(&collect, count);
 }
 
-// List networks
+// List networks, via the tenant_id index when filtering by tenant
 vxlan_network_t** storage_list_networks(const char* tenant_id, int* count) {
     *count = 0;
-    vxlan_network_t** networks = NULL;
-    int capacity = 0;
-
-    pthread_mutex_lock(&networks_table.mutex);
-    for (int i = 0; i < HASH_SIZE; i++) {
-        hash_entry_t* entry = networks_table.entries[i];
-        while (entry) {
-            vxlan_network_t* network = (vxlan_network_t*)entry->value;
-            if (!tenant_id || strcmp(network->tenant_id, tenant_id) == 0) {
-                if (*count >= capacity) {
-                    capacity = capacity == 0 ? 16 : capacity * 2;
-                    networks = realloc(networks, capacity * sizeof(vxlan_network_t*));
-                    if (!networks) {
-                        pthread_mutex_unlock(&networks_table.mutex);
-                        return NULL;
-                    }
-                }
-                networks[(*count)++] = network;
+
+    if (!tenant_id) {
+        // Walks each shard's version list of networks, without locks
+        return list_all_networks(NULL, count);
+    }
+
+    // A tenant that was never interned has no networks
+    const char* tenant = intern_find_string(tenant_id);
+    if (!tenant) {
+        return malloc(sizeof(vxlan_network_t*));
+    }
+    if (atomic_load(&stray_networks)) {
+        return list_all_networks(&tenant, count);
+    }
+    storage_shard_t* shard = tenant_shard(tenant);
+    return (vxlan_network_t**)index_collect(shard, &shard->networks, interned_key(&tenant), count);
+}
+
+// List one page of networks in id order
+vxlan_network_t** storage_list_networks_page(const char* tenant_id, const vxlan_uuid_t* after, int limit,
+                                             int* count) {
+    *count = 0;
+    if (limit < 1) return NULL;
+
+    unsigned n = shard_mask + 1;
+    if (tenant_id) {
+        const char* tenant = intern_find_string(tenant_id);
+        if (!tenant) {
+            return malloc(sizeof(vxlan_network_t*));
+        }
+        storage_table_t* tables[STORAGE_MAX_SHARDS];
+        if (atomic_load(&stray_networks)) {
+            for (unsigned i = 0; i < n; i++) {
+                tables[i] = &shards[i].networks;
             }
-            entry = entry->next;
+        } else {
+            tables[0] = &tenant_shard(tenant)->networks;
+            n = 1;
         }
+        return (vxlan_network_t**)index_page(tables, (int)n, interned_key(&tenant), after, limit, count);
     }
-    pthread_mutex_unlock(&networks_table.mutex);
 
-    return networks;
+    // Shards are read-locked in order; writers only ever hold one of them
+    const tree_t* trees[STORAGE_MAX_SHARDS] = { NULL };
+    for (unsigned i = 0; i < n; i++) {
+        pthread_rwlock_rdlock(&shards[i].network_index_lock);
+        trees[i] = &shards[i].networks_by_id;
+    }
+    void** values = tree_page(trees, (int)n, offsetof(network_entry_t, all_node), after, limit, count);
+    for (unsigned i = 0; i < n; i++) {
+        pthread_rwlock_unlock(&shards[i].network_index_lock);
+    }
+    return (vxlan_network_t**)values;
 }
 
 // Save endpoint to storage
 bool storage_save_endpoint(vxlan_endpoint_t* endpoint) {
-    if (!endpoint || !endpoint->id) return false;
+    if (!endpoint) return false;
 
-    unsigned int h = hash(endpoint->id);
-    hash_entry_t* entry = malloc(sizeof(hash_entry_t));
+    storage_shard_t* shard = shard_for(&endpoint->network_id);
+    hash_entry_t* entry = entry_new(shard, &endpoint->id, endpoint, sizeof(endpoint_entry_t));
     if (!entry) {
         LOG_ERROR_FMT("Failed to allocate memory for endpoint entry");
         return false;
     }
+    endpoint->version = next_version();
+
+    log_record_t rec;
+    bool logged = atomic_load(&logging);
+    if (logged && !encode_endpoint(&rec, endpoint)) {
+        LOG_ERROR_FMT("Failed to allocate memory for endpoint log record");
+        slab_free(shard->slab, entry, sizeof(endpoint_entry_t));
+        return false;
+    }
 
-    entry->key = strdup(endpoint->id);
-    entry->value = endpoint;
-    entry->next = NULL;
+    // Set before the endpoint is visible, so no lookup by id alone misses it
+    if (shard != shard_for(&endpoint->id)) {
+        atomic_store(&stray_endpoints, true);
+    }
+    bool saved = table_insert(shard, &shard->endpoints, entry, uuid_key(&endpoint->network_id),
+                              logged ? &rec : NULL);
+    int reason = saved ? 0 : errno;
+    if (logged) {
+        wal_sync(rec.lsn);
+        log_record_free(&rec);
+    }
+    if (!saved) {
+        if (reason == EEXIST) {
+            LOG_DEBUG_FMT("Endpoint MAC or IP address already in use in its network");
+        } else if (reason == ENOENT) {
+            LOG_DEBUG_FMT("Endpoint network not found");
+        } else {
+            LOG_ERROR_FMT("Failed to index endpoint");
+        }
+        slab_free(shard->slab, entry, sizeof(endpoint_entry_t));
+        errno = reason;
+        return false;
+    }
 
-    pthread_mutex_lock(&endpoints_table.mutex);
-    entry->next = endpoints_table.entries[h];
-    endpoints_table.entries[h] = entry;
-    pthread_mutex_unlock(&endpoints_table.mutex);
+    char id[VXLAN_UUID_STR_SIZE];
+    vxlan_uuid_format(&endpoint->id, id);
+    LOG_DEBUG_FMT("Saved endpoint %s", id);
 
-    LOG_DEBUG_FMT("Saved endpoint %s", endpoint->id);
     return true;
 }
 
+// Find an endpoint entry in its stripe, optionally requiring it to belong
+// to network_id. The caller holds the stripe lock or is inside an epoch.
+static hash_entry_t* find_endpoint_entry(storage_stripe_t* stripe, const vxlan_uuid_t* network_id,
+                                         const vxlan_uuid_t* endpoint_id, unsigned int h) {
+    hash_entry_t* entry = (hash_entry_t*)id_table_find(&stripe->table, endpoint_id->bytes, h);
+    // Claimed by a network delete that has yet to unlink it
+    if (entry && mvcc_deleted(&entry->stamp)) {
+        return NULL;
+    }
+    if (entry && network_id &&
+        memcmp(&((vxlan_endpoint_t*)entry->value)->network_id, network_id, sizeof(*network_id)) != 0) {
+        return NULL;
+    }
+    return entry;
+}
+
+// The attempt-th shard an endpoint may be in, NULL after the last: its
+// network's when network_id is given, else the one its id is tagged with,
+// followed by the others once an endpoint was stored outside its tag's
+static storage_shard_t* endpoint_shard(const vxlan_uuid_t* network_id, const vxlan_uuid_t* endpoint_id,
+                                       unsigned attempt) {
+    if (network_id) {
+        return attempt == 0 ? shard_for(network_id) : NULL;
+    }
+    if (attempt > shard_mask || (attempt > 0 && !atomic_load(&stray_endpoints))) {
+        return NULL;
+    }
+    return &shards[(endpoint_id->bytes[VXLAN_UUID_TAG_BYTE] + attempt) & shard_mask];
+}
+
 // Get endpoint from storage
-vxlan_endpoint_t* storage_get_endpoint(const char* network_id, const char* endpoint_id) {
+vxlan_endpoint_t* storage_get_endpoint(const vxlan_uuid_t* network_id, const vxlan_uuid_t* endpoint_id) {
     if (!endpoint_id) return NULL;
 
-    unsigned int h = hash(endpoint_id);
+    unsigned int h = id_hash(endpoint_id->bytes);
     vxlan_endpoint_t* endpoint = NULL;
+    storage_shard_t* shard;
 
-    pthread_mutex_lock(&endpoints_table.mutex);
-    hash_entry_t* entry = endpoints_table.entries[h];
-    while (entry) {
-        endpoint = (vxlan_endpoint_t*)entry->value;
-        if (strcmp(entry->key, endpoint_id) == 0 &&
-            (!network_id || strcmp(endpoint->network_id, network_id) == 0)) {
-            break;
+    epoch_enter();
+    for (unsigned attempt = 0; !endpoint && (shard = endpoint_shard(network_id, endpoint_id, attempt)); attempt++) {
+        storage_stripe_t* stripe = STRIPE_FOR(shard->endpoints.entries, h);
+        hash_entry_t* entry = find_endpoint_entry(stripe, network_id, endpoint_id, h);
+        if (entry) {
+            endpoint = (vxlan_endpoint_t*)entry->value;
         }
-        endpoint = NULL;
-        entry = entry->next;
     }
-    pthread_mutex_unlock(&endpoints_table.mutex);
+    epoch_exit();
 
     return endpoint;
 }
 
+// Find the endpoint with a MAC or IP address through a network's address
+// indexes. Lock-free: the caller is inside an epoch, and index sets,
+// address tables and entries are all retired through it.
+static vxlan_endpoint_t* find_endpoint_by_address(const vxlan_uuid_t* network_id,
+                                                  const vxlan_mac_t* mac, const vxlan_ip_t* ip) {
+    index_key_t key = uuid_key(network_id);
+    index_stripe_t* index = STRIPE_FOR(shard_for(network_id)->endpoints.index, key.hash);
+    index_set_t* set = index_find(&index->table, &key);
+    if (!set || !set->addresses) return NULL;
+
+    endpoint_entry_t* entry = mac ? find_by_mac(set->addresses, mac) : find_by_ip(set->addresses, ip);
+    return entry ? (vxlan_endpoint_t*)entry->entry.value : NULL;
+}
+
+// Find the endpoint with a MAC address in a network
+vxlan_endpoint_t* storage_find_endpoint_by_mac(const vxlan_uuid_t* network_id, const vxlan_mac_t* mac) {
+    if (!network_id || !mac) return NULL;
+    epoch_enter();
+    vxlan_endpoint_t* endpoint = find_endpoint_by_address(network_id, mac, NULL);
+    epoch_exit();
+    return endpoint;
+}
+
+// Find the endpoint with an IP address in a network
+vxlan_endpoint_t* storage_find_endpoint_by_ip(const vxlan_uuid_t* network_id, const vxlan_ip_t* ip) {
+    if (!network_id || !ip) return NULL;
+    epoch_enter();
+    vxlan_endpoint_t* endpoint = find_endpoint_by_address(network_id, NULL, ip);
+    epoch_exit();
+    return endpoint;
+}
+
+// Find a network by VNI; the caller is inside an epoch
+static vxlan_network_t* find_network_by_vni(uint32_t vni) {
+    hash_node_t* node = hash_table_find(&networks_by_vni, &vni, sizeof(vni), hash_bytes(&vni, sizeof(vni)));
+    if (!node) return NULL;
+    network_entry_t* entry = (network_entry_t*)((char*)node - offsetof(network_entry_t, vni_node));
+    return (vxlan_network_t*)entry->entry.value;
+}
+
+// Get the network with a VNI
+vxlan_network_t* storage_get_network_by_vni(uint32_t vni) {
+    epoch_enter();
+    vxlan_network_t* network = find_network_by_vni(vni);
+    epoch_exit();
+    return network;
+}
+
+// Find the endpoint with a MAC or IP address in the network with a VNI
+static vxlan_endpoint_t* lookup_address(uint32_t vni, const vxlan_mac_t* mac, const vxlan_ip_t* ip) {
+    epoch_enter();
+    vxlan_network_t* network = find_network_by_vni(vni);
+    vxlan_endpoint_t* endpoint = network ? find_endpoint_by_address(&network->id, mac, ip) : NULL;
+    epoch_exit();
+    return endpoint;
+}
+
+// Find the endpoint with a MAC address in the network with a VNI
+vxlan_endpoint_t* storage_lookup_mac(uint32_t vni, const vxlan_mac_t* mac) {
+    if (!mac) return NULL;
+    return lookup_address(vni, mac, NULL);
+}
+
+// Find the endpoint with an IP address in the network with a VNI
+vxlan_endpoint_t* storage_lookup_ip(uint32_t vni, const vxlan_ip_t* ip) {
+    if (!ip) return NULL;
+    return lookup_address(vni, NULL, ip);
+}
+
+// Version of a network's endpoint list
+uint64_t storage_endpoints_version(const vxlan_uuid_t* network_id) {
+    if (!network_id) return 0;
+
+    unsigned int h = id_hash(network_id->bytes);
+    storage_stripe_t* stripe = STRIPE_FOR(shard_for(network_id)->networks.entries, h);
+    uint64_t version = 0;
+
+    epoch_enter();
+    hash_entry_t* entry = (hash_entry_t*)id_table_find(&stripe->table, network_id->bytes, h);
+    if (entry) {
+        version = atomic_load(&((network_entry_t*)entry)->endpoints_version);
+    }
+    epoch_exit();
+    return version;
+}
+
 // Delete endpoint from storage
-bool storage_delete_endpoint(const char* network_id, const char* endpoint_id) {
+bool storage_delete_endpoint(const vxlan_uuid_t* network_id, const vxlan_uuid_t* endpoint_id) {
     if (!endpoint_id) return false;
 
-    unsigned int h = hash(endpoint_id);
-    bool found = false;
-
-    pthread_mutex_lock(&endpoints_table.mutex);
-    hash_entry_t* entry = endpoints_table.entries[h];
-    hash_entry_t* prev = NULL;
-
-    while (entry) {
-        vxlan_endpoint_t* endpoint = (vxlan_endpoint_t*)entry->value;
-        if (strcmp(entry->key, endpoint_id) == 0 &&
-            (!network_id || strcmp(endpoint->network_id, network_id) == 0)) {
-            if (prev) {
-                prev->next = entry->next;
-            } else {
-                endpoints_table.entries[h] = entry->next;
+    unsigned int h = id_hash(endpoint_id->bytes);
+    log_record_t rec = { .lsn = 0 };
+    hash_entry_t* entry = NULL;
+    bool retain = false;
+    storage_shard_t* shard;
+
+    for (unsigned attempt = 0; (shard = endpoint_shard(network_id, endpoint_id, attempt)); attempt++) {
+        storage_stripe_t* stripe = STRIPE_FOR(shard->endpoints.entries, h);
+        pthread_mutex_lock(&stripe->lock);
+        entry = find_endpoint_entry(stripe, network_id, endpoint_id, h);
+        if (entry && !table_unlink(shard, &shard->endpoints, stripe, entry, &retain)) {
+            entry = NULL;
+        }
+        if (entry) {
+            if (atomic_load(&logging)) {
+                encode_delete(&rec, LOG_ENDPOINT_DELETE, endpoint_id);
+                log_append(&rec);
             }
-            vxlan_free_endpoint(endpoint);
-            free(entry->key);
-            free(entry);
-            found = true;
-            break;
         }
-        prev = entry;
-        entry = entry->next;
+        pthread_mutex_unlock(&stripe->lock);
+        if (entry) break;
     }
-    pthread_mutex_unlock(&endpoints_table.mutex);
 
-    if (found) {
-        LOG_DEBUG_FMT("Deleted endpoint %s", endpoint_id);
+    if (!entry) return false;
+
+    wal_sync(rec.lsn);
+    if (retain) {
+        retain_entry(shard, entry, false);
+    } else {
+        epoch_retire(entry, free_endpoint_entry_deferred);
     }
-    return found;
+    release_retained(shard);
+
+    char id[VXLAN_UUID_STR_SIZE];
+    vxlan_uuid_format(endpoint_id, id);
+    LOG_DEBUG_FMT("Deleted endpoint %s", id);
+    return true;
 }
 
-// List endpoints
-vxlan_endpoint_t** storage_list_endpoints(const char* network_id, int* count) {
+// List endpoints of a network via the network_id index, O(endpoints in network)
+vxlan_endpoint_t** storage_list_endpoints(const vxlan_uuid_t* network_id, int* count) {
     if (!network_id) return NULL;
 
     *count = 0;
-    vxlan_endpoint_t** endpoints = NULL;
-    int capacity = 0;
-
-    pthread_mutex_lock(&endpoints_table.mutex);
-    for (int i = 0; i < HASH_SIZE; i++) {
-        hash_entry_t* entry = endpoints_table.entries[i];
-        while (entry) {
-            vxlan_endpoint_t* endpoint = (vxlan_endpoint_t*)entry->value;
-            if (strcmp(endpoint->network_id, network_id) == 0) {
-                if (*count >= capacity) {
-                    capacity = capacity == 0 ? 16 : capacity * 2;
-                    endpoints = realloc(endpoints, capacity * sizeof(vxlan_endpoint_t*));
-                    if (!endpoints) {
-                        pthread_mutex_unlock(&endpoints_table.mutex);
-                        return NULL;
-                    }
-                }
-                endpoints[(*count)++] = endpoint;
+    storage_shard_t* shard = shard_for(network_id);
+    return (vxlan_endpoint_t**)index_collect(shard, &shard->endpoints, uuid_key(network_id), count);
+}
+
+// List one page of a network's endpoints in id order
+vxlan_endpoint_t** storage_list_endpoints_page(const vxlan_uuid_t* network_id, const vxlan_uuid_t* after,
+                                               int limit, int* count) {
+    *count = 0;
+    if (!network_id || limit < 1) return NULL;
+
+    storage_table_t* table = &shard_for(network_id)->endpoints;
+    return (vxlan_endpoint_t**)index_page(&table, 1, uuid_key(network_id), after, limit, count);
+}
+
+// Write one table to the snapshot, a section per stripe. Entries are
+// collected under the stripe lock and encoded after it is dropped; the
+// read section keeps records deleted in the meantime alive.
+static bool snapshot_table(snapshot_writer_t* writer, storage_table_t* table, bool networks) {
+    collect_ctx_t collect = { NULL, 0, 0, false };
+    bool ok = true;
+
+    for (int i = 0; i < STORAGE_STRIPES && ok; i++) {
+        storage_stripe_t* stripe = &table->entries[i];
+        collect.count = 0;
+        epoch_enter();
+        pthread_mutex_lock(&stripe->lock);
+        id_table_foreach(&stripe->table, collect_live, &collect);
+        pthread_mutex_unlock(&stripe->lock);
+
+        ok = !collect.failed && snapshot_section(writer);
+        for (int j = 0; j < collect.count && ok; j++) {
+            log_record_t rec;
+            ok = networks ? encode_network(&rec, (vxlan_network_t*)collect.values[j])
+                          : encode_endpoint(&rec, (vxlan_endpoint_t*)collect.values[j]);
+            if (ok) {
+                ok = snapshot_add(writer, rec.type, rec.payload, rec.len);
+                log_record_free(&rec);
             }
-            entry = entry->next;
         }
+        epoch_exit();
     }
-    pthread_mutex_unlock(&endpoints_table.mutex);
+    free(collect.values);
+    return ok;
+}
 
-    return endpoints;
+// Snapshot both tables and drop the log records the snapshot covers
+bool storage_snapshot(void) {
+    if (!atomic_load(&logging)) return false;
+
+    pthread_mutex_lock(&snapshot_lock);
+    // Every change up to lsn is in the tables before any stripe is visited;
+    // later changes may or may not be in the snapshot and are replayed on top
+    uint64_t lsn = wal_checkpoint();
+    if (lsn == snapshot_lsn) {
+        pthread_mutex_unlock(&snapshot_lock);
+        return true;
+    }
+
+    // Read after the checkpoint: a limit logged before lsn is compacted
+    // away, and was set before it was logged
+    snapshot_writer_t* writer = snapshot_begin(snapshot_path, lsn, changes_limit());
+    bool ok = writer != NULL;
+    if (ok) {
+        for (unsigned i = 0; ok && i <= shard_mask; i++) {
+            ok = snapshot_table(writer, &shards[i].networks, true);
+        }
+        for (unsigned i = 0; ok && i <= shard_mask; i++) {
+            ok = snapshot_table(writer, &shards[i].endpoints, false);
+        }
+        if (ok) {
+            ok = snapshot_commit(writer);
+        } else {
+            LOG_ERROR_FMT("Failed to write snapshot %s", snapshot_path);
+            snapshot_abort(writer);
+        }
+    }
+    if (ok) {
+        snapshot_lsn = lsn;
+        // The snapshot is usable either way; an uncompacted log only costs
+        // disk space and a longer seek
+        if (!wal_compact(lsn)) {
+            LOG_WARN_FMT("Snapshot written but log not compacted");
+        }
+        LOG_INFO_FMT("Wrote snapshot %s at log position %llu", snapshot_path, (unsigned long long)lsn);
+    }
+    pthread_mutex_unlock(&snapshot_lock);
+    return ok;
+}
+
+static void* snapshot_run(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&snapshotter.lock);
+    while (!snapshotter.stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += snapshotter.interval;
+        while (!snapshotter.stop &&
+               pthread_cond_timedwait(&snapshotter.wake, &snapshotter.lock, &deadline) != ETIMEDOUT) {
+        }
+        if (snapshotter.stop) break;
+
+        pthread_mutex_unlock(&snapshotter.lock);
+        storage_snapshot();
+        pthread_mutex_lock(&snapshotter.lock);
+    }
+    pthread_mutex_unlock(&snapshotter.lock);
+    return NULL;
+}
+
+// Snapshot every interval_seconds in a background thread
+bool storage_start_snapshots(unsigned interval_seconds) {
+    if (!atomic_load(&logging) || interval_seconds == 0) return false;
+
+    pthread_mutex_lock(&snapshotter.lock);
+    if (snapshotter.running) {
+        pthread_mutex_unlock(&snapshotter.lock);
+        return false;
+    }
+    snapshotter.interval = interval_seconds;
+    snapshotter.stop = false;
+    snapshotter.running = pthread_create(&snapshotter.thread, NULL, snapshot_run, NULL) == 0;
+    bool running = snapshotter.running;
+    pthread_mutex_unlock(&snapshotter.lock);
+    return running;
+}
+
+// Stop the background snapshot thread, waiting for a snapshot in progress
+static void stop_snapshots(void) {
+    pthread_mutex_lock(&snapshotter.lock);
+    if (!snapshotter.running) {
+        pthread_mutex_unlock(&snapshotter.lock);
+        return;
+    }
+    snapshotter.stop = true;
+    pthread_cond_signal(&snapshotter.wake);
+    pthread_mutex_unlock(&snapshotter.lock);
+
+    pthread_join(snapshotter.thread, NULL);
+    snapshotter.running = false;
+}
+
+// Copy the changes after since, waiting up to timeout_ms for one
+bool storage_watch(uint64_t since, const vxlan_uuid_t* network_id, int timeout_ms, change_t* changes, int max,
+                   int* count, uint64_t* next) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;) {
+        if (!changes_read(since, network_id, changes, max, count, next)) return false;
+        if (*count > 0) return true;
+
+        // Changes of other networks only move the position forward
+        since = *next;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (elapsed_ms >= timeout_ms) return true;
+        changes_wait(since, (int)(timeout_ms - elapsed_ms));
+    }
+}
+
+// Sequence number of the last published change
+uint64_t storage_changes_last(void) {
+    return changes_last();
 }
 
 // Free network array
@@ -328,4 +2164,4 @@ void storage_free_network_array(vxlan_network_t** networks, int count) {
 void storage_free_endpoint_array(vxlan_endpoint_t** endpoints, int count) {
     if (!endpoints) return;
     free(endpoints);
-} 
\ No newline at end of file
+}
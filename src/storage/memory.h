@@ -3,24 +3,108 @@
 
 #include <stdbool.h>
 #include "../network/vxlan.h"
+#include "changes.h"
+#include "wal.h"
 
-// Initialize storage system
+// Sharding. Records live in one of a power-of-two number of shards, each
+// with its own tables, locks and entry allocator. A network goes to the
+// shard of its tenant (by the tag in its id, see vxlan.h) and an endpoint
+// to its network's, so writes to different tenants never contend. Lookups
+// by id go straight to one shard; listings across tenants merge every
+// shard at one snapshot.
+#define STORAGE_DEFAULT_SHARDS 8
+#define STORAGE_MAX_SHARDS 256
+
+// Initialize storage system with STORAGE_DEFAULT_SHARDS shards
 bool storage_init(void);
 
+// Initialize storage system with count shards (a power of two up to
+// STORAGE_MAX_SHARDS); fails with errno EINVAL otherwise
+bool storage_init_shards(unsigned count);
+
 // Clean up storage resources
 void storage_cleanup(void);
 
-// Network storage functions
+// Durability. Loads the snapshot at <path>.snap, replays the write-ahead
+// log at path from the snapshot's position on, then appends every later
+// save and delete to the log; saves and deletes return once their record
+// is durable per mode. Call once, after storage_init().
+bool storage_open_log(const char* path, wal_sync_mode_t mode);
+
+// Write a snapshot of both tables to <path>.snap and drop the log records
+// it covers. Readers and writers keep running: each stripe is locked only
+// while its entries are collected. Needs storage_open_log().
+bool storage_snapshot(void);
+
+// Call storage_snapshot() every interval_seconds from a background thread
+// until storage_cleanup()
+bool storage_start_snapshots(unsigned interval_seconds);
+
+// Read sections. Lookups and listings take no lock; a deleted record is
+// freed only once no read section that could have seen it is still open.
+// Wrap every use of a returned record (e.g. serializing it) in
+// storage_read_begin()/storage_read_end(). Sections nest.
+void storage_read_begin(void);
+void storage_read_end(void);
+
+// Network storage functions. Saving claims the network's VNI, or
+// allocates the next free one when vni is 0; it fails with errno EEXIST
+// when another network has the VNI and ENOSPC when none is free. Saving a
+// network or an endpoint sets the record's version.
 bool storage_save_network(vxlan_network_t* network);
-vxlan_network_t* storage_get_network(const char* network_id);
-bool storage_delete_network(const char* network_id);
+vxlan_network_t* storage_get_network(const vxlan_uuid_t* network_id);
+// Deleting a network also deletes all of its endpoints, as one operation
+// in O(endpoints in the network): listings see them all go at once, and
+// the change feed publishes only the network's delete.
+bool storage_delete_network(const vxlan_uuid_t* network_id);
+// Same, also returning the deleted network and endpoints for teardown.
+// They stay valid until storage_read_end(), so call it in a read section;
+// free the array with storage_free_endpoint_array().
+bool storage_delete_network_endpoints(const vxlan_uuid_t* network_id, vxlan_network_t** network,
+                                      vxlan_endpoint_t*** endpoints, int* count);
 vxlan_network_t** storage_list_networks(const char* tenant_id, int* count);
 
-// Endpoint storage functions
+// Endpoint storage functions. Saving fails with errno EEXIST when another
+// endpoint in the network has the same MAC or IP address, and ENOENT when
+// the network is not stored (or is deleted concurrently).
 bool storage_save_endpoint(vxlan_endpoint_t* endpoint);
-vxlan_endpoint_t* storage_get_endpoint(const char* network_id, const char* endpoint_id);
-bool storage_delete_endpoint(const char* network_id, const char* endpoint_id);
-vxlan_endpoint_t** storage_list_endpoints(const char* network_id, int* count);
+// network_id may be NULL in get/delete to match an endpoint in any network
+vxlan_endpoint_t* storage_get_endpoint(const vxlan_uuid_t* network_id, const vxlan_uuid_t* endpoint_id);
+// Find the endpoint holding an address within a network, in O(1)
+vxlan_endpoint_t* storage_find_endpoint_by_mac(const vxlan_uuid_t* network_id, const vxlan_mac_t* mac);
+vxlan_endpoint_t* storage_find_endpoint_by_ip(const vxlan_uuid_t* network_id, const vxlan_ip_t* ip);
+// Address lookups by VNI, for address-learning agents. Lock-free: they
+// only enter an epoch, so they never wait on writers.
+vxlan_network_t* storage_get_network_by_vni(uint32_t vni);
+vxlan_endpoint_t* storage_lookup_mac(uint32_t vni, const vxlan_mac_t* mac);
+vxlan_endpoint_t* storage_lookup_ip(uint32_t vni, const vxlan_ip_t* ip);
+bool storage_delete_endpoint(const vxlan_uuid_t* network_id, const vxlan_uuid_t* endpoint_id);
+vxlan_endpoint_t** storage_list_endpoints(const vxlan_uuid_t* network_id, int* count);
+// Version of a network's endpoint list, 0 if the network is not stored. It
+// changes with every save and delete of one of its endpoints, once listings
+// show it, so a listing read after taking it is at least that recent.
+uint64_t storage_endpoints_version(const vxlan_uuid_t* network_id);
+
+// Paged listings, in record id order: up to limit (> 0) records whose ids
+// come after after, or from the first one when after is NULL. Pass the id
+// of the last record of a page to get the next one. A page costs
+// O(log n + limit) and holds one index lock while it is copied; records
+// added or deleted between pages never shift the ones not yet returned.
+vxlan_network_t** storage_list_networks_page(const char* tenant_id, const vxlan_uuid_t* after, int limit,
+                                             int* count);
+vxlan_endpoint_t** storage_list_endpoints_page(const vxlan_uuid_t* network_id, const vxlan_uuid_t* after,
+                                               int limit, int* count);
+
+// Change feed. Every save and delete is published with the next sequence
+// number; storage_watch() copies up to max changes after since (only those
+// of network_id unless it is NULL), waiting up to timeout_ms for one to
+// arrive. *next is the sequence to watch from next. Fails with errno ERANGE
+// when since is older than the changes still kept, or from before a
+// restart: list the current state again and watch from
+// storage_changes_last() taken before the listing.
+bool storage_watch(uint64_t since, const vxlan_uuid_t* network_id, int timeout_ms, change_t* changes, int max,
+                   int* count, uint64_t* next);
+uint64_t storage_changes_last(void);
 
 // Helper functions
 void storage_free_network_array(vxlan_network_t** networks, int count);
@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include "mvcc.h"
+#include "../utils/logging.h"
+
+// Stamp markers. A record is linked UNCOMMITTED, and a commit moves the
+// stamp to PENDING before taking its sequence number, so a reader that
+// sees UNCOMMITTED knows the commit is later than its snapshot and one that
+// sees PENDING waits the few instructions until the number is stored.
+#define MVCC_UNCOMMITTED UINT64_MAX
+#define MVCC_LIVE UINT64_MAX
+#define MVCC_PENDING (UINT64_MAX - 1)
+// Snapshot slot of a thread that has none open
+#define MVCC_IDLE UINT64_MAX
+
+// Per-thread snapshot; records are never freed, only recycled when a thread exits
+typedef struct mvcc_thread {
+    _Atomic uint64_t snapshot;  // lower bound of the open snapshot, or MVCC_IDLE
+    uint64_t current;           // snapshot handed to nested mvcc_begin() calls
+    atomic_bool in_use;
+    int depth;
+    struct mvcc_thread* next;
+} mvcc_thread_t;
+
+// Last commit sequence number handed out
+static _Atomic uint64_t commit_seq = 0;
+
+// Registry of thread records (append-only list)
+static _Atomic(mvcc_thread_t*) threads = NULL;
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local mvcc_thread_t* self = NULL;
+
+// Release a thread record when its thread exits
+static void thread_record_release(void* arg) {
+    mvcc_thread_t* record = (mvcc_thread_t*)arg;
+    record->depth = 0;
+    atomic_store(&record->snapshot, MVCC_IDLE);
+    atomic_store(&record->in_use, false);
+}
+
+static void make_thread_key(void) {
+    pthread_key_create(&thread_key, thread_record_release);
+}
+
+// Get (registering on first use) the calling thread's record
+static mvcc_thread_t* thread_record(void) {
+    if (self) return self;
+
+    pthread_once(&thread_key_once, make_thread_key);
+
+    pthread_mutex_lock(&registry_mutex);
+    mvcc_thread_t* record = atomic_load(&threads);
+    while (record) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&record->in_use, &expected, true)) {
+            break;
+        }
+        record = record->next;
+    }
+    if (!record) {
+        record = calloc(1, sizeof(mvcc_thread_t));
+        if (!record) {
+            pthread_mutex_unlock(&registry_mutex);
+            LOG_FATAL_FMT("Failed to allocate snapshot thread record");
+            abort();
+        }
+        atomic_store(&record->snapshot, MVCC_IDLE);
+        atomic_store(&record->in_use, true);
+        record->next = atomic_load(&threads);
+        atomic_store(&threads, record);
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    record->depth = 0;
+    pthread_setspecific(thread_key, record);
+    self = record;
+    return record;
+}
+
+// Stamp a record that is linked but not yet committed
+void mvcc_stamp_init(mvcc_stamp_t* stamp) {
+    atomic_init(&stamp->created, MVCC_UNCOMMITTED);
+    atomic_init(&stamp->deleted, MVCC_LIVE);
+}
+
+static uint64_t commit(_Atomic uint64_t* field) {
+    atomic_store(field, MVCC_PENDING);
+    uint64_t seq = atomic_fetch_add(&commit_seq, 1) + 1;
+    atomic_store(field, seq);
+    return seq;
+}
+
+// Commit the record's creation
+uint64_t mvcc_commit_create(mvcc_stamp_t* stamp) {
+    return commit(&stamp->created);
+}
+
+// Claim the record's deletion: only one delete may commit it
+bool mvcc_claim_delete(mvcc_stamp_t* stamp) {
+    uint64_t live = MVCC_LIVE;
+    return atomic_compare_exchange_strong(&stamp->deleted, &live, MVCC_PENDING);
+}
+
+// Commit the record's deletion, or return 0 if it was already claimed
+uint64_t mvcc_commit_delete(mvcc_stamp_t* stamp) {
+    if (!mvcc_claim_delete(stamp)) return 0;
+    uint64_t seq = atomic_fetch_add(&commit_seq, 1) + 1;
+    atomic_store(&stamp->deleted, seq);
+    return seq;
+}
+
+// Commit claimed deletions under one sequence number
+uint64_t mvcc_commit_claimed(mvcc_stamp_t* const* stamps, int count) {
+    uint64_t seq = atomic_fetch_add(&commit_seq, 1) + 1;
+    for (int i = 0; i < count; i++) {
+        atomic_store(&stamps[i]->deleted, seq);
+    }
+    return seq;
+}
+
+// True once the record's deletion is claimed or committed
+bool mvcc_deleted(const mvcc_stamp_t* stamp) {
+    return atomic_load(&stamp->deleted) != MVCC_LIVE;
+}
+
+// Open a snapshot of the current commit sequence
+uint64_t mvcc_begin(void) {
+    mvcc_thread_t* record = thread_record();
+    if (record->depth++ > 0) return record->current;
+
+    // Publish a lower bound first: a delete committed after the snapshot
+    // is read is then sure to see this thread in mvcc_needed()
+    atomic_store(&record->snapshot, atomic_load(&commit_seq));
+    record->current = atomic_load(&commit_seq);
+    return record->current;
+}
+
+// Close the calling thread's snapshot
+void mvcc_end(void) {
+    mvcc_thread_t* record = self;
+    if (!record || record->depth == 0) return;
+    if (--record->depth == 0) {
+        atomic_store_explicit(&record->snapshot, MVCC_IDLE, memory_order_release);
+    }
+}
+
+// Read a stamp field, waiting out a commit in progress
+static uint64_t stamp_load(const _Atomic uint64_t* field) {
+    uint64_t value = atomic_load(field);
+    while (value == MVCC_PENDING) {
+        sched_yield();
+        value = atomic_load(field);
+    }
+    return value;
+}
+
+// True if the record existed at snapshot
+bool mvcc_visible(const mvcc_stamp_t* stamp, uint64_t snapshot) {
+    // Both markers compare above any snapshot
+    return stamp_load(&stamp->created) <= snapshot && stamp_load(&stamp->deleted) > snapshot;
+}
+
+// True while a snapshot older than the commit deleted is open
+bool mvcc_needed(uint64_t deleted) {
+    for (mvcc_thread_t* record = atomic_load(&threads); record; record = record->next) {
+        if (atomic_load(&record->snapshot) < deleted) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,56 @@
+#ifndef MVCC_H
+#define MVCC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Multi-version concurrency control for listings.
+//
+// Every create and delete takes the next number of one global commit
+// sequence and stamps it on the record. A listing takes a snapshot (the
+// sequence at that point) and walks its records without locks, keeping
+// those created at or before the snapshot and not deleted by then, so the
+// result is the state at one instant however long the walk takes.
+//
+// A deleted record must stay reachable while a snapshot older than its
+// delete is open; mvcc_needed() tells writers whether that is the case.
+// Snapshots nest and, like epoch critical sections, should be short.
+
+// Creation or deletion stamp of a record: a commit sequence number, or one
+// of the markers below
+typedef struct {
+    _Atomic uint64_t created;
+    _Atomic uint64_t deleted;
+} mvcc_stamp_t;
+
+// Stamp a record that is linked but not yet committed
+void mvcc_stamp_init(mvcc_stamp_t* stamp);
+
+// Commit the record's creation or deletion; returns its sequence number.
+// A delete returns 0 when the record's deletion was already claimed.
+uint64_t mvcc_commit_create(mvcc_stamp_t* stamp);
+uint64_t mvcc_commit_delete(mvcc_stamp_t* stamp);
+
+// Deleting several records as one: claim each record's deletion (false
+// if it was already claimed), then commit the claimed ones together. They
+// share a sequence number, so every snapshot sees all of them or none.
+bool mvcc_claim_delete(mvcc_stamp_t* stamp);
+uint64_t mvcc_commit_claimed(mvcc_stamp_t* const* stamps, int count);
+
+// True once the record's deletion is claimed or committed
+bool mvcc_deleted(const mvcc_stamp_t* stamp);
+
+// Open a snapshot of the current commit sequence for the calling thread
+uint64_t mvcc_begin(void);
+
+// Close the calling thread's snapshot (matches mvcc_begin)
+void mvcc_end(void);
+
+// True if the record existed at snapshot
+bool mvcc_visible(const mvcc_stamp_t* stamp, uint64_t snapshot);
+
+// True while a snapshot older than the commit deleted is open
+bool mvcc_needed(uint64_t deleted);
+
+#endif // MVCC_H
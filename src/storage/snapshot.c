@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+#include "../utils/logging.h"
+
+#define SNAPSHOT_MAGIC "VXLANSNP"
+#define SNAPSHOT_VERSION 1
+// stdio buffer for the writer
+#define SNAPSHOT_WRITE_BUFFER (1024 * 1024)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t lsn;
+    uint64_t sequence;
+} snapshot_header_t;
+
+// Section table entry
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+    uint64_t records;
+} snapshot_section_t;
+
+typedef struct {
+    uint64_t table_offset;
+    uint64_t section_count;
+    char magic[8];
+} snapshot_trailer_t;
+
+// Record frame: payload length, then the type byte
+#define SNAPSHOT_FRAME_SIZE (sizeof(uint32_t) + 1)
+
+struct snapshot_writer {
+    char* path;
+    char* tmp;
+    FILE* file;
+    uint64_t offset;
+    snapshot_section_t* sections;
+    size_t count;
+    size_t capacity;
+    bool open;     // a section is in progress
+    bool failed;
+};
+
+// Sync the directory holding path, so a file renamed there survives a crash
+static bool sync_parent_dir(const char* path) {
+    const char* slash = strrchr(path, '/');
+    char* dir = slash ? strndup(path, slash == path ? 1 : (size_t)(slash - path)) : strdup(".");
+    if (!dir) return false;
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free(dir);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+static bool writer_put(snapshot_writer_t* writer, const void* data, size_t len) {
+    if (writer->failed) return false;
+    if (len > 0 && fwrite(data, len, 1, writer->file) != 1) {
+        writer->failed = true;
+        return false;
+    }
+    writer->offset += len;
+    return true;
+}
+
+// Start writing a snapshot into path.tmp
+snapshot_writer_t* snapshot_begin(const char* path, uint64_t lsn, uint64_t sequence) {
+    snapshot_writer_t* writer = calloc(1, sizeof(snapshot_writer_t));
+    if (!writer) return NULL;
+
+    size_t tmp_size = strlen(path) + sizeof(".tmp");
+    writer->path = strdup(path);
+    writer->tmp = malloc(tmp_size);
+    if (!writer->path || !writer->tmp) {
+        free(writer->path);
+        free(writer->tmp);
+        free(writer);
+        return NULL;
+    }
+    snprintf(writer->tmp, tmp_size, "%s.tmp", path);
+
+    writer->file = fopen(writer->tmp, "wbe");
+    if (!writer->file) {
+        LOG_ERROR_FMT("Failed to create snapshot %s: %s", writer->tmp, strerror(errno));
+        free(writer->path);
+        free(writer->tmp);
+        free(writer);
+        return NULL;
+    }
+    setvbuf(writer->file, NULL, _IOFBF, SNAPSHOT_WRITE_BUFFER);
+
+    snapshot_header_t header = { .version = SNAPSHOT_VERSION, .lsn = lsn, .sequence = sequence };
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    writer_put(writer, &header, sizeof(header));
+    return writer;
+}
+
+static void close_section(snapshot_writer_t* writer) {
+    if (writer->open) {
+        snapshot_section_t* section = &writer->sections[writer->count - 1];
+        section->length = writer->offset - section->offset;
+        writer->open = false;
+    }
+}
+
+// Close the current section and start a new one
+bool snapshot_section(snapshot_writer_t* writer) {
+    if (writer->failed) return false;
+    close_section(writer);
+
+    if (writer->count == writer->capacity) {
+        size_t capacity = writer->capacity ? writer->capacity * 2 : 64;
+        snapshot_section_t* grown = realloc(writer->sections, capacity * sizeof(snapshot_section_t));
+        if (!grown) {
+            writer->failed = true;
+            return false;
+        }
+        writer->sections = grown;
+        writer->capacity = capacity;
+    }
+    writer->sections[writer->count++] = (snapshot_section_t){ writer->offset, 0, 0 };
+    writer->open = true;
+    return true;
+}
+
+// Add a record to the current section
+bool snapshot_add(snapshot_writer_t* writer, uint8_t type, const void* payload, size_t len) {
+    if (!writer->open && !snapshot_section(writer)) return false;
+    if (len > UINT32_MAX) {
+        writer->failed = true;
+        return false;
+    }
+
+    uint32_t frame_len = (uint32_t)len;
+    if (!writer_put(writer, &frame_len, sizeof(frame_len)) || !writer_put(writer, &type, 1) ||
+        !writer_put(writer, payload, len)) {
+        return false;
+    }
+    writer->sections[writer->count - 1].records++;
+    return true;
+}
+
+static void writer_free(snapshot_writer_t* writer) {
+    free(writer->sections);
+    free(writer->path);
+    free(writer->tmp);
+    free(writer);
+}
+
+// Write the section table and trailer, sync and rename into place
+bool snapshot_commit(snapshot_writer_t* writer) {
+    close_section(writer);
+
+    // The table and trailer are read in place from the mapping, so align them
+    static const uint8_t padding[sizeof(uint64_t)] = {0};
+    writer_put(writer, padding, (sizeof(uint64_t) - writer->offset % sizeof(uint64_t)) % sizeof(uint64_t));
+
+    snapshot_trailer_t trailer = { writer->offset, writer->count, {0} };
+    memcpy(trailer.magic, SNAPSHOT_MAGIC, sizeof(trailer.magic));
+    writer_put(writer, writer->sections, writer->count * sizeof(snapshot_section_t));
+    writer_put(writer, &trailer, sizeof(trailer));
+
+    bool ok = !writer->failed && fflush(writer->file) == 0 && fdatasync(fileno(writer->file)) == 0;
+    ok = fclose(writer->file) == 0 && ok;
+    ok = ok && rename(writer->tmp, writer->path) == 0 && sync_parent_dir(writer->path);
+    if (!ok) {
+        LOG_ERROR_FMT("Failed to write snapshot %s: %s", writer->path, strerror(errno));
+        unlink(writer->tmp);
+    }
+    writer_free(writer);
+    return ok;
+}
+
+// Discard a partially written snapshot
+void snapshot_abort(snapshot_writer_t* writer) {
+    fclose(writer->file);
+    unlink(writer->tmp);
+    writer_free(writer);
+}
+
+// Shared state of the loader threads; sections are handed out one at a time
+typedef struct {
+    const uint8_t* base;
+    const snapshot_section_t* sections;
+    size_t count;
+    atomic_size_t next;
+    atomic_bool failed;
+    atomic_ullong records;
+    snapshot_apply_fn apply;
+    void* ctx;
+} snapshot_loader_t;
+
+// Decode one section; every record is bounds-checked against the section
+static bool load_section(snapshot_loader_t* loader, const snapshot_section_t* section) {
+    const uint8_t* cursor = loader->base + section->offset;
+    const uint8_t* end = cursor + section->length;
+    uint64_t records = 0;
+
+    while (cursor < end) {
+        uint32_t len;
+        if ((size_t)(end - cursor) < SNAPSHOT_FRAME_SIZE) return false;
+        memcpy(&len, cursor, sizeof(len));
+        uint8_t type = cursor[sizeof(len)];
+        cursor += SNAPSHOT_FRAME_SIZE;
+        if ((size_t)(end - cursor) < len) return false;
+        if (!loader->apply(type, cursor, len, loader->ctx)) return false;
+        cursor += len;
+        records++;
+    }
+    atomic_fetch_add(&loader->records, records);
+    return records == section->records;
+}
+
+static void* loader_run(void* arg) {
+    snapshot_loader_t* loader = (snapshot_loader_t*)arg;
+    while (!atomic_load(&loader->failed)) {
+        size_t i = atomic_fetch_add(&loader->next, 1);
+        if (i >= loader->count) break;
+        if (!load_section(loader, &loader->sections[i])) {
+            atomic_store(&loader->failed, true);
+        }
+    }
+    return NULL;
+}
+
+// Check the header, trailer and section table of a mapped snapshot
+static bool snapshot_validate(const uint8_t* base, size_t size, const snapshot_header_t** header,
+                              const snapshot_section_t** sections, size_t* count) {
+    if (size < sizeof(snapshot_header_t) + sizeof(snapshot_trailer_t)) return false;
+
+    *header = (const snapshot_header_t*)base;
+    const snapshot_trailer_t* trailer =
+        (const snapshot_trailer_t*)(base + size - sizeof(snapshot_trailer_t));
+    if (memcmp((*header)->magic, SNAPSHOT_MAGIC, sizeof((*header)->magic)) != 0 ||
+        (*header)->version != SNAPSHOT_VERSION ||
+        memcmp(trailer->magic, SNAPSHOT_MAGIC, sizeof(trailer->magic)) != 0) {
+        return false;
+    }
+
+    uint64_t data_end = size - sizeof(snapshot_trailer_t);
+    if (trailer->table_offset < sizeof(snapshot_header_t) || trailer->table_offset > data_end ||
+        trailer->table_offset % sizeof(uint64_t) != 0 ||
+        trailer->section_count != (data_end - trailer->table_offset) / sizeof(snapshot_section_t) ||
+        (data_end - trailer->table_offset) % sizeof(snapshot_section_t) != 0) {
+        return false;
+    }
+
+    *sections = (const snapshot_section_t*)(base + trailer->table_offset);
+    *count = (size_t)trailer->section_count;
+    for (size_t i = 0; i < *count; i++) {
+        const snapshot_section_t* section = &(*sections)[i];
+        if (section->offset < sizeof(snapshot_header_t) || section->offset > trailer->table_offset ||
+            section->length > trailer->table_offset - section->offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Map the snapshot and decode its sections on up to threads threads
+bool snapshot_load(const char* path, int threads, snapshot_apply_fn apply, void* ctx, uint64_t* lsn,
+                   uint64_t* sequence) {
+    *lsn = 0;
+    *sequence = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        LOG_ERROR_FMT("Snapshot %s is empty or unreadable", path);
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    const uint8_t* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        LOG_ERROR_FMT("Failed to map snapshot %s: %s", path, strerror(errno));
+        return false;
+    }
+    madvise((void*)base, size, MADV_WILLNEED);
+
+    const snapshot_header_t* header;
+    snapshot_loader_t loader = { .base = base, .apply = apply, .ctx = ctx };
+    if (!snapshot_validate(base, size, &header, &loader.sections, &loader.count)) {
+        LOG_ERROR_FMT("Snapshot %s is corrupt", path);
+        munmap((void*)base, size);
+        return false;
+    }
+    atomic_init(&loader.next, 0);
+    atomic_init(&loader.failed, false);
+    atomic_init(&loader.records, 0);
+
+    // The calling thread loads sections too
+    int helpers = threads > 1 ? threads - 1 : 0;
+    if ((size_t)helpers >= loader.count) {
+        helpers = loader.count > 0 ? (int)loader.count - 1 : 0;
+    }
+    pthread_t* tids = helpers > 0 ? malloc(helpers * sizeof(pthread_t)) : NULL;
+    int started = 0;
+    while (tids && started < helpers &&
+           pthread_create(&tids[started], NULL, loader_run, &loader) == 0) {
+        started++;
+    }
+    loader_run(&loader);
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+
+    bool ok = !atomic_load(&loader.failed);
+    if (ok) {
+        *lsn = header->lsn;
+        *sequence = header->sequence;
+        LOG_INFO_FMT("Loaded %llu records from snapshot %s (%d threads)",
+                     (unsigned long long)atomic_load(&loader.records), path, started + 1);
+    } else {
+        LOG_ERROR_FMT("Failed to load snapshot %s", path);
+    }
+    munmap((void*)base, size);
+    return ok;
+}
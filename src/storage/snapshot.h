@@ -0,0 +1,45 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Snapshot file: a compact dump of the store at a write-ahead log
+// position, so startup only replays the log tail.
+//
+// Layout: header {magic, version, lsn, sequence}, then sections of records framed as
+// [u32 length][u8 type][payload], then a section table and a trailer
+// pointing at it. Sections are independent, so loading maps the file and
+// decodes sections on several threads at once. The file is written under
+// a temporary name, synced and renamed into place, so a reader sees
+// either the previous snapshot or the complete new one.
+
+typedef struct snapshot_writer snapshot_writer_t;
+
+// Called for every record while loading; may run on several threads
+typedef bool (*snapshot_apply_fn)(uint8_t type, const void* payload, size_t len, void* ctx);
+
+// Start writing a snapshot of the state at log position lsn. sequence is
+// the change feed's limit at that point (see changes_limit()).
+snapshot_writer_t* snapshot_begin(const char* path, uint64_t lsn, uint64_t sequence);
+
+// Close the current section (if any) and start a new one
+bool snapshot_section(snapshot_writer_t* writer);
+
+// Add a record to the current section
+bool snapshot_add(snapshot_writer_t* writer, uint8_t type, const void* payload, size_t len);
+
+// Finish the file, sync it and atomically replace path. Frees the writer.
+bool snapshot_commit(snapshot_writer_t* writer);
+
+// Discard a partially written snapshot. Frees the writer.
+void snapshot_abort(snapshot_writer_t* writer);
+
+// Load the snapshot at path using up to threads threads. Stores the log
+// position it covers in *lsn and its change sequence limit in *sequence
+// (0 when there is no snapshot, or it is from before sequences were kept).
+bool snapshot_load(const char* path, int threads, snapshot_apply_fn apply, void* ctx, uint64_t* lsn,
+                   uint64_t* sequence);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,146 @@
+#include <stdint.h>
+#include <string.h>
+#include "tree.h"
+
+// Heap priority of a node, from its address (64-bit finalizer of MurmurHash3)
+static uint64_t priority(const tree_node_t* node) {
+    uint64_t x = (uint64_t)(uintptr_t)node;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// First 8 key bytes, zero-padded, so prefixes order like the keys
+static uint64_t key_prefix(const void* key, size_t len) {
+    const uint8_t* bytes = key;
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < sizeof(prefix); i++) {
+        prefix = prefix << 8 | (i < len ? bytes[i] : 0);
+    }
+    return prefix;
+}
+
+// Order of node against a key with the given prefix
+static int compare_node(const tree_t* tree, const tree_node_t* node, const void* key, size_t len,
+                        uint64_t prefix) {
+    if (node->prefix != prefix) {
+        return node->prefix < prefix ? -1 : 1;
+    }
+    size_t node_len;
+    const void* node_key = tree->key(node, &node_len);
+    int c = memcmp(node_key, key, node_len < len ? node_len : len);
+    if (c != 0) return c;
+    return (node_len > len) - (node_len < len);
+}
+
+// Point the parent of old (or the root) at new
+static void replace_child(tree_t* tree, tree_node_t* parent, tree_node_t* old, tree_node_t* new) {
+    if (!parent) {
+        tree->root = new;
+    } else if (parent->left == old) {
+        parent->left = new;
+    } else {
+        parent->right = new;
+    }
+}
+
+// Rotate node above its parent, keeping the key order
+static void rotate_up(tree_t* tree, tree_node_t* node) {
+    tree_node_t* parent = node->parent;
+    tree_node_t* grandparent = parent->parent;
+    if (parent->left == node) {
+        parent->left = node->right;
+        if (node->right) node->right->parent = parent;
+        node->right = parent;
+    } else {
+        parent->right = node->left;
+        if (node->left) node->left->parent = parent;
+        node->left = parent;
+    }
+    parent->parent = node;
+    node->parent = grandparent;
+    replace_child(tree, grandparent, parent, node);
+}
+
+// Initialize an empty tree
+void tree_init(tree_t* tree, tree_key_fn key) {
+    tree->root = NULL;
+    tree->key = key;
+}
+
+// Insert a node; equal keys are kept, after the existing ones
+void tree_insert(tree_t* tree, tree_node_t* node) {
+    size_t len;
+    const void* key = tree->key(node, &len);
+    node->prefix = key_prefix(key, len);
+    tree_node_t* parent = NULL;
+    tree_node_t** link = &tree->root;
+    while (*link) {
+        parent = *link;
+        link = compare_node(tree, parent, key, len, node->prefix) > 0 ? &parent->left : &parent->right;
+    }
+    node->left = node->right = NULL;
+    node->parent = parent;
+    *link = node;
+
+    uint64_t prio = priority(node);
+    while (node->parent && prio > priority(node->parent)) {
+        rotate_up(tree, node);
+    }
+}
+
+// Unlink a node previously inserted into the tree
+void tree_remove(tree_t* tree, tree_node_t* node) {
+    // Rotate the node down until it has at most one child
+    while (node->left && node->right) {
+        rotate_up(tree, priority(node->left) > priority(node->right) ? node->left : node->right);
+    }
+    tree_node_t* child = node->left ? node->left : node->right;
+    if (child) {
+        child->parent = node->parent;
+    }
+    replace_child(tree, node->parent, node, child);
+    node->left = node->right = node->parent = NULL;
+}
+
+static tree_node_t* leftmost(tree_node_t* node) {
+    while (node && node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+// First node in key order, or NULL when the tree is empty
+tree_node_t* tree_first(const tree_t* tree) {
+    return leftmost(tree->root);
+}
+
+// First node whose key is greater than key, or NULL
+tree_node_t* tree_after(const tree_t* tree, const void* key, size_t len) {
+    uint64_t prefix = key_prefix(key, len);
+    tree_node_t* found = NULL;
+    tree_node_t* node = tree->root;
+    while (node) {
+        if (compare_node(tree, node, key, len, prefix) > 0) {
+            found = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return found;
+}
+
+// Next node in key order, or NULL after the last one
+tree_node_t* tree_next(const tree_node_t* node) {
+    if (node->right) {
+        return leftmost(node->right);
+    }
+    while (node->parent && node->parent->right == node) {
+        node = node->parent;
+    }
+    return node->parent;
+}
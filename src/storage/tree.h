@@ -0,0 +1,46 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Ordered tree node, embedded in stored entries like hash_node_t
+typedef struct tree_node {
+    struct tree_node* left;
+    struct tree_node* right;
+    struct tree_node* parent;
+    uint64_t prefix;  // first key bytes as a big-endian number, set on insert
+} tree_node_t;
+
+// Returns the key bytes of the entry holding node
+typedef const void* (*tree_key_fn)(const tree_node_t* node, size_t* len);
+
+// Treap ordered by key bytes (memcmp, then length). Priorities are a hash
+// of the node address, so nodes need no extra field and the expected depth
+// is O(log n) whatever the insertion order. Each node caches its key
+// prefix, so a search only reads the keys themselves on a prefix tie.
+// Writers and readers must be serialized by the caller.
+typedef struct {
+    tree_node_t* root;
+    tree_key_fn key;
+} tree_t;
+
+// Initialize an empty tree
+void tree_init(tree_t* tree, tree_key_fn key);
+
+// Insert a node; equal keys are kept, after the existing ones
+void tree_insert(tree_t* tree, tree_node_t* node);
+
+// Unlink a node previously inserted into the tree
+void tree_remove(tree_t* tree, tree_node_t* node);
+
+// First node in key order, or NULL when the tree is empty
+tree_node_t* tree_first(const tree_t* tree);
+
+// First node whose key is greater than key, or NULL
+tree_node_t* tree_after(const tree_t* tree, const void* key, size_t len);
+
+// Next node in key order, or NULL after the last one
+tree_node_t* tree_next(const tree_node_t* node);
+
+#endif // TREE_H
@@ -0,0 +1,136 @@
+#include <string.h>
+#include <pthread.h>
+#include "vni.h"
+#include "../network/vxlan.h"
+
+#define VNI_BITS 24
+#define VNI_COUNT (1u << VNI_BITS)
+#define WORD_BITS 64
+#define FULL_WORD (~(uint64_t)0)
+
+// used: a bit per VNI. full1: a bit per word of used that is all ones.
+// full2: a bit per word of full1 that is all ones.
+static struct {
+    pthread_mutex_t lock;
+    uint32_t next;  // allocation resumes here
+    uint64_t used[VNI_COUNT / WORD_BITS];
+    uint64_t full1[VNI_COUNT / WORD_BITS / WORD_BITS];
+    uint64_t full2[VNI_COUNT / WORD_BITS / WORD_BITS / WORD_BITS];
+} vnis = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .next = 1,
+    // VNI 0 is not a valid identifier and is never handed out
+    .used = { 1 },
+};
+
+#define WORDS(level) (sizeof(level) / sizeof(uint64_t))
+
+// Clear bits below index within its word
+static inline uint64_t from_bit(uint32_t index) {
+    return FULL_WORD << (index % WORD_BITS);
+}
+
+static void set_used(uint32_t vni) {
+    uint32_t w0 = vni / WORD_BITS;
+    vnis.used[w0] |= (uint64_t)1 << (vni % WORD_BITS);
+    if (vnis.used[w0] != FULL_WORD) return;
+    uint32_t w1 = w0 / WORD_BITS;
+    vnis.full1[w1] |= (uint64_t)1 << (w0 % WORD_BITS);
+    if (vnis.full1[w1] != FULL_WORD) return;
+    vnis.full2[w1 / WORD_BITS] |= (uint64_t)1 << (w1 % WORD_BITS);
+}
+
+static void clear_used(uint32_t vni) {
+    uint32_t w0 = vni / WORD_BITS;
+    uint32_t w1 = w0 / WORD_BITS;
+    vnis.used[w0] &= ~((uint64_t)1 << (vni % WORD_BITS));
+    vnis.full1[w1] &= ~((uint64_t)1 << (w0 % WORD_BITS));
+    vnis.full2[w1 / WORD_BITS] &= ~((uint64_t)1 << (w1 % WORD_BITS));
+}
+
+// First free VNI at or after start, or 0 if there is none up to the end
+static uint32_t find_free(uint32_t start) {
+    uint32_t w0 = start / WORD_BITS;
+    uint64_t free0 = ~vnis.used[w0] & from_bit(start);
+    if (free0) {
+        return w0 * WORD_BITS + (uint32_t)__builtin_ctzll(free0);
+    }
+
+    // A later word with room: look in full1 from w0 + 1, then in full2
+    uint32_t i1 = w0 + 1;
+    if (i1 >= WORDS(vnis.used)) return 0;
+    uint32_t w1 = i1 / WORD_BITS;
+    uint64_t free1 = ~vnis.full1[w1] & from_bit(i1);
+    if (!free1) {
+        uint32_t i2 = w1 + 1;
+        if (i2 >= WORDS(vnis.full1)) return 0;
+        uint32_t w2 = i2 / WORD_BITS;
+        uint64_t free2 = ~vnis.full2[w2] & from_bit(i2);
+        while (!free2 && ++w2 < WORDS(vnis.full2)) {
+            free2 = ~vnis.full2[w2];
+        }
+        if (!free2) return 0;
+        w1 = w2 * WORD_BITS + (uint32_t)__builtin_ctzll(free2);
+        free1 = ~vnis.full1[w1];
+    }
+    w0 = w1 * WORD_BITS + (uint32_t)__builtin_ctzll(free1);
+    return w0 * WORD_BITS + (uint32_t)__builtin_ctzll(~vnis.used[w0]);
+}
+
+// Forget every reservation
+void vni_reset(void) {
+    pthread_mutex_lock(&vnis.lock);
+    memset(vnis.used, 0, sizeof(vnis.used));
+    memset(vnis.full1, 0, sizeof(vnis.full1));
+    memset(vnis.full2, 0, sizeof(vnis.full2));
+    vnis.used[0] = 1;
+    vnis.next = 1;
+    pthread_mutex_unlock(&vnis.lock);
+}
+
+// Mark vni as used
+bool vni_reserve(uint32_t vni) {
+    if (vni == 0 || vni > MAX_VNI) return false;
+
+    pthread_mutex_lock(&vnis.lock);
+    bool free = !(vnis.used[vni / WORD_BITS] & ((uint64_t)1 << (vni % WORD_BITS)));
+    if (free) {
+        set_used(vni);
+    }
+    pthread_mutex_unlock(&vnis.lock);
+    return free;
+}
+
+// Reserve the next free VNI, wrapping around once
+uint32_t vni_allocate(void) {
+    pthread_mutex_lock(&vnis.lock);
+    uint32_t vni = find_free(vnis.next);
+    if (vni == 0 && vnis.next > 1) {
+        vni = find_free(1);
+    }
+    if (vni != 0) {
+        set_used(vni);
+        vnis.next = vni + 1 < VNI_COUNT ? vni + 1 : 1;
+    }
+    pthread_mutex_unlock(&vnis.lock);
+    return vni;
+}
+
+// Mark vni as free again
+void vni_release(uint32_t vni) {
+    if (vni == 0 || vni > MAX_VNI) return;
+
+    pthread_mutex_lock(&vnis.lock);
+    clear_used(vni);
+    pthread_mutex_unlock(&vnis.lock);
+}
+
+// True if vni is reserved
+bool vni_in_use(uint32_t vni) {
+    if (vni == 0 || vni > MAX_VNI) return false;
+
+    pthread_mutex_lock(&vnis.lock);
+    bool used = vnis.used[vni / WORD_BITS] & ((uint64_t)1 << (vni % WORD_BITS));
+    pthread_mutex_unlock(&vnis.lock);
+    return used;
+}
@@ -0,0 +1,32 @@
+#ifndef VNI_H
+#define VNI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Set of VNIs in use.
+//
+// A bit per VNI (2^24 bits, 2 MiB), plus two summary levels where a set
+// bit marks a full 64-bit word of the level below. Reserving and releasing
+// a VNI touch one word per level; finding a free VNI looks at one word per
+// level plus at most 64 top-level words, whatever the occupancy. Allocation
+// continues from the last allocated VNI, so a freed VNI is not handed out
+// again until the rest of the space has been used. All calls are
+// serialized by one internal mutex.
+
+// Forget every reservation
+void vni_reset(void);
+
+// Mark vni as used; false if it already is or is out of range
+bool vni_reserve(uint32_t vni);
+
+// Reserve and return a free VNI, or 0 when none is left
+uint32_t vni_allocate(void);
+
+// Mark vni as free again
+void vni_release(uint32_t vni);
+
+// True if vni is reserved
+bool vni_in_use(uint32_t vni);
+
+#endif // VNI_H
@@ -0,0 +1,480 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "wal.h"
+#include "../utils/logging.h"
+
+// File header: magic and the sequence number of the first record
+#define WAL_MAGIC "VXLANWAL"
+typedef struct {
+    char magic[8];
+    uint64_t base;
+} wal_file_header_t;
+
+// Records larger than this are treated as corruption during replay
+#define WAL_MAX_RECORD (16u * 1024 * 1024)
+// In WAL_SYNC_NONE mode buffered records are written once this much accumulates
+#define WAL_FLUSH_THRESHOLD (64 * 1024)
+// Copy buffer used when compacting
+#define WAL_COPY_CHUNK (64 * 1024)
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} wal_buffer_t;
+
+// Log state. Appenders fill bufs[active]; the sync leader swaps buffers
+// and writes the full one outside the lock.
+static struct {
+    int fd;
+    char* path;
+    uint64_t base;      // sequence number of the first record in the file
+    wal_sync_mode_t mode;
+    pthread_mutex_t lock;
+    pthread_cond_t synced;
+    wal_buffer_t bufs[2];
+    int active;
+    uint64_t appended;  // sequence number of the last buffered record
+    uint64_t durable;   // everything up to here is written (and synced)
+    bool syncing;       // a leader is writing outside the lock
+    uint64_t syncs;
+} wal = {
+    .fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .synced = PTHREAD_COND_INITIALIZER,
+};
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+}
+
+// CRC-32 (IEEE) of the type byte followed by the payload
+static uint32_t record_crc(uint8_t type, const void* payload, size_t len) {
+    pthread_once(&crc_once, crc_init);
+    const uint8_t* p = (const uint8_t*)payload;
+    uint32_t c = crc_table[(0xFFFFFFFFu ^ type) & 0xff] ^ (0xFFFFFFFFu >> 8);
+    for (size_t i = 0; i < len; i++) {
+        c = crc_table[(c ^ p[i]) & 0xff] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+// A failed write or sync means acknowledged changes may be lost; there is
+// no safe way to continue
+static void wal_fail(const char* what) {
+    LOG_FATAL_FMT("Write-ahead log %s failed: %s", what, strerror(errno));
+    abort();
+}
+
+static bool write_full(int fd, const void* data, size_t len) {
+    const char* p = (const char*)data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static void write_all(int fd, const char* data, size_t len) {
+    if (!write_full(fd, data, len)) {
+        wal_fail("write");
+    }
+}
+
+static void sync_fd(int fd) {
+    if (fdatasync(fd) != 0) {
+        wal_fail("fdatasync");
+    }
+    wal.syncs++;
+}
+
+static bool buffer_reserve(wal_buffer_t* buf, size_t extra) {
+    if (buf->len + extra <= buf->cap) return true;
+    size_t cap = buf->cap ? buf->cap : 4096;
+    while (cap < buf->len + extra) cap *= 2;
+    char* grown = realloc(buf->data, cap);
+    if (!grown) return false;
+    buf->data = grown;
+    buf->cap = cap;
+    return true;
+}
+
+// Write a file header to an empty file
+static bool write_file_header(int fd, uint64_t base) {
+    wal_file_header_t header = { .base = base };
+    memcpy(header.magic, WAL_MAGIC, sizeof(header.magic));
+    return write_full(fd, &header, sizeof(header));
+}
+
+// Sync the directory holding path, so a file created or renamed there survives a crash
+static bool sync_parent_dir(const char* path) {
+    const char* slash = strrchr(path, '/');
+    char* dir = slash ? strndup(path, slash == path ? 1 : (size_t)(slash - path)) : strdup(".");
+    if (!dir) return false;
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free(dir);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+// Replay the log at path from from_lsn on, truncating a torn or corrupt tail
+bool wal_replay(const char* path, uint64_t from_lsn, wal_apply_fn apply, void* ctx) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return errno == ENOENT;
+    }
+
+    // A file without a complete header never held a record; wal_open()
+    // starts it over
+    wal_file_header_t header;
+    if (fread(&header, sizeof(header), 1, f) != 1) {
+        fclose(f);
+        return true;
+    }
+    if (memcmp(header.magic, WAL_MAGIC, sizeof(header.magic)) != 0) {
+        LOG_ERROR_FMT("%s is not a write-ahead log", path);
+        fclose(f);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    uint64_t end = header.base + (uint64_t)ftell(f) - sizeof(header);
+    if (from_lsn < header.base || from_lsn > end) {
+        LOG_ERROR_FMT("Log %s covers positions %llu-%llu, replay needs %llu on",
+                      path, (unsigned long long)header.base, (unsigned long long)end,
+                      (unsigned long long)from_lsn);
+        fclose(f);
+        return false;
+    }
+    fseek(f, (long)(sizeof(header) + (from_lsn - header.base)), SEEK_SET);
+
+    char* payload = NULL;
+    size_t payload_cap = 0;
+    long good = ftell(f);
+    long records = 0;
+    bool ok = true;
+
+    for (;;) {
+        uint32_t frame[2];
+        uint8_t type;
+        if (fread(frame, sizeof(frame), 1, f) != 1 || fread(&type, 1, 1, f) != 1) break;
+        uint32_t len = frame[0];
+        if (len > WAL_MAX_RECORD) break;
+        if (len > payload_cap) {
+            char* grown = realloc(payload, len);
+            if (!grown) {
+                ok = false;
+                break;
+            }
+            payload = grown;
+            payload_cap = len;
+        }
+        if (len > 0 && fread(payload, len, 1, f) != 1) break;
+        if (record_crc(type, payload, len) != frame[1]) break;
+
+        if (!apply(type, payload, len, ctx)) {
+            ok = false;
+            break;
+        }
+        good = ftell(f);
+        records++;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    free(payload);
+
+    if (ok && good < size) {
+        LOG_WARN_FMT("Truncating %ld bytes of incomplete log tail in %s", size - good, path);
+        if (truncate(path, good) != 0) {
+            LOG_ERROR_FMT("Failed to truncate %s: %s", path, strerror(errno));
+            return false;
+        }
+    }
+    if (ok) {
+        LOG_INFO_FMT("Replayed %ld log records from %s", records, path);
+    }
+    return ok;
+}
+
+// Open the log at path for appending
+bool wal_open(const char* path, wal_sync_mode_t mode, uint64_t start_lsn) {
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    char* path_copy = strdup(path);
+    if (fd < 0 || !path_copy) {
+        LOG_ERROR_FMT("Failed to open log %s: %s", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        free(path_copy);
+        return false;
+    }
+
+    wal_file_header_t header;
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size < (off_t)sizeof(header)) {
+        // New log, or one that crashed before its header was complete
+        header.base = start_lsn;
+        if (ftruncate(fd, 0) != 0 || !write_file_header(fd, start_lsn) || fdatasync(fd) != 0 ||
+            !sync_parent_dir(path)) {
+            LOG_ERROR_FMT("Failed to create log %s: %s", path, strerror(errno));
+            close(fd);
+            free(path_copy);
+            return false;
+        }
+        size = sizeof(header);
+    } else if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+               memcmp(header.magic, WAL_MAGIC, sizeof(header.magic)) != 0 ||
+               header.base + (uint64_t)size - sizeof(header) < start_lsn) {
+        LOG_ERROR_FMT("Log %s is not a write-ahead log or ends before position %llu",
+                      path, (unsigned long long)start_lsn);
+        close(fd);
+        free(path_copy);
+        return false;
+    }
+
+    pthread_mutex_lock(&wal.lock);
+    wal.fd = fd;
+    wal.path = path_copy;
+    wal.base = header.base;
+    wal.mode = mode;
+    wal.active = 0;
+    wal.appended = wal.durable = header.base + (uint64_t)size - sizeof(header);
+    wal.syncing = false;
+    wal.syncs = 0;
+    pthread_mutex_unlock(&wal.lock);
+    return true;
+}
+
+// Flush, sync and close the log
+void wal_close(void) {
+    pthread_mutex_lock(&wal.lock);
+    while (wal.syncing) {
+        pthread_cond_wait(&wal.synced, &wal.lock);
+    }
+    if (wal.fd >= 0) {
+        wal_buffer_t* buf = &wal.bufs[wal.active];
+        write_all(wal.fd, buf->data, buf->len);
+        buf->len = 0;
+        if (wal.mode != WAL_SYNC_NONE) {
+            sync_fd(wal.fd);
+        }
+        close(wal.fd);
+        wal.fd = -1;
+    }
+    free(wal.path);
+    wal.path = NULL;
+    for (int i = 0; i < 2; i++) {
+        free(wal.bufs[i].data);
+        wal.bufs[i] = (wal_buffer_t){ NULL, 0, 0 };
+    }
+    pthread_mutex_unlock(&wal.lock);
+}
+
+// True while a log is open
+bool wal_is_open(void) {
+    pthread_mutex_lock(&wal.lock);
+    bool open = wal.fd >= 0;
+    pthread_mutex_unlock(&wal.lock);
+    return open;
+}
+
+// Buffer a record and return its sequence number
+uint64_t wal_append(uint8_t type, const void* payload, size_t len) {
+    uint32_t header[2] = { (uint32_t)len, record_crc(type, payload, len) };
+    size_t total = sizeof(header) + 1 + len;
+
+    pthread_mutex_lock(&wal.lock);
+    if (wal.fd < 0) {
+        pthread_mutex_unlock(&wal.lock);
+        return 0;
+    }
+    wal_buffer_t* buf = &wal.bufs[wal.active];
+    if (!buffer_reserve(buf, total)) {
+        errno = ENOMEM;
+        wal_fail("append");
+    }
+    memcpy(buf->data + buf->len, header, sizeof(header));
+    buf->data[buf->len + sizeof(header)] = (char)type;
+    memcpy(buf->data + buf->len + sizeof(header) + 1, payload, len);
+    buf->len += total;
+    wal.appended += total;
+    uint64_t lsn = wal.appended;
+
+    if (wal.mode == WAL_SYNC_EACH ||
+        (wal.mode == WAL_SYNC_NONE && buf->len >= WAL_FLUSH_THRESHOLD && !wal.syncing)) {
+        // A concurrent leader may still be writing the other buffer
+        while (wal.syncing) {
+            pthread_cond_wait(&wal.synced, &wal.lock);
+        }
+        buf = &wal.bufs[wal.active];
+        write_all(wal.fd, buf->data, buf->len);
+        buf->len = 0;
+        if (wal.mode == WAL_SYNC_EACH) {
+            sync_fd(wal.fd);
+        }
+        wal.durable = wal.appended;
+    }
+    pthread_mutex_unlock(&wal.lock);
+    return lsn;
+}
+
+// Block until lsn is durable. The first waiter becomes the leader and
+// writes everything buffered so far; the rest wait for its sync.
+void wal_sync(uint64_t lsn) {
+    if (lsn == 0) return;
+
+    pthread_mutex_lock(&wal.lock);
+    while (wal.durable < lsn) {
+        if (wal.syncing) {
+            pthread_cond_wait(&wal.synced, &wal.lock);
+            continue;
+        }
+        wal.syncing = true;
+        wal_buffer_t* out = &wal.bufs[wal.active];
+        wal.active ^= 1;
+        uint64_t target = wal.appended;
+        int fd = wal.fd;
+        bool sync = wal.mode != WAL_SYNC_NONE;
+        pthread_mutex_unlock(&wal.lock);
+
+        write_all(fd, out->data, out->len);
+        out->len = 0;
+        if (sync && fdatasync(fd) != 0) {
+            wal_fail("fdatasync");
+        }
+
+        pthread_mutex_lock(&wal.lock);
+        if (sync) wal.syncs++;
+        wal.durable = target;
+        wal.syncing = false;
+        pthread_cond_broadcast(&wal.synced);
+    }
+    pthread_mutex_unlock(&wal.lock);
+}
+
+// Wait for a running leader, then write out the active buffer. The
+// caller holds the lock.
+static void flush_locked(void) {
+    while (wal.syncing) {
+        pthread_cond_wait(&wal.synced, &wal.lock);
+    }
+    wal_buffer_t* buf = &wal.bufs[wal.active];
+    write_all(wal.fd, buf->data, buf->len);
+    buf->len = 0;
+}
+
+// Write and sync everything appended so far
+uint64_t wal_checkpoint(void) {
+    pthread_mutex_lock(&wal.lock);
+    if (wal.fd < 0) {
+        pthread_mutex_unlock(&wal.lock);
+        return 0;
+    }
+    flush_locked();
+    sync_fd(wal.fd);
+    wal.durable = wal.appended;
+    uint64_t lsn = wal.appended;
+    pthread_mutex_unlock(&wal.lock);
+    return lsn;
+}
+
+// Copy the old file from offset to its end into fd
+static bool copy_tail(int from, off_t offset, int to) {
+    char* chunk = malloc(WAL_COPY_CHUNK);
+    if (!chunk) return false;
+    bool ok = true;
+    for (;;) {
+        ssize_t n = pread(from, chunk, WAL_COPY_CHUNK, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            ok = n == 0;
+            break;
+        }
+        if (!write_full(to, chunk, (size_t)n)) {
+            ok = false;
+            break;
+        }
+        offset += n;
+    }
+    free(chunk);
+    return ok;
+}
+
+// Drop the records before lsn. The tail is copied into path.tmp, which is
+// synced and renamed over the log; a crash at any point leaves either the
+// old log or the new one.
+bool wal_compact(uint64_t lsn) {
+    pthread_mutex_lock(&wal.lock);
+    if (wal.fd < 0 || lsn < wal.base || lsn > wal.appended) {
+        pthread_mutex_unlock(&wal.lock);
+        return false;
+    }
+    if (lsn == wal.base) {
+        pthread_mutex_unlock(&wal.lock);
+        return true;
+    }
+    flush_locked();
+
+    size_t tmp_size = strlen(wal.path) + sizeof(".tmp");
+    char* tmp = malloc(tmp_size);
+    int fd = -1;
+    bool ok = tmp != NULL;
+    if (ok) {
+        snprintf(tmp, tmp_size, "%s.tmp", wal.path);
+        fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        off_t offset = (off_t)(sizeof(wal_file_header_t) + (lsn - wal.base));
+        ok = fd >= 0 && write_file_header(fd, lsn) && copy_tail(wal.fd, offset, fd) &&
+             fdatasync(fd) == 0 && rename(tmp, wal.path) == 0;
+    }
+    if (!ok) {
+        LOG_ERROR_FMT("Failed to compact log %s: %s", wal.path, strerror(errno));
+        if (fd >= 0) close(fd);
+        if (tmp) unlink(tmp);
+        free(tmp);
+        pthread_mutex_unlock(&wal.lock);
+        return false;
+    }
+    free(tmp);
+    // Records appended from here on go to the new file; if the rename were
+    // lost in a crash, so would they be
+    if (!sync_parent_dir(wal.path)) {
+        wal_fail("directory sync");
+    }
+
+    close(wal.fd);
+    wal.fd = fd;
+    wal.base = lsn;
+    wal.durable = wal.appended;
+    wal.syncs++;
+    LOG_INFO_FMT("Compacted log %s to position %llu", wal.path, (unsigned long long)lsn);
+    pthread_mutex_unlock(&wal.lock);
+    return true;
+}
+
+// Number of fdatasync() calls issued since the log was opened
+uint64_t wal_sync_count(void) {
+    pthread_mutex_lock(&wal.lock);
+    uint64_t syncs = wal.syncs;
+    pthread_mutex_unlock(&wal.lock);
+    return syncs;
+}
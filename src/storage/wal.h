@@ -0,0 +1,62 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Append-only write-ahead log.
+//
+// The file starts with a header holding the sequence number of its first
+// record; each record is framed as [u32 length][u32 crc32][u8 type][payload]
+// in host byte order. wal_append() only copies the record into an
+// in-memory buffer and returns its log sequence number (the log position
+// just past the record); callers append while holding the lock that orders the
+// change, then call wal_sync() after releasing it. Under group commit the
+// first waiter writes and fdatasync()s everything buffered so far while
+// later writers queue up behind it, so one sync covers a whole batch.
+
+typedef enum {
+    WAL_SYNC_NONE,   // write(), never fdatasync(); survives a crash of the process only
+    WAL_SYNC_EACH,   // write() and fdatasync() every record before wal_append() returns
+    WAL_SYNC_GROUP   // batch concurrent writers into one fdatasync()
+} wal_sync_mode_t;
+
+// Called for every intact record during replay; return false to stop
+typedef bool (*wal_apply_fn)(uint8_t type, const void* payload, size_t len, void* ctx);
+
+// Replay the records of the log at path from sequence number from_lsn on.
+// A torn or corrupt tail (from a crash mid-write) ends the replay and is
+// truncated away. A missing file is an empty log. Fails if the log has
+// already dropped records at or after from_lsn.
+bool wal_replay(const char* path, uint64_t from_lsn, wal_apply_fn apply, void* ctx);
+
+// Open the log at path for appending. A new log starts numbering at
+// start_lsn (the position of the snapshot it follows, 0 without one).
+bool wal_open(const char* path, wal_sync_mode_t mode, uint64_t start_lsn);
+
+// Flush, sync and close the log
+void wal_close(void);
+
+// True while a log is open
+bool wal_is_open(void);
+
+// Buffer a record; returns its sequence number, or 0 when no log is open
+uint64_t wal_append(uint8_t type, const void* payload, size_t len);
+
+// Block until the record with sequence number lsn is durable (per the
+// sync mode). lsn 0 returns immediately.
+void wal_sync(uint64_t lsn);
+
+// Write and sync everything appended so far, regardless of the sync
+// mode. Returns the sequence number it covers, 0 when no log is open.
+uint64_t wal_checkpoint(void);
+
+// Drop the records before lsn (covered by a snapshot) by rewriting the
+// remaining tail into a new file. Appenders wait while the tail is copied.
+bool wal_compact(uint64_t lsn);
+
+// Number of fdatasync() calls issued since the log was opened
+uint64_t wal_sync_count(void);
+
+#endif // WAL_H
@@ -49,8 +49,9 @@ void logging_set_level(log_level_t level) {
 // Get current timestamp
 static void get_timestamp(char* buffer, size_t size) {
     time_t now = time(NULL);
-    struct tm* tm_info = localtime(&now);
-    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", tm_info);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &tm_info);
 }
 
 // Write log message
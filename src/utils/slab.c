@@ -0,0 +1,176 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "slab.h"
+
+// Chunk size carved into objects of one class
+#define SLAB_CHUNK_SIZE (64 * 1024)
+// Free-list arenas per class; threads are spread across them
+#define SLAB_ARENAS 16
+// Class lookup granularity
+#define SLAB_QUANTUM 16
+
+// Object sizes served by the slab (multiples of SLAB_QUANTUM)
+static const size_t class_sizes[] = {32, 48, 64, 80, 96, 112, 128, 160, 192, 256, 320, 384, 448, 512};
+#define SLAB_CLASSES (sizeof(class_sizes) / sizeof(class_sizes[0]))
+
+// Chunk header, kept at the start of every chunk so destroy can find them
+typedef struct slab_chunk {
+    struct slab_chunk* next;
+    char pad[SLAB_QUANTUM - sizeof(struct slab_chunk*)];
+} slab_chunk_t;
+
+// Free object, linked through its first word
+typedef struct slab_object {
+    struct slab_object* next;
+} slab_object_t;
+
+// Free list and bump region of one class in one arena, padded to its own
+// cache line
+typedef struct {
+    pthread_mutex_t lock;
+    slab_object_t* free_list;
+    char* bump;
+    char* bump_end;
+} __attribute__((aligned(64))) slab_arena_t;
+
+struct slab_allocator {
+    slab_arena_t arenas[SLAB_CLASSES][SLAB_ARENAS];
+    pthread_mutex_t chunks_lock;
+    slab_chunk_t* chunks;
+    size_t reserved;
+};
+
+// Class index for each size in SLAB_QUANTUM steps
+static unsigned char size_to_class[SLAB_MAX_SIZE / SLAB_QUANTUM + 1];
+static pthread_once_t size_table_once = PTHREAD_ONCE_INIT;
+
+static atomic_uint next_arena = 0;
+static _Thread_local int thread_arena = -1;
+
+static void build_size_table(void) {
+    size_t cls = 0;
+    for (size_t i = 0; i <= SLAB_MAX_SIZE / SLAB_QUANTUM; i++) {
+        while (class_sizes[cls] < i * SLAB_QUANTUM) {
+            cls++;
+        }
+        size_to_class[i] = (unsigned char)cls;
+    }
+}
+
+static inline slab_arena_t* arena_for(slab_allocator_t* slab, size_t size) {
+    if (thread_arena < 0) {
+        thread_arena = (int)(atomic_fetch_add(&next_arena, 1) % SLAB_ARENAS);
+    }
+    size_t cls = size_to_class[(size + SLAB_QUANTUM - 1) / SLAB_QUANTUM];
+    return &slab->arenas[cls][thread_arena];
+}
+
+static inline size_t class_size_of(size_t size) {
+    return class_sizes[size_to_class[(size + SLAB_QUANTUM - 1) / SLAB_QUANTUM]];
+}
+
+// Create an allocator
+slab_allocator_t* slab_create(void) {
+    pthread_once(&size_table_once, build_size_table);
+
+    slab_allocator_t* slab = aligned_alloc(64, sizeof(slab_allocator_t));
+    if (!slab) return NULL;
+    memset(slab, 0, sizeof(slab_allocator_t));
+
+    for (size_t c = 0; c < SLAB_CLASSES; c++) {
+        for (int a = 0; a < SLAB_ARENAS; a++) {
+            pthread_mutex_init(&slab->arenas[c][a].lock, NULL);
+        }
+    }
+    pthread_mutex_init(&slab->chunks_lock, NULL);
+    return slab;
+}
+
+// Destroy an allocator and every object allocated from it
+void slab_destroy(slab_allocator_t* slab) {
+    if (!slab) return;
+
+    slab_chunk_t* chunk = slab->chunks;
+    while (chunk) {
+        slab_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    for (size_t c = 0; c < SLAB_CLASSES; c++) {
+        for (int a = 0; a < SLAB_ARENAS; a++) {
+            pthread_mutex_destroy(&slab->arenas[c][a].lock);
+        }
+    }
+    pthread_mutex_destroy(&slab->chunks_lock);
+    free(slab);
+}
+
+// Reserve a fresh chunk for an arena; caller holds the arena lock
+static bool arena_refill(slab_allocator_t* slab, slab_arena_t* arena) {
+    slab_chunk_t* chunk = malloc(SLAB_CHUNK_SIZE);
+    if (!chunk) return false;
+
+    pthread_mutex_lock(&slab->chunks_lock);
+    chunk->next = slab->chunks;
+    slab->chunks = chunk;
+    slab->reserved += SLAB_CHUNK_SIZE;
+    pthread_mutex_unlock(&slab->chunks_lock);
+
+    arena->bump = (char*)(chunk + 1);
+    arena->bump_end = (char*)chunk + SLAB_CHUNK_SIZE;
+    return true;
+}
+
+// Allocate size bytes
+void* slab_alloc(slab_allocator_t* slab, size_t size) {
+    if (!slab || size == 0 || size > SLAB_MAX_SIZE) {
+        return malloc(size);
+    }
+
+    size_t object_size = class_size_of(size);
+    slab_arena_t* arena = arena_for(slab, size);
+    void* ptr = NULL;
+
+    pthread_mutex_lock(&arena->lock);
+    if (arena->free_list) {
+        ptr = arena->free_list;
+        arena->free_list = arena->free_list->next;
+    } else if ((size_t)(arena->bump_end - arena->bump) >= object_size ||
+               arena_refill(slab, arena)) {
+        ptr = arena->bump;
+        arena->bump += object_size;
+    }
+    pthread_mutex_unlock(&arena->lock);
+
+    return ptr;
+}
+
+// Return an object to the calling thread's arena
+void slab_free(slab_allocator_t* slab, void* ptr, size_t size) {
+    if (!ptr) return;
+    if (!slab || size == 0 || size > SLAB_MAX_SIZE) {
+        free(ptr);
+        return;
+    }
+
+    slab_arena_t* arena = arena_for(slab, size);
+    slab_object_t* object = (slab_object_t*)ptr;
+
+    pthread_mutex_lock(&arena->lock);
+    object->next = arena->free_list;
+    arena->free_list = object;
+    pthread_mutex_unlock(&arena->lock);
+}
+
+// Bytes reserved from the system for chunks
+size_t slab_reserved_bytes(slab_allocator_t* slab) {
+    if (!slab) return 0;
+    pthread_mutex_lock(&slab->chunks_lock);
+    size_t reserved = slab->reserved;
+    pthread_mutex_unlock(&slab->chunks_lock);
+    return reserved;
+}
@@ -0,0 +1,34 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+// Size-class slab allocator for small, fixed-layout records.
+//
+// Objects up to SLAB_MAX_SIZE bytes are carved from 64 KiB chunks and
+// recycled through per-class free lists; larger requests fall through to
+// malloc. Free lists are split across a few arenas chosen per thread, so
+// concurrent allocators rarely share a lock. Chunks are only returned to
+// the system by slab_destroy(). The caller passes the object size back to
+// slab_free(); a NULL allocator means plain malloc/free.
+
+#define SLAB_MAX_SIZE 512
+
+typedef struct slab_allocator slab_allocator_t;
+
+// Create an allocator
+slab_allocator_t* slab_create(void);
+
+// Destroy an allocator and every object allocated from it
+void slab_destroy(slab_allocator_t* slab);
+
+// Allocate size bytes (16-byte aligned)
+void* slab_alloc(slab_allocator_t* slab, size_t size);
+
+// Return an object; size must match the slab_alloc() request
+void slab_free(slab_allocator_t* slab, void* ptr, size_t size);
+
+// Bytes reserved from the system for chunks
+size_t slab_reserved_bytes(slab_allocator_t* slab);
+
+#endif // SLAB_H
@@ -0,0 +1,563 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "../src/api/cache.h"
+#include "../src/api/router.h"
+#include "../src/api/routes.h"
+#include "../src/api/stream.h"
+#include "../src/api/writer.h"
+#include "../src/network/vxlan.h"
+#include "../src/storage/memory.h"
+#include "../src/utils/logging.h"
+
+// Values written to exercise buffer growth
+#define GROWTH_VALUES 100000
+// Endpoints of a streamed listing: several pages and a partial one
+#define STREAM_ENDPOINTS (3 * LIST_STREAM_PAGE + 10)
+#define STREAM_NETWORKS (LIST_STREAM_PAGE + 1)
+// Bytes read from a stream at a time, to split records across reads
+#define STREAM_READ_SIZE 100
+// Threads caching one record at once
+#define CACHE_THREADS 4
+// The API description the route table mirrors, read from the repository root
+#define OPENAPI_PATH "api/openapi.yaml"
+#define NETWORK_ID "6f1c2a3b-4d5e-4f60-8a7b-9c0d1e2f3a4b"
+#define ENDPOINT_ID "0a1b2c3d-4e5f-4a6b-8c7d-8e9f0a1b2c3d"
+#define HOST_ID "host-7"
+
+// Take a writer's text as a NUL-terminated string; NULL if writing failed
+static char* take_text(writer_t* writer) {
+    size_t len;
+    char* data = writer_take(writer, &len);
+    if (!data) return NULL;
+    char* text = strndup(data, len);
+    writer_buffer_free(data);
+    return text;
+}
+
+static bool expect_text(writer_t* writer, const char* expected) {
+    char* text = take_text(writer);
+    bool ok = text && strcmp(text, expected) == 0;
+    if (!ok) {
+        printf("Expected %s\n     got %s\n", expected, text ? text : "(failed)");
+    }
+    free(text);
+    return ok;
+}
+
+// Commas, nesting, escaping and integers
+static bool test_writer_values(void) {
+    writer_t writer;
+    writer_init(&writer);
+    writer_begin_object(&writer);
+    writer_key(&writer, "text");
+    writer_string(&writer, "a\"b\\c\nd\te\x01/");
+    writer_key(&writer, "numbers");
+    writer_begin_array(&writer);
+    writer_int(&writer, 0);
+    writer_int(&writer, -42);
+    writer_int(&writer, INT64_MAX);
+    writer_int(&writer, INT64_MIN);
+    writer_end_array(&writer);
+    writer_key(&writer, "empty");
+    writer_begin_object(&writer);
+    writer_end_object(&writer);
+    writer_key(&writer, "nested");
+    writer_begin_array(&writer);
+    writer_begin_array(&writer);
+    writer_end_array(&writer);
+    writer_raw(&writer, "{\"k\":1}", 7);
+    writer_string(&writer, "");
+    writer_end_array(&writer);
+    writer_end_object(&writer);
+
+    return expect_text(&writer,
+                       "{\"text\":\"a\\\"b\\\\c\\nd\\te\\u0001/\","
+                       "\"numbers\":[0,-42,9223372036854775807,-9223372036854775808],"
+                       "\"empty\":{},\"nested\":[[],{\"k\":1},\"\"]}");
+}
+
+// Networks and endpoints in their API representation
+static bool test_writer_records(void) {
+    vxlan_network_t* network = vxlan_create_network("tenant-1", "net \"one\"", 4097, NULL);
+    vxlan_mac_t mac = {{0x02, 0x00, 0x00, 0x00, 0x00, 0x01}};
+    vxlan_ip_t ip, vtep;
+    vxlan_ip_parse("10.0.0.1", &ip);
+    vxlan_ip_parse("2001:db8::1", &vtep);
+    vxlan_endpoint_t* endpoint = network ? vxlan_create_endpoint(&network->id, &mac, &ip, "host-1", &vtep) : NULL;
+    if (!network || !endpoint) {
+        vxlan_free_network(network);
+        return false;
+    }
+
+    char id[VXLAN_UUID_STR_SIZE], endpoint_id[VXLAN_UUID_STR_SIZE];
+    char created[VXLAN_TIME_STR_SIZE], updated[VXLAN_TIME_STR_SIZE];
+    char endpoint_created[VXLAN_TIME_STR_SIZE], endpoint_updated[VXLAN_TIME_STR_SIZE];
+    vxlan_uuid_format(&network->id, id);
+    vxlan_uuid_format(&endpoint->id, endpoint_id);
+    vxlan_time_format(network->created_at, created);
+    vxlan_time_format(network->updated_at, updated);
+    vxlan_time_format(endpoint->created_at, endpoint_created);
+    vxlan_time_format(endpoint->updated_at, endpoint_updated);
+
+    char expected[1024];
+    snprintf(expected, sizeof(expected),
+             "[{\"id\":\"%s\",\"tenant_id\":\"tenant-1\",\"name\":\"net \\\"one\\\"\",\"vni\":4097,"
+             "\"created_at\":\"%s\",\"updated_at\":\"%s\"},"
+             "{\"id\":\"%s\",\"network_id\":\"%s\",\"mac_address\":\"02:00:00:00:00:01\","
+             "\"ip_address\":\"10.0.0.1\",\"host_id\":\"host-1\",\"vtep_ip\":\"2001:db8::1\","
+             "\"created_at\":\"%s\",\"updated_at\":\"%s\"}]",
+             id, created, updated, endpoint_id, id, endpoint_created, endpoint_updated);
+
+    writer_t writer;
+    writer_init(&writer);
+    writer_begin_array(&writer);
+    writer_network(&writer, network);
+    writer_endpoint(&writer, endpoint);
+    writer_end_array(&writer);
+    bool ok = expect_text(&writer, expected);
+
+    vxlan_free_endpoint(endpoint);
+    vxlan_free_network(network);
+    return ok;
+}
+
+// Growth past the initial buffer, and reuse of a released small buffer
+static bool test_writer_buffers(void) {
+    writer_t writer;
+    writer_init(&writer);
+    writer_begin_array(&writer);
+    for (int i = 0; i < GROWTH_VALUES; i++) {
+        writer_int(&writer, i);
+    }
+    writer_end_array(&writer);
+    char* text = take_text(&writer);
+    bool ok = text && text[0] == '[' && strstr(text, ",99999]") && strncmp(text, "[0,1,2,", 7) == 0;
+    free(text);
+
+    writer_init(&writer);
+    writer_string(&writer, "small");
+    size_t len;
+    char* first = writer_take(&writer, &len);
+    writer_buffer_free(first);
+    writer_init(&writer);
+    ok = ok && first && writer.data == first && writer.len == 0;
+    writer_free(&writer);
+    return ok;
+}
+
+// Read a whole stream into a NUL-terminated string, checking that its
+// buffer stays within one page; NULL on failure
+static char* read_stream(list_stream_t* stream) {
+    size_t len = 0, capacity = 4096;
+    char* text = malloc(capacity);
+    bool ok = stream && text;
+    while (ok) {
+        if (len + STREAM_READ_SIZE + 1 > capacity) {
+            char* grown = realloc(text, capacity *= 2);
+            if (!grown) break;
+            text = grown;
+        }
+        ssize_t n = list_stream_read(stream, text + len, STREAM_READ_SIZE);
+        ok = n >= 0 && stream->writer.capacity <= WRITER_SPARE_MAX;
+        if (n <= 0) break;
+        len += (size_t)n;
+    }
+    list_stream_free(stream);
+    if (!ok) {
+        free(text);
+        return NULL;
+    }
+    text[len] = '\0';
+    return text;
+}
+
+static int count_of(const char* text, const char* needle) {
+    int count = 0;
+    for (const char* p = text; (p = strstr(p, needle)); p++) {
+        count++;
+    }
+    return count;
+}
+
+// Streamed endpoint and network listings: every record once, in order,
+// across pages and reads, with records deleted mid-stream left out
+static bool test_list_stream(void) {
+    vxlan_network_t* network = vxlan_create_network("stream-tenant", "stream", 0, NULL);
+    vxlan_network_t* empty = vxlan_create_network("stream-tenant", "empty", 0, NULL);
+    if (!network || !empty || !storage_save_network(network) || !storage_save_network(empty)) return false;
+    for (int i = 1; i < STREAM_NETWORKS - 1; i++) {
+        vxlan_network_t* other = vxlan_create_network("stream-tenant", "other", 0, NULL);
+        if (!other || !storage_save_network(other)) return false;
+    }
+    vxlan_network_t* foreign = vxlan_create_network("other-tenant", "foreign", 0, NULL);
+    if (!foreign || !storage_save_network(foreign)) return false;
+
+    vxlan_ip_t vtep;
+    vxlan_ip_parse("192.0.2.1", &vtep);
+    for (int i = 0; i < STREAM_ENDPOINTS; i++) {
+        vxlan_mac_t mac = {{0x02, 0x00, 0x00, 0x00, (uint8_t)(i >> 8), (uint8_t)i}};
+        vxlan_ip_t ip = { AF_INET, {10, 0, (uint8_t)(i >> 8), (uint8_t)i} };
+        vxlan_endpoint_t* endpoint = vxlan_create_endpoint(&network->id, &mac, &ip, "host1", &vtep);
+        if (!endpoint || !storage_save_endpoint(endpoint)) return false;
+    }
+
+    // Whole listing: ids strictly increasing, so none twice
+    char* text = read_stream(list_stream_endpoints(&network->id));
+    bool ok = text && text[0] == '[' && text[strlen(text) - 1] == ']' &&
+              count_of(text, "\"mac_address\"") == STREAM_ENDPOINTS;
+    char previous[VXLAN_UUID_STR_SIZE] = "";
+    for (const char* p = text; ok && (p = strstr(p, "{\"id\":\"")); p++) {
+        ok = strncmp(p + 7, previous, VXLAN_UUID_STR_SIZE - 1) > 0;
+        memcpy(previous, p + 7, VXLAN_UUID_STR_SIZE - 1);
+    }
+    free(text);
+
+    // The first page is read when the stream starts; the last endpoint is
+    // deleted before its page is, so it is left out
+    int count;
+    storage_read_begin();
+    vxlan_endpoint_t** endpoints = storage_list_endpoints_page(&network->id, NULL, STREAM_ENDPOINTS, &count);
+    list_stream_t* stream = list_stream_endpoints(&network->id);
+    ok = ok && endpoints && count == STREAM_ENDPOINTS && stream &&
+         storage_delete_endpoint(&network->id, &endpoints[count - 1]->id);
+    storage_read_end();
+    free(endpoints);
+    text = read_stream(stream);
+    ok = ok && text && count_of(text, "\"mac_address\"") == STREAM_ENDPOINTS - 1;
+    free(text);
+
+    text = read_stream(list_stream_endpoints(&empty->id));
+    ok = ok && text && strcmp(text, "[]") == 0;
+    free(text);
+
+    text = read_stream(list_stream_networks("stream-tenant"));
+    ok = ok && text && count_of(text, "\"vni\"") == STREAM_NETWORKS;
+    free(text);
+    text = read_stream(list_stream_networks(NULL));
+    ok = ok && text && count_of(text, "\"vni\"") == STREAM_NETWORKS + 1;
+    free(text);
+    text = read_stream(list_stream_networks("no-such-tenant"));
+    ok = ok && text && strcmp(text, "[]") == 0;
+    free(text);
+    return ok;
+}
+
+// Entity tags and If-None-Match lists
+static bool test_etags(void) {
+    char etag[CACHE_ETAG_SIZE];
+    cache_etag(0x1234abcdULL, etag);
+    if (strcmp(etag, "\"000000001234abcd\"") != 0) {
+        printf("Unexpected entity tag %s\n", etag);
+        return false;
+    }
+    return cache_etag_matches(etag, etag) &&
+           cache_etag_matches("\"x\", W/\"000000001234abcd\"", etag) &&
+           cache_etag_matches(" \"x\" ,\"000000001234abcd\"", etag) &&
+           cache_etag_matches("*", etag) &&
+           !cache_etag_matches("", etag) &&
+           !cache_etag_matches("\"000000001234abcd", etag) &&
+           !cache_etag_matches("000000001234abcd", etag) &&
+           !cache_etag_matches("\"000000001234abc\"", etag) &&
+           !cache_etag_matches("\"000000001234abcde\"", etag);
+}
+
+static void* cache_worker(void* arg) {
+    return (void*)cache_endpoint(arg);
+}
+
+// A record's JSON is cached once, matches what the writer produces, and is
+// what listings copy; concurrent misses settle on one copy
+static bool test_record_cache(void) {
+    vxlan_network_t* network = vxlan_create_network("cache-tenant", "cache", 0, "cached");
+    if (!network || !storage_save_network(network)) return false;
+    vxlan_mac_t mac = {{0x02, 0, 0, 0, 0, 1}};
+    vxlan_ip_t ip, vtep;
+    vxlan_ip_parse("10.0.0.1", &ip);
+    vxlan_ip_parse("192.0.2.1", &vtep);
+    vxlan_endpoint_t* endpoint = vxlan_create_endpoint(&network->id, &mac, &ip, "host1", &vtep);
+    if (!endpoint || !storage_save_endpoint(endpoint)) return false;
+
+    writer_t writer;
+    writer_init(&writer);
+    writer_network(&writer, network);
+    char* expected = take_text(&writer);
+    const struct vxlan_json* json = cache_network(network);
+    bool ok = expected && json && json->len == strlen(expected) && memcmp(json->data, expected, json->len) == 0 &&
+              cache_network(network) == json;
+    free(expected);
+
+    // Listings copy the cached bytes, so a listing shows what is cached
+    writer_init(&writer);
+    writer_begin_array(&writer);
+    cache_write_network(&writer, network);
+    cache_write_network(&writer, network);
+    writer_end_array(&writer);
+    char* text = take_text(&writer);
+    ok = ok && text && count_of(text, "\"cached\"") == 2 && text[json->len + 1] == ',';
+    free(text);
+
+    pthread_t threads[CACHE_THREADS];
+    void* results[CACHE_THREADS];
+    for (int i = 0; i < CACHE_THREADS; i++) {
+        pthread_create(&threads[i], NULL, cache_worker, endpoint);
+    }
+    for (int i = 0; i < CACHE_THREADS; i++) {
+        pthread_join(threads[i], &results[i]);
+        ok = ok && results[i] && results[i] == results[0];
+    }
+    ok = ok && cache_endpoint(endpoint) == results[0];
+
+    // Copies of an endpoint, as events carry, leave the cache with the record
+    vxlan_endpoint_t copy;
+    vxlan_copy_endpoint(&copy, endpoint);
+    ok = ok && copy.version == endpoint->version && atomic_load(&copy.json) == NULL;
+    return ok;
+}
+
+// The sample value a path parameter of the API description stands for
+static const char* sample_value(const char* name, size_t len) {
+    if (len == strlen("network_id") && memcmp(name, "network_id", len) == 0) return NETWORK_ID;
+    if (len == strlen("endpoint_id") && memcmp(name, "endpoint_id", len) == 0) return ENDPOINT_ID;
+    if (len == strlen("host_id") && memcmp(name, "host_id", len) == 0) return HOST_ID;
+    return NULL;
+}
+
+// Match one operation of the API description against the route table: a
+// request to its path, with sample parameters, must reach the route named
+// by its operationId and bring the parameters back in order
+static bool check_operation(const router_t* router, const char* method, const char* path, const char* operation,
+                            bool* covered) {
+    char url[256] = API_BASE_PATH;
+    const char* expected[ROUTER_MAX_PARAMS];
+    int params = 0;
+    for (const char* p = path; *p;) {
+        const char* close = *p == '{' ? strchr(p, '}') : NULL;
+        if (close) {
+            const char* value = sample_value(p + 1, (size_t)(close - p - 1));
+            if (!value || params == ROUTER_MAX_PARAMS) {
+                printf("Unknown parameter in %s\n", path);
+                return false;
+            }
+            expected[params++] = value;
+            strncat(url, value, sizeof(url) - strlen(url) - 1);
+            p = close + 1;
+        } else {
+            strncat(url, p, 1);
+            p++;
+        }
+    }
+
+    route_match_t match;
+    if (router_match(router, method, url, &match) != ROUTER_FOUND ||
+        strcmp(api_routes[match.route].name, operation) != 0 || match.count != params) {
+        printf("%s %s does not reach %s\n", method, url, operation);
+        return false;
+    }
+    for (int i = 0; i < params; i++) {
+        if (match.params[i].len != strlen(expected[i]) ||
+            memcmp(match.params[i].value, expected[i], match.params[i].len) != 0) {
+            printf("%s %s: parameter %d is %.*s\n", method, url, i, (int)match.params[i].len,
+                   match.params[i].value);
+            return false;
+        }
+    }
+    covered[match.route] = true;
+    return true;
+}
+
+// Every operation of the API description reaches its route, and every
+// route is one of them
+static bool test_routes(void) {
+    FILE* file = fopen(OPENAPI_PATH, "r");
+    router_t* router = router_compile(api_routes, API_ROUTE_COUNT);
+    if (!file || !router) {
+        printf("Failed to open %s or compile the routes\n", OPENAPI_PATH);
+        if (file) {
+            fclose(file);
+        }
+        router_free(router);
+        return false;
+    }
+
+    // paths: maps "  /path:" to "    method:" to "      operationId: name"
+    bool covered[API_ROUTE_COUNT] = {false};
+    char line[512], path[256] = "", method[16] = "";
+    bool in_paths = false, ok = true;
+    int operations = 0;
+    while (ok && fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        size_t indent = strspn(line, " ");
+        if (indent == 0 && line[0]) {
+            in_paths = strcmp(line, "paths:") == 0;
+        } else if (!in_paths) {
+            continue;
+        } else if (indent == 2 && line[2] == '/') {
+            snprintf(path, sizeof(path), "%.*s", (int)strcspn(line + 2, ":"), line + 2);
+            method[0] = '\0';
+        } else if (indent == 4 && islower((unsigned char)line[4])) {
+            // A method, or a path-level key such as parameters
+            size_t len = strcspn(line + 4, ":");
+            method[0] = '\0';
+            if (len < sizeof(method) && line[4 + len] == ':' && !line[5 + len]) {
+                for (size_t i = 0; i < len; i++) {
+                    method[i] = (char)toupper((unsigned char)line[4 + i]);
+                }
+                method[len] = '\0';
+                if (strcmp(method, "GET") != 0 && strcmp(method, "POST") != 0 && strcmp(method, "PUT") != 0 &&
+                    strcmp(method, "PATCH") != 0 && strcmp(method, "DELETE") != 0) {
+                    method[0] = '\0';
+                }
+            }
+        } else if (indent == 6 && method[0] && strncmp(line + 6, "operationId: ", 13) == 0) {
+            ok = check_operation(router, method, path, line + 19, covered);
+            operations++;
+        }
+    }
+    fclose(file);
+    router_free(router);
+
+    if (ok && operations != API_ROUTE_COUNT) {
+        printf("%s has %d operations, the route table %d\n", OPENAPI_PATH, operations, API_ROUTE_COUNT);
+        ok = false;
+    }
+    for (int i = 0; ok && i < API_ROUTE_COUNT; i++) {
+        if (!covered[i]) {
+            printf("Route %s is not in %s\n", api_routes[i].name, OPENAPI_PATH);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static router_result_t match_route(const router_t* router, const char* method, const char* url, int* route) {
+    route_match_t match;
+    router_result_t result = router_match(router, method, url, &match);
+    *route = match.route;
+    return result;
+}
+
+// Misses, 405s, literal segments before parameters, and bad tables
+static bool test_router(void) {
+    router_t* router = router_compile(api_routes, API_ROUTE_COUNT);
+    if (!router) return false;
+
+    // A path with other methods is a 405 naming them
+    route_match_t match;
+    char allow[64];
+    bool ok = router_match(router, "PUT", API_BASE_PATH "/networks", &match) == ROUTER_METHOD_NOT_ALLOWED;
+    router_format_allowed(match.allowed, allow, sizeof(allow));
+    ok = ok && strcmp(allow, "GET, POST") == 0;
+    ok = ok && router_match(router, NULL, API_BASE_PATH "/networks/" NETWORK_ID, &match) ==
+                   ROUTER_METHOD_NOT_ALLOWED;
+    router_format_allowed(match.allowed, allow, sizeof(allow));
+    ok = ok && strcmp(allow, "GET, DELETE") == 0;
+
+    // The routes the old prefix matching sent elsewhere or nowhere
+    int route;
+    ok = ok && match_route(router, "POST", API_BASE_PATH "/networks/" NETWORK_ID "/endpoints", &route) ==
+                   ROUTER_FOUND && route == ROUTE_ADD_ENDPOINT;
+    ok = ok && match_route(router, "GET", API_BASE_PATH "/networks/" NETWORK_ID "/endpoints/" ENDPOINT_ID,
+                           &route) == ROUTER_FOUND && route == ROUTE_GET_ENDPOINT;
+
+    // Near misses
+    const char* misses[] = {
+        "", "/", "/api", "/api/", "/api/v1x/lookup", API_BASE_PATH, API_BASE_PATH "/", API_BASE_PATH "/networks/", API_BASE_PATH "/networks//endpoints",
+        API_BASE_PATH "/networksx", "/api/v2/networks", API_BASE_PATH "/watch/", API_BASE_PATH "/hosts//fdb",
+        API_BASE_PATH "/hosts/" HOST_ID, API_BASE_PATH "/hosts/" HOST_ID "/fdb/x",
+        API_BASE_PATH "/networks/" NETWORK_ID "/endpoints/" ENDPOINT_ID "/x", "api/v1/networks",
+    };
+    for (size_t i = 0; ok && i < sizeof(misses) / sizeof(misses[0]); i++) {
+        if (match_route(router, "GET", misses[i], &route) != ROUTER_NOT_FOUND) {
+            printf("GET %s matched route %d\n", misses[i], route);
+            ok = false;
+        }
+    }
+    router_free(router);
+
+    // A literal wins over a parameter, and a dead-end literal falls back
+    // to the parameter
+    const route_t routes[] = {
+        {"GET", "/a/{x}/c", "param"},
+        {"GET", "/a/b", "literal"},
+        {"DELETE", "/a/{x}", "delete"},
+    };
+    router = router_compile(routes, 3);
+    if (!router) return false;
+    ok = ok && router_match(router, "GET", "/a/b", &match) == ROUTER_FOUND && match.route == 1 && match.count == 0;
+    ok = ok && router_match(router, "GET", "/a/b/c", &match) == ROUTER_FOUND && match.route == 0 &&
+         match.count == 1 && match.params[0].len == 1 && match.params[0].value[0] == 'b';
+    ok = ok && router_match(router, "DELETE", "/a/b", &match) == ROUTER_FOUND && match.route == 2;
+    ok = ok && router_match(router, "GET", "/a/z", &match) == ROUTER_METHOD_NOT_ALLOWED &&
+         match.allowed == 1u << ROUTER_DELETE;
+    router_free(router);
+
+    // Malformed templates, unknown methods and duplicates, which the
+    // router logs as errors
+    logging_set_level(LOG_LEVEL_FATAL);
+    const route_t bad[][2] = {
+        {{"GET", "/a//b", "empty"}},
+        {{"GET", "a", "relative"}},
+        {{"GET", "/a/{}", "unnamed"}},
+        {{"GET", "/a/{x", "unclosed"}},
+        {{"GET", "/a/x}", "stray"}},
+        {{"GET", "/a/{x}y", "mixed"}},
+        {{"GET", "/{a}/{b}/{c}/{d}/{e}", "many"}},
+        {{"TRACE", "/a", "method"}},
+        {{"GET", "/a/{x}", "first"}, {"GET", "/a/{y}", "second"}},
+    };
+    for (size_t i = 0; ok && i < sizeof(bad) / sizeof(bad[0]); i++) {
+        errno = 0;
+        router = router_compile(bad[i], bad[i][1].method ? 2 : 1);
+        if (router || errno != EINVAL) {
+            printf("Route %s compiled\n", bad[i][0].name);
+            router_free(router);
+            ok = false;
+        }
+    }
+    logging_set_level(LOG_LEVEL_ERROR);
+    return ok;
+}
+
+int main(void) {
+    logging_set_level(LOG_LEVEL_ERROR);
+
+    printf("Running API tests...\n\n");
+
+    struct {
+        const char* name;
+        bool (*run)(void);
+    } tests[] = {
+        {"writer values", test_writer_values},
+        {"writer records", test_writer_records},
+        {"writer buffers", test_writer_buffers},
+        {"list streams", test_list_stream},
+        {"entity tags", test_etags},
+        {"record cache", test_record_cache},
+        {"routes", test_routes},
+        {"router", test_router},
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        printf("Testing %s...\n", tests[i].name);
+        if (!storage_init()) {
+            printf("Failed to initialize storage\n");
+            return 1;
+        }
+        bool passed = tests[i].run();
+        storage_cleanup();
+        if (!passed) {
+            printf("%s test failed\n", tests[i].name);
+            return 1;
+        }
+        printf("%s test passed\n\n", tests[i].name);
+    }
+
+    printf("All tests passed!\n");
+    return 0;
+}
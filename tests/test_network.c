@@ -22,7 +22,9 @@ static bool test_create_network(void) {
     }
 
     char response[4096] = {0};
-    const char* json = "{\"tenant_id\":\"tenant1\",\"name\":\"test-network\",\"vni\":1000,\"description\":\"Test network\"}";
+    // No vni: the service allocates a free one, so reruns against a
+    // persisted log do not collide with the VNI of an earlier run
+    const char* json = "{\"tenant_id\":\"tenant1\",\"name\":\"test-network\",\"description\":\"Test network\"}";
 
     curl_easy_setopt(curl, CURLOPT_URL, "http://localhost:18080/api/v1/networks");
     curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json);
@@ -0,0 +1,1446 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../src/network/vxlan.h"
+#include "../src/storage/fdb.h"
+#include "../src/storage/idtable.h"
+#include "../src/storage/memory.h"
+#include "../src/storage/intern.h"
+#include "../src/storage/vni.h"
+#include "../src/utils/logging.h"
+
+#define STRESS_WRITERS 4
+#define STRESS_READERS 4
+#define STRESS_WRITES_PER_WRITER 20000
+// Endpoints each writer keeps alive in its network
+#define STRESS_LIVE_ENDPOINTS 64
+#define INTERN_THREADS 4
+#define INTERN_VALUES 1000
+#define VNI_THREADS 4
+#define VNI_NETWORKS_PER_THREAD 1000
+#define PAGE_ENDPOINTS 250
+#define PAGE_LIMIT 32
+#define SNAPSHOT_WRITERS 2
+#define SNAPSHOT_WRITES_PER_WRITER 2000
+#define MVCC_READERS 3
+#define MVCC_ROTATIONS 5000
+#define MVCC_FIXED_ENDPOINTS 64
+// Enough saves and deletes to overrun the change feed
+#define FEED_OVERRUN 20000
+#define SHARD_TENANTS 16
+#define ID_TABLE_NODES 20000
+#define SHARD_NETWORKS_PER_TENANT 2
+
+static atomic_bool writers_done;
+
+// Deterministic id for a network; saved with save_test_network() or only
+// referenced
+static vxlan_uuid_t test_uuid(int n) {
+    vxlan_uuid_t uuid = {{0}};
+    memcpy(uuid.bytes, &n, sizeof(n));
+    return uuid;
+}
+
+// Save a network with id test_uuid(n), so endpoints can be saved into it
+static bool save_test_network(int n) {
+    vxlan_network_t fields = { .tenant_id = "tenant-test", .name = "test" };
+    fields.id = test_uuid(n);
+    vxlan_network_t* network = vxlan_restore_network(&fields);
+    if (!network || !storage_save_network(network)) {
+        vxlan_free_network(network);
+        return false;
+    }
+    return true;
+}
+
+// Create an endpoint on a host; every call gets a new MAC and IP address
+static vxlan_endpoint_t* host_endpoint(const vxlan_uuid_t* network_id, const char* host_id) {
+    static atomic_uint next_address;
+    unsigned int n = atomic_fetch_add(&next_address, 1);
+    vxlan_mac_t mac = {{0x00, 0x11, (n >> 24) & 0xff, (n >> 16) & 0xff, (n >> 8) & 0xff, n & 0xff}};
+    vxlan_ip_t ip, vtep;
+    char ip_str[16];
+    snprintf(ip_str, sizeof(ip_str), "10.%u.%u.%u", (n >> 16) & 0xff, (n >> 8) & 0xff, n & 0xff);
+    vxlan_ip_parse(ip_str, &ip);
+    vxlan_ip_parse("10.0.0.1", &vtep);
+    return vxlan_create_endpoint(network_id, &mac, &ip, host_id, &vtep);
+}
+
+static vxlan_endpoint_t* test_endpoint(const vxlan_uuid_t* network_id) {
+    return host_endpoint(network_id, "host1");
+}
+
+// Test basic save/get/delete of networks and endpoints
+static bool test_save_get_delete(void) {
+    vxlan_network_t* network = vxlan_create_network("tenant1", "net1", 1000, "Test network");
+    if (!network || !storage_save_network(network)) {
+        printf("Failed to save network\n");
+        return false;
+    }
+    vxlan_uuid_t network_id = network->id;
+
+    vxlan_endpoint_t* endpoint = test_endpoint(&network_id);
+    if (!endpoint || !storage_save_endpoint(endpoint)) {
+        printf("Failed to save endpoint\n");
+        return false;
+    }
+    vxlan_uuid_t endpoint_id = endpoint->id;
+
+    if (storage_get_network(&network_id) != network ||
+        storage_get_endpoint(&network_id, &endpoint_id) != endpoint ||
+        storage_get_endpoint(NULL, &endpoint_id) != endpoint) {
+        printf("Lookup returned the wrong record\n");
+        return false;
+    }
+    vxlan_uuid_t other = test_uuid(1);
+    if (storage_get_endpoint(&other, &endpoint_id) != NULL) {
+        printf("Endpoint found under the wrong network\n");
+        return false;
+    }
+
+    if (!storage_delete_endpoint(&network_id, &endpoint_id) ||
+        storage_delete_endpoint(&network_id, &endpoint_id) ||
+        storage_get_endpoint(NULL, &endpoint_id) != NULL) {
+        printf("Endpoint delete failed\n");
+        return false;
+    }
+    if (!storage_delete_network(&network_id) || storage_get_network(&network_id) != NULL) {
+        printf("Network delete failed\n");
+        return false;
+    }
+    return true;
+}
+
+// Test listing through the tenant and network indexes
+static bool test_list_indexes(void) {
+    vxlan_network_t* a = vxlan_create_network("tenant-a", "a", 1, NULL);
+    vxlan_network_t* b = vxlan_create_network("tenant-b", "b", 2, NULL);
+    if (!a || !b || !storage_save_network(a) || !storage_save_network(b)) {
+        printf("Failed to save networks\n");
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        vxlan_endpoint_t* endpoint = test_endpoint(&a->id);
+        if (!endpoint || !storage_save_endpoint(endpoint)) {
+            printf("Failed to save endpoint\n");
+            return false;
+        }
+    }
+
+    int count;
+    vxlan_network_t** networks = storage_list_networks("tenant-a", &count);
+    bool ok = networks && count == 1 && networks[0] == a;
+    storage_free_network_array(networks, count);
+    if (!ok) {
+        printf("Tenant listing returned %d networks, expected 1\n", count);
+        return false;
+    }
+
+    networks = storage_list_networks("tenant-none", &count);
+    ok = networks && count == 0;
+    storage_free_network_array(networks, count);
+    if (!ok) {
+        printf("Empty tenant listing failed\n");
+        return false;
+    }
+
+    vxlan_endpoint_t** endpoints = storage_list_endpoints(&a->id, &count);
+    ok = endpoints && count == 3;
+    storage_free_endpoint_array(endpoints, count);
+    if (!ok) {
+        printf("Endpoint listing returned %d endpoints, expected 3\n", count);
+        return false;
+    }
+
+    endpoints = storage_list_endpoints(&b->id, &count);
+    ok = endpoints && count == 0;
+    storage_free_endpoint_array(endpoints, count);
+    if (!ok) {
+        printf("Empty endpoint listing failed\n");
+        return false;
+    }
+    return true;
+}
+
+// Page through a network's endpoints, deleting the last endpoint of every
+// page before asking for the next; returns how many were seen, or -1 when
+// the ids are not strictly increasing
+static int page_endpoints(const vxlan_uuid_t* network_id) {
+    vxlan_uuid_t after;
+    bool has_after = false;
+    int seen = 0;
+
+    for (;;) {
+        int count;
+        vxlan_endpoint_t** page = storage_list_endpoints_page(network_id, has_after ? &after : NULL,
+                                                              PAGE_LIMIT, &count);
+        if (!page) return -1;
+        for (int i = 0; i < count; i++) {
+            if (has_after && memcmp(page[i]->id.bytes, after.bytes, sizeof(after.bytes)) <= 0) {
+                storage_free_endpoint_array(page, count);
+                return -1;
+            }
+            after = page[i]->id;
+            has_after = true;
+        }
+        seen += count;
+        storage_free_endpoint_array(page, count);
+        if (count < PAGE_LIMIT) return seen;
+        if (!storage_delete_endpoint(network_id, &after)) return -1;
+    }
+}
+
+// Test paged listings: id order, and a cursor that outlives its record
+static bool test_list_pages(void) {
+    vxlan_network_t* network = vxlan_create_network("tenant-a", "a", 1, NULL);
+    if (!network || !storage_save_network(network)) return false;
+    for (int i = 0; i < PAGE_ENDPOINTS; i++) {
+        vxlan_endpoint_t* endpoint = test_endpoint(&network->id);
+        if (!endpoint || !storage_save_endpoint(endpoint)) return false;
+    }
+
+    int seen = page_endpoints(&network->id);
+    if (seen != PAGE_ENDPOINTS) {
+        printf("Paging saw %d endpoints, expected %d\n", seen, PAGE_ENDPOINTS);
+        return false;
+    }
+
+    // Networks page the same way, with and without a tenant filter
+    for (int i = 0; i < 4; i++) {
+        vxlan_network_t* other = vxlan_create_network(i % 2 ? "tenant-a" : "tenant-b", "n", 0, NULL);
+        if (!other || !storage_save_network(other)) return false;
+    }
+    int count, more = 0;
+    vxlan_network_t** first = storage_list_networks_page(NULL, NULL, 3, &count);
+    vxlan_network_t** rest = first && count == 3 ? storage_list_networks_page(NULL, &first[2]->id, 3, &more) : NULL;
+    bool ok = rest && more == 2 && memcmp(first[2]->id.bytes, rest[0]->id.bytes, sizeof(rest[0]->id.bytes)) < 0;
+    storage_free_network_array(first, count);
+    storage_free_network_array(rest, more);
+    vxlan_network_t** tenant = storage_list_networks_page("tenant-a", NULL, 10, &count);
+    ok = ok && tenant && count == 3;
+    storage_free_network_array(tenant, count);
+    if (!ok) {
+        printf("Network paging returned the wrong pages\n");
+    }
+    return ok;
+}
+
+// Restart storage from the log at path
+static bool reopen_storage(const char* path) {
+    storage_cleanup();
+    return storage_init() && storage_open_log(path, WAL_SYNC_GROUP);
+}
+
+// Test that saves and deletes survive a restart, and that a torn record at
+// the end of the log is dropped
+static bool test_log_replay(void) {
+    char path[] = "/tmp/test_storage_wal_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return false;
+    close(fd);
+
+    bool ok = storage_open_log(path, WAL_SYNC_GROUP);
+    vxlan_network_t* kept = vxlan_create_network("tenant-log", "kept", 10, "survives");
+    vxlan_network_t* dropped = vxlan_create_network("tenant-log", "dropped", 11, NULL);
+    ok = ok && kept && dropped && storage_save_network(kept) && storage_save_network(dropped);
+    vxlan_uuid_t kept_id = kept->id, dropped_id = dropped->id;
+    int64_t created_at = kept->created_at;
+    vxlan_uuid_t endpoint_ids[3];
+    for (int i = 0; ok && i < 3; i++) {
+        vxlan_endpoint_t* endpoint = test_endpoint(&kept_id);
+        ok = endpoint && storage_save_endpoint(endpoint);
+        if (ok) endpoint_ids[i] = endpoint->id;
+    }
+    ok = ok && storage_delete_endpoint(&kept_id, &endpoint_ids[1]) && storage_delete_network(&dropped_id);
+
+    for (int round = 0; ok && round < 2; round++) {
+        if (round == 1) {
+            // Simulate a crash in the middle of appending a record
+            FILE* f = fopen(path, "ab");
+            ok = f && fwrite("\x40\0\0\0garbage", 11, 1, f) == 1;
+            if (f) fclose(f);
+        }
+        ok = ok && reopen_storage(path);
+
+        vxlan_network_t* network = storage_get_network(&kept_id);
+        vxlan_endpoint_t* endpoint = storage_get_endpoint(NULL, &endpoint_ids[2]);
+        int count;
+        vxlan_endpoint_t** endpoints = storage_list_endpoints(&kept_id, &count);
+        ok = ok && network && strcmp(network->name, "kept") == 0 && network->vni == 10 &&
+             network->created_at == created_at && strcmp(network->description, "survives") == 0 &&
+             storage_get_network(&dropped_id) == NULL &&
+             endpoints && count == 2 &&
+             storage_get_endpoint(&kept_id, &endpoint_ids[0]) != NULL &&
+             storage_get_endpoint(&kept_id, &endpoint_ids[1]) == NULL &&
+             endpoint && strcmp(endpoint->host_id, "host1") == 0;
+        storage_free_endpoint_array(endpoints, count);
+    }
+
+    unlink(path);
+    if (!ok) {
+        printf("Log replay did not restore the saved state\n");
+    }
+    return ok;
+}
+
+// Create an endpoint with the given addresses
+static vxlan_endpoint_t* address_endpoint(const vxlan_uuid_t* network_id, const char* mac_str,
+                                          const char* ip_str) {
+    vxlan_mac_t mac;
+    vxlan_ip_t ip, vtep;
+    vxlan_mac_parse(mac_str, &mac);
+    vxlan_ip_parse(ip_str, &ip);
+    vxlan_ip_parse("10.0.0.1", &vtep);
+    return vxlan_create_endpoint(network_id, &mac, &ip, "host1", &vtep);
+}
+
+// Test that a MAC or IP is held by one endpoint per network, and lookups
+// by address within a network
+static bool test_address_conflicts(void) {
+    vxlan_uuid_t net = test_uuid(1), other = test_uuid(2);
+    vxlan_endpoint_t* a = address_endpoint(&net, "02:00:00:00:00:01", "10.1.0.1");
+    vxlan_endpoint_t* same_mac = address_endpoint(&net, "02:00:00:00:00:01", "10.1.0.2");
+    vxlan_endpoint_t* same_ip = address_endpoint(&net, "02:00:00:00:00:02", "10.1.0.1");
+    vxlan_endpoint_t* elsewhere = address_endpoint(&other, "02:00:00:00:00:01", "10.1.0.1");
+    if (!a || !same_mac || !same_ip || !elsewhere) return false;
+    vxlan_uuid_t a_id = a->id;
+
+    bool ok = save_test_network(1) && save_test_network(2) && storage_save_endpoint(a);
+    errno = 0;
+    ok = ok && !storage_save_endpoint(same_mac) && errno == EEXIST;
+    errno = 0;
+    ok = ok && !storage_save_endpoint(same_ip) && errno == EEXIST;
+    ok = ok && storage_save_endpoint(elsewhere);
+    if (!ok) {
+        printf("Address conflicts were not detected per network\n");
+        return false;
+    }
+
+    // IPv4 lookups ignore the unused address bytes
+    vxlan_mac_t mac;
+    vxlan_ip_t ip;
+    vxlan_mac_parse("02:00:00:00:00:01", &mac);
+    vxlan_ip_parse("10.1.0.1", &ip);
+    ip.bytes[15] = 0xff;
+    ok = storage_find_endpoint_by_mac(&net, &mac) == a && storage_find_endpoint_by_ip(&net, &ip) == a &&
+         storage_find_endpoint_by_mac(&other, &mac) == elsewhere;
+    vxlan_mac_parse("02:00:00:00:00:09", &mac);
+    ok = ok && storage_find_endpoint_by_mac(&net, &mac) == NULL;
+    if (!ok) {
+        printf("Lookup by address returned the wrong endpoint\n");
+        return false;
+    }
+
+    // Deleting the holder frees both addresses
+    ok = storage_delete_endpoint(&net, &a_id) && storage_save_endpoint(same_mac) &&
+         storage_find_endpoint_by_ip(&net, &ip) == NULL && storage_save_endpoint(same_ip);
+    vxlan_mac_parse("02:00:00:00:00:01", &mac);
+    ok = ok && storage_find_endpoint_by_mac(&net, &mac) == same_mac &&
+         storage_find_endpoint_by_ip(&net, &ip) == same_ip;
+    if (!ok) {
+        printf("Deleted endpoint still held its addresses\n");
+    }
+    return ok;
+}
+
+// Test address lookups by VNI
+static bool test_vni_lookup(void) {
+    vxlan_network_t* network = vxlan_create_network("tenant1", "net1", 100, NULL);
+    if (!network || !storage_save_network(network)) return false;
+    vxlan_uuid_t network_id = network->id;
+    vxlan_endpoint_t* endpoint = address_endpoint(&network_id, "02:00:00:00:01:01", "10.2.0.1");
+    if (!endpoint || !storage_save_endpoint(endpoint)) return false;
+
+    vxlan_mac_t mac;
+    vxlan_ip_t ip;
+    vxlan_mac_parse("02:00:00:00:01:01", &mac);
+    vxlan_ip_parse("10.2.0.1", &ip);
+    bool ok = storage_get_network_by_vni(100) == network && storage_lookup_mac(100, &mac) == endpoint &&
+              storage_lookup_ip(100, &ip) == endpoint && storage_lookup_mac(101, &mac) == NULL;
+    vxlan_ip_parse("10.2.0.2", &ip);
+    ok = ok && storage_lookup_ip(100, &ip) == NULL;
+    if (!ok) {
+        printf("Lookup by VNI returned the wrong record\n");
+        return false;
+    }
+
+    // The VNI leaves the index with its network
+    ok = storage_delete_network(&network_id) && storage_get_network_by_vni(100) == NULL &&
+         storage_lookup_mac(100, &mac) == NULL;
+    if (!ok) {
+        printf("Deleted network still answered lookups\n");
+    }
+    return ok;
+}
+
+// Creates networks without a VNI and records the ones allocated
+static void* vni_worker(void* arg) {
+    uint32_t* vnis = (uint32_t*)arg;
+    for (int i = 0; i < VNI_NETWORKS_PER_THREAD; i++) {
+        vxlan_network_t* network = vxlan_create_network("tenant-vni", "auto", 0, NULL);
+        if (!network || !storage_save_network(network)) {
+            vxlan_free_network(network);
+            return (void*)1;
+        }
+        vnis[i] = network->vni;
+    }
+    return NULL;
+}
+
+// Test that a VNI is held by one network at a time and that omitted VNIs
+// are allocated without collisions, also under concurrent creates
+static bool test_vni(void) {
+    vxlan_network_t* first = vxlan_create_network("tenant-vni", "first", 42, NULL);
+    vxlan_network_t* second = vxlan_create_network("tenant-vni", "second", 42, NULL);
+    bool ok = first && second && storage_save_network(first);
+    vxlan_uuid_t first_id = first->id;
+    errno = 0;
+    ok = ok && !storage_save_network(second) && errno == EEXIST &&
+         storage_delete_network(&first_id) && storage_save_network(second);
+    if (!ok) {
+        printf("Duplicate VNI was not rejected, or not released on delete\n");
+        return false;
+    }
+
+    static uint32_t vnis[VNI_THREADS][VNI_NETWORKS_PER_THREAD];
+    pthread_t threads[VNI_THREADS];
+    for (int t = 0; t < VNI_THREADS; t++) {
+        pthread_create(&threads[t], NULL, vni_worker, vnis[t]);
+    }
+    for (int t = 0; t < VNI_THREADS; t++) {
+        void* result;
+        pthread_join(threads[t], &result);
+        ok &= result == NULL;
+    }
+    // 42 is taken by the second network, everything else must be unique
+    static bool seen[MAX_VNI + 1];
+    memset(seen, 0, sizeof(seen));
+    seen[42] = true;
+    for (int t = 0; ok && t < VNI_THREADS; t++) {
+        for (int i = 0; ok && i < VNI_NETWORKS_PER_THREAD; i++) {
+            ok = vnis[t][i] >= 1 && vnis[t][i] <= MAX_VNI && !seen[vnis[t][i]];
+            seen[vnis[t][i]] = true;
+        }
+    }
+    if (!ok) {
+        printf("Concurrent VNI allocation handed out a VNI twice\n");
+        return false;
+    }
+
+    // Allocation continues past freed VNIs and only reuses them after
+    // wrapping around the whole space
+    vni_reset();
+    for (uint32_t vni = 1; vni <= 130; vni++) {
+        vni_reserve(vni);
+    }
+    ok = vni_allocate() == 131;
+    vni_release(5);
+    ok = ok && vni_allocate() == 132;
+    uint32_t allocated = 0, last = 0;
+    for (uint32_t vni; ok && (vni = vni_allocate()) != 0; allocated++) {
+        last = vni;
+    }
+    ok = ok && allocated == MAX_VNI - 131 && last == 5 && !vni_reserve(MAX_VNI);
+    if (!ok) {
+        printf("VNI allocator did not walk the whole space\n");
+    }
+    return ok;
+}
+
+// Saves endpoints into its own network while snapshots are taken
+static void* snapshot_writer(void* arg) {
+    vxlan_uuid_t network_id = test_uuid(100 + (int)(long)arg);
+    for (int i = 0; i < SNAPSHOT_WRITES_PER_WRITER; i++) {
+        vxlan_endpoint_t* endpoint = test_endpoint(&network_id);
+        if (!endpoint || !storage_save_endpoint(endpoint)) {
+            vxlan_free_endpoint(endpoint);
+            return (void*)1;
+        }
+    }
+    return NULL;
+}
+
+// Test restarting from a snapshot plus the log tail after it, including
+// snapshots taken while writers are running
+static bool test_snapshot_restart(void) {
+    char path[] = "/tmp/test_storage_wal_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return false;
+    close(fd);
+    char snap[sizeof(path) + 8];
+    snprintf(snap, sizeof(snap), "%s.snap", path);
+
+    bool ok = storage_open_log(path, WAL_SYNC_GROUP);
+    vxlan_network_t* network = vxlan_create_network("tenant-snap", "snap", 20, NULL);
+    ok = ok && network && storage_save_network(network);
+    vxlan_uuid_t network_id = network->id;
+    vxlan_uuid_t endpoint_ids[4];
+    for (int i = 0; ok && i < 3; i++) {
+        vxlan_endpoint_t* endpoint = test_endpoint(&network_id);
+        ok = endpoint && storage_save_endpoint(endpoint);
+        if (ok) endpoint_ids[i] = endpoint->id;
+    }
+
+    // The snapshot takes the log's place; only later changes stay in it
+    struct stat before, after;
+    ok = ok && stat(path, &before) == 0 && storage_snapshot() &&
+         stat(path, &after) == 0 && after.st_size < before.st_size;
+    vxlan_endpoint_t* tail = test_endpoint(&network_id);
+    ok = ok && tail && storage_save_endpoint(tail) && storage_delete_endpoint(NULL, &endpoint_ids[0]);
+    if (ok) endpoint_ids[3] = tail->id;
+
+    for (int round = 0; ok && round < 2; round++) {
+        ok = reopen_storage(path);
+        int count;
+        vxlan_endpoint_t** endpoints = storage_list_endpoints(&network_id, &count);
+        vxlan_network_t* restored = storage_get_network(&network_id);
+        ok = ok && restored && strcmp(restored->tenant_id, "tenant-snap") == 0 && vni_in_use(20) &&
+             endpoints && count == 3 &&
+             storage_get_endpoint(NULL, &endpoint_ids[0]) == NULL &&
+             storage_get_endpoint(&network_id, &endpoint_ids[3]) != NULL;
+        storage_free_endpoint_array(endpoints, count);
+        // Second round starts from a snapshot that holds everything
+        ok = ok && (round == 1 || storage_snapshot());
+    }
+
+    pthread_t writers[SNAPSHOT_WRITERS];
+    for (int i = 0; ok && i < SNAPSHOT_WRITERS; i++) {
+        ok = save_test_network(100 + i);
+    }
+    for (long i = 0; ok && i < SNAPSHOT_WRITERS; i++) {
+        pthread_create(&writers[i], NULL, snapshot_writer, (void*)i);
+    }
+    for (int i = 0; ok && i < 5; i++) {
+        ok = storage_snapshot();
+    }
+    for (int i = 0; i < SNAPSHOT_WRITERS; i++) {
+        void* result;
+        pthread_join(writers[i], &result);
+        ok &= result == NULL;
+    }
+    // Saves that raced with a snapshot may be in it and in the log tail
+    ok = ok && reopen_storage(path);
+    for (int i = 0; ok && i < SNAPSHOT_WRITERS; i++) {
+        vxlan_uuid_t writer_network = test_uuid(100 + i);
+        int count;
+        vxlan_endpoint_t** endpoints = storage_list_endpoints(&writer_network, &count);
+        ok = endpoints && count == SNAPSHOT_WRITES_PER_WRITER;
+        storage_free_endpoint_array(endpoints, count);
+    }
+
+    // A network delete replays with its endpoints
+    ok = ok && storage_delete_network(&network_id) && reopen_storage(path) &&
+         !storage_get_network(&network_id) && !storage_get_endpoint(NULL, &endpoint_ids[3]);
+
+    unlink(path);
+    unlink(snap);
+    if (!ok) {
+        printf("Snapshot restart did not restore the saved state\n");
+    }
+    return ok;
+}
+
+// Interns the same values as every other thread and records the pointers
+static void* intern_worker(void* arg) {
+    const char** seen = (const char**)arg;
+    char value[32];
+    for (int i = 0; i < INTERN_VALUES; i++) {
+        snprintf(value, sizeof(value), "intern-host-%d", i);
+        seen[i] = intern_string(value);
+        if (!seen[i] || strcmp(seen[i], value) != 0) return (void*)1;
+    }
+    return NULL;
+}
+
+// Test that repeated values share one pointer, including across threads
+static bool test_interning(void) {
+    vxlan_network_t* a = vxlan_create_network("tenant-shared", "a", 1, NULL);
+    vxlan_network_t* b = vxlan_create_network("tenant-shared", "b", 2, NULL);
+    vxlan_uuid_t network_id = test_uuid(1);
+    vxlan_endpoint_t* e1 = test_endpoint(&network_id);
+    vxlan_endpoint_t* e2 = test_endpoint(&network_id);
+    bool ok = a && b && e1 && e2 && a->tenant_id == b->tenant_id &&
+              e1->host_id == e2->host_id && e1->vtep_ip == e2->vtep_ip &&
+              intern_find_string("tenant-shared") == a->tenant_id &&
+              intern_find_string("tenant-never-seen") == NULL;
+    vxlan_free_network(a);
+    vxlan_free_network(b);
+    vxlan_free_endpoint(e1);
+    vxlan_free_endpoint(e2);
+    if (!ok) {
+        printf("Repeated values were not shared\n");
+        return false;
+    }
+
+    static const char* seen[INTERN_THREADS][INTERN_VALUES];
+    pthread_t threads[INTERN_THREADS];
+    for (int t = 0; t < INTERN_THREADS; t++) {
+        pthread_create(&threads[t], NULL, intern_worker, seen[t]);
+    }
+    for (int t = 0; t < INTERN_THREADS; t++) {
+        void* result;
+        pthread_join(threads[t], &result);
+        ok &= result == NULL;
+    }
+    for (int t = 1; ok && t < INTERN_THREADS; t++) {
+        ok = memcmp(seen[0], seen[t], sizeof(seen[0])) == 0;
+    }
+    if (!ok) {
+        printf("Concurrent interning returned different pointers\n");
+        return false;
+    }
+    return true;
+}
+
+// Writer: keeps STRESS_LIVE_ENDPOINTS endpoints in its network, replacing
+// the oldest on every step
+static void* stress_writer(void* arg) {
+    int id = (int)(long)arg;
+    vxlan_uuid_t network_id = test_uuid(id);
+    vxlan_uuid_t live[STRESS_LIVE_ENDPOINTS];
+    int head = 0, size = 0;
+
+    for (int i = 0; i < STRESS_WRITES_PER_WRITER; i++) {
+        if (size == STRESS_LIVE_ENDPOINTS) {
+            if (!storage_delete_endpoint(&network_id, &live[head])) {
+                printf("Writer %d failed to delete endpoint\n", id);
+                return (void*)1;
+            }
+            head = (head + 1) % STRESS_LIVE_ENDPOINTS;
+            size--;
+        }
+        vxlan_endpoint_t* endpoint = test_endpoint(&network_id);
+        if (!endpoint) return (void*)1;
+        live[(head + size) % STRESS_LIVE_ENDPOINTS] = endpoint->id;
+        if (!storage_save_endpoint(endpoint)) {
+            vxlan_free_endpoint(endpoint);
+            return (void*)1;
+        }
+        size++;
+    }
+    return NULL;
+}
+
+// Reader: lists a writer's network and looks up and reads every endpoint
+// while writers delete them underneath
+static void* stress_reader(void* arg) {
+    int id = (int)(long)arg;
+    unsigned long checksum = 0;
+
+    for (int round = 0; !atomic_load(&writers_done); round++) {
+        vxlan_uuid_t network_id = test_uuid((id + round) % STRESS_WRITERS);
+
+        storage_read_begin();
+        int count;
+        vxlan_endpoint_t** endpoints = storage_list_endpoints(&network_id, &count);
+        for (int i = 0; endpoints && i < count; i++) {
+            vxlan_endpoint_t* endpoint = storage_get_endpoint(&network_id, &endpoints[i]->id);
+            if (storage_find_endpoint_by_mac(&network_id, &endpoints[i]->mac_address)) {
+                checksum++;
+            }
+            checksum += endpoints[i]->mac_address.bytes[5] + strlen(endpoints[i]->host_id);
+            if (endpoint && memcmp(&endpoint->network_id, &network_id, sizeof(network_id)) != 0) {
+                printf("Reader %d saw an endpoint from the wrong network\n", id);
+                storage_read_end();
+                return (void*)1;
+            }
+        }
+        storage_free_endpoint_array(endpoints, count);
+        storage_read_end();
+    }
+    return checksum == 0 ? (void*)0 : NULL;
+}
+
+// Concurrent get/list against delete; meant to run under -fsanitize=thread
+// or -fsanitize=address to catch use-after-free
+static bool test_concurrent_get_delete(void) {
+    pthread_t writers[STRESS_WRITERS], readers[STRESS_READERS];
+    bool ok = true;
+    for (int i = 0; i < STRESS_WRITERS; i++) {
+        if (!save_test_network(i)) return false;
+    }
+
+    atomic_store(&writers_done, false);
+    for (long i = 0; i < STRESS_READERS; i++) {
+        pthread_create(&readers[i], NULL, stress_reader, (void*)i);
+    }
+    for (long i = 0; i < STRESS_WRITERS; i++) {
+        pthread_create(&writers[i], NULL, stress_writer, (void*)i);
+    }
+    for (int i = 0; i < STRESS_WRITERS; i++) {
+        void* result;
+        pthread_join(writers[i], &result);
+        ok &= result == NULL;
+    }
+    atomic_store(&writers_done, true);
+    for (int i = 0; i < STRESS_READERS; i++) {
+        void* result;
+        pthread_join(readers[i], &result);
+        ok &= result == NULL;
+    }
+
+    for (int i = 0; ok && i < STRESS_WRITERS; i++) {
+        vxlan_uuid_t network_id = test_uuid(i);
+        int count;
+        vxlan_endpoint_t** endpoints = storage_list_endpoints(&network_id, &count);
+        if (!endpoints || count != STRESS_LIVE_ENDPOINTS) {
+            printf("Network %d has %d endpoints, expected %d\n", i, count, STRESS_LIVE_ENDPOINTS);
+            ok = false;
+        }
+        storage_free_endpoint_array(endpoints, count);
+    }
+    return ok;
+}
+
+// Current token endpoint and token network of mvcc_writer
+static vxlan_uuid_t mvcc_endpoint_id, mvcc_token_id;
+
+// Replaces its network's token endpoint and the token network of
+// tenant-mvcc, always saving the new one before deleting the old, so every
+// point-in-time listing holds one or two of each
+static void* mvcc_writer(void* arg) {
+    const vxlan_uuid_t* network_id = (const vxlan_uuid_t*)arg;
+    for (int i = 0; i < MVCC_ROTATIONS; i++) {
+        vxlan_endpoint_t* endpoint = test_endpoint(network_id);
+        vxlan_network_t* token = vxlan_create_network("tenant-mvcc", "token", 0, NULL);
+        if (!endpoint || !storage_save_endpoint(endpoint) || !token || !storage_save_network(token)) {
+            vxlan_free_endpoint(endpoint);
+            vxlan_free_network(token);
+            return (void*)1;
+        }
+        if (!storage_delete_endpoint(network_id, &mvcc_endpoint_id) || !storage_delete_network(&mvcc_token_id)) {
+            return (void*)1;
+        }
+        mvcc_endpoint_id = endpoint->id;
+        mvcc_token_id = token->id;
+    }
+    return NULL;
+}
+
+// Checks that every listing is a consistent snapshot while mvcc_writer runs
+static void* mvcc_reader(void* arg) {
+    const vxlan_uuid_t* network_id = (const vxlan_uuid_t*)arg;
+    while (!atomic_load(&writers_done)) {
+        storage_read_begin();
+        int count = 0, tokens = 0;
+        vxlan_endpoint_t** endpoints = storage_list_endpoints(network_id, &count);
+        bool ok = endpoints && count >= MVCC_FIXED_ENDPOINTS + 1 && count <= MVCC_FIXED_ENDPOINTS + 2;
+        storage_free_endpoint_array(endpoints, count);
+
+        vxlan_network_t** networks = storage_list_networks(NULL, &count);
+        for (int i = 0; networks && i < count; i++) {
+            tokens += strcmp(networks[i]->tenant_id, "tenant-mvcc") == 0;
+        }
+        ok = ok && networks && tokens >= 1 && tokens <= 2;
+        storage_free_network_array(networks, count);
+        storage_read_end();
+        if (!ok) {
+            printf("Listing was not a consistent snapshot\n");
+            return (void*)1;
+        }
+    }
+    return NULL;
+}
+
+// Test that listings see a single point in time while records are created
+// and deleted under them, and that deleted versions are released after
+static bool test_list_snapshot(void) {
+    vxlan_network_t* network = vxlan_create_network("tenant-fixed", "fixed", 0, NULL);
+    if (!network || !storage_save_network(network)) {
+        vxlan_free_network(network);
+        return false;
+    }
+    vxlan_uuid_t network_id = network->id;
+    for (int i = 0; i < MVCC_FIXED_ENDPOINTS; i++) {
+        vxlan_endpoint_t* endpoint = test_endpoint(&network_id);
+        if (!endpoint || !storage_save_endpoint(endpoint)) {
+            vxlan_free_endpoint(endpoint);
+            return false;
+        }
+    }
+
+    // The first tokens are saved before the readers start
+    vxlan_endpoint_t* endpoint = test_endpoint(&network_id);
+    vxlan_network_t* token = vxlan_create_network("tenant-mvcc", "token", 0, NULL);
+    if (!endpoint || !storage_save_endpoint(endpoint) || !token || !storage_save_network(token)) {
+        vxlan_free_endpoint(endpoint);
+        vxlan_free_network(token);
+        return false;
+    }
+    mvcc_endpoint_id = endpoint->id;
+    mvcc_token_id = token->id;
+
+    pthread_t writer, readers[MVCC_READERS];
+    bool ok = true;
+    atomic_store(&writers_done, false);
+    for (int i = 0; i < MVCC_READERS; i++) {
+        pthread_create(&readers[i], NULL, mvcc_reader, &network_id);
+    }
+    pthread_create(&writer, NULL, mvcc_writer, &network_id);
+    void* result;
+    pthread_join(writer, &result);
+    ok &= result == NULL;
+    atomic_store(&writers_done, true);
+    for (int i = 0; i < MVCC_READERS; i++) {
+        pthread_join(readers[i], &result);
+        ok &= result == NULL;
+    }
+
+    // Old versions are gone once no listing is open
+    int count;
+    vxlan_endpoint_t** endpoints = storage_list_endpoints(&network_id, &count);
+    ok = ok && endpoints && count == MVCC_FIXED_ENDPOINTS + 1;
+    storage_free_endpoint_array(endpoints, count);
+    vxlan_network_t** networks = storage_list_networks("tenant-mvcc", &count);
+    ok = ok && networks && count == 1;
+    storage_free_network_array(networks, count);
+    if (!ok) {
+        printf("Snapshot listing test found inconsistent results\n");
+    }
+    return ok;
+}
+
+// Saves an endpoint into the network after a short delay
+static void* delayed_save(void* arg) {
+    struct timespec pause = {0, 50 * 1000 * 1000};
+    nanosleep(&pause, NULL);
+    vxlan_endpoint_t* endpoint = test_endpoint((const vxlan_uuid_t*)arg);
+    if (!endpoint || !storage_save_endpoint(endpoint)) {
+        vxlan_free_endpoint(endpoint);
+        return (void*)1;
+    }
+    return NULL;
+}
+
+// Test that saves and deletes are published in order, filtered by
+// network, waited for, and that an overrun feed asks for a resync
+static bool test_change_feed(void) {
+    change_t changes[8];
+    int count;
+    uint64_t start = storage_changes_last(), next;
+
+    vxlan_network_t* network = vxlan_create_network("tenant-feed", "feed", 0, NULL);
+    bool ok = network && storage_save_network(network);
+    vxlan_uuid_t network_id = network->id;
+    vxlan_endpoint_t* endpoint = test_endpoint(&network_id);
+    ok = ok && endpoint && storage_save_endpoint(endpoint);
+    vxlan_uuid_t endpoint_id = endpoint->id;
+    ok = ok && storage_delete_endpoint(&network_id, &endpoint_id);
+    ok = ok && storage_watch(start, NULL, 0, changes, 8, &count, &next) && count == 3 &&
+         changes[0].type == CHANGE_NETWORK_CREATED && changes[0].vni == network->vni &&
+         changes[1].type == CHANGE_ENDPOINT_CREATED && changes[2].type == CHANGE_ENDPOINT_DELETED &&
+         memcmp(&changes[2].endpoint.id, &endpoint_id, sizeof(endpoint_id)) == 0 &&
+         changes[0].seq == start + 1 && changes[2].seq == start + 3 && next == start + 3;
+    if (!ok) {
+        printf("Changes were not published in order\n");
+        return false;
+    }
+
+    // Changes of other networks are skipped, but the position moves on
+    vxlan_uuid_t other = test_uuid(300);
+    ok = storage_watch(start, &other, 0, changes, 8, &count, &next) && count == 0 && next == start + 3;
+    if (!ok) {
+        printf("Watch did not filter by network\n");
+        return false;
+    }
+
+    pthread_t saver;
+    pthread_create(&saver, NULL, delayed_save, &network_id);
+    ok = storage_watch(next, &network_id, 5000, changes, 8, &count, &next) && count == 1 &&
+         changes[0].type == CHANGE_ENDPOINT_CREATED;
+    void* result;
+    pthread_join(saver, &result);
+    if (!ok || result != NULL) {
+        printf("Watch did not wake up on a change\n");
+        return false;
+    }
+
+    for (int i = 0; ok && i < FEED_OVERRUN; i++) {
+        endpoint = test_endpoint(&network_id);
+        ok = endpoint && storage_save_endpoint(endpoint);
+        endpoint_id = endpoint->id;
+        ok = ok && storage_delete_endpoint(&network_id, &endpoint_id);
+    }
+    errno = 0;
+    ok = ok && !storage_watch(start, NULL, 0, changes, 8, &count, &next) && errno == ERANGE &&
+         !storage_watch(storage_changes_last() + 1, NULL, 0, changes, 8, &count, &next) && errno == ERANGE &&
+         storage_watch(storage_changes_last() - 1, NULL, 0, changes, 8, &count, &next) && count == 1;
+    if (!ok) {
+        printf("Overrun change feed did not ask for a resync\n");
+    }
+    return ok;
+}
+
+// Test that a restart resumes change sequences after the limit the last
+// run persisted, from the log and, once it is compacted, the snapshot. The
+// limit is a second of sequences ahead of the clock, so a quick restart
+// only gets past it by reading it back.
+static bool test_sequence_restart(void) {
+    char path[] = "/tmp/test_storage_wal_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return false;
+    close(fd);
+    char snap[sizeof(path) + 8];
+    snprintf(snap, sizeof(snap), "%s.snap", path);
+
+    bool ok = storage_open_log(path, WAL_SYNC_GROUP);
+    vxlan_network_t* network = vxlan_create_network("tenant-seq", "seq", 0, NULL);
+    ok = ok && network && storage_save_network(network);
+    uint64_t limit = changes_limit();
+    ok = ok && limit == storage_changes_last() + CHANGES_PERSIST_STEP - 1 && reopen_storage(path) &&
+         storage_changes_last() >= limit;
+    if (!ok) {
+        printf("Sequence limit was not recovered from the log\n");
+        unlink(path);
+        return false;
+    }
+
+    network = vxlan_create_network("tenant-seq", "seq", 0, NULL);
+    ok = network && storage_save_network(network);
+    limit = changes_limit();
+    ok = ok && storage_snapshot() && reopen_storage(path) && storage_changes_last() >= limit;
+    unlink(path);
+    unlink(snap);
+    if (!ok) {
+        printf("Sequence limit was not recovered from the snapshot\n");
+    }
+    return ok;
+}
+
+// Save an endpoint on a host, returning its id
+static bool save_on_host(const vxlan_uuid_t* network_id, const char* host_id, vxlan_uuid_t* id) {
+    vxlan_endpoint_t* endpoint = host_endpoint(network_id, host_id);
+    if (!endpoint || !storage_save_endpoint(endpoint)) {
+        vxlan_free_endpoint(endpoint);
+        return false;
+    }
+    *id = endpoint->id;
+    return true;
+}
+
+// Take the queued FDB updates of a host and check their operations
+// (a = add, r = remove, f = flush)
+static bool take_ops(const char* host_id, const char* expected) {
+    fdb_update_t updates[8];
+    int count;
+    char ops[9];
+    if (!fdb_take(host_id, updates, 8, &count, NULL, NULL, 0)) return false;
+    for (int i = 0; i < count; i++) {
+        ops[i] = "arf"[updates[i].op];
+    }
+    ops[count] = '\0';
+    return strcmp(ops, expected) == 0;
+}
+
+static void count_notify(void* ctx) {
+    (*(int*)ctx)++;
+}
+
+// Test that parked change waiters are notified once by an append of their
+// network, not by changes of other networks, that a waiter behind the feed
+// is not parked, and that cancelled waiters are not notified while timed
+// out ones are, past the changes they skipped
+static bool test_change_waiters(void) {
+    change_waiter_t first, second, other, late;
+    int notified = 0, others = 0, expired = 0;
+    vxlan_uuid_t other_id = test_uuid(500);
+    changes_waiter_init(&first, NULL, 60000, count_notify, &notified);
+    changes_waiter_init(&second, NULL, 60000, count_notify, &notified);
+    changes_waiter_init(&other, &other_id, 60000, count_notify, &others);
+    uint64_t last = storage_changes_last();
+    bool ok = changes_park(&first, last) && changes_park(&second, last) && changes_park(&other, last) &&
+              !changes_park(&first, last) && changes_cancel(&second) && !changes_cancel(&second);
+    vxlan_network_t* network = vxlan_create_network("tenant-waiters", "waiters", 0, NULL);
+    ok = ok && network && storage_save_network(network);
+    vxlan_uuid_t network_id = network->id;
+    ok = ok && notified == 1 && !first.parked && !first.timed_out && first.since == last &&
+         !changes_cancel(&first) && !changes_park(&first, last) && others == 0 && other.parked;
+    if (!ok) {
+        printf("Parked waiter was not notified once, or only for its network\n");
+        return false;
+    }
+
+    // A waiter of the network is woken by its endpoint, past the network
+    change_waiter_t mine;
+    int mine_notified = 0;
+    changes_waiter_init(&mine, &network_id, 60000, count_notify, &mine_notified);
+    uint64_t created = storage_changes_last();
+    vxlan_endpoint_t* endpoint = test_endpoint(&network_id);
+    ok = changes_park(&mine, created) && endpoint && storage_save_endpoint(endpoint) && mine_notified == 1 &&
+         mine.since == created && others == 0;
+    if (!ok) {
+        printf("Waiter was not notified by a change of its network\n");
+        return false;
+    }
+
+    // A waiter past its deadline is not parked; the sweep notifies those
+    // whose deadline passes while parked, or all of them before shutdown
+    changes_waiter_init(&first, NULL, 60000, count_notify, &notified);
+    changes_waiter_init(&late, NULL, 0, count_notify, &expired);
+    last = storage_changes_last();
+    ok = changes_park(&first, last) && !changes_park(&late, last) && late.timed_out;
+    changes_expire(false);
+    ok = ok && first.parked && other.parked && notified == 1;
+    changes_expire(true);
+    ok = ok && !first.parked && first.timed_out && notified == 2 && expired == 0 && !changes_park(&first, last) &&
+         !other.parked && others == 1 && other.since == storage_changes_last();
+    if (!ok) {
+        printf("Waiters did not time out\n");
+    }
+    return ok;
+}
+
+// Test that endpoint changes reach the other hosts of their network only,
+// that joining and leaving hosts get the network and a flush, and that
+// waiting hosts are notified
+static bool test_fdb_fanout(void) {
+    vxlan_network_t* network = vxlan_create_network("tenant-fdb", "fdb", 0, NULL);
+    if (!network || !storage_save_network(network)) {
+        vxlan_free_network(network);
+        return false;
+    }
+    vxlan_uuid_t n1 = network->id, n2 = test_uuid(400), a1, b1, b2, c1;
+    fdb_update_t update;
+    int count, notified = 0;
+
+    bool ok = save_test_network(400) && fdb_start("host-a") && fdb_start("host-b") && save_on_host(&n1, "host-a", &a1) &&
+              take_ops("host-a", "") && save_on_host(&n1, "host-b", &b1) && take_ops("host-a", "a") &&
+              save_on_host(&n2, "host-c", &c1) && take_ops("host-a", "") && take_ops("host-b", "a");
+    if (!ok) {
+        printf("Endpoint saves were not fanned out to their network's hosts\n");
+        return false;
+    }
+
+    // host-b waits; host-a leaving n1 wakes it with a remove
+    ok = fdb_take("host-b", &update, 1, &count, count_notify, &notified, 60000) && count == 0 &&
+         storage_delete_endpoint(&n1, &a1) && notified == 1 && take_ops("host-a", "f") &&
+         take_ops("host-b", "r");
+    if (!ok) {
+        printf("FDB removes, flushes or notifications were wrong\n");
+        return false;
+    }
+
+    // A wait times out, and a local save does not wake the host
+    ok = fdb_take("host-b", &update, 1, &count, count_notify, &notified, 0) && count == 0 &&
+         save_on_host(&n1, "host-b", &b2) && notified == 1;
+    fdb_expire(false);
+    ok = ok && notified == 2 && !fdb_cancel("host-b", &notified);
+
+    // A restart queues the host's whole FDB; unknown hosts have no stream
+    ok = ok && save_on_host(&n1, "host-a", &a1) && take_ops("host-b", "a") && take_ops("host-a", "aa") &&
+         fdb_start("host-a") && take_ops("host-a", "aa");
+    errno = 0;
+    ok = ok && !fdb_take("host-c", &update, 1, &count, NULL, NULL, 0) && errno == ENOENT;
+    if (!ok) {
+        printf("FDB expiry, restart or unknown host was wrong\n");
+    }
+    return ok;
+}
+
+#define CASCADE_ENDPOINTS 500
+
+static vxlan_uuid_t cascade_network_id;
+static vxlan_uuid_t cascade_endpoint_ids[CASCADE_ENDPOINTS];
+
+// Deletes the endpoints of cascade_network_id one by one, from the last;
+// returns how many it deleted
+static void* cascade_deleter(void* arg) {
+    (void)arg;
+    long deleted = 0;
+    for (int i = CASCADE_ENDPOINTS - 1; i >= 0; i--) {
+        deleted += storage_delete_endpoint(&cascade_network_id, &cascade_endpoint_ids[i]);
+    }
+    return (void*)deleted;
+}
+
+// Test that a restart rebuilds the FDB from the recovered tables with each
+// network's VNI, for endpoints from the snapshot and from the log tail
+static bool test_fdb_restart(void) {
+    char path[] = "/tmp/test_storage_wal_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return false;
+    close(fd);
+    char snap[sizeof(path) + 8];
+    snprintf(snap, sizeof(snap), "%s.snap", path);
+
+    bool ok = storage_open_log(path, WAL_SYNC_GROUP);
+    vxlan_network_t* network = vxlan_create_network("tenant-fdb-restart", "fdb", 0, NULL);
+    ok = ok && network && storage_save_network(network);
+    vxlan_uuid_t network_id = network->id, a1, b1, b2;
+    uint32_t vni = network->vni;
+    ok = ok && save_on_host(&network_id, "host-a", &a1) && save_on_host(&network_id, "host-b", &b1) &&
+         storage_snapshot() && save_on_host(&network_id, "host-b", &b2) && reopen_storage(path);
+
+    fdb_update_t updates[8];
+    int count = 0;
+    ok = ok && fdb_start("host-a") && fdb_take("host-a", updates, 8, &count, NULL, NULL, 0) && count == 2;
+    for (int i = 0; ok && i < count; i++) {
+        ok = updates[i].op == FDB_ADD && updates[i].vni == vni;
+    }
+    ok = ok && fdb_start("host-b") && fdb_take("host-b", updates, 8, &count, NULL, NULL, 0) && count == 1 &&
+         updates[0].vni == vni && memcmp(&updates[0].endpoint.id, &a1, sizeof(a1)) == 0;
+    ok = ok && storage_delete_network(&network_id) && fdb_take("host-a", updates, 8, &count, NULL, NULL, 0) &&
+         count == 1 && updates[0].op == FDB_FLUSH && updates[0].vni == vni;
+    unlink(path);
+    unlink(snap);
+    if (!ok) {
+        printf("FDB was not rebuilt with its VNIs after a restart\n");
+    }
+    return ok;
+}
+
+// Test that deleting a network deletes its endpoints with it, in one
+// change, one FDB flush per host and one teardown batch
+static bool test_network_cascade(void) {
+    vxlan_network_t* network = vxlan_create_network("tenant-cascade", "doomed", 0, NULL);
+    vxlan_network_t* other = vxlan_create_network("tenant-cascade", "kept", 0, NULL);
+    if (!network || !other || !storage_save_network(network) || !storage_save_network(other)) {
+        printf("Failed to save networks\n");
+        return false;
+    }
+    vxlan_uuid_t network_id = network->id, other_id = other->id, kept, first, last;
+    bool ok = save_on_host(&other_id, "cascade-a", &kept) && save_on_host(&other_id, "cascade-b", &kept);
+    for (int i = 0; i < CASCADE_ENDPOINTS && ok; i++) {
+        ok = save_on_host(&network_id, i % 2 ? "cascade-a" : "cascade-b", i ? &last : &first);
+    }
+    // Start the stream of host a and drain its full FDB
+    fdb_update_t updates[64];
+    ok = ok && fdb_start("cascade-a");
+    int count = 1;
+    while (ok && count > 0) {
+        ok = fdb_take("cascade-a", updates, 64, &count, NULL, NULL, 0);
+    }
+    if (!ok) {
+        printf("Failed to save endpoints\n");
+        return false;
+    }
+
+    uint64_t since = storage_changes_last();
+    vxlan_network_t* deleted;
+    vxlan_endpoint_t** endpoints;
+    storage_read_begin();
+    ok = storage_delete_network_endpoints(&network_id, &deleted, &endpoints, &count) && deleted == network &&
+         count == CASCADE_ENDPOINTS;
+    char* teardown = ok ? vxlan_generate_teardown_cmds(deleted, endpoints, count) : NULL;
+    int lines = 0;
+    for (const char* c = teardown; c && *c; c++) {
+        lines += *c == '\n';
+    }
+    storage_read_end();
+    if (ok) {
+        storage_free_endpoint_array(endpoints, count);
+    }
+    free(teardown);
+    if (!ok || lines != CASCADE_ENDPOINTS + 1) {
+        printf("Cascade returned %d endpoints and %d teardown commands\n", ok ? count : -1, lines);
+        return false;
+    }
+
+    int listed = -1;
+    vxlan_endpoint_t** remaining = storage_list_endpoints(&network_id, &listed);
+    storage_free_endpoint_array(remaining, listed);
+    change_t changes[4];
+    uint64_t next;
+    ok = listed == 0 && !storage_get_endpoint(NULL, &first) && !storage_get_endpoint(NULL, &last) &&
+         storage_get_endpoint(&other_id, &kept) && !storage_delete_network(&network_id) &&
+         storage_watch(since, NULL, 0, changes, 4, &count, &next) && count == 1 &&
+         changes[0].type == CHANGE_NETWORK_DELETED && take_ops("cascade-a", "f");
+    listed = -1;
+    remaining = storage_list_endpoints(&other_id, &listed);
+    storage_free_endpoint_array(remaining, listed);
+    if (!ok || listed != 2) {
+        printf("Cascade left endpoints behind or published the wrong changes\n");
+        return false;
+    }
+
+    // A save into the deleted network fails before it is published
+    since = storage_changes_last();
+    vxlan_endpoint_t* orphan = host_endpoint(&network_id, "cascade-b");
+    errno = 0;
+    ok = orphan && !storage_save_endpoint(orphan) && errno == ENOENT && storage_changes_last() == since &&
+         take_ops("cascade-a", "");
+    vxlan_free_endpoint(orphan);
+    if (!ok) {
+        printf("Endpoint saved into a deleted network\n");
+        return false;
+    }
+
+    // Racing deletes of single endpoints: each endpoint goes exactly once
+    network = vxlan_create_network("tenant-cascade", "raced", 0, NULL);
+    ok = network && storage_save_network(network);
+    cascade_network_id = ok ? network->id : network_id;
+    for (int i = 0; i < CASCADE_ENDPOINTS && ok; i++) {
+        ok = save_on_host(&cascade_network_id, "cascade-a", &cascade_endpoint_ids[i]);
+    }
+    pthread_t deleter;
+    void* deleted_alone = NULL;
+    if (ok && pthread_create(&deleter, NULL, cascade_deleter, NULL) == 0) {
+        storage_read_begin();
+        ok = storage_delete_network_endpoints(&cascade_network_id, &deleted, &endpoints, &count);
+        storage_read_end();
+        pthread_join(deleter, &deleted_alone);
+        if (ok) {
+            storage_free_endpoint_array(endpoints, count);
+        }
+        ok = ok && count + (long)deleted_alone == CASCADE_ENDPOINTS;
+    } else {
+        ok = false;
+    }
+    for (int i = 0; i < CASCADE_ENDPOINTS && ok; i++) {
+        ok = !storage_get_endpoint(NULL, &cascade_endpoint_ids[i]);
+    }
+    if (!ok) {
+        printf("Cascade and single deletes removed %d and %ld endpoints\n", count, (long)deleted_alone);
+    }
+    return ok;
+}
+
+// Main test function
+static void count_node(hash_node_t* node, void* ctx) {
+    (void)node;
+    (*(size_t*)ctx)++;
+}
+
+// Test the id table: growth, misses, tombstones from removes and their
+// reuse, and rebuilds that only drop tombstones
+static bool test_id_table(void) {
+    vxlan_uuid_t* ids = malloc(ID_TABLE_NODES * sizeof(vxlan_uuid_t));
+    hash_node_t* nodes = calloc(ID_TABLE_NODES, sizeof(hash_node_t));
+    id_table_t table;
+    if (!ids || !nodes || !id_table_init(&table)) {
+        free(ids);
+        free(nodes);
+        return false;
+    }
+
+    bool ok = true;
+    for (int i = 0; i < ID_TABLE_NODES && ok; i++) {
+        ids[i] = test_uuid(i);
+        nodes[i].key = ids[i].bytes;
+        nodes[i].key_len = sizeof(ids[i].bytes);
+        nodes[i].hash = id_hash(ids[i].bytes);
+        ok = id_table_insert(&table, &nodes[i]);
+    }
+    for (int i = 0; i < ID_TABLE_NODES && ok; i++) {
+        ok = id_table_find(&table, ids[i].bytes, nodes[i].hash) == &nodes[i];
+    }
+    vxlan_uuid_t missing = test_uuid(ID_TABLE_NODES);
+    ok = ok && id_table_count(&table) == ID_TABLE_NODES &&
+         !id_table_find(&table, missing.bytes, id_hash(missing.bytes));
+    if (!ok) printf("Id table lost a node while growing\n");
+
+    // Remove and reinsert the even nodes a few times over, so tombstones
+    // pile up and force rebuilds at the same size
+    for (int round = 0; round < 4 && ok; round++) {
+        for (int i = 0; i < ID_TABLE_NODES && ok; i += 2) {
+            ok = id_table_remove(&table, &nodes[i]) && !id_table_remove(&table, &nodes[i]);
+        }
+        for (int i = 0; i < ID_TABLE_NODES && ok; i++) {
+            hash_node_t* found = id_table_find(&table, ids[i].bytes, nodes[i].hash);
+            ok = found == (i % 2 ? &nodes[i] : NULL);
+        }
+        for (int i = 0; i < ID_TABLE_NODES && ok; i += 2) {
+            ok = id_table_insert(&table, &nodes[i]);
+        }
+    }
+    size_t visited = 0;
+    id_table_foreach(&table, count_node, &visited);
+    ok = ok && id_table_count(&table) == ID_TABLE_NODES && visited == ID_TABLE_NODES;
+    if (!ok) printf("Id table lost a node across removes\n");
+
+    id_table_destroy(&table);
+    free(ids);
+    free(nodes);
+    return ok;
+}
+
+// Page through all networks (or a tenant's) in pages of limit; returns how
+// many were seen, or -1 when the ids are not strictly increasing
+static int page_networks(const char* tenant_id, int limit) {
+    vxlan_uuid_t after;
+    bool has_after = false;
+    int seen = 0;
+
+    for (;;) {
+        int count;
+        vxlan_network_t** page = storage_list_networks_page(tenant_id, has_after ? &after : NULL, limit, &count);
+        if (!page) return -1;
+        for (int i = 0; i < count; i++) {
+            if (has_after && memcmp(page[i]->id.bytes, after.bytes, sizeof(after.bytes)) <= 0) {
+                storage_free_network_array(page, count);
+                return -1;
+            }
+            after = page[i]->id;
+            has_after = true;
+        }
+        seen += count;
+        storage_free_network_array(page, count);
+        if (count < limit) return seen;
+    }
+}
+
+// Test routing across shards: tenant listings, listings and pages merged
+// across shards, and records whose id tags do not match their shard
+static bool test_shards(void) {
+    if (storage_init_shards(3) || errno != EINVAL) {
+        printf("A shard count that is not a power of two was accepted\n");
+        return false;
+    }
+
+    char tenant[32];
+    vxlan_network_t* network = NULL;
+    for (int t = 0; t < SHARD_TENANTS; t++) {
+        snprintf(tenant, sizeof(tenant), "shard-tenant-%d", t);
+        for (int i = 0; i < SHARD_NETWORKS_PER_TENANT; i++) {
+            network = vxlan_create_network(tenant, "n", 0, NULL);
+            if (!network || !storage_save_network(network)) return false;
+            if (network->id.bytes[VXLAN_UUID_TAG_BYTE] != vxlan_tenant_tag(tenant)) {
+                printf("Network id not tagged with its tenant\n");
+                return false;
+            }
+        }
+    }
+
+    int total = SHARD_TENANTS * SHARD_NETWORKS_PER_TENANT, count;
+    vxlan_network_t** networks = storage_list_networks(NULL, &count);
+    storage_free_network_array(networks, count);
+    if (!networks || count != total || page_networks(NULL, 5) != total) {
+        printf("Merged listing returned %d networks, expected %d\n", count, total);
+        return false;
+    }
+    networks = storage_list_networks(tenant, &count);
+    storage_free_network_array(networks, count);
+    if (!networks || count != SHARD_NETWORKS_PER_TENANT) {
+        printf("Tenant listing returned %d networks, expected %d\n", count, SHARD_NETWORKS_PER_TENANT);
+        return false;
+    }
+
+    // Endpoints share their network's tag, so a bare id finds its shard
+    vxlan_endpoint_t* endpoint = test_endpoint(&network->id);
+    if (!endpoint || !storage_save_endpoint(endpoint) || storage_get_endpoint(NULL, &endpoint->id) != endpoint) {
+        printf("Tagged endpoint not found by id\n");
+        return false;
+    }
+
+    // Records from before tagging live outside their tenant's shard
+    vxlan_network_t fields = { .tenant_id = tenant, .name = "legacy" };
+    fields.id = test_uuid(7);
+    fields.id.bytes[VXLAN_UUID_TAG_BYTE] = vxlan_tenant_tag(tenant) ^ 1;
+    vxlan_network_t* legacy = vxlan_restore_network(&fields);
+    if (!legacy || !storage_save_network(legacy)) return false;
+    networks = storage_list_networks(tenant, &count);
+    storage_free_network_array(networks, count);
+    if (!networks || count != SHARD_NETWORKS_PER_TENANT + 1 ||
+        page_networks(tenant, 1) != SHARD_NETWORKS_PER_TENANT + 1) {
+        printf("Tenant listing missed a network outside the tenant's shard\n");
+        return false;
+    }
+
+    vxlan_endpoint_t* stray = test_endpoint(&network->id);
+    if (!stray) return false;
+    stray->id.bytes[VXLAN_UUID_TAG_BYTE] ^= 1;
+    vxlan_uuid_t stray_id = stray->id;
+    if (!storage_save_endpoint(stray) || storage_get_endpoint(NULL, &stray_id) != stray ||
+        !storage_delete_endpoint(NULL, &stray_id) || storage_get_endpoint(NULL, &stray_id)) {
+        printf("Endpoint outside its id's shard not found by id\n");
+        return false;
+    }
+    return true;
+}
+
+// Record versions are unique and never reused after a restart, and a
+// network's endpoint list gets a new version with each save and delete
+static bool test_versions(void) {
+    vxlan_network_t* network = vxlan_create_network("version-tenant", "v", 0, NULL);
+    if (!network || !storage_save_network(network)) return false;
+    uint64_t network_version = network->version;
+    vxlan_uuid_t network_id = network->id;
+    if (!network_version || storage_endpoints_version(&network_id) != network_version) {
+        printf("New network's endpoint list does not share its version\n");
+        return false;
+    }
+    vxlan_uuid_t unknown = test_uuid(9);
+    if (storage_endpoints_version(&unknown) != 0) {
+        printf("Unknown network has an endpoint list version\n");
+        return false;
+    }
+
+    vxlan_endpoint_t* a = test_endpoint(&network_id);
+    if (!a || !storage_save_endpoint(a)) return false;
+    uint64_t added = storage_endpoints_version(&network_id);
+    if (a->version <= network_version || added < a->version) {
+        printf("Endpoint save did not advance versions\n");
+        return false;
+    }
+    if (!storage_delete_endpoint(&network_id, &a->id) || storage_endpoints_version(&network_id) <= added) {
+        printf("Endpoint delete did not advance the list version\n");
+        return false;
+    }
+
+    // A restart starts versions from the clock, past every earlier one
+    uint64_t last = storage_endpoints_version(&network_id);
+    storage_cleanup();
+    if (!storage_init()) return false;
+    network = vxlan_create_network("version-tenant", "v", 0, NULL);
+    if (!network || !storage_save_network(network) || network->version <= last) {
+        printf("Version reused after a restart\n");
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    logging_set_level(LOG_LEVEL_ERROR);
+
+    printf("Running storage tests...\n\n");
+
+    struct {
+        const char* name;
+        bool (*run)(void);
+    } tests[] = {
+        {"save/get/delete", test_save_get_delete},
+        {"index listing", test_list_indexes},
+        {"paged listing", test_list_pages},
+        {"interning", test_interning},
+        {"vni uniqueness", test_vni},
+        {"address conflicts", test_address_conflicts},
+        {"vni lookup", test_vni_lookup},
+        {"log replay", test_log_replay},
+        {"snapshot restart", test_snapshot_restart},
+        {"concurrent get/delete", test_concurrent_get_delete},
+        {"snapshot listing", test_list_snapshot},
+        {"change feed", test_change_feed},
+        {"sequence restart", test_sequence_restart},
+        {"change waiters", test_change_waiters},
+        {"fdb fan-out", test_fdb_fanout},
+        {"fdb restart", test_fdb_restart},
+        {"network cascade", test_network_cascade},
+        {"shards", test_shards},
+        {"id table", test_id_table},
+        {"versions", test_versions},
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        printf("Testing %s...\n", tests[i].name);
+        if (!storage_init()) {
+            printf("Failed to initialize storage\n");
+            return 1;
+        }
+        bool passed = tests[i].run();
+        storage_cleanup();
+        if (!passed) {
+            printf("%s test failed\n", tests[i].name);
+            return 1;
+        }
+        printf("%s test passed\n\n", tests[i].name);
+    }
+
+    printf("All tests passed!\n");
+    return 0;
+}